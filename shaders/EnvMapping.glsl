@@ -29,8 +29,8 @@ uniform mat4 uModelViewProjMatrix;
 uniform mat4 uModelMatrix;
 uniform mat3 uNormalMatrix;
 uniform vec3 uEyePosWS;
-uniform mat4 uIrradianceMatrix[3];  // RGB irradiance coefficient matrices
-uniform mat3 uInvSkyboxRotation;    // tp question
+uniform mat4 uIrradianceMatrix[3];  // RGB irradiance coefficient matrices, 
+                                    // rotated as the skybox
 
 
 vec3 computeIrradiance( vec3 normal, mat4 M[3])
@@ -58,8 +58,270 @@ void main()
   vViewDirWS = normalize(posWS - uEyePosWS);
   
   // Irradiance color for RGB components
-  vec3 normalWS = uInvSkyboxRotation * vNormalWS;
-  vIrradiance = computeIrradiance( normalWS, uIrradianceMatrix);
+  vIrradiance = computeIrradiance( vNormalWS, uIrradianceMatrix);
+}
+
+
+--
+
+//------------------------------------------------------------------------------
+
+
+-- Vertex.Packed
+
+// Irradiance of the matrices as their polynomial on normalized normals (cf. 
+// IrradianceEnvMap::getIrradiancePolynomial) : 9 RGB coefficients instead of 
+// 3 symmetric mat4, and 8 vec3 multiply-adds instead of 3 matrix products.
+
+// IN
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+// OUT
+out vec3 vNormalWS;
+out vec3 vViewDirWS;
+out vec3 vIrradiance;
+
+// UNIFORM
+uniform mat4 uModelViewProjMatrix;
+uniform mat4 uModelMatrix;
+uniform mat3 uNormalMatrix;
+uniform vec3 uEyePosWS;
+uniform vec3 uIrradiancePoly[9];    // RGB coefficients of 1, y, z, x, xy, yz, 
+                                    // z^2, xz, x^2-y^2, rotated as the skybox
+
+
+vec3 computeIrradiance( vec3 n )
+{
+  vec3 output = uIrradiancePoly[0];
+  
+  output += uIrradiancePoly[1] * n.y;
+  output += uIrradiancePoly[2] * n.z;
+  output += uIrradiancePoly[3] * n.x;
+  output += uIrradiancePoly[4] * (n.x * n.y);
+  output += uIrradiancePoly[5] * (n.y * n.z);
+  output += uIrradiancePoly[6] * (n.z * n.z);
+  output += uIrradiancePoly[7] * (n.x * n.z);
+  output += uIrradiancePoly[8] * (n.x * n.x - n.y * n.y);
+  
+  return output;
+}
+
+void main()
+{
+  // Clip Space position
+  gl_Position = uModelViewProjMatrix * inPosition;
+
+  // World Space normal
+  vNormalWS = normalize( uNormalMatrix * inNormal );
+  
+  // World Space view direction from world space position
+  vec3 posWS = vec3(uModelMatrix * inPosition);
+  vViewDirWS = normalize(posWS - uEyePosWS);
+  
+  // Irradiance color for RGB components
+  vIrradiance = computeIrradiance( vNormalWS );
+}
+
+
+--
+
+//------------------------------------------------------------------------------
+
+
+-- Vertex.SH
+
+// Irradiance from SH coefficients of order SH_ORDER (1 to 8, set by the 
+// application), evaluated with the recurrences of irradianceSH.hpp.
+
+// IN
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+// OUT
+out vec3 vNormalWS;
+out vec3 vViewDirWS;
+out vec3 vIrradiance;
+
+// UNIFORM
+uniform mat4 uModelViewProjMatrix;
+uniform mat4 uModelMatrix;
+uniform mat3 uNormalMatrix;
+uniform vec3 uEyePosWS;
+uniform vec3 uSHIrradiance[(SH_ORDER+1)*(SH_ORDER+1)];  // normalized RGB coefficients, 
+                                                        // rotated as the skybox
+
+
+vec3 computeIrradiance( vec3 n )
+{
+  vec3 output = vec3( 0.0f );
+  
+  float cm = 1.0f;    // C_m
+  float sm = 0.0f;    // S_m
+  float pmm = 1.0f;   // P_m,m
+  
+  for (int m=0; m<=SH_ORDER; ++m)
+  {
+    if (m > 0) 
+    {
+      float c = n.x * cm - n.y * sm;
+      sm = n.x * sm + n.y * cm;
+      cm = c;
+      pmm *= float(2*m - 1);
+    }
+    
+    float p2 = 0.0f;
+    float p1 = pmm;
+    
+    for (int l=m; l<=SH_ORDER; ++l)
+    {
+      if (l > m)
+      {
+        float p = (float(2*l - 1) * n.z * p1 - float(l + m - 1) * p2) / float(l - m);
+        p2 = p1;
+        p1 = p;
+      }
+      
+      int id = l * (l+1);
+      if (m == 0) {
+        output += p1 * uSHIrradiance[id];
+      } else {
+        output += (p1 * cm) * uSHIrradiance[id+m] + (p1 * sm) * uSHIrradiance[id-m];
+      }
+    }
+  }
+  
+  return output;
+}
+
+void main()
+{
+  // Clip Space position
+  gl_Position = uModelViewProjMatrix * inPosition;
+
+  // World Space normal
+  vNormalWS = normalize( uNormalMatrix * inNormal );
+  
+  // World Space view direction from world space position
+  vec3 posWS = vec3(uModelMatrix * inPosition);
+  vViewDirWS = normalize(posWS - uEyePosWS);
+  
+  // Irradiance color for RGB components
+  vIrradiance = computeIrradiance( vNormalWS );
+}
+
+
+--
+
+//------------------------------------------------------------------------------
+
+
+-- Vertex.L1
+
+// Irradiance from the 4 SH coefficients of order 1 (SH_ORDER 1), as the 
+// linear polynomial of the basis instead of the recurrences of Vertex.SH.
+
+// IN
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+// OUT
+out vec3 vNormalWS;
+out vec3 vViewDirWS;
+out vec3 vIrradiance;
+
+// UNIFORM
+uniform mat4 uModelViewProjMatrix;
+uniform mat4 uModelMatrix;
+uniform mat3 uNormalMatrix;
+uniform vec3 uEyePosWS;
+uniform vec3 uSHIrradiance[4];     // normalized RGB coefficients, 
+                                    // rotated as the skybox
+
+
+vec3 computeIrradiance( vec3 n )
+{
+  return uSHIrradiance[0] + uSHIrradiance[1] * n.y + 
+         uSHIrradiance[2] * n.z + uSHIrradiance[3] * n.x;
+}
+
+void main()
+{
+  // Clip Space position
+  gl_Position = uModelViewProjMatrix * inPosition;
+
+  // World Space normal
+  vNormalWS = normalize( uNormalMatrix * inNormal );
+  
+  // World Space view direction from world space position
+  vec3 posWS = vec3(uModelMatrix * inPosition);
+  vViewDirWS = normalize(posWS - uEyePosWS);
+  
+  // Irradiance color for RGB components
+  vIrradiance = computeIrradiance( vNormalWS );
+}
+
+
+--
+
+//------------------------------------------------------------------------------
+
+
+-- Vertex.HBasis
+
+// Irradiance from the H-basis of the hemisphere of the normal around Y, 
+// HBASIS_SIZE (4 or 6) coefficients being evaluated (cf. irradianceHBasis.hpp).
+
+// IN
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+// OUT
+out vec3 vNormalWS;
+out vec3 vViewDirWS;
+out vec3 vIrradiance;
+
+// UNIFORM
+uniform mat4 uModelViewProjMatrix;
+uniform mat4 uModelMatrix;
+uniform mat3 uNormalMatrix;
+uniform vec3 uEyePosWS;
+uniform vec3 uHBasisIrradiance[2*HBASIS_SIZE];  // normalized RGB coefficients of the
+                                                // hemispheres y >= 0 and y < 0,
+                                                // rotated as the skybox
+
+
+vec3 computeIrradiance( vec3 n )
+{
+  int h = (n.y >= 0.0f) ? 0 : HBASIS_SIZE;
+  
+  vec3 output = uHBasisIrradiance[h];
+  output += uHBasisIrradiance[h+1] * n.z;
+  output += uHBasisIrradiance[h+2] * (2.0f * abs(n.y) - 1.0f);
+  output += uHBasisIrradiance[h+3] * n.x;
+  
+#if HBASIS_SIZE > 4
+  output += uHBasisIrradiance[h+4] * (n.x * n.z);
+  output += uHBasisIrradiance[h+5] * (n.x * n.x - n.z * n.z);
+#endif
+  
+  return output;
+}
+
+void main()
+{
+  // Clip Space position
+  gl_Position = uModelViewProjMatrix * inPosition;
+
+  // World Space normal
+  vNormalWS = normalize( uNormalMatrix * inNormal );
+  
+  // World Space view direction from world space position
+  vec3 posWS = vec3(uModelMatrix * inPosition);
+  vViewDirWS = normalize(posWS - uEyePosWS);
+  
+  // Irradiance color for RGB components
+  vIrradiance = computeIrradiance( vNormalWS );
 }
 
 
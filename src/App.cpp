@@ -5,6 +5,7 @@
  */
 
 
+#include <algorithm>
 #include <cstdio>
 #include <vector>
 
@@ -18,10 +19,33 @@
 
 
 
+#if IEM_SH_ORDER == 2
+/// Irradiance uniforms of the order 2 program
+static
+const char* getIrradianceLayoutName( const bool bPacked )
+{
+  #if ENABLE_IEM_HBASIS
+  return bPacked ? "H-basis" : "matrices";
+  #else
+  return bPacked ? "packed polynomial" : "matrices";
+  #endif
+}
+#endif
+
+
 App::App()
 {
   m_bInitialized = false;
   m_Mesh = 0;
+  
+  m_bPackedIrradiance = true;
+  m_DenseMesh = 0;
+  m_bDenseMesh = false;
+  
+  m_timerQuery = 0u;
+  m_bTimerPending = false;
+  m_gpuTime = 0.0;
+  m_numTimedFrames = 0;
 }
 
 App::~App()
@@ -31,6 +55,9 @@ App::~App()
   } 
   
   if (m_Mesh) delete m_Mesh;
+  if (m_DenseMesh) delete m_DenseMesh;
+  
+  if (m_timerQuery) glDeleteQueries( 1, &m_timerQuery);
 }
 
 void App::init(TCamera *pCamera)
@@ -48,22 +75,57 @@ void App::init(TCamera *pCamera)
   //m_skyBox.addCubemap( "data/cubemap/Grace/grace_*.bmp" );
   m_skyBox.setCubemap( 0u );  
   
+  #if ENABLE_IEM_FACE_WATCH && (IEM_SH_ORDER <= 2)
+  _watchFaces();
+  #endif
+  
   /// Init Environment mapping Program
   m_envMapProgram.generate();
-    m_envMapProgram.addShader( GL_VERTEX_SHADER, "EnvMapping.Vertex");
+    #if IEM_SH_ORDER == 1
+    m_envMapProgram.addShader( GL_VERTEX_SHADER, "EnvMapping.Vertex.L1");
+    #elif IEM_SH_ORDER != 2
+    m_envMapProgram.addShader( GL_VERTEX_SHADER, "EnvMapping.Vertex.SH");
+    #elif ENABLE_IEM_HBASIS
+    m_envMapProgram.addShader( GL_VERTEX_SHADER, "EnvMapping.Vertex.HBasis");
+    #else
+    m_envMapProgram.addShader( GL_VERTEX_SHADER, "EnvMapping.Vertex.Packed");
+    #endif
     m_envMapProgram.addShader( GL_FRAGMENT_SHADER, "EnvMapping.Fragment");
   m_envMapProgram.link();  
   
+  #if IEM_SH_ORDER == 2
+  m_envMapMatrixProgram.generate();
+    m_envMapMatrixProgram.addShader( GL_VERTEX_SHADER, "EnvMapping.Vertex");
+    m_envMapMatrixProgram.addShader( GL_FRAGMENT_SHADER, "EnvMapping.Fragment");
+  m_envMapMatrixProgram.link();
+  #endif
+  
   /// Init mesh
   m_Mesh = new SphereMesh( 48, 5.0f);
   m_Mesh->init();
   
+  m_DenseMesh = new SphereMesh( 1024, 5.0f);
+  m_DenseMesh->init();
+  
+  glGenQueries( 1, &m_timerQuery);
+  
   
   m_bInitialized = true;
 }
 
 void App::update()
 {
+  #if ENABLE_IEM_FACE_WATCH && (IEM_SH_ORDER <= 2)
+  /// Faces written since the last frame
+  std::vector<int> changed;
+  m_faceWatcher.poll( changed );
+  
+  for (size_t i=0u; i<changed.size(); ++i)
+  {
+    const std::pair<size_t, int> &face = m_watchedFaces[ changed[i] ];
+    m_skyBox.getCubemap( face.first )->reloadFace( face.second );
+  }
+  #endif
 }
 
 void App::render()
@@ -88,6 +150,25 @@ void App::keyEvent(unsigned char k)
     case 'r':
       m_skyBox.toggleAutoRotate();
     break;
+    
+    case 'p':
+      #if IEM_SH_ORDER == 2
+      _reportGPUTime();
+      m_bPackedIrradiance = !m_bPackedIrradiance;
+      fprintf( stderr, "Irradiance uniforms : %s\n", 
+               getIrradianceLayoutName( m_bPackedIrradiance ));
+      #endif
+    break;
+    
+    case 'd':
+      _reportGPUTime();
+      m_bDenseMesh = !m_bDenseMesh;
+      fprintf( stderr, "Mesh : %s\n", m_bDenseMesh ? "dense" : "default");
+    break;
+    
+    case 't':
+      _reportGPUTime();
+    break;
   }
 }
 
@@ -103,38 +184,137 @@ void App::_renderScene()
   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glEnable(GL_CULL_FACE);
 
-  m_envMapProgram.bind();
+  const ProgramShader &program = m_bPackedIrradiance ? m_envMapProgram : m_envMapMatrixProgram;
+  const Mesh *mesh = m_bDenseMesh ? m_DenseMesh : m_Mesh;
+  
+  /// Time the scene when the previous query is done, without stalling
+  if (m_bTimerPending)
+  {
+    GLint available = 0;
+    glGetQueryObjectiv( m_timerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    
+    if (available)
+    {
+      GLuint64 elapsed = 0u;
+      glGetQueryObjectui64v( m_timerQuery, GL_QUERY_RESULT, &elapsed);
+      m_gpuTime += 1.0e-6 * elapsed;
+      ++m_numTimedFrames;
+      m_bTimerPending = false;
+    }
+  }
+  
+  const bool bTimed = !m_bTimerPending;
+  if (bTimed) {
+    glBeginQuery( GL_TIME_ELAPSED, m_timerQuery);
+  }
+  
+  program.bind();
   {
     // Vertex uniforms
-    glm::mat4 mvp = m_pCamera->getViewProjMatrix() * m_Mesh->getModelMatrix();
-    m_envMapProgram.setUniform( "uModelViewProjMatrix", mvp);
-    m_envMapProgram.setUniform( "uModelMatrix", m_Mesh->getModelMatrix());
-    m_envMapProgram.setUniform( "uNormalMatrix", m_Mesh->getNormalMatrix());
-    m_envMapProgram.setUniform( "uEyePosWS", m_pCamera->getPosition());
-    m_envMapProgram.setUniform( "uInvSkyboxRotation", m_skyBox.getInvRotateMatrix() );
+    glm::mat4 mvp = m_pCamera->getViewProjMatrix() * mesh->getModelMatrix();
+    program.setUniform( "uModelViewProjMatrix", mvp);
+    program.setUniform( "uModelMatrix", mesh->getModelMatrix());
+    program.setUniform( "uNormalMatrix", mesh->getNormalMatrix());
+    program.setUniform( "uEyePosWS", m_pCamera->getPosition());
     
     TextureCubemap *cubemap = m_skyBox.getCurrentCubemap();
     
     if (cubemap->hasSphericalHarmonics())
     {
-      glm::mat4 *M = cubemap->getSHMatrices();
-      m_envMapProgram.setUniform( "uIrradianceMatrix[0]", M[0]);
-      m_envMapProgram.setUniform( "uIrradianceMatrix[1]", M[1]);
-      m_envMapProgram.setUniform( "uIrradianceMatrix[2]", M[2]);
+      #if IEM_SH_ORDER != 2
+      program.setUniform( "uSHIrradiance", m_skyBox.getSHIrradiance(), 
+                          (IEM_SH_ORDER+1) * (IEM_SH_ORDER+1));
+      #else
+      if (m_bPackedIrradiance) 
+      {
+        #if ENABLE_IEM_HBASIS
+        program.setUniform( "uHBasisIrradiance", m_skyBox.getHBasisIrradiance(), 
+                            2 * IEM_HBASIS_SIZE);
+        #else
+        // 27 floats instead of 48
+        program.setUniform( "uIrradiancePoly", m_skyBox.getSHPolynomial(), 9);
+        #endif
+      }
+      else
+      {
+        const glm::mat4 *M = m_skyBox.getSHMatrices();
+        program.setUniform( "uIrradianceMatrix[0]", M[0]);
+        program.setUniform( "uIrradianceMatrix[1]", M[1]);
+        program.setUniform( "uIrradianceMatrix[2]", M[2]);
+      }
+      #endif
     }
     
     // Fragment uniforms
-    m_envMapProgram.setUniform( "uEnvmap", 0);
+    program.setUniform( "uEnvmap", 0);
     
     cubemap->bind( 0u );
       glCullFace( GL_FRONT );
-      m_Mesh->draw();
+      mesh->draw();
       glCullFace( GL_BACK );
-      m_Mesh->draw();
+      mesh->draw();
     cubemap->unbind( 0u );
   }
-  m_envMapProgram.unbind();
+  program.unbind();
+  
+  if (bTimed) 
+  {
+    glEndQuery( GL_TIME_ELAPSED );
+    m_bTimerPending = true;
+  }
   
   glDisable(GL_CULL_FACE);
   glDisable(GL_BLEND);
 }
+
+void App::_reportGPUTime()
+{
+  if (m_numTimedFrames > 0)
+  {
+    fprintf( stderr, "scene GPU time : %.3f ms (%s mesh, %s, %d frames)\n", 
+             m_gpuTime / m_numTimedFrames, m_bDenseMesh ? "dense" : "default",
+             #if IEM_SH_ORDER == 2
+             getIrradianceLayoutName( m_bPackedIrradiance ),
+             #else
+             "SH coefficients",
+             #endif
+             m_numTimedFrames);
+  }
+  
+  m_gpuTime = 0.0;
+  m_numTimedFrames = 0;
+}
+
+void App::_watchFaces()
+{
+  if (!FileWatcher::isSupported())
+  {
+    fprintf( stderr, "Faces watching not supported on this system.\n");
+    return;
+  }
+  
+  m_watchedFaces.clear();
+  
+  for (size_t idx=0u; idx<m_skyBox.getNumCubemaps(); ++idx)
+  {
+    const TextureCubemap *cubemap = m_skyBox.getCubemap( idx );
+    
+    for (int i=0; i<6; ++i)
+    {
+      // No face files for a cross or a strip
+      if (cubemap->getFaceName(i).empty()) {
+        continue;
+      }
+      
+      const int id = m_faceWatcher.addFile( cubemap->getFaceName(i) );
+      
+      if (id >= 0) 
+      {
+        m_watchedFaces.resize( std::max( m_watchedFaces.size(), size_t(id) + 1u) );
+        m_watchedFaces[id] = std::make_pair( idx, i);
+      }
+    }
+  }
+  
+  fprintf( stderr, "Watching %u faces files.\n", unsigned(m_watchedFaces.size()));
+}
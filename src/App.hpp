@@ -10,9 +10,11 @@
 #ifndef APP_HPP
 #define APP_HPP
 
+#include <utility>
 #include <vector>
 #include <GL/glew.h>
 #include <GLType/ProgramShader.hpp>
+#include <tools/FileWatcher.hpp>
 #include "SkyBox.hpp"
 
 class TCamera;
@@ -29,6 +31,26 @@ class App
     ProgramShader m_envMapProgram;
     Mesh *m_Mesh;
     
+    /** Irradiance from the three matrices instead of their packed polynomial
+     *  (IEM_SH_ORDER 2 only), to compare their cost */
+    ProgramShader m_envMapMatrixProgram;
+    bool m_bPackedIrradiance;
+    
+    /** Dense mesh, for vertex bound timings */
+    Mesh *m_DenseMesh;
+    bool m_bDenseMesh;
+    
+    /** GPU time of the scene, averaged until the next report */
+    GLuint m_timerQuery;
+    bool m_bTimerPending;
+    double m_gpuTime;
+    int m_numTimedFrames;
+    
+    /** Faces files of the cubemaps, reloaded when written (with 
+     *  ENABLE_IEM_FACE_WATCH), as (cubemap index, face) by watcher id */
+    FileWatcher m_faceWatcher;
+    std::vector< std::pair<size_t, int> > m_watchedFaces;
+    
   
   public:
     App();
@@ -41,6 +63,12 @@ class App
 
   protected:
     void _renderScene();
+    
+    /** Print the average GPU time of the scene since the last report */
+    void _reportGPUTime();
+    
+    /** Watch the faces of all the cubemaps of the skybox */
+    void _watchFaces();
 };
 
 
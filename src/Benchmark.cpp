@@ -0,0 +1,2009 @@
+/**
+ * 
+ *      \file Benchmark.cpp
+ * 
+ */
+ 
+
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <tools/ImageView.hpp>
+#include <tools/ParallelImageLoader.hpp>
+#include <tools/PixelSwizzle.hpp>
+#include <tools/ThreadPool.hpp>
+#include <tools/Timer.hpp>
+#include "irradianceAnalysis.hpp"
+#include "irradianceAsset.hpp"
+#include "irradianceCache.hpp"
+#include "irradianceBaker.hpp"
+#include "irradianceEnvMap.hpp"
+#include "irradianceFaceSums.hpp"
+#include "irradianceHBasis.hpp"
+#include "irradianceMipmap.hpp"
+#include "irradiancePixelFormat.hpp"
+#include "irradianceReference.hpp"
+#include "irradianceRotation.hpp"
+#include "irradianceSampling.hpp"
+#include "irradianceSH.hpp"
+#include "irradianceSHAlgebra.hpp"
+#include "irradianceSpecular.hpp"
+#include "irradianceWeightTable.hpp"
+
+
+namespace Benchmark {
+
+
+/// Number of runs per measure, the best one is kept
+static const int NUM_RUNS = 3;
+
+/// Accepted difference between a kernel and the scalar reference, relative
+/// to the largest reference matrix coefficient (cf. irradianceKernels.cpp)
+static
+float getKernelTolerance( const int texRes )
+{
+  return fmaxf( 1.0e-4f, 0.1f / float(texRes * texRes));
+}
+
+
+/// Largest absolute difference between two sets of irradiance matrices
+static
+float maxDifference( const glm::mat4 A[3], const glm::mat4 B[3])
+{
+  float d = 0.0f;
+  for (int c=0; c<3; ++c) {
+    for (int i=0; i<4; ++i) {
+      for (int j=0; j<4; ++j) {
+        d = fmaxf( d, fabsf( A[c][i][j] - B[c][i][j] ));
+      }
+    }
+  }
+  return d;
+}
+
+/// Best time (ms) of NUM_RUNS prefiltering
+static
+double timePrefilter( const Image_t envmap[6], glm::mat4 M[3], ThreadPool &pool)
+{
+  Timer &timer = Timer::getInstance();
+  double bestTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double tStart = timer.getAbsoluteTime();
+    IrradianceEnvMap::prefilter( envmap, M, pool);
+    double t = timer.getAbsoluteTime() - tStart;
+    bestTime = (t < bestTime) ? t : bestTime;
+  }
+  
+  return bestTime;
+}
+
+
+void prefilterScaling( const Image_t envmap[6], unsigned int maxThreads)
+{
+  if (0u == maxThreads) {
+    maxThreads = ThreadPool::getHardwareConcurrency();
+  }
+  
+  const double numTexels = 6.0 * envmap[0].width * envmap[0].height;
+  
+  fprintf( stderr, "[Benchmark] prefilter %dx%d, 1 to %u threads\n", 
+           envmap[0].width, envmap[0].height, maxThreads);
+  
+  glm::mat4 reference[3];
+  double refTime = 0.0;
+  
+  for (unsigned int n=1u; n<=maxThreads; ++n)
+  {
+    ThreadPool pool(n);
+    glm::mat4 M[3];
+    double bestTime = timePrefilter( envmap, M, pool);
+    
+    if (1u == n) 
+    {
+      for (int c=0; c<3; ++c) {
+        reference[c] = M[c];
+      }
+      refTime = bestTime;
+    }
+    
+    bool bIdentical = (0 == memcmp( reference, M, sizeof(reference)));
+    
+    fprintf( stderr, "  %2u threads : %9.3f ms  x%5.2f  %8.2f Mtexels/s  %s\n", 
+             n, bestTime, refTime / bestTime, 
+             1.0e-3 * numTexels / bestTime,
+             bIdentical ? "identical" : "MISMATCH");
+  }
+  
+  /// The workers restarted by a resize, between two prefilters
+  {
+    const unsigned int n = (maxThreads > 1u) ? maxThreads : 2u;
+    ThreadPool pool(n);
+    glm::mat4 M[3];
+    IrradianceEnvMap::prefilter( envmap, M, pool);
+    
+    pool.resize( n );
+    double bestTime = timePrefilter( envmap, M, pool);
+    
+    bool bIdentical = (0 == memcmp( reference, M, sizeof(reference)));
+    
+    fprintf( stderr, "  %2u threads : %9.3f ms  after a resize  %s\n", 
+             n, bestTime, bIdentical ? "identical" : "MISMATCH");
+  }
+}
+
+void projectionKernels( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  const double numTexels = 6.0 * envmap[0].width * envmap[0].height;
+  const float tolerance = getKernelTolerance( envmap[0].width );
+  const SIMDKernel userKernel = getKernel();
+  const PrefilterMethod userMethod = getPrefilterMethod();
+  ThreadPool pool(1u);
+  
+  setPrefilterMethod( PREFILTER_DIRECT );
+  
+  fprintf( stderr, "[Benchmark] projection kernels %dx%d, single thread\n", 
+           envmap[0].width, envmap[0].height);
+  
+  glm::mat4 reference[3];
+  double refTime = 0.0;
+  float refScale = 0.0f;
+  
+  for (int k=KERNEL_SCALAR; k<NUM_SIMD_KERNEL; ++k)
+  {
+    if (!isKernelSupported( SIMDKernel(k) )) {
+      continue;
+    }
+    setKernel( SIMDKernel(k) );
+    
+    glm::mat4 M[3];
+    double bestTime = timePrefilter( envmap, M, pool);
+    
+    if (KERNEL_SCALAR == k)
+    {
+      for (int c=0; c<3; ++c) {
+        reference[c] = M[c];
+      }
+      refTime = bestTime;
+      
+      glm::mat4 zero[3] = { glm::mat4(0.0f), glm::mat4(0.0f), glm::mat4(0.0f) };
+      refScale = maxDifference( reference, zero );
+    }
+    
+    float error = maxDifference( reference, M ) / refScale;
+    
+    fprintf( stderr, "  %-8s : %9.3f ms  x%6.2f  %8.2f Mtexels/s  error %.2e %s\n", 
+             getKernelName( SIMDKernel(k) ), bestTime, refTime / bestTime, 
+             1.0e-3 * numTexels / bestTime, error, 
+             (error <= tolerance) ? "" : "(above tolerance)");
+  }
+  
+  setKernel( userKernel );
+  setPrefilterMethod( userMethod );
+}
+
+void prefilterMethods( const Image_t envmap[6], size_t batchSize)
+{
+  using namespace IrradianceEnvMap;
+  
+  const int texRes = envmap[0].width;
+  const double numTexels = 6.0 * texRes * texRes;
+  const PrefilterMethod userMethod = getPrefilterMethod();
+  Timer &timer = Timer::getInstance();
+  ThreadPool pool(1u);
+  
+  fprintf( stderr, "[Benchmark] prefilter methods %dx%d, single thread, %s kernel\n", 
+           texRes, texRes, getKernelName( getKernel() ));
+  
+  glm::mat4 reference[3];
+  setPrefilterMethod( PREFILTER_DIRECT );
+  double directTime = timePrefilter( envmap, reference, pool);
+  
+  fprintf( stderr, "  direct          : %9.3f ms  %8.2f Mtexels/s\n", 
+           directTime, 1.0e-3 * numTexels / directTime);
+  
+  if (texRes & 1) 
+  {
+    fprintf( stderr, "  weight table    : odd resolution, not supported\n");
+    setPrefilterMethod( userMethod );
+    return;
+  }
+  
+  setPrefilterMethod( PREFILTER_WEIGHT_TABLE );
+  glm::mat4 M[3];
+  
+  // Includes the table creation, if not already used
+  double tStart = timer.getAbsoluteTime();
+  IrradianceEnvMap::prefilter( envmap, M, pool);
+  double firstTime = timer.getAbsoluteTime() - tStart;
+  
+  double tableTime = timePrefilter( envmap, M, pool);
+  
+  glm::mat4 zero[3] = { glm::mat4(0.0f), glm::mat4(0.0f), glm::mat4(0.0f) };
+  float error = maxDifference( reference, M ) / maxDifference( reference, zero );
+  
+  fprintf( stderr, "  weight table    : %9.3f ms  %8.2f Mtexels/s  x%5.2f  "
+                   "(first call %.3f ms, %.2f MB)  error %.2e %s\n", 
+           tableTime, 1.0e-3 * numTexels / tableTime, directTime / tableTime, 
+           firstTime, WeightTable::get( texRes )->getMemorySize() / (1024.0 * 1024.0), 
+           error, (error <= getKernelTolerance( texRes )) ? "" : "(above tolerance)");
+  
+  /// Batch of copies of the same cubemap
+  std::vector<const Image_t*> envmaps( batchSize, envmap );
+  std::vector<glm::mat4> batchM( 3u * batchSize );
+  double batchTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    tStart = timer.getAbsoluteTime();
+    IrradianceEnvMap::prefilter( &envmaps[0], batchSize, 
+                                 reinterpret_cast<glm::mat4 (*)[3]>(&batchM[0]), pool);
+    double t = timer.getAbsoluteTime() - tStart;
+    batchTime = (t < batchTime) ? t : batchTime;
+  }
+  
+  bool bIdentical = true;
+  for (size_t i=0u; i<batchSize; ++i) {
+    bIdentical &= (0 == memcmp( M, &batchM[3u*i], sizeof(M)));
+  }
+  
+  fprintf( stderr, "  batch of %-6zu : %9.3f ms  %8.2f Mtexels/s  x%5.2f  %s\n", 
+           batchSize, batchTime / batchSize, 
+           1.0e-3 * numTexels * batchSize / batchTime, 
+           directTime * batchSize / batchTime, 
+           bIdentical ? "identical" : "MISMATCH");
+  
+  setPrefilterMethod( userMethod );
+}
+
+/// Number of directions on which the SH orders irradiances are compared
+static const int NUM_SH_DIRECTIONS = 4096;
+
+/// Best time (ms) of NUM_RUNS projections of order Order, and the irradiance
+/// on NUM_SH_DIRECTIONS Fibonacci directions
+template<int Order>
+static
+double timeSHOrder( const Image_t envmap[6], ThreadPool &pool, glm::vec3 irradiance[])
+{
+  Timer &timer = Timer::getInstance();
+  IrradianceEnvMap::SH_t<Order> sh;
+  double bestTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double tStart = timer.getAbsoluteTime();
+    IrradianceEnvMap::prefilter( envmap, sh, pool);
+    double t = timer.getAbsoluteTime() - tStart;
+    bestTime = (t < bestTime) ? t : bestTime;
+  }
+  
+  IrradianceEnvMap::convolveIrradiance( sh );
+  
+  for (int i=0; i<NUM_SH_DIRECTIONS; ++i)
+  {
+    const float z = 1.0f - 2.0f * (i + 0.5f) / NUM_SH_DIRECTIONS;
+    const float r = sqrtf( 1.0f - z*z );
+    const float phi = 2.39996323f * i;
+    irradiance[i] = IrradianceEnvMap::evaluate( sh, glm::vec3( r*cosf(phi), r*sinf(phi), z));
+  }
+  
+  return bestTime;
+}
+
+void shOrders( const Image_t envmap[6] )
+{
+  const double numTexels = 6.0 * envmap[0].width * envmap[0].height;
+  ThreadPool pool(1u);
+  
+  fprintf( stderr, "[Benchmark] SH orders %dx%d, single thread\n", 
+           envmap[0].width, envmap[0].height);
+  
+  const int numOrders = IrradianceEnvMap::SH_MAX_ORDER;
+  std::vector<glm::vec3> irradiance( numOrders * NUM_SH_DIRECTIONS );
+  double times[numOrders];
+  
+  times[0] = timeSHOrder<1>( envmap, pool, &irradiance[0 * NUM_SH_DIRECTIONS]);
+  times[1] = timeSHOrder<2>( envmap, pool, &irradiance[1 * NUM_SH_DIRECTIONS]);
+  times[2] = timeSHOrder<3>( envmap, pool, &irradiance[2 * NUM_SH_DIRECTIONS]);
+  times[3] = timeSHOrder<4>( envmap, pool, &irradiance[3 * NUM_SH_DIRECTIONS]);
+  times[4] = timeSHOrder<5>( envmap, pool, &irradiance[4 * NUM_SH_DIRECTIONS]);
+  times[5] = timeSHOrder<6>( envmap, pool, &irradiance[5 * NUM_SH_DIRECTIONS]);
+  times[6] = timeSHOrder<7>( envmap, pool, &irradiance[6 * NUM_SH_DIRECTIONS]);
+  times[7] = timeSHOrder<8>( envmap, pool, &irradiance[7 * NUM_SH_DIRECTIONS]);
+  
+  // Differences relative to the largest irradiance component of the last order
+  const glm::vec3 *reference = &irradiance[(numOrders-1) * NUM_SH_DIRECTIONS];
+  float refScale = 0.0f;
+  for (int i=0; i<NUM_SH_DIRECTIONS; ++i) {
+    refScale = fmaxf( refScale, fmaxf( reference[i].r, fmaxf( reference[i].g, reference[i].b)));
+  }
+  
+  for (int o=0; o<numOrders; ++o)
+  {
+    float error = 0.0f;
+    for (int i=0; i<NUM_SH_DIRECTIONS; ++i)
+    {
+      const glm::vec3 d = glm::abs( irradiance[o * NUM_SH_DIRECTIONS + i] - reference[i] );
+      error = fmaxf( error, fmaxf( d.r, fmaxf( d.g, d.b)));
+    }
+    
+    fprintf( stderr, "  order %d (%2d coeffs) : %9.3f ms  %8.2f Mtexels/s  "
+                     "irradiance difference to order %d %.2e\n", 
+             o+1, (o+2) * (o+2), times[o], 1.0e-3 * numTexels / times[o], 
+             numOrders, error / refScale);
+  }
+}
+
+/// Convert an 8-bit channel, floating point ones being mapped to [0, 1]
+template<typename Channel_t>
+static inline Channel_t toChannel( const unsigned char v );
+
+template<> inline unsigned char toChannel( const unsigned char v ) { return v; }
+template<> inline uint16_t toChannel( const unsigned char v ) 
+{ 
+  return floatToHalf( v / 255.0f ); 
+}
+template<> inline float toChannel( const unsigned char v )         { return v / 255.0f; }
+
+/// Copy an 8-bit cubemap to another pixel format, colors mapped to [0, 1]
+static
+void convertCubemap( const Image_t src[6], const IrradianceEnvMap::PixelFormat format, 
+                     Image_t dst[6])
+{
+  using namespace IrradianceEnvMap;
+  
+  const int srcChannels = (GL_RGBA == src[0].format) ? 4 : 3;
+  
+  for (int face=0; face<6; ++face)
+  {
+    dst[face].clean();
+    dst[face].target = src[face].target;
+    dst[face].width = src[face].width;
+    dst[face].height = src[face].height;
+    
+    dispatchPixelFormat( format, [&](auto F)
+    {
+      typedef PixelTraits<decltype(F)::value> Traits;
+      typedef typename Traits::Channel_t Channel_t;
+      const int nc = Traits::NUM_CHANNELS;
+      
+      const size_t numPixels = size_t(src[face].width) * src[face].height;
+      Channel_t *data = new Channel_t[nc * numPixels];
+      
+      for (size_t i=0u; i<numPixels; ++i) {
+        for (int c=0; c<nc; ++c) 
+        {
+          const unsigned char v = (c < srcChannels) ? src[face].data[i*srcChannels + c] : 255u;
+          data[i*nc + c] = toChannel<Channel_t>( v );
+        }
+      }
+      
+      dst[face].bytesPerPixel = getPixelSize( format );
+      dst[face].format = (4 == nc) ? GL_RGBA : GL_RGB;
+      dst[face].internalFormat = dst[face].format;
+      dst[face].type = (sizeof(Channel_t) == 1u) ? GL_UNSIGNED_BYTE :
+                       (sizeof(Channel_t) == 2u) ? GL_HALF_FLOAT : GL_FLOAT;
+      dst[face].data = reinterpret_cast<GLubyte*>(data);
+    });
+  }
+}
+
+void pixelFormats( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  const double numTexels = 6.0 * envmap[0].width * envmap[0].height;
+  const PrefilterMethod userMethod = getPrefilterMethod();
+  ThreadPool pool(1u);
+  
+  fprintf( stderr, "[Benchmark] pixel formats %dx%d, single thread, %s kernel\n", 
+           envmap[0].width, envmap[0].height, getKernelName( getKernel() ));
+  
+  const PrefilterMethod methods[2] = { PREFILTER_DIRECT, PREFILTER_WEIGHT_TABLE };
+  const char* methodNames[2] = { "direct", "weight table" };
+  glm::mat4 reference[2][3];
+  
+  for (int f=PIXEL_RGB8; f<NUM_PIXEL_FORMAT; ++f)
+  {
+    Image_t image[6];
+    convertCubemap( envmap, PixelFormat(f), image);
+    
+    for (int m=0; m<2; ++m)
+    {
+      setPrefilterMethod( methods[m] );
+      
+      glm::mat4 M[3];
+      double bestTime = timePrefilter( image, M, pool);
+      
+      if (PIXEL_RGB8 == f) {
+        for (int c=0; c<3; ++c) {
+          reference[m][c] = M[c];
+        }
+      }
+      
+      glm::mat4 zero[3] = { glm::mat4(0.0f), glm::mat4(0.0f), glm::mat4(0.0f) };
+      float error = maxDifference( reference[m], M ) / maxDifference( reference[m], zero );
+      
+      fprintf( stderr, "  %-8s %-12s : %9.3f ms  %8.2f Mtexels/s  difference to RGB8 %.2e\n", 
+               getPixelFormatName( PixelFormat(f) ), methodNames[m], bestTime, 
+               1.0e-3 * numTexels / bestTime, error);
+    }
+  }
+  
+  setPrefilterMethod( userMethod );
+}
+
+void mipReduction( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  const int texRes = envmap[0].width;
+  Timer &timer = Timer::getInstance();
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] mip reduced prefiltering %dx%d, %u threads\n", 
+           texRes, texRes, pool.getNumThreads());
+  
+  glm::mat4 reference[3];
+  const double referenceTime = timePrefilter( envmap, reference, pool);
+  fprintf( stderr, "  full %4d       : %9.3f ms\n", texRes, referenceTime);
+  
+  for (int res=MIPMAP_MIN_RESOLUTION; res<texRes; res*=2)
+  {
+    double bestReduce = 1.0e30;
+    double bestTotal = 1.0e30;
+    float estimate = 0.0f;
+    glm::mat4 M[3];
+    
+    for (int r=0; r<NUM_RUNS; ++r)
+    {
+      Image_t level[6];
+      
+      double tStart = timer.getAbsoluteTime();
+      reduceCubemap( envmap, texRes / res, level, pool);
+      double tReduce = timer.getAbsoluteTime();
+      prefilter( level, M, pool);
+      double tEnd = timer.getAbsoluteTime();
+      
+      bestReduce = std::min( bestReduce, tReduce - tStart );
+      bestTotal = std::min( bestTotal, tEnd - tStart );
+    }
+    estimate = prefilterReduced( envmap, res, M, pool);
+    
+    fprintf( stderr, "  level %4d      : %9.3f ms (reduction %.3f ms, projection %.3f ms)"
+                     "  estimated error %.2e, actual %.2e\n", 
+             res, bestTotal, bestReduce, bestTotal - bestReduce, 
+             estimate, getRelativeDifference( M, reference ));
+  }
+  
+  const float budgets[3] = { 1.0e-2f, 1.0e-3f, 1.0e-4f };
+  
+  for (int b=0; b<3; ++b)
+  {
+    double bestTime = 1.0e30;
+    float estimate = 0.0f;
+    int res = 0;
+    glm::mat4 M[3];
+    
+    for (int r=0; r<NUM_RUNS; ++r)
+    {
+      double tStart = timer.getAbsoluteTime();
+      res = prefilterWithinBudget( envmap, budgets[b], M, &estimate, pool);
+      bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+    }
+    
+    fprintf( stderr, "  budget %.0e   : %9.3f ms  level %4d  estimated error %.2e, actual %.2e\n", 
+             budgets[b], bestTime, res, estimate, getRelativeDifference( M, reference ));
+  }
+}
+
+void sampledProjection( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  const int texRes = envmap[0].width;
+  Timer &timer = Timer::getInstance();
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] sampled projection %dx%d, %u threads\n", 
+           texRes, texRes, pool.getNumThreads());
+  
+  glm::mat4 reference[3];
+  const double referenceTime = timePrefilter( envmap, reference, pool);
+  fprintf( stderr, "  full %8d texels  : %9.3f ms\n", 6 * texRes * texRes, referenceTime);
+  
+  for (int numSamples=1024; numSamples<=(1 << 20); numSamples*=4)
+  {
+    double bestTime = 1.0e30;
+    float estimate = 0.0f;
+    glm::mat4 M[3];
+    
+    for (int r=0; r<NUM_RUNS; ++r)
+    {
+      double tStart = timer.getAbsoluteTime();
+      estimate = prefilterSampled( envmap, numSamples, M, pool);
+      bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+    }
+    
+    fprintf( stderr, "  %8d samples      : %9.3f ms  estimated error %.2e, actual %.2e\n", 
+             numSamples, bestTime, estimate, getRelativeDifference( M, reference ));
+  }
+}
+
+void fixedPoint( const Image_t envmap[6], size_t batchSize)
+{
+  using namespace IrradianceEnvMap;
+  
+  const int texRes = envmap[0].width;
+  const double numTexels = 6.0 * texRes * texRes;
+  const PixelFormat format = getPixelFormat( envmap[0] );
+  const SIMDKernel userKernel = getKernel();
+  const PrefilterMethod userMethod = getPrefilterMethod();
+  ThreadPool pool(1u);
+  
+  fprintf( stderr, "[Benchmark] fixed point projection %dx%d, single thread\n", 
+           texRes, texRes);
+  
+  if ((texRes & 1) || ((PIXEL_RGB8 != format) && (PIXEL_RGBA8 != format)))
+  {
+    fprintf( stderr, "  %s %s cubemap, not supported\n", 
+             (texRes & 1) ? "odd resolution" : "non 8-bit", getPixelFormatName( format ));
+    return;
+  }
+  
+  glm::mat4 reference[3];
+  setKernel( KERNEL_SCALAR );
+  setPrefilterMethod( PREFILTER_DIRECT );
+  timePrefilter( envmap, reference, pool);
+  
+  glm::mat4 zero[3] = { glm::mat4(0.0f), glm::mat4(0.0f), glm::mat4(0.0f) };
+  const float refScale = maxDifference( reference, zero );
+  
+  fprintf( stderr, "  error bound of the fixed point weights : %.2e\n", 
+           WeightTable::get( texRes )->getFixedErrorBound());
+  
+  glm::mat4 fixedM[3];
+  bool bIdentical = true;
+  bool bFirst = true;
+  
+  for (int k=KERNEL_SCALAR; k<NUM_SIMD_KERNEL; ++k)
+  {
+    if (!isKernelSupported( SIMDKernel(k) )) {
+      continue;
+    }
+    setKernel( SIMDKernel(k) );
+    
+    glm::mat4 M[3];
+    setPrefilterMethod( PREFILTER_WEIGHT_TABLE );
+    const double tableTime = timePrefilter( envmap, M, pool);
+    const float tableError = maxDifference( reference, M ) / refScale;
+    
+    setPrefilterMethod( PREFILTER_FIXED_POINT );
+    const double fixedTime = timePrefilter( envmap, M, pool);
+    const float fixedError = maxDifference( reference, M ) / refScale;
+    
+    if (bFirst) {
+      for (int c=0; c<3; ++c) {
+        fixedM[c] = M[c];
+      }
+    }
+    bIdentical &= (0 == memcmp( fixedM, M, sizeof(fixedM)));
+    bFirst = false;
+    
+    fprintf( stderr, "  %-8s : float %9.3f ms  error %.2e | fixed %9.3f ms  %8.2f Mtexels/s"
+                     "  x%5.2f  error %.2e\n", 
+             getKernelName( SIMDKernel(k) ), tableTime, tableError, fixedTime, 
+             1.0e-3 * numTexels / fixedTime, tableTime / fixedTime, fixedError);
+  }
+  
+  /// Same result on the shared pool and in batch
+  setKernel( userKernel );
+  
+  glm::mat4 M[3];
+  IrradianceEnvMap::prefilter( envmap, M, getThreadPool());
+  bIdentical &= (0 == memcmp( fixedM, M, sizeof(fixedM)));
+  
+  std::vector<const Image_t*> envmaps( batchSize, envmap );
+  std::vector<glm::mat4> batchM( 3u * batchSize );
+  IrradianceEnvMap::prefilter( &envmaps[0], batchSize, 
+                               reinterpret_cast<glm::mat4 (*)[3]>(&batchM[0]), getThreadPool());
+  for (size_t i=0u; i<batchSize; ++i) {
+    bIdentical &= (0 == memcmp( fixedM, &batchM[3u*i], sizeof(fixedM)));
+  }
+  
+  fprintf( stderr, "  kernels, %u threads & batch of %zu : %s\n", 
+           getThreadPool().getNumThreads(), batchSize, bIdentical ? "identical" : "MISMATCH");
+  
+  setPrefilterMethod( userMethod );
+}
+
+void batchPrefilter( const Image_t envmap[6], size_t count)
+{
+  using namespace IrradianceEnvMap;
+  
+  const int texRes = envmap[0].width;
+  Timer &timer = Timer::getInstance();
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] batch of %zu cubemaps from %dx%d, %u threads\n", 
+           count, texRes, texRes, pool.getNumThreads());
+  
+  /// The cubemap, then its levels down to MIPMAP_MIN_RESOLUTION in turn
+  std::vector< std::unique_ptr<Image_t[]> > levels;
+  for (int factor=2; (0 == texRes % factor) && (texRes / factor >= MIPMAP_MIN_RESOLUTION); factor*=2)
+  {
+    levels.emplace_back( new Image_t[6] );
+    reduceCubemap( envmap, factor, levels.back().get(), pool);
+  }
+  
+  std::vector<const Image_t*> envmaps( count );
+  for (size_t i=0u; i<count; ++i) {
+    envmaps[i] = (0u == i % (levels.size() + 1u)) ? envmap : levels[i % (levels.size() + 1u) - 1u].get();
+  }
+  
+  /// One by one, as the cubemaps loading
+  std::vector<glm::mat4> serialM( 3u * count );
+  double serialTime = 1.0e30;
+  double numTexels = 0.0;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    numTexels = 0.0;
+    double tStart = timer.getAbsoluteTime();
+    for (size_t i=0u; i<count; ++i) 
+    {
+      IrradianceEnvMap::prefilter( envmaps[i], &serialM[3u*i], pool);
+      numTexels += 6.0 * envmaps[i][0].width * envmaps[i][0].height;
+    }
+    serialTime = std::min( serialTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  fprintf( stderr, "  one by one : %9.3f ms  %8.2f Mtexels/s  %9.2f cubemaps/s\n", 
+           serialTime, 1.0e-3 * numTexels / serialTime, 1.0e3 * count / serialTime);
+  
+  /// Single batch
+  std::vector<glm::mat4> batchM( 3u * count );
+  BatchStats_t bestStats;
+  bestStats.time = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    BatchStats_t stats;
+    prefilterBatch( &envmaps[0], count, reinterpret_cast<glm::mat4 (*)[3]>(&batchM[0]), 
+                    pool, &stats);
+    bestStats = (stats.time < bestStats.time) ? stats : bestStats;
+  }
+  
+  const bool bIdentical = (0 == memcmp( &serialM[0], &batchM[0], batchM.size() * sizeof(glm::mat4)));
+  
+  fprintf( stderr, "  batch      : %9.3f ms  %8.2f Mtexels/s  %9.2f cubemaps/s  x%5.2f  %s\n", 
+           bestStats.time, 1.0e-6 * bestStats.texelsPerSecond, bestStats.cubemapsPerSecond,
+           serialTime / bestStats.time, bIdentical ? "identical" : "MISMATCH");
+}
+
+/// Number of rotations timed for a single set of coefficients
+static const int NUM_SH_ROTATIONS = 1000;
+
+/// Time the rotation of order Order of the coefficients of a cubemap, 
+/// single & batched, and give the largest irradiance difference to the 
+/// unrotated coefficients evaluated on the rotated back directions
+template<int Order>
+static
+void timeSHRotation( const Image_t envmap[6], const glm::mat3 &R, const size_t numProbes, 
+                     ThreadPool &pool)
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  
+  SH_t<Order> sh, rotated;
+  prefilter( envmap, sh, pool);
+  convolveIrradiance( sh );
+  
+  /// Per frame, matrices built from the rotation
+  double singleTime = 1.0e30;
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double tStart = timer.getAbsoluteTime();
+    for (int i=0; i<NUM_SH_ROTATIONS; ++i) {
+      SHRotation<Order>( R ).apply( sh, rotated);
+    }
+    singleTime = std::min( singleTime, timer.getAbsoluteTime() - tStart );
+  }
+  singleTime /= NUM_SH_ROTATIONS;
+  
+  /// Batch of probes
+  std::vector< SH_t<Order> > probes( numProbes, sh );
+  std::vector< SH_t<Order> > rotatedProbes( numProbes );
+  double batchTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double tStart = timer.getAbsoluteTime();
+    rotate( &probes[0], &rotatedProbes[0], numProbes, R, pool);
+    batchTime = std::min( batchTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  float error = 0.0f;
+  float scale = 0.0f;
+  const glm::mat3 invR = glm::transpose( R );
+  
+  for (int i=0; i<NUM_SH_DIRECTIONS; ++i)
+  {
+    const float z = 1.0f - 2.0f * (i + 0.5f) / NUM_SH_DIRECTIONS;
+    const float r = sqrtf( 1.0f - z*z );
+    const float phi = 2.39996323f * i;
+    const glm::vec3 n( r*cosf(phi), r*sinf(phi), z);
+    
+    const glm::vec3 reference = evaluate( sh, invR * n);
+    const glm::vec3 d = glm::abs( evaluate( rotated, n) - reference );
+    error = fmaxf( error, fmaxf( d.r, fmaxf( d.g, d.b)));
+    scale = fmaxf( scale, fmaxf( reference.r, fmaxf( reference.g, reference.b)));
+  }
+  
+  fprintf( stderr, "  order %d (%2d coeffs) : %8.3f us per rotation  batch %9.3f ms"
+                   "  %9.3f Mprobes/s  error %.2e\n", 
+           Order, SH_t<Order>::NUM_COEFFS, 1.0e3 * singleTime, batchTime, 
+           1.0e-3 * numProbes / batchTime, error / scale);
+}
+
+
+void shRotation( const Image_t envmap[6], size_t numProbes)
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  ThreadPool &pool = getThreadPool();
+  const glm::mat3 R( glm::rotate( glm::mat4(1.0f), 37.0f, glm::vec3( 1.0f, 0.7f, -0.5f)) );
+  
+  fprintf( stderr, "[Benchmark] SH rotation, batches of %zu probes, %u threads\n", 
+           numProbes, pool.getNumThreads());
+  
+  /// Irradiance matrices, as uploaded by SkyBox
+  glm::mat4 M[3], rotated[3];
+  prefilter( envmap, M, pool);
+  
+  double matrixTime = 1.0e30;
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double tStart = timer.getAbsoluteTime();
+    for (int i=0; i<NUM_SH_ROTATIONS; ++i) {
+      rotateIrradianceMatrices( M, R, rotated);
+    }
+    matrixTime = std::min( matrixTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  float error = 0.0f;
+  float scale = 0.0f;
+  for (int i=0; i<NUM_SH_DIRECTIONS; ++i)
+  {
+    const float z = 1.0f - 2.0f * (i + 0.5f) / NUM_SH_DIRECTIONS;
+    const float r = sqrtf( 1.0f - z*z );
+    const float phi = 2.39996323f * i;
+    const glm::vec4 n( r*cosf(phi), r*sinf(phi), z, 1.0f);
+    const glm::vec4 m( glm::transpose( R ) * glm::vec3( n ), 1.0f);
+    
+    for (int c=0; c<3; ++c)
+    {
+      const float reference = glm::dot( m, M[c] * m);
+      error = fmaxf( error, fabsf( glm::dot( n, rotated[c] * n) - reference ));
+      scale = fmaxf( scale, reference);
+    }
+  }
+  
+  fprintf( stderr, "  matrices            : %8.3f us per rotation  error %.2e\n", 
+           1.0e3 * matrixTime / NUM_SH_ROTATIONS, error / scale);
+  
+  timeSHRotation<2>( envmap, R, numProbes, pool);
+  timeSHRotation<4>( envmap, R, numProbes, pool);
+  timeSHRotation<6>( envmap, R, numProbes, pool);
+  timeSHRotation<8>( envmap, R, numProbes, pool);
+}
+
+/// Time the SH algebra of order Order on a batch of probes, against the 
+/// same operations written as plain loops on each coefficient
+template<int Order>
+static
+void timeSHAlgebra( const Image_t envmap[6], const size_t numProbes, ThreadPool &pool)
+{
+  using namespace IrradianceEnvMap;
+  typedef SH_t<Order> SH;
+  
+  Timer &timer = Timer::getInstance();
+  
+  SH sh;
+  prefilter( envmap, sh, pool);
+  
+  /// Probes scaled differently, so that the operations are not constant
+  std::vector<SH> a( numProbes ), b( numProbes ), out( numProbes );
+  for (size_t i=0u; i<numProbes; ++i)
+  {
+    scale( sh, 0.5f + float(i % 17u) / 16.0f, a[i]);
+    scale( sh, 1.5f - float(i % 13u) / 12.0f, b[i]);
+  }
+  
+  float zonal[Order+1];
+  getCosineLobe<Order>( zonal );
+  
+  const float t = 0.3f;
+  double naiveTime = 1.0e30, lerpTime = 1.0e30;
+  double convolveTime = 1.0e30, multiplyTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double tStart = timer.getAbsoluteTime();
+    for (size_t i=0u; i<numProbes; ++i) {
+      for (int c=0; c<3; ++c) {
+        for (int k=0; k<SH::NUM_COEFFS; ++k) {
+          out[i].coeffs[c][k] = (1.0f - t) * a[i].coeffs[c][k] + t * b[i].coeffs[c][k];
+        }
+      }
+    }
+    naiveTime = std::min( naiveTime, timer.getAbsoluteTime() - tStart );
+    
+    tStart = timer.getAbsoluteTime();
+    lerp( &a[0], &b[0], t, &out[0], numProbes);
+    lerpTime = std::min( lerpTime, timer.getAbsoluteTime() - tStart );
+    
+    tStart = timer.getAbsoluteTime();
+    convolve( &a[0], zonal, &out[0], numProbes);
+    convolveTime = std::min( convolveTime, timer.getAbsoluteTime() - tStart );
+    
+    tStart = timer.getAbsoluteTime();
+    multiply( &a[0], &b[0], &out[0], numProbes);
+    multiplyTime = std::min( multiplyTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  /// The cosine lobe convolution is convolveIrradiance
+  SH irradiance = sh, convolved;
+  convolveIrradiance( irradiance );
+  convolve( sh, zonal, convolved);
+  
+  /// The product by the constant function 1 is the identity
+  SH one = SH(), product;
+  for (int c=0; c<3; ++c) {
+    one.coeffs[c][0] = sqrtf( 4.0f * M_PI );
+  }
+  multiply( sh, one, product);
+  
+  float convolveError = 0.0f, multiplyError = 0.0f, scale = 0.0f;
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<SH::NUM_COEFFS; ++k)
+    {
+      convolveError = fmaxf( convolveError, fabsf( convolved.coeffs[c][k] - irradiance.coeffs[c][k] ));
+      multiplyError = fmaxf( multiplyError, fabsf( product.coeffs[c][k] - sh.coeffs[c][k] ));
+      scale = fmaxf( scale, fabsf( sh.coeffs[c][k] ));
+    }
+  }
+  
+  fprintf( stderr, "  order %d (%5zu gaunt) : lerp %8.2f Mprobes/s (loop %8.2f)  convolve %8.2f"
+                   "  multiply %7.3f Mprobes/s  error %.2e %.2e\n", 
+           Order, getNumGauntCoefficients<Order>(), 1.0e-3 * numProbes / lerpTime, 
+           1.0e-3 * numProbes / naiveTime, 1.0e-3 * numProbes / convolveTime,
+           1.0e-3 * numProbes / multiplyTime, convolveError / scale, multiplyError / scale);
+}
+
+void shAlgebra( const Image_t envmap[6], size_t numProbes)
+{
+  using namespace IrradianceEnvMap;
+  
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] SH algebra, batches of %zu probes\n", numProbes);
+  
+  /// Round trip through the irradiance matrices
+  SH_t<2> sh, back;
+  glm::mat4 M[3];
+  prefilter( envmap, sh, pool);
+  getIrradianceMatrices( &sh, &M, 1u);
+  getRadianceCoefficients( &M, &back, 1u);
+  
+  float error = 0.0f, scale = 0.0f;
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<9; ++k)
+    {
+      error = fmaxf( error, fabsf( back.coeffs[c][k] - sh.coeffs[c][k] ));
+      scale = fmaxf( scale, fabsf( sh.coeffs[c][k] ));
+    }
+  }
+  fprintf( stderr, "  matrices round trip : error %.2e\n", error / scale);
+  
+  timeSHAlgebra<2>( envmap, numProbes, pool);
+  timeSHAlgebra<4>( envmap, numProbes, pool);
+  timeSHAlgebra<8>( envmap, numProbes, pool);
+}
+
+void irradianceEvaluation( const Image_t envmap[6], size_t numNormals)
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  const SIMDKernel userKernel = getKernel();
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] irradiance evaluation of %zu normals, %u threads\n", 
+           numNormals, pool.getNumThreads());
+  
+  glm::mat4 M[3];
+  prefilter( envmap, M, pool);
+  
+  /// Normals of a Fibonacci sphere, as SoA
+  std::vector<float> nx( numNormals ), ny( numNormals ), nz( numNormals );
+  for (size_t i=0u; i<numNormals; ++i)
+  {
+    const float z = 1.0f - 2.0f * (i + 0.5f) / numNormals;
+    const float r = sqrtf( 1.0f - z*z );
+    const float phi = 2.39996323f * i;
+    nx[i] = r * cosf(phi);
+    ny[i] = r * sinf(phi);
+    nz[i] = z;
+  }
+  
+  /// Reference : the three matrix products of computeIrradiance
+  std::vector<glm::vec3> reference( numNormals );
+  double naiveTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    double tStart = timer.getAbsoluteTime();
+    for (size_t i=0u; i<numNormals; ++i)
+    {
+      const glm::vec4 n( nx[i], ny[i], nz[i], 1.0f);
+      reference[i] = glm::vec3( glm::dot( n, M[0] * n), 
+                                glm::dot( n, M[1] * n), 
+                                glm::dot( n, M[2] * n));
+    }
+    naiveTime = std::min( naiveTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  float scale = 0.0f;
+  for (size_t i=0u; i<numNormals; ++i) {
+    scale = fmaxf( scale, fmaxf( reference[i].r, fmaxf( reference[i].g, reference[i].b)));
+  }
+  
+  fprintf( stderr, "  glm loop : %9.3f ms  %9.2f Mnormals/s\n", 
+           naiveTime, 1.0e-3 * numNormals / naiveTime);
+  
+  std::vector<float> rgb( 3u * numNormals );
+  
+  for (int k=KERNEL_SCALAR; k<NUM_SIMD_KERNEL; ++k)
+  {
+    if (!isKernelSupported( SIMDKernel(k) )) {
+      continue;
+    }
+    setKernel( SIMDKernel(k) );
+    
+    double bestTime = 1.0e30;
+    for (int run=0; run<NUM_RUNS; ++run)
+    {
+      double tStart = timer.getAbsoluteTime();
+      evaluateIrradiance( M, &nx[0], &ny[0], &nz[0], numNormals, &rgb[0], pool);
+      bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+    }
+    
+    float error = 0.0f;
+    for (size_t i=0u; i<numNormals; ++i) {
+      for (int c=0; c<3; ++c) {
+        error = fmaxf( error, fabsf( rgb[3u*i + c] - reference[i][c] ));
+      }
+    }
+    
+    fprintf( stderr, "  %-8s : %9.3f ms  %9.2f Mnormals/s  x%6.2f  error %.2e\n", 
+             getKernelName( SIMDKernel(k) ), bestTime, 1.0e-3 * numNormals / bestTime,
+             naiveTime / bestTime, error / scale);
+  }
+  
+  setKernel( userKernel );
+}
+
+void irradianceBaking( const Image_t envmap[6], size_t numProbes, int size)
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] irradiance baking of %zu probes to %dx%d cubemaps, %u threads\n", 
+           numProbes, size, size, pool.getNumThreads());
+  
+  glm::mat4 M[3];
+  prefilter( envmap, M, pool);
+  
+  /// Probes scaled differently, as a set of light probes
+  std::vector<glm::mat4> probes( 3u * numProbes );
+  for (size_t i=0u; i<numProbes; ++i) {
+    for (int c=0; c<3; ++c) {
+      probes[3u*i + c] = (0.5f + float(i % 17u) / 16.0f) * M[c];
+    }
+  }
+  const glm::mat4 (*probeM)[3] = reinterpret_cast<const glm::mat4 (*)[3]>(&probes[0]);
+  
+  const size_t faceTexels = size_t(size) * size;
+  
+  for (int f=0; f<NUM_BAKE_FORMAT; ++f)
+  {
+    const BakeFormat format = BakeFormat(f);
+    const size_t faceBytes = faceTexels * getBakedTexelSize( format );
+    std::vector<unsigned char> pixels( numProbes * 6u * faceBytes );
+    
+    double bestTime = 1.0e30;
+    for (int run=0; run<NUM_RUNS; ++run)
+    {
+      double tStart = timer.getAbsoluteTime();
+      bakeIrradiance( probeM, numProbes, size, format, &pixels[0], pool);
+      bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+    }
+    
+    /// The first probe baked alone, to upload
+    Image_t faces[6];
+    bakeIrradiance( probeM[0], size, format, faces, pool);
+    
+    bool bIdentical = true;
+    float error = 0.0f;
+    
+    for (int face=0; face<6; ++face)
+    {
+      const unsigned char *baked = &pixels[face * faceBytes];
+      bIdentical &= (0 == memcmp( baked, faces[face].data, faceBytes));
+      
+      /// Relative difference to the matrix products on the texel directions
+      const float (&frame)[3][3] = FACE_FRAMES[face];
+      
+      for (int i=0; i<size; ++i) {
+        for (int j=0; j<size; ++j)
+        {
+          const float u = 2.0f * (j + 0.5f) / size - 1.0f;
+          const float v = 2.0f * (i + 0.5f) / size - 1.0f;
+          const glm::vec4 n( glm::normalize( glm::vec3( frame[0][0] + u * frame[1][0] + v * frame[2][0],
+                                                        frame[0][1] + u * frame[1][1] + v * frame[2][1],
+                                                        frame[0][2] + u * frame[1][2] + v * frame[2][2]) ), 
+                             1.0f);
+          const glm::vec3 expected( glm::dot( n, probeM[0][0] * n), 
+                                    glm::dot( n, probeM[0][1] * n), 
+                                    glm::dot( n, probeM[0][2] * n));
+          
+          const size_t texel = size_t(i) * size + j;
+          glm::vec3 color;
+          if (BAKE_RGB9E5 == format) {
+            color = unpackRGB9E5( reinterpret_cast<const uint32_t*>(baked)[texel] );
+          } else {
+            const float *rgb = reinterpret_cast<const float*>(baked) + 3u * texel;
+            color = glm::vec3( rgb[0], rgb[1], rgb[2]);
+          }
+          
+          const glm::vec3 d = glm::abs( color - expected );
+          const float maxc = fmaxf( expected.r, fmaxf( expected.g, expected.b));
+          error = fmaxf( error, fmaxf( d.r, fmaxf( d.g, d.b)) / maxc);
+        }
+      }
+    }
+    
+    fprintf( stderr, "  %s : %9.3f ms  %9.1f probes/s  %8.2f Mtexels/s  error %.2e  %s\n", 
+             (BAKE_RGB9E5 == format) ? "RGB9E5" : "RGB32F", bestTime, 
+             1.0e3 * numProbes / bestTime, 1.0e-3 * numProbes * 6u * faceTexels / bestTime, 
+             error, bIdentical ? "identical" : "MISMATCH");
+  }
+}
+
+void referenceIrradiance( const Image_t envmap[6], int size, int sourceResolution)
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] reference irradiance %dx%d from %dx%d, %u threads\n", 
+           size, size, sourceResolution, sourceResolution, pool.getNumThreads());
+  
+  glm::mat4 M[3];
+  prefilter( envmap, M, pool);
+  
+  /// Reference, then from a 4 times smaller source
+  Image_t reference[6], coarse[6];
+  
+  double tStart = timer.getAbsoluteTime();
+  bakeReferenceIrradiance( envmap, size, sourceResolution, reference, pool);
+  const double referenceTime = timer.getAbsoluteTime() - tStart;
+  
+  tStart = timer.getAbsoluteTime();
+  bakeReferenceIrradiance( envmap, size, sourceResolution / 4, coarse, pool);
+  const double coarseTime = timer.getAbsoluteTime() - tStart;
+  
+  float maxReference = 0.0f, coarseError = 0.0f;
+  for (int face=0; face<6; ++face)
+  {
+    const float *ref = reinterpret_cast<const float*>(reference[face].data);
+    const float *c = reinterpret_cast<const float*>(coarse[face].data);
+    
+    for (int k=0; k<3*size*size; ++k)
+    {
+      maxReference = fmaxf( maxReference, ref[k] );
+      coarseError = fmaxf( coarseError, fabsf( c[k] - ref[k] ));
+    }
+  }
+  
+  Image_t errorMaps[6];
+  const ReferenceError_t error = getErrorMaps( M, reference, errorMaps, pool);
+  
+  fprintf( stderr, "  source %4d : %9.1f ms\n", sourceResolution, referenceTime);
+  fprintf( stderr, "  source %4d : %9.1f ms  error %.2e\n", sourceResolution / 4, 
+           coarseTime, coarseError / maxReference);
+  fprintf( stderr, "  SH matrices : max error %.2e  rms error %.2e\n", 
+           error.maxError, error.rmsError);
+}
+
+void specularMipmaps( const Image_t envmap[6], int size, int lutSize)
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] specular mipmaps %dx%d, %u threads\n", 
+           size, size, pool.getNumThreads());
+  
+  /// Mean color of the source, to compare with the roughest level
+  Image_t reduced[6];
+  reduceCubemap( envmap, 1, reduced, pool);
+  
+  glm::dvec3 mean( 0.0 );
+  const size_t faceTexels = size_t(reduced[0].width) * reduced[0].height;
+  for (int face=0; face<6; ++face)
+  {
+    const float *texels = reinterpret_cast<const float*>(reduced[face].data);
+    for (size_t k=0u; k<faceTexels; ++k) {
+      mean += glm::dvec3( texels[3u*k + 0], texels[3u*k + 1], texels[3u*k + 2]);
+    }
+  }
+  mean /= 6.0 * faceTexels;
+  
+  static const int sampleBudgets[] = { 16, 64, 256 };
+  
+  for (const int numSamples : sampleBudgets)
+  {
+    std::vector< std::unique_ptr<Image_t[]> > levels;
+    std::vector<SpecularLevelStats_t> stats;
+    
+    const double tStart = timer.getAbsoluteTime();
+    prefilterSpecular( envmap, size, numSamples, levels, pool, &stats);
+    const double totalTime = timer.getAbsoluteTime() - tStart;
+    
+    fprintf( stderr, "  %3d samples : %9.1f ms\n", numSamples, totalTime);
+    for (size_t l=0u; l<stats.size(); ++l)
+    {
+      fprintf( stderr, "    level %2u %4dx%-4d roughness %.2f : %8.2f ms\n", unsigned(l), 
+               stats[l].size, stats[l].size, stats[l].roughness, stats[l].time);
+    }
+    
+    /// The roughest level is close to the mean of the hemisphere around R
+    glm::vec3 roughest( 0.0f );
+    for (int face=0; face<6; ++face)
+    {
+      const float *texel = reinterpret_cast<const float*>(levels.back()[face].data);
+      roughest += glm::vec3( texel[0], texel[1], texel[2]) / 6.0f;
+    }
+    fprintf( stderr, "    roughest level %.3f %.3f %.3f  (mean %.3f %.3f %.3f)\n", 
+             roughest.r, roughest.g, roughest.b, mean.r, mean.g, mean.b);
+  }
+  
+  /// BRDF table, its scale + bias being 1 at roughness 0 (cf. the paper)
+  for (const int numSamples : sampleBudgets)
+  {
+    double bestTime = 1.0e30;
+    Image_t table;
+    
+    for (int r=0; r<NUM_RUNS; ++r)
+    {
+      const double tStart = timer.getAbsoluteTime();
+      bakeBRDFTable( lutSize, numSamples, table, pool);
+      bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+    }
+    
+    const float *lut = reinterpret_cast<const float*>(table.data);
+    const float *smooth = lut + 2*(lutSize - 1);
+    const float *rough = lut + 2*(size_t(lutSize) * lutSize - 1);
+    
+    fprintf( stderr, "  BRDF table %dx%d, %3d samples : %8.2f ms  "
+             "(smooth %.3f %.3f, rough %.3f %.3f)\n", lutSize, lutSize, numSamples, bestTime,
+             smooth[0], smooth[1], rough[0], rough[1]);
+  }
+}
+
+/// Best time (ms) of NUM_RUNS evaluations of a basis on all the normals
+template<typename EvaluateFn>
+static
+double timeEvaluation( const std::vector<glm::vec3> &normals, std::vector<glm::vec3> &irradiance,
+                       EvaluateFn evaluate)
+{
+  Timer &timer = Timer::getInstance();
+  double bestTime = 1.0e30;
+  
+  irradiance.resize( normals.size() );
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    const double tStart = timer.getAbsoluteTime();
+    for (size_t i=0u; i<normals.size(); ++i) {
+      irradiance[i] = evaluate( normals[i] );
+    }
+    bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  return bestTime;
+}
+
+void irradianceBases( const Image_t envmap[6], size_t numNormals)
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  ThreadPool pool(1u);
+  
+  fprintf( stderr, "[Benchmark] irradiance bases %dx%d, %u normals, single thread\n", 
+           envmap[0].width, envmap[0].height, unsigned(numNormals));
+  
+  /// Projections
+  glm::mat4 M[3];
+  const double timeL2 = timePrefilter( envmap, M, pool);
+  
+  SH_t<1> sh1;
+  double timeL1 = 1.0e30;
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    const double tStart = timer.getAbsoluteTime();
+    prefilter( envmap, sh1, pool);
+    convolveIrradiance( sh1 );
+    timeL1 = std::min( timeL1, timer.getAbsoluteTime() - tStart );
+  }
+  
+  // Per frame conversions, timed on many calls
+  const int numConversions = 10000;
+  HBasis_t<4> h4;
+  HBasis_t<6> h6;
+  
+  double tStart = timer.getAbsoluteTime();
+  for (int i=0; i<numConversions; ++i) {
+    getHBasisIrradiance( M, h4);
+  }
+  const double timeH4 = (timer.getAbsoluteTime() - tStart) / numConversions;
+  
+  tStart = timer.getAbsoluteTime();
+  for (int i=0; i<numConversions; ++i) {
+    getHBasisIrradiance( M, h6);
+  }
+  const double timeH6 = (timer.getAbsoluteTime() - tStart) / numConversions;
+  
+  /// Shader coefficients
+  float poly[3][9];
+  getIrradiancePolynomial( M, poly);
+  glm::vec3 P[9];
+  for (int k=0; k<9; ++k) {
+    P[k] = glm::vec3( poly[0][k], poly[1][k], poly[2][k]);
+  }
+  
+  glm::vec3 L1[4], H4[2*4], H6[2*6];
+  getShaderCoefficients( sh1, L1);
+  getShaderCoefficients( h4, H4);
+  getShaderCoefficients( h6, H6);
+  
+  /// Fibonacci normals
+  std::vector<glm::vec3> normals( numNormals );
+  for (size_t i=0u; i<numNormals; ++i)
+  {
+    const float z = 1.0f - 2.0f * (i + 0.5f) / numNormals;
+    const float r = sqrtf( 1.0f - z*z );
+    const float phi = 2.39996323f * i;
+    normals[i] = glm::vec3( r*cosf(phi), r*sinf(phi), z);
+  }
+  
+  /// Evaluations, as computeIrradiance of the shaders
+  std::vector<glm::vec3> E2, E;
+  
+  const double evalL2 = timeEvaluation( normals, E2, [&](const glm::vec3 &n)
+  {
+    return P[0] + P[1] * n.y + P[2] * n.z + P[3] * n.x + P[4] * (n.x * n.y) + 
+           P[5] * (n.y * n.z) + P[6] * (n.z * n.z) + P[7] * (n.x * n.z) + 
+           P[8] * (n.x * n.x - n.y * n.y);
+  });
+  
+  float maxIrradiance = 0.0f;
+  for (const glm::vec3 &e : E2) {
+    maxIrradiance = fmaxf( maxIrradiance, fmaxf( e.r, fmaxf( e.g, e.b)));
+  }
+  
+  auto printBasis = [&]( const char *name, const int numCoeffs, const double projectionTime, 
+                         const double evaluationTime)
+  {
+    float maxError = 0.0f;
+    double sumSquares = 0.0;
+    for (size_t i=0u; i<numNormals; ++i)
+    {
+      const glm::vec3 d = glm::abs( E[i] - E2[i] );
+      const float e = fmaxf( d.r, fmaxf( d.g, d.b)) / maxIrradiance;
+      maxError = fmaxf( maxError, e);
+      sumSquares += double(e) * e;
+    }
+    
+    fprintf( stderr, "  %-3s (%d coeffs) : projection %9.3f ms  evaluation %6.2f ns/normal  "
+             "error to L2 max %.2e rms %.2e\n", name, numCoeffs, projectionTime, 
+             1.0e6 * evaluationTime / numNormals, maxError, sqrt( sumSquares / numNormals ));
+  };
+  
+  const double evalL1 = timeEvaluation( normals, E, [&](const glm::vec3 &n)
+  {
+    return L1[0] + L1[1] * n.y + L1[2] * n.z + L1[3] * n.x;
+  });
+  printBasis( "L1", 4, timeL1, evalL1);
+  
+  // The bands 0 and 1 of the matrices, without projection
+  SH_t<1> sh1FromL2;
+  getL1Irradiance( M, sh1FromL2);
+  float l1Difference = 0.0f;
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<4; ++k) {
+      l1Difference = fmaxf( l1Difference, fabsf( sh1FromL2.coeffs[c][k] - sh1.coeffs[c][k] ));
+    }
+  }
+  fprintf( stderr, "  L1 from the L2 matrices : difference %.2e\n", l1Difference / maxIrradiance);
+  
+  E = E2;
+  printBasis( "L2", 9, timeL2, evalL2);
+  
+  const double evalH4 = timeEvaluation( normals, E, [&](const glm::vec3 &n)
+  {
+    const glm::vec3 *h = (n.y >= 0.0f) ? H4 : H4 + 4;
+    return h[0] + h[1] * n.z + h[2] * (2.0f * fabsf(n.y) - 1.0f) + h[3] * n.x;
+  });
+  printBasis( "H4", 4, timeL2 + timeH4, evalH4);
+  
+  const double evalH6 = timeEvaluation( normals, E, [&](const glm::vec3 &n)
+  {
+    const glm::vec3 *h = (n.y >= 0.0f) ? H6 : H6 + 6;
+    return h[0] + h[1] * n.z + h[2] * (2.0f * fabsf(n.y) - 1.0f) + h[3] * n.x + 
+           h[4] * (n.x * n.z) + h[5] * (n.x * n.x - n.z * n.z);
+  });
+  printBasis( "H6", 6, timeL2 + timeH6, evalH6);
+  
+  /// The shader forms match the CPU evaluations
+  float difference = 0.0f;
+  for (size_t i=0u; i<numNormals; i+=97u)
+  {
+    const glm::vec3 d = glm::abs( evaluate( h6, normals[i]) - E[i] );
+    difference = fmaxf( difference, fmaxf( d.r, fmaxf( d.g, d.b)));
+  }
+  fprintf( stderr, "  H-basis conversion : H4 %.2f us, H6 %.2f us  "
+           "(shader form difference %.2e)\n", 1.0e3 * timeH4, 1.0e3 * timeH6, 
+           difference / maxIrradiance);
+}
+
+/// Best time (ms) of NUM_RUNS analyses
+static
+double timeAnalysis( const Image_t envmap[6], const unsigned int flags, 
+                     IrradianceEnvMap::EnvironmentAnalysis_t &analysis, ThreadPool &pool)
+{
+  Timer &timer = Timer::getInstance();
+  double bestTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    const double tStart = timer.getAbsoluteTime();
+    IrradianceEnvMap::analyzeEnvironment( envmap, flags, analysis, pool);
+    bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  return bestTime;
+}
+
+void environmentAnalysis( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  ThreadPool &pool = getThreadPool();
+  
+  fprintf( stderr, "[Benchmark] environment analysis %dx%d, %u threads\n", 
+           envmap[0].width, envmap[0].height, pool.getNumThreads());
+  
+  static const struct { unsigned int flag; const char *name; } passes[] =
+  {
+    { ANALYSIS_SH,             "SH" },
+    { ANALYSIS_LUMINANCE,      "luminance" },
+    { ANALYSIS_DOMINANT_LIGHT, "dominant light" },
+    { ANALYSIS_BOUNDS,         "bounds" }
+  };
+  
+  EnvironmentAnalysis_t analysis;
+  double separateTime = 0.0;
+  
+  for (const auto &pass : passes)
+  {
+    const double t = timeAnalysis( envmap, pass.flag, analysis, pool);
+    separateTime += t;
+    fprintf( stderr, "  %-14s : %9.3f ms\n", pass.name, t);
+  }
+  
+  const double fusedTime = timeAnalysis( envmap, ANALYSIS_ALL, analysis, pool);
+  fprintf( stderr, "  separate passes : %9.3f ms, fused pass %9.3f ms (x%.2f)\n", 
+           separateTime, fusedTime, separateTime / fusedTime);
+  
+  /// Same matrices as the direct projection
+  const PrefilterMethod method = getPrefilterMethod();
+  setPrefilterMethod( PREFILTER_DIRECT );
+  glm::mat4 M[3];
+  prefilter( envmap, M, pool);
+  setPrefilterMethod( method );
+  
+  fprintf( stderr, "  matrices difference to prefilter %.2e\n", maxDifference( M, analysis.M));
+  fprintf( stderr, "  luminance : average %.4f, log average %.4f\n", 
+           analysis.averageLuminance, analysis.logAverageLuminance);
+  fprintf( stderr, "  light : direction (%.3f %.3f %.3f) color (%.3f %.3f %.3f) "
+           "directionality %.3f\n", 
+           analysis.lightDirection.x, analysis.lightDirection.y, analysis.lightDirection.z,
+           analysis.lightColor.r, analysis.lightColor.g, analysis.lightColor.b,
+           analysis.directionality);
+  fprintf( stderr, "  bounds : min (%.3f %.3f %.3f) max (%.3f %.3f %.3f) "
+           "brightest (%.3f %.3f %.3f)\n", 
+           analysis.minRadiance.r, analysis.minRadiance.g, analysis.minRadiance.b,
+           analysis.maxRadiance.r, analysis.maxRadiance.g, analysis.maxRadiance.b,
+           analysis.brightestDirection.x, analysis.brightestDirection.y, 
+           analysis.brightestDirection.z);
+}
+
+void faceUpdate( const Image_t envmap[6], int numEditedRows)
+{
+  using namespace IrradianceEnvMap;
+  
+  ThreadPool &pool = getThreadPool();
+  Timer &timer = Timer::getInstance();
+  
+  const int texRes = envmap[0].width;
+  const int faceId = 4;
+  numEditedRows = std::min( numEditedRows, texRes / 2);
+  
+  fprintf( stderr, "[Benchmark] face update %dx%d, %d edited rows, %u threads\n", 
+           texRes, envmap[0].height, numEditedRows, pool.getNumThreads());
+  
+  /// Copy of the cubemap, its face colors inverted on a band of rows
+  Image_t editedEnvmap[6];
+  for (int i=0; i<6; ++i)
+  {
+    Image_t &dst = editedEnvmap[i];
+    dst.bytesPerPixel = envmap[i].bytesPerPixel;
+    dst.target = envmap[i].target;
+    dst.internalFormat = envmap[i].internalFormat;
+    dst.width = envmap[i].width;
+    dst.height = envmap[i].height;
+    dst.format = envmap[i].format;
+    dst.type = envmap[i].type;
+    dst.data = new GLubyte[ envmap[i].getMemorySize() ];
+    memcpy( dst.data, envmap[i].data, envmap[i].getMemorySize());
+  }
+  const Image_t &edited = editedEnvmap[faceId];
+  
+  const size_t rowSize = size_t(edited.bytesPerPixel) * texRes;
+  GLubyte *firstEdited = edited.data + (texRes / 2) * rowSize;
+  for (size_t i=0u; i<numEditedRows * rowSize; ++i) {
+    firstEdited[i] = ~firstEdited[i];
+  }
+  
+  /// Full projection, by the per tile sums and by prefilter
+  CubemapSums sums;
+  double initTime = 1.0e30;
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    const double tStart = timer.getAbsoluteTime();
+    sums.init( envmap, pool);
+    initTime = std::min( initTime, timer.getAbsoluteTime() - tStart );
+  }
+  
+  glm::mat4 initM[3], M[3], sumsM[3];
+  sums.getIrradianceMatrices( initM );
+  const double prefilterTime = timePrefilter( envmap, M, pool);
+  
+  /// Edit & restore the face, only the edited tiles being projected
+  FaceUpdateStats_t editStats, restoreStats;
+  double editTime = 1.0e30, restoreTime = 1.0e30;
+  
+  for (int run=0; run<NUM_RUNS; ++run)
+  {
+    sums.updateFace( faceId, edited, pool, &editStats);
+    sums.updateFace( faceId, envmap[faceId], pool, &restoreStats);
+    editTime = std::min( editTime, editStats.time );
+    restoreTime = std::min( restoreTime, restoreStats.time );
+  }
+  sums.getIrradianceMatrices( sumsM );
+  const float restoredError = maxDifference( initM, sumsM);
+  
+  sums.updateFace( faceId, edited, pool, &editStats);
+  sums.getIrradianceMatrices( sumsM );
+  
+  CubemapSums editedSums;
+  editedSums.init( editedEnvmap, pool);
+  editedSums.getIrradianceMatrices( M );
+  const float editedError = maxDifference( M, sumsM);
+  
+  fprintf( stderr, "  prefilter %9.3f ms, per tile sums %9.3f ms\n", prefilterTime, initTime);
+  fprintf( stderr, "  face update %9.3f ms (%d / %d tiles), restore %9.3f ms\n", 
+           editTime, editStats.numChangedTiles, editStats.numTiles, restoreTime);
+  fprintf( stderr, "  difference to a full projection : edited %.2e, restored %.2e\n", 
+           editedError, restoredError);
+}
+
+void imageSwizzle( int size )
+{
+  Timer &timer = Timer::getInstance();
+  
+  fprintf( stderr, "[Benchmark] image swizzle %dx%d\n", size, size);
+  
+  for (unsigned int nc=3u; nc<=4u; ++nc)
+  {
+    const size_t rowSize = size_t(size) * nc;
+    const size_t numBytes = rowSize * size;
+    
+    std::vector<unsigned char> src( numBytes ), dst( numBytes ), reference( numBytes );
+    for (size_t i=0u; i<numBytes; ++i) {
+      src[i] = (unsigned char)((i * 2654435761u) >> 13);
+    }
+    
+    for (int k=0; k<NUM_SWIZZLE_KERNEL; ++k)
+    {
+      const SwizzleRowFn swizzle = getSwizzleRow( SwizzleKernel(k) );
+      if (!swizzle) {
+        continue;
+      }
+      
+      /// Out of place, the rows flipped
+      double bestTime = 1.0e30;
+      for (int run=0; run<NUM_RUNS; ++run)
+      {
+        const double tStart = timer.getAbsoluteTime();
+        for (int y=0; y<size; ++y) {
+          swizzle( &src[(size-1-y) * rowSize], size, nc, &dst[y * rowSize]);
+        }
+        bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+      }
+      
+      if (SWIZZLE_SCALAR == k) {
+        reference = dst;
+      }
+      const bool bSame = (0 == memcmp( &dst[0], &reference[0], numBytes));
+      
+      /// In place, by pairs of rows
+      std::vector<unsigned char> row( rowSize );
+      double bestInPlaceTime = 1.0e30;
+      for (int run=0; run<NUM_RUNS; ++run)
+      {
+        dst = src;
+        const double tStart = timer.getAbsoluteTime();
+        for (int y=0; y<(size+1)/2; ++y)
+        {
+          unsigned char *top = &dst[y * rowSize];
+          unsigned char *bottom = &dst[(size-1-y) * rowSize];
+          swizzle( top, size, nc, &row[0]);
+          if (top != bottom) {
+            swizzle( bottom, size, nc, top);
+          }
+          memcpy( bottom, &row[0], rowSize);
+        }
+        bestInPlaceTime = std::min( bestInPlaceTime, timer.getAbsoluteTime() - tStart );
+      }
+      const bool bSameInPlace = (0 == memcmp( &dst[0], &reference[0], numBytes));
+      
+      fprintf( stderr, "  %u bytes %-6s : %8.3f ms %6.2f GB/s, in place %8.3f ms %6.2f GB/s%s\n", 
+               nc, getSwizzleKernelName( SwizzleKernel(k) ), 
+               bestTime, 1.0e-6 * numBytes / bestTime, 
+               bestInPlaceTime, 1.0e-6 * numBytes / bestInPlaceTime,
+               (bSame && bSameInPlace) ? "" : " (MISMATCH)");
+    }
+  }
+}
+
+void cubemapAsset( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  ThreadPool &pool = getThreadPool();
+  Timer &timer = Timer::getInstance();
+  
+  const char *filename = "benchmark_cubemap.iemc";
+  
+  fprintf( stderr, "[Benchmark] cubemap asset %dx%d, %u threads\n", 
+           envmap[0].width, envmap[0].height, pool.getNumThreads());
+  
+  /// Bake, with the box filtered levels
+  const double tBake = timer.getAbsoluteTime();
+  if (!bakeCubemapAsset( envmap, filename, false, pool)) {
+    return;
+  }
+  const double bakeTime = timer.getAbsoluteTime() - tBake;
+  
+  glm::mat4 M[3];
+  const double prefilterTime = timePrefilter( envmap, M, pool);
+  
+  /// Mapping then reading every page, the file being dropped from the cache
+  /// first (when the system allows it) or already cached
+  double openTime[2] = { 1.0e30, 1.0e30 };
+  size_t fileSize = 0u;
+  volatile unsigned int checksum = 0u;   // the pages being read
+  
+  for (int c=0; c<2; ++c)
+  {
+    const bool bCold = (0 == c);
+    
+    for (int run=0; run<NUM_RUNS; ++run)
+    {
+      #ifndef _WIN32
+      if (bCold)
+      {
+        const int fd = open( filename, O_RDONLY);
+        if (fd >= 0)
+        {
+          fdatasync( fd );
+          posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED);
+          close( fd );
+        }
+      }
+      #endif
+      
+      const double tStart = timer.getAbsoluteTime();
+      CubemapAsset asset;
+      if (!asset.open( filename )) {
+        break;
+      }
+      
+      const unsigned char *data = static_cast<const unsigned char*>(asset.getFace( 0, 0)) - 
+                                  asset.getHeader().offsets[0][0];
+      for (size_t i=0u; i<asset.getSize(); i+=4096u) {
+        checksum += data[i];
+      }
+      openTime[c] = std::min( openTime[c], timer.getAbsoluteTime() - tStart );
+      fileSize = asset.getSize();
+    }
+  }
+  
+  /// Same matrices & first level as the cubemap
+  float error = 1.0e30f;
+  bool bSameFaces = false;
+  {
+    CubemapAsset asset;
+    if (asset.open( filename ))
+    {
+      const CubemapAssetHeader_t &header = asset.getHeader();
+      glm::mat4 assetM[3];
+      for (int c=0; c<3; ++c) {
+        memcpy( &assetM[c][0][0], header.M[c], sizeof(header.M[c]));
+      }
+      error = maxDifference( M, assetM);
+      
+      bSameFaces = true;
+      for (int i=0; i<6; ++i) {
+        bSameFaces = bSameFaces && 
+                     (0 == memcmp( asset.getFace( 0, i), envmap[i].data, envmap[i].getMemorySize()));
+      }
+    }
+  }
+  remove( filename );
+  
+  fprintf( stderr, "  bake %9.3f ms, prefilter alone %9.3f ms\n", bakeTime, prefilterTime);
+  fprintf( stderr, "  %.2f MB : cold open %9.3f ms (%6.2f GB/s), warm open %9.3f ms (%6.2f GB/s)\n",
+           fileSize / (1024.0 * 1024.0), 
+           openTime[0], 1.0e-6 * fileSize / openTime[0], 
+           openTime[1], 1.0e-6 * fileSize / openTime[1]);
+  fprintf( stderr, "  difference to prefilter %.2e, level 0 %s\n", 
+           error, bSameFaces ? "identical" : "MISMATCH");
+}
+
+void irradianceCache( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  ThreadPool &pool = getThreadPool();
+  Timer &timer = Timer::getInstance();
+  
+  const std::string directory = "benchmark_cache";
+  const size_t entrySize = 256u;     // about an entry with no coefficients
+  
+  fprintf( stderr, "[Benchmark] irradiance cache %dx%d, %u threads\n", 
+           envmap[0].width, envmap[0].height, pool.getNumThreads());
+  
+  /// Faces written as files, to be keyed
+  std::string filenames[6];
+  size_t fileSize = 0u;
+  for (int i=0; i<6; ++i)
+  {
+    filenames[i] = directory + "_face" + char('0' + i) + ".raw";
+    FILE *fd = fopen( filenames[i].c_str(), "wb");
+    if (0 == fd) {
+      return;
+    }
+    fwrite( envmap[i].data, 1u, envmap[i].getMemorySize(), fd);
+    fclose( fd );
+    fileSize += envmap[i].getMemorySize();
+  }
+  
+  {
+    IrradianceCache cache( directory, 64u * entrySize);
+    if (!cache.isEnabled()) {
+      return;
+    }
+    
+    /// Miss : faces hashed, prefiltered & stored
+    glm::mat4 M[3], cachedM[3];
+    double tStart = timer.getAbsoluteTime();
+    uint64_t key = cache.getKey( filenames, 6u, 0u);
+    const bool bFirstHit = cache.lookup( key, cachedM, 0, 0u);
+    prefilter( envmap, M, pool);
+    cache.store( key, M, 0, 0u);
+    const double missTime = timer.getAbsoluteTime() - tStart;
+    
+    const double prefilterTime = timePrefilter( envmap, M, pool);
+    
+    /// Hits from the stats of the unchanged faces
+    double statHitTime = 1.0e30;
+    bool bHits = !bFirstHit;
+    for (int run=0; run<NUM_RUNS; ++run)
+    {
+      tStart = timer.getAbsoluteTime();
+      key = cache.getKey( filenames, 6u, 0u);
+      bHits = cache.lookup( key, cachedM, 0, 0u) && bHits;
+      statHitTime = std::min( statHitTime, timer.getAbsoluteTime() - tStart );
+    }
+    
+    /// Hits from the content of touched faces
+    double contentHitTime = 1.0e30;
+    for (int run=0; run<NUM_RUNS; ++run)
+    {
+      for (int i=0; i<6; ++i)
+      {
+        FILE *fd = fopen( filenames[i].c_str(), "r+b");
+        if (fd)
+        {
+          fwrite( envmap[i].data, 1u, 1u, fd);
+          fclose( fd );
+        }
+      }
+      
+      tStart = timer.getAbsoluteTime();
+      key = cache.getKey( filenames, 6u, 0u);
+      bHits = cache.lookup( key, cachedM, 0, 0u) && bHits;
+      contentHitTime = std::min( contentHitTime, timer.getAbsoluteTime() - tStart );
+    }
+    const float error = maxDifference( M, cachedM);
+    
+    /// Other settings, then a truncated entry
+    const bool bOtherSettings = cache.lookup( cache.getKey( filenames, 6u, 1u), cachedM, 0, 0u);
+    
+    char entryName[32];
+    sprintf( entryName, "/%016llx.sh", (unsigned long long)key);
+    FILE *fd = fopen( (directory + entryName).c_str(), "wb");
+    if (fd) {
+      fclose( fd );
+    }
+    const bool bTruncated = cache.lookup( key, cachedM, 0, 0u);
+    
+    fprintf( stderr, "  faces %.2f MB, prefilter %9.3f ms\n", fileSize / (1024.0 * 1024.0), 
+             prefilterTime);
+    fprintf( stderr, "  miss %9.3f ms, hit by the file stats %9.3f ms, by the content %9.3f ms\n", 
+             missTime, statHitTime, contentHitTime);
+    fprintf( stderr, "  %s, difference to prefilter %.2e, other settings %s, truncated %s\n", 
+             bHits ? "hits" : "MISSED", error, 
+             bOtherSettings ? "HIT" : "missed", bTruncated ? "HIT" : "missed");
+  }
+  
+  /// Least recently used entries evicted, past the size of 16 entries
+  {
+    glm::mat4 M[3];
+    IrradianceCache cache( directory, 16u * entrySize);
+    
+    int numKept = 0;
+    for (uint64_t key=1u; key<=64u; ++key)
+    {
+      cache.store( 1000u + key, M, 0, 0u);
+      numKept += cache.lookup( 1000u + 1u, M, 0, 0u) ? 1 : 0;
+    }
+    
+    const IrradianceCacheStats_t &stats = cache.getStats();
+    fprintf( stderr, "  64 stores in %u entries : %u evictions, first entry kept %s\n", 
+             16u, stats.numEvictions, (64 == numKept) ? "yes" : "NO");
+  }
+  
+  /// Clean up
+  IrradianceCache( directory, 0u).evict();
+  rmdir( directory.c_str() );
+  for (int i=0; i<6; ++i) {
+    remove( filenames[i].c_str() );
+  }
+}
+
+void imageViews( const Image_t envmap[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  ThreadPool &pool = getThreadPool();
+  Timer &timer = Timer::getInstance();
+  
+  const int texRes = envmap[0].width;
+  const unsigned int bpp = envmap[0].bytesPerPixel;
+  const size_t rowSize = size_t(bpp) * texRes;
+  
+  static const char* sLayoutNames[NUM_CUBEMAP_LAYOUT] = 
+  { 
+    "horizontal cross", "vertical cross", "horizontal strip", "vertical strip"
+  };
+  static const int sSizes[NUM_CUBEMAP_LAYOUT][2] = { {4,3}, {3,4}, {6,1}, {1,6} };
+  
+  fprintf( stderr, "[Benchmark] faces viewed in place %dx%d, %u threads\n", 
+           texRes, envmap[0].height, pool.getNumThreads());
+  
+  glm::mat4 M[3];
+  SH_t<4> sh;
+  timePrefilter( envmap, M, pool);
+  prefilter( envmap, sh, pool);
+  
+  for (int layout=0; layout<NUM_CUBEMAP_LAYOUT; ++layout)
+  {
+    /// Single image of the layout, its faces written through their views
+    Image_t image;
+    image.bytesPerPixel = bpp;
+    image.target = GL_TEXTURE_RECTANGLE;
+    image.internalFormat = envmap[0].internalFormat;
+    image.width = sSizes[layout][0] * texRes;
+    image.height = sSizes[layout][1] * texRes;
+    image.format = envmap[0].format;
+    image.type = envmap[0].type;
+    image.data = new GLubyte[image.getMemorySize()];
+    memset( image.data, 0, image.getMemorySize());
+    
+    Image_t rotated;
+    ImageView_t faces[6];
+    getCubemapFaces( image, faces, rotated);
+    
+    // The -Z face of the vertical cross is upside down, below +Z
+    const size_t stride = size_t(image.width) * bpp;
+    
+    for (int i=0; i<6; ++i) 
+    {
+      const bool bRotated = (faces[i].data == rotated.data);
+      GLubyte *dst = bRotated ? image.data + 3 * texRes * stride + rowSize :
+                                const_cast<GLubyte*>(faces[i].data);
+      
+      for (int y=0; y<texRes; ++y) 
+      {
+        const GLubyte *src = envmap[i].data + (bRotated ? texRes-1-y : y) * rowSize;
+        GLubyte *row = dst + y * stride;
+        
+        if (!bRotated) {
+          memcpy( row, src, rowSize);
+        } else {
+          for (int x=0; x<texRes; ++x) {
+            memcpy( row + x * bpp, src + (texRes-1-x) * bpp, bpp);
+          }
+        }
+      }
+    }
+    
+    /// Projected from the views, and from the faces cut out of the image
+    glm::mat4 viewM[3], copyM[3];
+    SH_t<4> viewSH;
+    double viewTime = 1.0e30, copyTime = 1.0e30;
+    
+    for (int run=0; run<NUM_RUNS; ++run)
+    {
+      double tStart = timer.getAbsoluteTime();
+      getCubemapFaces( image, faces, rotated);
+      prefilter( faces, viewM, pool);
+      viewTime = std::min( viewTime, timer.getAbsoluteTime() - tStart );
+      
+      tStart = timer.getAbsoluteTime();
+      getCubemapFaces( image, faces, rotated);
+      Image_t copies[6];
+      for (int i=0; i<6; ++i) {
+        copyImageView( faces[i], copies[i]);
+      }
+      prefilter( copies, copyM, pool);
+      copyTime = std::min( copyTime, timer.getAbsoluteTime() - tStart );
+    }
+    prefilter( faces, viewSH, pool);
+    
+    float shError = 0.0f;
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<SH_t<4>::NUM_COEFFS; ++k) {
+        shError = std::max( shError, fabsf( viewSH.coeffs[c][k] - sh.coeffs[c][k] ));
+      }
+    }
+    
+    fprintf( stderr, "  %-16s : views %9.3f ms, cut out %9.3f ms (x%.2f)  "
+             "difference to the faces %.2e, order 4 %.2e\n", 
+             sLayoutNames[layout], viewTime, copyTime, copyTime / viewTime, 
+             maxDifference( M, viewM), shError);
+  }
+}
+
+void imageLoading( const std::string filenames[6] )
+{
+  using namespace IrradianceEnvMap;
+  
+  Timer &timer = Timer::getInstance();
+  
+  fprintf( stderr, "[Benchmark] image loading %s ...\n", filenames[0].c_str());
+  
+  for (int s=0; s<2; ++s)
+  {
+    const bool bHalfFloat = (0 == s);
+    
+    double bestTime = 1.0e30;
+    double bestParallelTime = 1.0e30;
+    size_t memorySize = 0u;
+    double numTexels = 0.0;
+    PixelFormat format = NUM_PIXEL_FORMAT;
+    GLenum type = GL_UNSIGNED_BYTE;
+    
+    for (int r=0; r<NUM_RUNS; ++r)
+    {
+      Image_t image[6];
+      double tStart = timer.getAbsoluteTime();
+      
+      for (int face=0; face<6; ++face)
+      {
+        if (!image[face].load( filenames[face].c_str(), bHalfFloat )) {
+          return;
+        }
+      }
+      bestTime = std::min( bestTime, timer.getAbsoluteTime() - tStart );
+      
+      /// Faces decoded concurrently, as by TextureCubemap::load
+      {
+        Image_t parallelImage[6];
+        tStart = timer.getAbsoluteTime();
+        
+        ParallelImageLoader loader( filenames, parallelImage, 6u);
+        bool bLoaded;
+        while (loader.next( &bLoaded ) >= 0) 
+        {
+          if (!bLoaded) {
+            return;
+          }
+        }
+        bestParallelTime = std::min( bestParallelTime, timer.getAbsoluteTime() - tStart );
+      }
+      
+      memorySize = 0u;
+      numTexels = 0.0;
+      for (int face=0; face<6; ++face) 
+      {
+        memorySize += image[face].getMemorySize();
+        numTexels += double(image[face].width) * image[face].height;
+      }
+      format = getPixelFormat( image[0] );
+      type = image[0].type;
+    }
+    
+    fprintf( stderr, "  %-8s : %9.3f ms  %8.2f Mtexels/s  %8.2f MB, "
+             "parallel %9.3f ms (x%.2f)\n", 
+             getPixelFormatName( format ), bestTime, 1.0e-3 * numTexels / bestTime, 
+             memorySize / (1024.0 * 1024.0), bestParallelTime, bestTime / bestParallelTime);
+    
+    // LDR images do not depend on the storage of HDR ones
+    if (GL_UNSIGNED_BYTE == type) {
+      break;
+    }
+  }
+}
+
+
+} //namespace Benchmark
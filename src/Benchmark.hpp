@@ -0,0 +1,133 @@
+/**
+ * 
+ *      \file Benchmark.hpp
+ * 
+ *      Timings of the CPU side irradiance computations, printed on stderr.
+ *      Enabled at load time when compiled with -DENABLE_IEM_BENCHMARK=1.
+ * 
+ */
+ 
+
+#pragma once
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <string>
+#include <tools/ImageLoader.hpp>
+
+
+namespace Benchmark
+{
+  
+  /** Time the prefiltering of a cubemap with 1 to maxThreads threads
+   *  (hardware concurrency if 0) and check the results are bit-identical */
+  void prefilterScaling( const Image_t envmap[6], unsigned int maxThreads=0u);
+  
+  /** Time the supported projection kernels on a single thread and compare
+   *  their results to the scalar reference */
+  void projectionKernels( const Image_t envmap[6] );
+  
+  /** Time the direct & weight table projections, the latter for a single 
+   *  cubemap and a batch of 'batchSize' copies of it */
+  void prefilterMethods( const Image_t envmap[6], size_t batchSize=8u);
+  
+  /** Time the projection of each SH order on a single thread and give the
+   *  irradiance difference to the highest order */
+  void shOrders( const Image_t envmap[6] );
+  
+  /** Time the prefiltering of an 8-bit cubemap converted to each supported 
+   *  pixel format, on a single thread */
+  void pixelFormats( const Image_t envmap[6] );
+  
+  /** Time the prefiltering of box-reduced levels of a cubemap and compare 
+   *  their estimated & actual errors, then the level selection for some
+   *  error budgets */
+  void mipReduction( const Image_t envmap[6] );
+  
+  /** Time the sampled projection for increasing sample counts and compare
+   *  its estimated & actual errors */
+  void sampledProjection( const Image_t envmap[6] );
+  
+  /** Time the fixed point projection of an 8-bit cubemap with each
+   *  supported kernel against the float weight table, give their errors 
+   *  to the direct scalar reference and check the fixed point results are
+   *  bit-identical across kernels, threads and batches */
+  void fixedPoint( const Image_t envmap[6], size_t batchSize=8u);
+  
+  /** Time the prefiltering of a set of cubemaps of mixed resolutions 
+   *  (the cubemap and its box-reduced levels, 'count' in total) one by one
+   *  and by prefilterBatch, on the shared thread pool, and check their 
+   *  results are identical */
+  void batchPrefilter( const Image_t envmap[6], size_t count=32u);
+  
+  /** Time the rotation of the SH coefficients of each order (per frame, 
+   *  and for a batch of numProbes sets) and compare the rotated irradiance
+   *  to the one of the rotated back normals */
+  void shRotation( const Image_t envmap[6], size_t numProbes=4096u);
+  
+  /** Time the SH algebra of each order on a batch of numProbes sets, and 
+   *  check the convolution and the product against known results */
+  void shAlgebra( const Image_t envmap[6], size_t numProbes=4096u);
+  
+  /** Time the evaluation of the irradiance matrices of a cubemap on 
+   *  numNormals normals with each supported kernel, against the matrix 
+   *  products of a plain glm loop */
+  void irradianceEvaluation( const Image_t envmap[6], size_t numNormals=1u << 20);
+  
+  /** Time the baking of numProbes irradiance cubemaps of size x size in 
+   *  each format, check a single probe bake gives the same faces and
+   *  compare them to the matrix products */
+  void irradianceBaking( const Image_t envmap[6], size_t numProbes=256u, int size=32);
+  
+  /** Time the reference irradiance cubemap of size x size from the cubemap
+   *  reduced to sourceResolution (and to a quarter of it), and give the 
+   *  errors of the SH matrices against it */
+  void referenceIrradiance( const Image_t envmap[6], int size=32, int sourceResolution=256);
+  
+  /** Time the GGX prefiltered mipmaps of size x size with each sample 
+   *  budget (per mip level) and the BRDF table, and check the roughest 
+   *  level against the mean color of the cubemap */
+  void specularMipmaps( const Image_t envmap[6], int size=64, int lutSize=64);
+  
+  /** Compare the irradiance bases of the renderer (L1 SH, L2 matrices and
+   *  H-basis) : time their projection and their evaluation in the form of 
+   *  the EnvMapping shaders on numNormals normals (single thread), and give
+   *  their error against the L2 matrices */
+  void irradianceBases( const Image_t envmap[6], size_t numNormals=1u << 20);
+  
+  /** Time the analysis of a cubemap by one pass per reduction and by a 
+   *  single fused pass, and check its matrices against the direct
+   *  projection of prefilter */
+  void environmentAnalysis( const Image_t envmap[6] );
+  
+  /** Time the update of the irradiance when a face of a cubemap is edited
+   *  on numEditedRows rows, by its changed tiles only, against the 
+   *  projection of the whole cubemap */
+  void faceUpdate( const Image_t envmap[6], int numEditedRows=64 );
+  
+  /** Time the conversion of size x size bitmaps of 3 and 4 bytes pixels 
+   *  from the FreeImage layout, by each swizzle kernel, out of place and 
+   *  in place as by Image_t::load */
+  void imageSwizzle( int size=2048 );
+  
+  /** Time the bake of a cubemap asset and its opening, from the disk and 
+   *  from the page cache, against the prefiltering it replaces */
+  void cubemapAsset( const Image_t envmap[6] );
+  
+  /** Time the lookups of the irradiance cache, hit from the stats of the 
+   *  faces or from their content, against a miss, and check its eviction */
+  void irradianceCache( const Image_t envmap[6] );
+  
+  /** Time the prefiltering of a cubemap stored as a cross or a strip, 
+   *  from the views of its faces against faces cut out of the image */
+  void imageViews( const Image_t envmap[6] );
+  
+  /** Time the loading of the faces of a cubemap and give their memory size, 
+   *  HDR faces being loaded both as halves and floats */
+  void imageLoading( const std::string filenames[6] );
+  
+} //namespace Benchmark
+
+
+#endif //BENCHMARK_HPP
@@ -182,3 +182,17 @@ bool ProgramShader::setUniform( const std::string &name, const glm::mat4 &v) con
   glUniformMatrix4fv( loc, 1, GL_FALSE, glm::value_ptr(v));
   return true;
 }
+
+bool ProgramShader::setUniform( const std::string &name, const glm::vec3 *v, GLsizei count) const
+{
+  GLint loc = glGetUniformLocation( m_id, name.c_str());
+    
+  if (-1 == loc) 
+  {
+    //Logger::getInstance().debug( "ProgramShader : can't find uniform \"%s\".", name);
+    return false;
+  }    
+  
+  glUniform3fv( loc, count, glm::value_ptr(v[0]));
+  return true;
+}
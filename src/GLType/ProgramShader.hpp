@@ -60,6 +60,7 @@ class ProgramShader
     bool setUniform( const std::string &name, const glm::vec4 &v) const;
     bool setUniform( const std::string &name, const glm::mat3 &v) const;
     bool setUniform( const std::string &name, const glm::mat4 &v) const;
+    bool setUniform( const std::string &name, const glm::vec3 *v, GLsizei count) const;
     // add array type..  
   
   private:
@@ -7,13 +7,57 @@
 
 #include <GL/glew.h>
 #include <cassert>
+#include <cstring>
+#include <sys/stat.h>
 #include <tools/ImageLoader.hpp>
+#include <tools/ImageView.hpp>
+#include <tools/ParallelImageLoader.hpp>
 #include <tools/Timer.hpp>
+#include "irradianceAsset.hpp"
+#include "irradianceCache.hpp"
 #include "irradianceEnvMap.hpp"
+#include "irradianceMipmap.hpp"
+#include "irradiancePixelFormat.hpp"
+#include "irradianceSpecular.hpp"
+
+#if ENABLE_IEM_BENCHMARK
+#include "Benchmark.hpp"
+#endif
 
 #include "Texture.hpp"
 
 
+namespace
+{
+  /// Mipmaps of the cubemaps, as in the assets
+  #if ENABLE_IEM_SPECULAR_MIPMAP
+  const bool bSpecularMipmap = true;
+  #else
+  const bool bSpecularMipmap = false;
+  #endif
+  
+  /// Settings of the irradiance computed by load, to key its cache entries
+  const uint32_t irradianceSettings = IEM_SH_ORDER 
+  #if ENABLE_IEM_APPROX_PREFILTER
+    | (1u << 8) | (uint32_t(1.0e6f * IEM_APPROX_ERROR_BUDGET) << 9)
+  #endif
+  ;
+  
+  /// Return true when a file was modified at the time of another or after,
+  /// to the nanosecond when the system keeps it
+  bool isModifiedSince( const struct stat &file, const struct stat &reference )
+  {
+    #ifndef _WIN32
+    return (file.st_mtim.tv_sec > reference.st_mtim.tv_sec) ||
+           ((file.st_mtim.tv_sec == reference.st_mtim.tv_sec) && 
+            (file.st_mtim.tv_nsec >= reference.st_mtim.tv_nsec));
+    #else
+    return file.st_mtime >= reference.st_mtime;
+    #endif
+  }
+}
+
+
 /** TEXTURE ----------------------------------------- */
 
 void Texture::generate()
@@ -102,6 +146,24 @@ bool TextureCubemap::load(const std::string &name)
  	
   assert( 0u != m_id );
   
+  /// Baked asset, given or up to date beside the faces
+  const std::string assetName = getAssetName( name );
+  
+  if (name == assetName) {
+    return loadAsset( name );
+  }
+  
+  /// Single image, a cross or a strip of faces
+  if (name.npos == name.find_last_of( '*' )) {
+    return loadLayout( name );
+  }
+  
+  #if !ENABLE_IEM_FACE_WATCH && !ENABLE_IEM_BENCHMARK
+  if (isAssetUpToDate( name ) && loadAsset( assetName )) {
+    return true;
+  }
+  #endif
+  
     
   bind();
   {  
@@ -120,40 +182,135 @@ bool TextureCubemap::load(const std::string &name)
     /// TODO : rewrite the loader-----------------------------------------------
     Image_t image[6];
     
-    size_t wildcard_idx = name.find_last_of( '*', name.size());
-    assert( wildcard_idx != name.npos );
+    std::string *texnames = m_faceNames;
+    getFaceNames( name, texnames);
     
-    std::string begin_name = name.substr(0, wildcard_idx);
-    std::string end_name = name.substr( wildcard_idx+1, name.size()-(wildcard_idx+1));
-    static const std::string wildname[] = { "posx", "negx", "posy", "negy", "posz", "negz"};
+    size_t memorySize = 0u;
+    double tDecoding = 0.0;
+    const double tLoadStart = Timer::getInstance().getAbsoluteTime();
     
-    for (int i=0; i<6; ++i)
+    /// The faces are decoded concurrently, each one being uploaded as soon
+    /// as it is ready
     {
-      std::string texname = begin_name + wildname[i] + end_name;      
+      ParallelImageLoader loader( texnames, image, 6u);
       
-      assert( true == image[i].load(texname.c_str()) );      
-      assert( GL_TEXTURE_2D == image[i].target ); //
-      fprintf( stderr, "%s loaded\n", texname.c_str());
-            
-      glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 
-                    image[i].internalFormat, 
-                    image[i].width, image[i].height, 0, 
-                    image[i].format, image[i].type, 
-                    image[i].data);
+      int i;
+      bool bLoaded;
+      double tFace;
+      
+      while ((i = loader.next( &bLoaded, &tFace)) >= 0)
+      {
+        if (!bLoaded || (GL_TEXTURE_2D != image[i].target)) 
+        {
+          fprintf( stderr, "%s : can't be loaded.\n", texnames[i].c_str());
+          unbind();
+          return false;
+        }
+        
+        tDecoding += tFace;
+        memorySize += image[i].getMemorySize();
+        fprintf( stderr, "%s loaded (%s, %.2f MB, %.1f ms)\n", texnames[i].c_str(), 
+                 IrradianceEnvMap::getPixelFormatName( IrradianceEnvMap::getPixelFormat(image[i]) ),
+                 image[i].getMemorySize() / (1024.0 * 1024.0), tFace);
+              
+        glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 
+                      image[i].internalFormat, 
+                      image[i].width, image[i].height, 0, 
+                      image[i].format, image[i].type, 
+                      image[i].data);
+      }
     }
+    
+    const double tLoading = Timer::getInstance().getAbsoluteTime() - tLoadStart;
     /// TODO : rewrite the loader-----------------------------------------------
     
-    fprintf( stderr, "Computing the irradiance matrices : " ); fflush(stderr);    
-    float tStart = Timer::getInstance().getRelativeTime();    
+    fprintf( stderr, "Cubemap loaded : %.2f MB in %.1f ms (faces decoding %.1f ms)\n", 
+             memorySize / (1024.0 * 1024.0), tLoading, tDecoding);
     
-    IrradianceEnvMap::prefilter( image, m_shMatrix);    
+    #if !ENABLE_IEM_FACE_WATCH
+    uint64_t cacheKey;
+    const bool bCached = _lookupIrradiance( texnames, 6u, irradianceSettings, &cacheKey);
+    #else
+    const bool bCached = false;
+    #endif
     
-    fprintf( stderr, "%.3f seconds.\n", 0.001f*(Timer::getInstance().getRelativeTime() - tStart)); 
+    if (!bCached)
+    {
+      fprintf( stderr, "Computing the irradiance matrices : " ); fflush(stderr);    
+      float tStart = Timer::getInstance().getRelativeTime();    
+      
+      #if ENABLE_IEM_APPROX_PREFILTER
+      float error;
+      int level = IrradianceEnvMap::prefilterWithinBudget( image, IEM_APPROX_ERROR_BUDGET, m_shMatrix, 
+                                                           &error, IrradianceEnvMap::getThreadPool());
+      fprintf( stderr, "(level %d, estimated error %.2e) ", level, error);
+      #elif ENABLE_IEM_FACE_WATCH
+      // Same matrices as the direct path of prefilter, kept per tile for reloadFace
+      m_faceSums.init( image, IrradianceEnvMap::getThreadPool());
+      m_faceSums.getIrradianceMatrices( m_shMatrix );
+      #else
+      IrradianceEnvMap::prefilter( image, m_shMatrix);    
+      #endif
+      
+      #if IEM_SH_ORDER == 1
+      IrradianceEnvMap::getL1Irradiance( m_shMatrix, m_shIrradiance);
+      #elif IEM_SH_ORDER != 2
+      IrradianceEnvMap::prefilter( image, m_shIrradiance, IrradianceEnvMap::getThreadPool());
+      IrradianceEnvMap::convolveIrradiance( m_shIrradiance );
+      #endif
+      
+      fprintf( stderr, "%.3f seconds.\n", 0.001f*(Timer::getInstance().getRelativeTime() - tStart)); 
+      
+      #if !ENABLE_IEM_FACE_WATCH
+      _storeIrradiance( cacheKey );
+      #endif
+    }
     
     m_bIrradiancePrecomputed = true;
     
+    #if ENABLE_IEM_BENCHMARK
+    Benchmark::prefilterScaling( image );
+    Benchmark::projectionKernels( image );
+    Benchmark::prefilterMethods( image );
+    Benchmark::shOrders( image );
+    Benchmark::pixelFormats( image );
+    Benchmark::mipReduction( image );
+    Benchmark::sampledProjection( image );
+    Benchmark::fixedPoint( image );
+    Benchmark::batchPrefilter( image );
+    Benchmark::shRotation( image );
+    Benchmark::shAlgebra( image );
+    Benchmark::irradianceEvaluation( image );
+    Benchmark::irradianceBaking( image );
+    Benchmark::referenceIrradiance( image );
+    Benchmark::specularMipmaps( image );
+    Benchmark::irradianceBases( image );
+    Benchmark::environmentAnalysis( image );
+    Benchmark::faceUpdate( image );
+    Benchmark::imageSwizzle();
+    Benchmark::cubemapAsset( image );
+    Benchmark::irradianceCache( image );
+    Benchmark::imageViews( image );
+    Benchmark::imageLoading( texnames );
+    #endif
+    
     
-    #if 1/*ENABLE_TEXTURE_MIPMAP*/
+    #if ENABLE_IEM_SPECULAR_MIPMAP
+    /// GGX prefiltered levels, for textureLod( envmap, R, roughness * maxLevel )
+    std::vector< std::unique_ptr<Image_t[]> > levels;
+    std::vector<IrradianceEnvMap::SpecularLevelStats_t> stats;
+    IrradianceEnvMap::prefilterSpecular( image, image[0].width, IEM_SPECULAR_SAMPLES, levels, 
+                                         IrradianceEnvMap::getThreadPool(), &stats);
+    
+    double tSpecular = 0.0;
+    for (size_t l=0u; l<stats.size(); ++l) {
+      tSpecular += stats[l].time;
+    }
+    fprintf( stderr, "Specular mipmaps : %u levels, %d samples in %.1f ms\n", 
+             unsigned(levels.size()), IEM_SPECULAR_SAMPLES, tSpecular);
+    
+    upload( levels );
+    #elif 1/*ENABLE_TEXTURE_MIPMAP*/
     glGenerateMipmap( GL_TEXTURE_CUBE_MAP );
     #endif   
   }
@@ -162,3 +319,478 @@ bool TextureCubemap::load(const std::string &name)
   
   return true;
 }
+
+bool TextureCubemap::loadAsset(const std::string &filename)
+{
+  assert( 0u != m_id );
+  
+  Timer &timer = Timer::getInstance();
+  const double tStart = timer.getAbsoluteTime();
+  
+  IrradianceEnvMap::CubemapAsset asset;
+  if (!asset.open( filename.c_str() )) {
+    return false;
+  }
+  
+  const IrradianceEnvMap::CubemapAssetHeader_t &header = asset.getHeader();
+  const bool bSpecular = (0u != (header.flags & IrradianceEnvMap::ASSET_SPECULAR_MIPMAP));
+  
+  if (bSpecular != bSpecularMipmap)
+  {
+    fprintf( stderr, "%s : baked with other mipmaps, not used.\n", filename.c_str());
+    return false;
+  }
+  
+  const double tMapped = timer.getAbsoluteTime();
+  size_t memorySize = 0u;
+  
+  bind();
+  {
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, GLint(header.numLevels) - 1);
+    
+    // The rows of the small levels are not 4 bytes aligned
+    GLint alignment;
+    glGetIntegerv( GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1);
+    
+    /// Uploaded straight from the mapping
+    for (int l=0; l<int(header.numLevels); ++l)
+    {
+      const int size = asset.getLevelSize( l );
+      
+      for (int i=0; i<6; ++i)
+      {
+        glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, l, 
+                      header.internalFormat, size, size, 0, 
+                      header.format, header.type, 
+                      asset.getFace( l, i));
+        memorySize += asset.getFaceSize( l );
+      }
+    }
+    
+    glPixelStorei( GL_UNPACK_ALIGNMENT, alignment);
+  }
+  unbind();
+  
+  /// Precomputed irradiance
+  for (int c=0; c<3; ++c) {
+    memcpy( &m_shMatrix[c][0][0], header.M[c], sizeof(header.M[c]));
+  }
+  
+  #if IEM_SH_ORDER == 1
+  IrradianceEnvMap::getL1Irradiance( m_shMatrix, m_shIrradiance);
+  #elif IEM_SH_ORDER != 2
+  // The first bands of the coefficients of SH_MAX_ORDER
+  for (int c=0; c<3; ++c) {
+    memcpy( m_shIrradiance.coeffs[c], header.shCoeffs[c], sizeof(m_shIrradiance.coeffs[c]));
+  }
+  IrradianceEnvMap::convolveIrradiance( m_shIrradiance );
+  #endif
+  
+  m_bIrradiancePrecomputed = true;
+  
+  const double tEnd = timer.getAbsoluteTime();
+  
+  fprintf( stderr, "%s loaded : %d levels, %.2f MB in %.1f ms (mapping %.1f ms, "
+           "upload %.1f ms, %.2f GB/s)\n", 
+           filename.c_str(), int(header.numLevels), memorySize / (1024.0 * 1024.0), 
+           tEnd - tStart, tMapped - tStart, tEnd - tMapped, 
+           1.0e-6 * memorySize / (tEnd - tMapped));
+  
+  return true;
+}
+
+bool TextureCubemap::bakeAsset(const std::string &name)
+{
+  Image_t image[6];
+  std::string texnames[6];
+  getFaceNames( name, texnames);
+  
+  /// Decoded as by load
+  {
+    ParallelImageLoader loader( texnames, image, 6u);
+    
+    int i;
+    bool bLoaded;
+    while ((i = loader.next( &bLoaded )) >= 0)
+    {
+      if (!bLoaded || (GL_TEXTURE_2D != image[i].target)) 
+      {
+        fprintf( stderr, "%s : can't be baked.\n", texnames[i].c_str());
+        return false;
+      }
+    }
+  }
+  
+  const std::string assetName = getAssetName( name );
+  const double tStart = Timer::getInstance().getAbsoluteTime();
+  
+  if (!IrradianceEnvMap::bakeCubemapAsset( image, assetName.c_str(), 
+                                           bSpecularMipmap, 
+                                           IrradianceEnvMap::getThreadPool())) {
+    return false;
+  }
+  
+  fprintf( stderr, "%s baked in %.1f ms\n", assetName.c_str(), 
+           Timer::getInstance().getAbsoluteTime() - tStart);
+  
+  return true;
+}
+
+void TextureCubemap::getFaceNames(const std::string &name, std::string names[6])
+{
+  static const std::string wildname[] = { "posx", "negx", "posy", "negy", "posz", "negz"};
+  
+  size_t wildcard_idx = name.find_last_of( '*', name.size());
+  assert( wildcard_idx != name.npos );
+  
+  std::string begin_name = name.substr(0, wildcard_idx);
+  std::string end_name = name.substr( wildcard_idx+1, name.size()-(wildcard_idx+1));
+  
+  for (int i=0; i<6; ++i) {
+    names[i] = begin_name + wildname[i] + end_name;
+  }
+}
+
+std::string TextureCubemap::getAssetName(const std::string &name)
+{
+  static const std::string extension = ".iemc";
+  
+  if ((name.size() >= extension.size()) && 
+      (0 == name.compare( name.size() - extension.size(), extension.size(), extension))) {
+    return name;
+  }
+  
+  const size_t wildcard_idx = name.find_last_of( '*', name.size());
+  return name.substr( 0, wildcard_idx) + "cubemap" + extension;
+}
+
+bool TextureCubemap::isAssetUpToDate(const std::string &name)
+{
+  struct stat assetStat;
+  if (0 != stat( getAssetName( name ).c_str(), &assetStat)) {
+    return false;
+  }
+  
+  std::string texnames[6];
+  getFaceNames( name, texnames);
+  
+  for (int i=0; i<6; ++i)
+  {
+    struct stat faceStat;
+    if ((0 == stat( texnames[i].c_str(), &faceStat)) && 
+        isModifiedSince( faceStat, assetStat)) 
+    {
+      fprintf( stderr, "%s : older than its faces, not used.\n", getAssetName( name ).c_str());
+      return false;
+    }
+  }
+  
+  return true;
+}
+
+bool TextureCubemap::loadLayout(const std::string &filename)
+{
+  assert( 0u != m_id );
+  
+  Timer &timer = Timer::getInstance();
+  const double tStart = timer.getAbsoluteTime();
+  
+  Image_t image;
+  if (!image.load( filename.c_str() )) {
+    return false;
+  }
+  const double tDecoding = timer.getAbsoluteTime() - tStart;
+  
+  /// Faces viewed in place
+  static const char* sLayoutNames[NUM_CUBEMAP_LAYOUT] = 
+  { 
+    "horizontal cross", "vertical cross", "horizontal strip", "vertical strip"
+  };
+  
+  Image_t rotated;
+  ImageView_t faces[6];
+  const CubemapLayout layout = getCubemapFaces( image, faces, rotated);
+  
+  if (NUM_CUBEMAP_LAYOUT == layout)
+  {
+    fprintf( stderr, "%s : not a cubemap cross nor strip (%dx%d).\n", 
+             filename.c_str(), image.width, image.height);
+    return false;
+  }
+  
+  for (int i=0; i<6; ++i) {
+    m_faceNames[i].clear();
+  }
+  
+  upload( faces );
+  
+  fprintf( stderr, "%s loaded (%s, %s %dx%d, %.2f MB, decoding %.1f ms, upload %.1f ms)\n", 
+           filename.c_str(), sLayoutNames[layout], 
+           IrradianceEnvMap::getPixelFormatName( IrradianceEnvMap::getPixelFormat( image ) ),
+           faces[0].width, faces[0].height, image.getMemorySize() / (1024.0 * 1024.0), 
+           tDecoding, timer.getAbsoluteTime() - tStart - tDecoding);
+  
+  /// Irradiance, projected from the views (the approximate prefiltering 
+  /// being only done on separate faces)
+  uint64_t cacheKey;
+  const uint32_t settings = IEM_SH_ORDER;
+  
+  if (!_lookupIrradiance( &filename, 1u, settings, &cacheKey))
+  {
+    ThreadPool &pool = IrradianceEnvMap::getThreadPool();
+    IrradianceEnvMap::prefilter( faces, m_shMatrix, pool);
+    
+    #if IEM_SH_ORDER == 1
+    IrradianceEnvMap::getL1Irradiance( m_shMatrix, m_shIrradiance);
+    #elif IEM_SH_ORDER != 2
+    IrradianceEnvMap::prefilter( faces, m_shIrradiance, pool);
+    IrradianceEnvMap::convolveIrradiance( m_shIrradiance );
+    #endif
+    
+    _storeIrradiance( cacheKey );
+  }
+  m_bIrradiancePrecomputed = true;
+  
+  /// Mipmaps
+  #if ENABLE_IEM_SPECULAR_MIPMAP
+  Image_t packed[6];
+  for (int i=0; i<6; ++i) {
+    copyImageView( faces[i], packed[i]);
+  }
+  
+  std::vector< std::unique_ptr<Image_t[]> > levels;
+  IrradianceEnvMap::prefilterSpecular( packed, packed[0].width, IEM_SPECULAR_SAMPLES, levels, 
+                                       IrradianceEnvMap::getThreadPool());
+  upload( levels );
+  #else
+  bind();
+  glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glGenerateMipmap( GL_TEXTURE_CUBE_MAP );
+  unbind();
+  #endif
+  
+  return true;
+}
+
+bool TextureCubemap::_lookupIrradiance(const std::string filenames[], const size_t count, 
+                                       const uint32_t settings, uint64_t *key)
+{
+  *key = 0u;
+  
+  #if ENABLE_IEM_SH_CACHE
+  /// Irradiance of the same files computed on a previous launch
+  IrradianceEnvMap::IrradianceCache &cache = IrradianceEnvMap::getIrradianceCache();
+  *key = cache.getKey( filenames, count, settings);
+  
+  #if (IEM_SH_ORDER == 1) || (IEM_SH_ORDER == 2)
+  const bool bCached = cache.lookup( *key, m_shMatrix, 0, 0u);
+  #else
+  const bool bCached = cache.lookup( *key, m_shMatrix, &m_shIrradiance.coeffs[0][0], 
+                                     IrradianceEnvMap::SH_t<IEM_SH_ORDER>::NUM_COEFFS);
+  #endif
+  
+  #if IEM_SH_ORDER == 1
+  if (bCached) {
+    IrradianceEnvMap::getL1Irradiance( m_shMatrix, m_shIrradiance);
+  }
+  #endif
+  
+  const IrradianceEnvMap::IrradianceCacheStats_t &stats = cache.getStats();
+  fprintf( stderr, "Irradiance cache : %s (%u hits, %u from the file stats, %u misses, "
+           "%u evictions, lookups %.2f ms)\n", 
+           bCached ? "hit" : "miss", stats.numHits, stats.numStatHits, 
+           stats.numMisses, stats.numEvictions, stats.lookupTime);
+  
+  return bCached;
+  #else
+  (void)filenames; (void)count; (void)settings;
+  return false;
+  #endif
+}
+
+void TextureCubemap::_storeIrradiance(const uint64_t key)
+{
+  #if ENABLE_IEM_SH_CACHE
+  IrradianceEnvMap::IrradianceCache &cache = IrradianceEnvMap::getIrradianceCache();
+  
+  #if (IEM_SH_ORDER == 1) || (IEM_SH_ORDER == 2)
+  cache.store( key, m_shMatrix, 0, 0u);
+  #else
+  cache.store( key, m_shMatrix, &m_shIrradiance.coeffs[0][0], 
+               IrradianceEnvMap::SH_t<IEM_SH_ORDER>::NUM_COEFFS);
+  #endif
+  #else
+  (void)key;
+  #endif
+}
+
+bool TextureCubemap::reloadFace(const int faceId)
+{
+  assert( 0u != m_id );
+  assert( (faceId >= 0) && (faceId < 6) );
+  
+  #if !ENABLE_IEM_FACE_WATCH || (IEM_SH_ORDER > 2)
+  (void)faceId;
+  fprintf( stderr, "TextureCubemap : face reloading not enabled.\n");
+  return false;
+  #else
+  Timer &timer = Timer::getInstance();
+  const double tStart = timer.getAbsoluteTime();
+  
+  const char *filename = m_faceNames[faceId].c_str();
+  Image_t faces[6];
+  Image_t &face = faces[faceId];
+  
+  if (!face.load( filename ) || (GL_TEXTURE_2D != face.target))
+  {
+    fprintf( stderr, "%s : can't be loaded, the face is kept.\n", filename);
+    return false;
+  }
+  
+  #if ENABLE_IEM_SPECULAR_MIPMAP
+  /// The GGX levels blur every face into the others : they are all decoded
+  /// again, before anything is updated
+  for (int i=0; i<6; ++i)
+  {
+    if ((i != faceId) && 
+        (!faces[i].load( m_faceNames[i].c_str() ) || (GL_TEXTURE_2D != faces[i].target) ||
+         (faces[i].width != face.width) || (faces[i].internalFormat != face.internalFormat)))
+    {
+      fprintf( stderr, "%s : can't be loaded with %s, the face is kept.\n", 
+               m_faceNames[i].c_str(), filename);
+      return false;
+    }
+  }
+  #endif
+  
+  const double tDecoded = timer.getAbsoluteTime();
+  
+  /// Only the changed tiles of the face are projected
+  IrradianceEnvMap::FaceUpdateStats_t stats;
+  if (!m_faceSums.updateFace( faceId, face, IrradianceEnvMap::getThreadPool(), &stats)) {
+    return false;
+  }
+  m_faceSums.getIrradianceMatrices( m_shMatrix );
+  
+  #if IEM_SH_ORDER == 1
+  IrradianceEnvMap::getL1Irradiance( m_shMatrix, m_shIrradiance);
+  #endif
+  
+  const double tProjected = timer.getAbsoluteTime();
+  
+  #if ENABLE_IEM_SPECULAR_MIPMAP
+  std::vector< std::unique_ptr<Image_t[]> > levels;
+  IrradianceEnvMap::prefilterSpecular( faces, face.width, IEM_SPECULAR_SAMPLES, levels, 
+                                       IrradianceEnvMap::getThreadPool());
+  upload( levels );
+  #else
+  bind();
+  {
+    glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + faceId, 0, 
+                  face.internalFormat, 
+                  face.width, face.height, 0, 
+                  face.format, face.type, 
+                  face.data);
+    
+    glGenerateMipmap( GL_TEXTURE_CUBE_MAP );
+  }
+  unbind();
+  #endif
+  
+  const double tEnd = timer.getAbsoluteTime();
+  
+  fprintf( stderr, "%s reloaded in %.1f ms : decoding %.1f ms, irradiance %.2f ms "
+           "(%d / %d tiles), mipmaps & upload %.1f ms\n", 
+           filename, tEnd - tStart, tDecoded - tStart, tProjected - tDecoded, 
+           stats.numChangedTiles, stats.numTiles, tEnd - tProjected);
+  
+  return true;
+  #endif
+}
+
+void TextureCubemap::upload(const Image_t faces[6])
+{
+  const ImageView_t views[6] = 
+  {
+    faces[0], faces[1], faces[2], faces[3], faces[4], faces[5]
+  };
+  upload( views );
+}
+
+void TextureCubemap::upload(const ImageView_t faces[6])
+{
+  assert( 0u != m_id );
+  
+  bind();
+  {
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    
+    // The rows of a view are read every rowStride bytes (from its first 
+    // pixel, so without skipped pixels nor rows)
+    GLint alignment;
+    glGetIntegerv( GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1);
+    
+    for (int i=0; i<6; ++i)
+    {
+      glPixelStorei( GL_UNPACK_ROW_LENGTH, GLint(faces[i].rowStride / faces[i].bytesPerPixel));
+      glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 
+                    faces[i].internalFormat, 
+                    faces[i].width, faces[i].height, 0, 
+                    faces[i].format, faces[i].type, 
+                    faces[i].data);
+    }
+    
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei( GL_UNPACK_ALIGNMENT, alignment);
+  }
+  unbind();
+}
+
+void TextureCubemap::upload(const std::vector< std::unique_ptr<Image_t[]> > &levels)
+{
+  assert( 0u != m_id );
+  assert( !levels.empty() );
+  
+  bind();
+  {
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, GLint(levels.size()) - 1);
+    
+    for (size_t l=0u; l<levels.size(); ++l)
+    {
+      const Image_t *faces = levels[l].get();
+      
+      for (int i=0; i<6; ++i)
+      {
+        glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, GLint(l), 
+                      faces[i].internalFormat, 
+                      faces[i].width, faces[i].height, 0, 
+                      faces[i].format, faces[i].type, 
+                      faces[i].data);
+      }
+    }
+  }
+  unbind();
+}
@@ -26,7 +26,13 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <memory>
+#include <stdint.h>
 #include <string>
+#include <vector>
+#include <tools/ImageView.hpp>
+#include "irradianceFaceSums.hpp"
+#include "irradianceSH.hpp"
 
 
 /** TEXTURE ----------------------------------------- */
@@ -105,7 +111,16 @@ class TextureCubemap : public Texture
     // outside the object, but as the textures are deleted after the loading, 
     // it is not practical atm.
     
+    /** Irradiance coefficients of order IEM_SH_ORDER (not computed at 
+     *  order 2), cf. IrradianceEnvMap::getShaderCoefficients */
+    IrradianceEnvMap::SH_t<IEM_SH_ORDER> m_shIrradiance;
+    
     bool m_bIrradiancePrecomputed;
+    
+    /** Files of the faces, and their partial SH sums to update the matrices 
+     *  when a face is reloaded (with ENABLE_IEM_FACE_WATCH) */
+    std::string m_faceNames[6];
+    IrradianceEnvMap::CubemapSums m_faceSums;
   
   public:
     TextureCubemap() : Texture(), m_bIrradiancePrecomputed(false) {}
@@ -113,8 +128,68 @@ class TextureCubemap : public Texture
     virtual GLenum getTarget() const { return GL_TEXTURE_CUBE_MAP; }    
     virtual bool load(const std::string &name);
     
+    /** Upload the 6 faces of a cubemap computed on the CPU (eg. by 
+     *  IrradianceEnvMap::bakeIrradiance), without mipmaps */
+    void upload(const Image_t faces[6]);
+    
+    /** Same as above for faces viewed in place, eg. in a cross (their rows
+     *  being read with GL_UNPACK_ROW_LENGTH) */
+    void upload(const ImageView_t faces[6]);
+    
+    /** Upload a mip chain of 6 faces per level computed on the CPU (eg. by
+     *  IrradianceEnvMap::prefilterSpecular), the level 0 first */
+    void upload(const std::vector< std::unique_ptr<Image_t[]> > &levels);
+    
+    /** Load a cubemap stored in a single image, as a cross or a strip of 
+     *  faces (cf. getCubemapFaces). The faces are uploaded and projected in
+     *  place, without being cut out of the image. load calls it for the 
+     *  names without a wildcard. */
+    bool loadLayout(const std::string &filename);
+    
+    /** Load a baked asset (cf. irradianceAsset.hpp), its levels being 
+     *  uploaded from the mapped file, with no decoding nor prefiltering. 
+     *  load uses the asset of its faces when it is newer than them (unless
+     *  the faces are watched or benchmarked). */
+    bool loadAsset(const std::string &filename);
+    
+    /** Decode the faces of name (eg. "path/ *.jpg") and bake them to the 
+     *  asset of getAssetName, with the mipmaps used by load */
+    static bool bakeAsset(const std::string &name);
+    
+    /** Files of the faces of name, its wildcard replaced by posx, negx,
+     *  posy, negy, posz & negz */
+    static void getFaceNames(const std::string &name, std::string names[6]);
+    
+    /** Baked asset of the faces of name, its wildcard & extension replaced
+     *  by "cubemap.iemc" (name itself if it is an asset) */
+    static std::string getAssetName(const std::string &name);
+    
+    /** Return true when the asset of name exists and is newer than its faces */
+    static bool isAssetUpToDate(const std::string &name);
+    
+    /** Decode the face faceId again from its file, update the irradiance
+     *  from its changed tiles only and upload it (IEM_SH_ORDER 1 or 2, with
+     *  ENABLE_IEM_FACE_WATCH). With ENABLE_IEM_SPECULAR_MIPMAP, the other
+     *  faces are decoded too and the GGX levels prefiltered again. On
+     *  failure the previous face is kept. */
+    bool reloadFace(const int faceId);
+    
+    /** Return the file of the face faceId */
+    const std::string& getFaceName(const int faceId) const { return m_faceNames[faceId]; }
+    
     bool hasSphericalHarmonics() {return m_bIrradiancePrecomputed;}
     glm::mat4* getSHMatrices() { return m_shMatrix; }
+    const IrradianceEnvMap::SH_t<IEM_SH_ORDER>& getSHIrradiance() const { return m_shIrradiance; }
+    
+    
+  protected:
+    /** Read the irradiance of the given files from the irradiance cache 
+     *  (with ENABLE_IEM_SH_CACHE), and return their key for _storeIrradiance */
+    bool _lookupIrradiance(const std::string filenames[], const size_t count, 
+                           const uint32_t settings, uint64_t *key);
+    
+    /** Write the irradiance to the cache */
+    void _storeIrradiance(const uint64_t key);
 };
 
 
@@ -14,6 +14,8 @@
 #include <tools/Timer.hpp>
 #include <GLType/ProgramShader.hpp>
 #include <GLType/Texture.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradianceRotation.hpp"
 #include "Mesh.hpp"
 #include "SkyBox.hpp"
 
@@ -80,10 +82,11 @@ void SkyBox::render(const TCamera& camera)
       glm::vec3 axis = glm::vec3( 1.0f, 0.7f, -0.5f );
       
       m_rotateMatrix = glm::rotate( glm::mat4(1.0f), m_spin, axis);
-      m_invRotateMatrix = glm::mat3( glm::rotate( glm::mat4(1.0f), -m_spin, axis) );
     }
     //-------------------------------------------------
     
+    _updateIrradiance();
+    
     // Vertex uniform
     glm::mat4 followCamera = glm::translate( glm::mat4(1.0f), camera.getPosition());
     glm::mat4 model = m_CubeMesh->getModelMatrix() * followCamera * m_rotateMatrix;
@@ -108,6 +111,38 @@ void SkyBox::render(const TCamera& camera)
   CHECKGLERROR();
 }
 
+void SkyBox::_updateIrradiance()
+{
+  /// Once per frame, instead of rotating the normals back at each vertex
+  TextureCubemap *cubemap = m_cubemaps[m_curIdx];
+  
+  if (!cubemap->hasSphericalHarmonics()) {
+    return;
+  }
+  
+  const glm::mat3 rotation( m_rotateMatrix );
+  
+  #if IEM_SH_ORDER != 2
+  IrradianceEnvMap::SH_t<IEM_SH_ORDER> sh;
+  IrradianceEnvMap::SHRotation<IEM_SH_ORDER>( rotation ).apply( cubemap->getSHIrradiance(), sh);
+  IrradianceEnvMap::getShaderCoefficients( sh, m_shIrradiance);
+  #else
+  IrradianceEnvMap::rotateIrradianceMatrices( cubemap->getSHMatrices(), rotation, m_shMatrix);
+  
+  float poly[3][9];
+  IrradianceEnvMap::getIrradiancePolynomial( m_shMatrix, poly);
+  for (int k=0; k<9; ++k) {
+    m_shPolynomial[k] = glm::vec3( poly[0][k], poly[1][k], poly[2][k]);
+  }
+  
+  #if ENABLE_IEM_HBASIS
+  IrradianceEnvMap::HBasis_t<IEM_HBASIS_SIZE> h;
+  IrradianceEnvMap::getHBasisIrradiance( m_shMatrix, h);
+  IrradianceEnvMap::getShaderCoefficients( h, m_hbIrradiance);
+  #endif
+  #endif
+}
+
 void SkyBox::addCubemap( const std::string &name )
 {
   assert( m_bInitialized );
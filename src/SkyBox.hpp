@@ -12,6 +12,9 @@
 
 #include <vector>
 #include <string>
+#include <glm/glm.hpp>
+#include "irradianceHBasis.hpp"
+#include "irradianceSH.hpp"
 
 class TCamera;
 class ProgramShader;
@@ -33,9 +36,14 @@ class SkyBox
     bool m_bAutoRotation;
     float m_spin;
     glm::mat4 m_rotateMatrix;
-    glm::mat3 m_invRotateMatrix; //it's for normals, so we don't need a 4x4 matrix
     //-------------------------------------------------
     
+    /** Irradiance uniforms of the current cubemap, rotated as the skybox */
+    glm::mat4 m_shMatrix[3];
+    glm::vec3 m_shPolynomial[9];
+    glm::vec3 m_hbIrradiance[ 2 * IEM_HBASIS_SIZE ];
+    glm::vec3 m_shIrradiance[ (IEM_SH_ORDER+1) * (IEM_SH_ORDER+1) ];
+    
     
   public:
     SkyBox()
@@ -45,7 +53,8 @@ class SkyBox
         m_curIdx(0u),
         
         m_bAutoRotation(false),
-        m_spin(0.0f)
+        m_spin(0.0f),
+        m_rotateMatrix(1.0f)
     {}
     
     virtual ~SkyBox();
@@ -59,12 +68,33 @@ class SkyBox
     
     TextureCubemap* getCurrentCubemap() { return m_cubemaps[m_curIdx]; }//
     TextureCubemap* getCubemap( size_t idx ) { return m_cubemaps[idx]; }//
+    size_t getNumCubemaps() const { return m_cubemaps.size(); }
     
     
     //-------------------------------------------------
     void toggleAutoRotate() {m_bAutoRotation = !m_bAutoRotation;}
-    const glm::mat3& getInvRotateMatrix() {return m_invRotateMatrix;}
     //-------------------------------------------------
+    
+    /** Irradiance matrices of the current cubemap, as rotated by the last 
+     *  render (for the EnvMapping.Vertex shader) */
+    const glm::mat4* getSHMatrices() const { return m_shMatrix; }
+    
+    /** Polynomial form of the irradiance matrices, as rotated by the last
+     *  render (for the EnvMapping.Vertex.Packed shader) */
+    const glm::vec3* getSHPolynomial() const { return m_shPolynomial; }
+    
+    /** H-basis coefficients of the irradiance matrices, as rotated by the
+     *  last render (for the EnvMapping.Vertex.HBasis shader) */
+    const glm::vec3* getHBasisIrradiance() const { return m_hbIrradiance; }
+    
+    /** Irradiance coefficients of the current cubemap, as rotated by the last
+     *  render (for the EnvMapping.Vertex.SH shader, IEM_SH_ORDER != 2) */
+    const glm::vec3* getSHIrradiance() const { return m_shIrradiance; }
+    
+    
+  private:
+    /** Rotate the irradiance of the current cubemap as the skybox */
+    void _updateIrradiance();
 };
 
 #endif //SKYBOX_HPP
@@ -0,0 +1,480 @@
+/**
+ *
+ *      \file irradianceAnalysis.cpp
+ *
+ */
+
+
+#include "irradianceAnalysis.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradianceKernels.hpp"
+#include "irradiancePixelFormat.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Number of texel rows processed by a single analysis task, as prefilter
+static const int ANALYSIS_BAND_ROWS = 16;
+
+/// Luminance offset of the logarithmic average, for black texels
+static const float LOG_LUMINANCE_OFFSET = 1.0e-4f;
+
+
+/// Rec. 709 luminance
+static inline
+float getLuminance( const float r, const float g, const float b)
+{
+  return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+
+namespace {
+
+/// Irradiance matrices, with the projection kernel of prefilter
+class SHReduction : public TexelReduction
+{
+  protected:
+    struct alignas(64) Partial_t
+    {
+      float shCoeff[3][9];
+      float sumWeight;
+      float colorScale;
+    };
+
+    ProjectRowFn m_projectRow;
+    std::vector<Partial_t> m_partials;
+
+  public:
+    SHReduction() : m_projectRow(getProjectRow( getKernel() )) {}
+
+    void reset( const size_t numTasks )
+    {
+      m_partials.assign( numTasks, Partial_t() );
+    }
+
+    void reduceRow( const size_t taskId, const TexelRow_t &row )
+    {
+      Partial_t &p = m_partials[taskId];
+      m_projectRow( row.red, row.green, row.blue, row.count, row.base, row.axisU,
+                    row.u0, row.du, row.texelArea, p.shCoeff, &p.sumWeight);
+      p.colorScale = row.colorScale;
+    }
+
+    void finish( const double sumWeight, EnvironmentAnalysis_t &analysis )
+    {
+      (void)sumWeight;
+
+      /// Reduced as a DirectJob of prefilter, from the sums of the kernel
+      float shCoeff[3][9] = {};
+      float kernelWeight = 0.0f;
+
+      for (const Partial_t &p : m_partials)
+      {
+        for (int c=0; c<3; ++c) {
+          for (int k=0; k<9; ++k) {
+            shCoeff[c][k] += p.colorScale * p.shCoeff[c][k];
+          }
+        }
+        kernelWeight += p.sumWeight;
+      }
+
+      const float dnorm = 2.0f * M_PI / kernelWeight;
+      for (int c=0; c<3; ++c) {
+        for (int k=0; k<9; ++k) {
+          shCoeff[c][k] *= dnorm;
+        }
+      }
+
+      setIrradianceMatrices( shCoeff, analysis.M);
+    }
+};
+
+/// Average & logarithmic average luminance, and its histogram
+class LuminanceReduction : public TexelReduction
+{
+  protected:
+    struct alignas(64) Partial_t
+    {
+      double sumLuminance;
+      double sumLogLuminance;
+      double histogram[LUMINANCE_NUM_BINS];
+    };
+
+    std::vector<Partial_t> m_partials;
+
+  public:
+    void reset( const size_t numTasks )
+    {
+      m_partials.assign( numTasks, Partial_t() );
+    }
+
+    void reduceRow( const size_t taskId, const TexelRow_t &row )
+    {
+      Partial_t &p = m_partials[taskId];
+      float sumLuminance = 0.0f, sumLogLuminance = 0.0f;
+
+      for (int j=0; j<row.count; ++j)
+      {
+        const float Y = row.colorScale * getLuminance( row.red[j], row.green[j], row.blue[j]);
+        const float dw = row.solidAngle[j];
+
+        sumLuminance += dw * Y;
+        sumLogLuminance += dw * logf( LOG_LUMINANCE_OFFSET + Y );
+
+        const float bin = (log2f( Y ) - LUMINANCE_MIN_LOG2) / LUMINANCE_BIN_STOPS;
+        const int b = (bin > 0.0f) ? std::min( int(bin), LUMINANCE_NUM_BINS - 1) : 0;
+        p.histogram[b] += dw;
+      }
+
+      p.sumLuminance += sumLuminance;
+      p.sumLogLuminance += sumLogLuminance;
+    }
+
+    void finish( const double sumWeight, EnvironmentAnalysis_t &analysis )
+    {
+      double sumLuminance = 0.0, sumLogLuminance = 0.0;
+      double histogram[LUMINANCE_NUM_BINS] = {};
+
+      for (const Partial_t &p : m_partials)
+      {
+        sumLuminance += p.sumLuminance;
+        sumLogLuminance += p.sumLogLuminance;
+        for (int b=0; b<LUMINANCE_NUM_BINS; ++b) {
+          histogram[b] += p.histogram[b];
+        }
+      }
+
+      analysis.averageLuminance = float(sumLuminance / sumWeight);
+      analysis.logAverageLuminance = float(exp( sumLogLuminance / sumWeight ));
+      for (int b=0; b<LUMINANCE_NUM_BINS; ++b) {
+        analysis.histogram[b] = float(histogram[b] / sumWeight);
+      }
+    }
+};
+
+/// Directional light of same first moment as the environment, its direction
+/// being the one of the luminance moment
+class DominantLightReduction : public TexelReduction
+{
+  protected:
+    struct alignas(64) Partial_t
+    {
+      double moments[3][3];     // sum of c * d * dw for each channel c
+      double sums[3];           // sum of c * dw
+    };
+
+    std::vector<Partial_t> m_partials;
+
+  public:
+    void reset( const size_t numTasks )
+    {
+      m_partials.assign( numTasks, Partial_t() );
+    }
+
+    void reduceRow( const size_t taskId, const TexelRow_t &row )
+    {
+      const float *colors[3] = { row.red, row.green, row.blue };
+      Partial_t &p = m_partials[taskId];
+
+      for (int c=0; c<3; ++c)
+      {
+        float mx = 0.0f, my = 0.0f, mz = 0.0f, sum = 0.0f;
+
+        for (int j=0; j<row.count; ++j)
+        {
+          const float w = colors[c][j] * row.solidAngle[j];
+          mx += w * row.dx[j];
+          my += w * row.dy[j];
+          mz += w * row.dz[j];
+          sum += w;
+        }
+
+        p.moments[c][0] += row.colorScale * mx;
+        p.moments[c][1] += row.colorScale * my;
+        p.moments[c][2] += row.colorScale * mz;
+        p.sums[c] += row.colorScale * sum;
+      }
+    }
+
+    void finish( const double sumWeight, EnvironmentAnalysis_t &analysis )
+    {
+      glm::dvec3 moments[3] = { glm::dvec3(0.0), glm::dvec3(0.0), glm::dvec3(0.0) };
+      glm::dvec3 sums( 0.0 );
+
+      for (const Partial_t &p : m_partials)
+      {
+        for (int c=0; c<3; ++c)
+        {
+          moments[c] += glm::dvec3( p.moments[c][0], p.moments[c][1], p.moments[c][2]);
+          sums[c] += p.sums[c];
+        }
+      }
+
+      const glm::dvec3 luminanceMoment = 0.2126 * moments[0] + 0.7152 * moments[1] +
+                                         0.0722 * moments[2];
+      const double luminanceSum = 0.2126 * sums[0] + 0.7152 * sums[1] + 0.0722 * sums[2];
+      const double length = glm::length( luminanceMoment );
+
+      if ((length <= 0.0) || (luminanceSum <= 0.0))
+      {
+        analysis.lightDirection = glm::vec3( 0.0f, 1.0f, 0.0f);
+        analysis.lightColor = glm::vec3( 0.0f );
+        analysis.directionality = 0.0f;
+        return;
+      }
+
+      // Integrals over the sphere
+      const double norm = 4.0 * M_PI / sumWeight;
+      const glm::dvec3 direction = luminanceMoment / length;
+
+      analysis.lightDirection = glm::vec3( direction );
+      analysis.lightColor = glm::vec3( norm * glm::dot( moments[0], direction),
+                                       norm * glm::dot( moments[1], direction),
+                                       norm * glm::dot( moments[2], direction));
+      analysis.directionality = float(length / luminanceSum);
+    }
+};
+
+/// Radiance bounds & brightest texel
+class BoundsReduction : public TexelReduction
+{
+  protected:
+    struct alignas(64) Partial_t
+    {
+      glm::vec3 minRadiance;
+      glm::vec3 maxRadiance;
+      glm::vec3 brightestDirection;
+      glm::vec3 brightestRadiance;
+      float maxLuminance;
+    };
+
+    std::vector<Partial_t> m_partials;
+
+  public:
+    void reset( const size_t numTasks )
+    {
+      Partial_t init;
+      init.minRadiance = glm::vec3( INFINITY );
+      init.maxRadiance = glm::vec3( -INFINITY );
+      init.brightestDirection = glm::vec3( 0.0f, 1.0f, 0.0f);
+      init.brightestRadiance = glm::vec3( 0.0f );
+      init.maxLuminance = -INFINITY;
+
+      m_partials.assign( numTasks, init );
+    }
+
+    void reduceRow( const size_t taskId, const TexelRow_t &row )
+    {
+      Partial_t &p = m_partials[taskId];
+      int brightest = -1;
+      float maxLuminance = p.maxLuminance;
+
+      for (int j=0; j<row.count; ++j)
+      {
+        const glm::vec3 c = row.colorScale * glm::vec3( row.red[j], row.green[j], row.blue[j]);
+        p.minRadiance = glm::min( p.minRadiance, c);
+        p.maxRadiance = glm::max( p.maxRadiance, c);
+
+        const float Y = getLuminance( c.r, c.g, c.b);
+        if (Y > maxLuminance)
+        {
+          maxLuminance = Y;
+          brightest = j;
+        }
+      }
+
+      if (brightest >= 0)
+      {
+        const int j = brightest;
+        p.maxLuminance = maxLuminance;
+        p.brightestDirection = glm::vec3( row.dx[j], row.dy[j], row.dz[j]);
+        p.brightestRadiance = row.colorScale * glm::vec3( row.red[j], row.green[j], row.blue[j]);
+      }
+    }
+
+    void finish( const double sumWeight, EnvironmentAnalysis_t &analysis )
+    {
+      (void)sumWeight;
+
+      Partial_t result = m_partials[0];
+      for (size_t t=1u; t<m_partials.size(); ++t)
+      {
+        const Partial_t &p = m_partials[t];
+        result.minRadiance = glm::min( result.minRadiance, p.minRadiance);
+        result.maxRadiance = glm::max( result.maxRadiance, p.maxRadiance);
+
+        if (p.maxLuminance > result.maxLuminance)
+        {
+          result.maxLuminance = p.maxLuminance;
+          result.brightestDirection = p.brightestDirection;
+          result.brightestRadiance = p.brightestRadiance;
+        }
+      }
+
+      analysis.minRadiance = result.minRadiance;
+      analysis.maxRadiance = result.maxRadiance;
+      analysis.brightestDirection = result.brightestDirection;
+      analysis.brightestRadiance = result.brightestRadiance;
+    }
+};
+
+} //namespace
+
+
+/// Hand the rows of a band of a face to the reductions, return the sum of
+/// their solid angles
+template<PixelFormat Format>
+static
+double analyzeBand( const Image_t &face, const int texId, const int firstRow, const int lastRow,
+                    const size_t taskId, TexelReduction *const reductions[],
+                    const size_t numReductions)
+{
+  typedef PixelTraits<Format> Traits;
+
+  const float (*axes)[3] = FACE_FRAMES[texId];
+
+  const int texRes = face.width;
+  const float texelSize = 1.0f / float(texRes);
+  const size_t rowSize = size_t(texRes) * Traits::NUM_CHANNELS;
+  const typename Traits::Channel_t *pixels =
+    reinterpret_cast<const typename Traits::Channel_t*>(face.data);
+
+  /// Structure-of-arrays row
+  std::vector<float> soa( 7 * texRes );
+
+  TexelRow_t row;
+  row.count = texRes;
+  row.face = texId;
+  row.colorScale = float(Traits::COLOR_SCALE);
+  row.red = &soa[0];
+  row.green = row.red + texRes;
+  row.blue = row.green + texRes;
+  row.dx = row.blue + texRes;
+  row.dy = row.dx + texRes;
+  row.dz = row.dy + texRes;
+  row.solidAngle = row.dz + texRes;
+  row.axisU = axes[1];
+  row.u0 = texelSize - 1.0f;
+  row.du = 2.0f * texelSize;
+  row.texelArea = 4.0f * texelSize * texelSize;
+
+  float *red = &soa[0];
+  float *dx = red + 3 * texRes;
+  float *dy = dx + texRes;
+  float *dz = dy + texRes;
+  float *solidAngle = dz + texRes;
+
+  double sumWeight = 0.0;
+
+  for (int i=firstRow; i<lastRow; ++i)
+  {
+    convertRow<Format>( pixels + i * rowSize, texRes, red, red + texRes, red + 2 * texRes);
+
+    const float v = 2.0f * ((i+0.5f) * texelSize) - 1.0f;
+    for (int c=0; c<3; ++c) {
+      row.base[c] = axes[0][c] + v * axes[2][c];
+    }
+
+    float rowWeight = 0.0f;
+    for (int j=0; j<texRes; ++j)
+    {
+      const float u = row.u0 + j * row.du;
+      const float x = row.base[0] + u * axes[1][0];
+      const float y = row.base[1] + u * axes[1][1];
+      const float z = row.base[2] + u * axes[1][2];
+      const float rs = 1.0f / sqrtf( x*x + y*y + z*z );
+
+      dx[j] = x * rs;
+      dy[j] = y * rs;
+      dz[j] = z * rs;
+      solidAngle[j] = row.texelArea * rs * rs * rs;
+      rowWeight += solidAngle[j];
+    }
+    sumWeight += rowWeight;
+
+    for (size_t r=0u; r<numReductions; ++r) {
+      reductions[r]->reduceRow( taskId, row);
+    }
+  }
+
+  return sumWeight;
+}
+
+
+void analyzeEnvironment( const Image_t envmap[6], const unsigned int flags,
+                         EnvironmentAnalysis_t &analysis, ThreadPool &pool,
+                         TexelReduction *const extra[], const size_t numExtra)
+{
+  analysis = EnvironmentAnalysis_t();
+
+  const PixelFormat format = getPixelFormat( envmap[0] );
+  if (NUM_PIXEL_FORMAT == format)
+  {
+    fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+    return;
+  }
+
+  /// Reductions requested
+  std::vector< std::unique_ptr<TexelReduction> > builtins;
+  if (flags & ANALYSIS_SH)             builtins.emplace_back( new SHReduction );
+  if (flags & ANALYSIS_LUMINANCE)      builtins.emplace_back( new LuminanceReduction );
+  if (flags & ANALYSIS_DOMINANT_LIGHT) builtins.emplace_back( new DominantLightReduction );
+  if (flags & ANALYSIS_BOUNDS)         builtins.emplace_back( new BoundsReduction );
+
+  std::vector<TexelReduction*> reductions;
+  for (const std::unique_ptr<TexelReduction> &r : builtins) {
+    reductions.push_back( r.get() );
+  }
+  reductions.insert( reductions.end(), extra, extra + numExtra);
+
+  if (reductions.empty()) {
+    return;
+  }
+
+  const int texRes = envmap[0].width;
+  const int bandsPerFace = (texRes + ANALYSIS_BAND_ROWS - 1) / ANALYSIS_BAND_ROWS;
+  const size_t numTasks = 6u * bandsPerFace;
+
+  for (TexelReduction *r : reductions) {
+    r->reset( numTasks );
+  }
+  std::vector<double> weights( numTasks, 0.0 );
+
+  /// Single pass
+  dispatchPixelFormat( format, [&](auto F)
+  {
+    pool.parallelFor( numTasks, [&](size_t taskId)
+    {
+      const int texId = taskId / bandsPerFace;
+      const int firstRow = (taskId % bandsPerFace) * ANALYSIS_BAND_ROWS;
+      const int lastRow = std::min( firstRow + ANALYSIS_BAND_ROWS, texRes);
+
+      weights[taskId] = analyzeBand<decltype(F)::value>( envmap[texId], texId, firstRow, lastRow,
+                                                         taskId, &reductions[0],
+                                                         reductions.size());
+    });
+  });
+
+  /// Fixed order reduction
+  double sumWeight = 0.0;
+  for (size_t t=0u; t<numTasks; ++t) {
+    sumWeight += weights[t];
+  }
+
+  for (TexelReduction *r : reductions) {
+    r->finish( sumWeight, analysis);
+  }
+  analysis.flags = flags;
+}
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,135 @@
+/**
+ *
+ *      \file irradianceAnalysis.hpp
+ *
+ *      Single pass analysis of a cubemap : any combination of reductions
+ *      (irradiance matrices, luminance for the exposure, dominant light,
+ *      radiance bounds) computed on one read of the texels, by a single
+ *      dispatch on a thread pool.
+ *
+ *      The faces are split in bands of rows as by prefilter. Each row is
+ *      converted once to float arrays, with the texel directions and solid
+ *      angles, then handed to every reduction, which adds it to the partial
+ *      sums of its task. The partials are merged in task order, so the
+ *      results do not depend on the number of threads.
+ *
+ *      Other reductions are plugged by implementing TexelReduction.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEANALYSIS_HPP
+#define IRRADIANCEANALYSIS_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <tools/ImageLoader.hpp>
+
+class ThreadPool;
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Reductions of analyzeEnvironment */
+  enum AnalysisFlag
+  {
+    ANALYSIS_SH             = 1u << 0,    // irradiance matrices, as prefilter
+    ANALYSIS_LUMINANCE      = 1u << 1,    // average luminance & histogram
+    ANALYSIS_DOMINANT_LIGHT = 1u << 2,    // direction & color of the main light
+    ANALYSIS_BOUNDS         = 1u << 3,    // radiance bounds & brightest texel
+
+    ANALYSIS_ALL            = 0x0f
+  };
+
+  /** Bins of the luminance histogram, of LUMINANCE_BIN_STOPS stops each from
+   *  2^LUMINANCE_MIN_LOG2 (darker texels are counted in the first bin,
+   *  brighter ones in the last) */
+  const int LUMINANCE_NUM_BINS = 64;
+  const float LUMINANCE_MIN_LOG2 = -16.0f;
+  const float LUMINANCE_BIN_STOPS = 0.5f;
+
+  /** Results of analyzeEnvironment, the colors of 8-bit cubemaps being
+   *  mapped to [0, 1]. The fields of the reductions not requested are left
+   *  unset. */
+  struct EnvironmentAnalysis_t
+  {
+    unsigned int flags;               // reductions computed
+
+    /// ANALYSIS_SH
+    glm::mat4 M[3];
+
+    /// ANALYSIS_LUMINANCE, weighted by the solid angles (Rec. 709 luminance)
+    float averageLuminance;
+    float logAverageLuminance;        // geometric mean, as used for the exposure
+    float histogram[LUMINANCE_NUM_BINS];  // fraction of the sphere of each bin
+
+    /// ANALYSIS_DOMINANT_LIGHT, the directional light of same first moment
+    glm::vec3 lightDirection;
+    glm::vec3 lightColor;
+    float directionality;             // 0 for a uniform environment, 1 for a single direction
+
+    /// ANALYSIS_BOUNDS
+    glm::vec3 minRadiance;
+    glm::vec3 maxRadiance;
+    glm::vec3 brightestDirection;     // of the texel of largest luminance
+    glm::vec3 brightestRadiance;
+  };
+
+  /** Row of texels handed to the reductions */
+  struct TexelRow_t
+  {
+    int count;
+    int face;
+    float colorScale;                 // of the colors, 1 / 255 for 8-bit cubemaps
+
+    const float *red;
+    const float *green;
+    const float *blue;
+
+    /// Normalized directions and solid angles
+    const float *dx;
+    const float *dy;
+    const float *dz;
+    const float *solidAngle;
+
+    /// Unnormalized direction of the texel j, base + (u0 + j * du) * axisU
+    /// (cf. ProjectRowFn)
+    float base[3];
+    const float *axisU;
+    float u0;
+    float du;
+    float texelArea;
+  };
+
+  /** Per texel reduction of analyzeEnvironment, with its own partial sums
+   *  for each task */
+  class TexelReduction
+  {
+    public:
+      virtual ~TexelReduction() {}
+
+      /** Clear the partial sums of numTasks tasks */
+      virtual void reset( const size_t numTasks ) = 0;
+
+      /** Add a row to the partial sums of a task */
+      virtual void reduceRow( const size_t taskId, const TexelRow_t &row ) = 0;
+
+      /** Merge the partial sums in task order to the analysis, sumWeight
+       *  being the sum of the texel solid angles */
+      virtual void finish( const double sumWeight, EnvironmentAnalysis_t &analysis ) = 0;
+  };
+
+  /** Compute the reductions of flags (a combination of AnalysisFlag) and
+   *  the extra ones on a single pass over the texels of a cubemap, with a
+   *  single dispatch on the pool. */
+  void analyzeEnvironment( const Image_t envmap[6], const unsigned int flags,
+                           EnvironmentAnalysis_t &analysis, ThreadPool &pool,
+                           TexelReduction *const extra[]=0, const size_t numExtra=0u);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEANALYSIS_HPP
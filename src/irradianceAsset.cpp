@@ -0,0 +1,317 @@
+/**
+ *
+ *      \file irradianceAsset.cpp
+ *
+ */
+
+
+#include "irradianceAsset.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradiancePixelFormat.hpp"
+#include "irradianceSpecular.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Channel from a float, as toFloat (8-bit values in [0, 255])
+static inline void fromFloat( const float v, unsigned char &c )
+{
+  c = (unsigned char)(std::min( std::max( v + 0.5f, 0.0f), 255.0f));
+}
+static inline void fromFloat( const float v, uint16_t &c ) { c = floatToHalf( v ); }
+static inline void fromFloat( const float v, float &c )    { c = v; }
+
+/// Offset rounded up to CUBEMAP_ASSET_ALIGNMENT
+static inline uint64_t alignOffset( const uint64_t offset )
+{
+  return (offset + CUBEMAP_ASSET_ALIGNMENT - 1u) & ~uint64_t(CUBEMAP_ASSET_ALIGNMENT - 1u);
+}
+
+
+/// Average the faces of a level by blocks of 2 x 2 texels, in their format
+template<PixelFormat Format>
+static
+void reduceLevel( const Image_t src[6], Image_t dst[6], ThreadPool &pool)
+{
+  typedef PixelTraits<Format> Traits;
+  typedef typename Traits::Channel_t Channel_t;
+  const int nc = Traits::NUM_CHANNELS;
+
+  const int srcRes = src[0].width;
+  const int dstRes = std::max( srcRes / 2, 1);
+
+  for (int face=0; face<6; ++face)
+  {
+    dst[face].clean();
+    dst[face].bytesPerPixel = src[face].bytesPerPixel;
+    dst[face].target = src[face].target;
+    dst[face].internalFormat = src[face].internalFormat;
+    dst[face].width = dst[face].height = dstRes;
+    dst[face].format = src[face].format;
+    dst[face].type = src[face].type;
+    dst[face].data = new GLubyte[dst[face].getMemorySize()];
+  }
+
+  pool.parallelFor( 6u * dstRes, [&](size_t taskId)
+  {
+    const int face = int(taskId / dstRes);
+    const int i = int(taskId % dstRes);
+
+    const Channel_t *pixels = reinterpret_cast<const Channel_t*>(src[face].data);
+    const Channel_t *row0 = pixels + size_t(std::min( 2*i,   srcRes-1)) * srcRes * nc;
+    const Channel_t *row1 = pixels + size_t(std::min( 2*i+1, srcRes-1)) * srcRes * nc;
+    Channel_t *out = reinterpret_cast<Channel_t*>(dst[face].data) + size_t(i) * dstRes * nc;
+
+    for (int j=0; j<dstRes; ++j)
+    {
+      const int x0 = std::min( 2*j,   srcRes-1) * nc;
+      const int x1 = std::min( 2*j+1, srcRes-1) * nc;
+
+      for (int c=0; c<nc; ++c)
+      {
+        const float sum = toFloat( row0[x0 + c] ) + toFloat( row0[x1 + c] ) +
+                          toFloat( row1[x0 + c] ) + toFloat( row1[x1 + c] );
+        fromFloat( 0.25f * sum, out[j*nc + c]);
+      }
+    }
+  });
+}
+
+
+bool bakeCubemapAsset( const Image_t envmap[6], const char *filename, const bool bSpecular,
+                       ThreadPool &pool)
+{
+  const PixelFormat format = getPixelFormat( envmap[0] );
+  const int resolution = envmap[0].width;
+
+  if (NUM_PIXEL_FORMAT == format)
+  {
+    fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+    return false;
+  }
+
+  /// Levels, the first one being the cubemap itself (unless prefiltered)
+  std::vector< std::unique_ptr<Image_t[]> > levels;
+  std::vector<const Image_t*> faces;
+
+  if (bSpecular)
+  {
+    prefilterSpecular( envmap, resolution, IEM_SPECULAR_SAMPLES, levels, pool);
+    for (size_t l=0u; l<levels.size(); ++l) {
+      faces.push_back( levels[l].get() );
+    }
+  }
+  else
+  {
+    faces.push_back( envmap );
+    for (int size=resolution; size>1; size/=2)
+    {
+      levels.emplace_back( new Image_t[6] );
+      dispatchPixelFormat( format, [&](auto F)
+      {
+        reduceLevel<decltype(F)::value>( faces.back(), levels.back().get(), pool);
+      });
+      faces.push_back( levels.back().get() );
+    }
+  }
+
+  if (faces.size() > size_t(CUBEMAP_ASSET_MAX_LEVELS))
+  {
+    fprintf( stderr, "IrradianceEnvMap : too many levels for an asset.\n");
+    return false;
+  }
+
+  /// Header
+  CubemapAssetHeader_t header;
+  memset( &header, 0, sizeof(header));
+
+  header.magic = CUBEMAP_ASSET_MAGIC;
+  header.version = CUBEMAP_ASSET_VERSION;
+  header.flags = bSpecular ? uint32_t(ASSET_SPECULAR_MIPMAP) : 0u;
+  header.numLevels = uint32_t(faces.size());
+  header.resolution = uint32_t(resolution);
+  header.bytesPerPixel = faces[0][0].bytesPerPixel;
+  header.internalFormat = faces[0][0].internalFormat;
+  header.format = faces[0][0].format;
+  header.type = faces[0][0].type;
+
+  glm::mat4 M[3];
+  prefilter( envmap, M, pool);
+  for (int c=0; c<3; ++c) {
+    memcpy( header.M[c], &M[c][0][0], sizeof(header.M[c]));
+  }
+
+  SH_t<SH_MAX_ORDER> sh;
+  prefilter( envmap, sh, pool);
+  memcpy( header.shCoeffs, sh.coeffs, sizeof(header.shCoeffs));
+
+  uint64_t offset = alignOffset( sizeof(header) );
+  for (size_t l=0u; l<faces.size(); ++l) {
+    for (int face=0; face<6; ++face)
+    {
+      header.offsets[l][face] = offset;
+      offset = alignOffset( offset + faces[l][face].getMemorySize() );
+    }
+  }
+
+  /// Written aside then renamed, so that a partial file is never mapped
+  const std::string tmpName = std::string(filename) + ".tmp";
+  FILE *fd = fopen( tmpName.c_str(), "wb");
+
+  if (0 == fd)
+  {
+    fprintf( stderr, "IrradianceEnvMap : can't write %s.\n", tmpName.c_str());
+    return false;
+  }
+
+  const char padding[CUBEMAP_ASSET_ALIGNMENT] = {};
+  bool bWritten = (1u == fwrite( &header, sizeof(header), 1u, fd));
+  uint64_t position = sizeof(header);
+
+  for (size_t l=0u; bWritten && (l<faces.size()); ++l) {
+    for (int face=0; bWritten && (face<6); ++face)
+    {
+      const size_t size = faces[l][face].getMemorySize();
+      const size_t numPadding = size_t(header.offsets[l][face] - position);
+
+      bWritten = (fwrite( padding, 1u, numPadding, fd) == numPadding) &&
+                 (fwrite( faces[l][face].data, 1u, size, fd) == size);
+      position = header.offsets[l][face] + size;
+    }
+  }
+
+  /// Flushed to the disk before the rename, so that a crash can't leave a
+  /// truncated asset newer than its faces
+  bWritten = bWritten && (0 == fflush( fd ));
+  #ifndef _WIN32
+  bWritten = bWritten && (0 == fsync( fileno( fd )));
+  #endif
+  bWritten = (0 == fclose( fd )) && bWritten;
+
+  if (!bWritten || (0 != rename( tmpName.c_str(), filename )))
+  {
+    fprintf( stderr, "IrradianceEnvMap : can't write %s.\n", filename);
+    remove( tmpName.c_str() );
+    return false;
+  }
+
+  return true;
+}
+
+
+bool CubemapAsset::open( const char *filename )
+{
+  close();
+
+  #ifndef _WIN32
+  const int fd = ::open( filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if ((0 == fstat( fd, &st)) && (size_t(st.st_size) >= sizeof(CubemapAssetHeader_t)))
+  {
+    void *data = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (MAP_FAILED != data)
+    {
+      // The whole file is uploaded : read it ahead
+      madvise( data, st.st_size, MADV_WILLNEED);
+      m_data = static_cast<const unsigned char*>(data);
+      m_size = st.st_size;
+      m_bMapped = true;
+    }
+  }
+  ::close( fd );
+  #else
+  FILE *fd = fopen( filename, "rb");
+  if (0 == fd) {
+    return false;
+  }
+
+  fseek( fd, 0, SEEK_END);
+  const long size = ftell( fd );
+  fseek( fd, 0, SEEK_SET);
+
+  if (size >= long(sizeof(CubemapAssetHeader_t)))
+  {
+    unsigned char *data = new unsigned char[size];
+    if (fread( data, 1u, size, fd) == size_t(size))
+    {
+      m_data = data;
+      m_size = size;
+    } else {
+      delete [] data;
+    }
+  }
+  fclose( fd );
+  #endif
+
+  if (0 == m_data) {
+    return false;
+  }
+
+  /// Header & faces within the file
+  const CubemapAssetHeader_t &header = getHeader();
+  bool bValid = (CUBEMAP_ASSET_MAGIC == header.magic) &&
+                (CUBEMAP_ASSET_VERSION == header.version) &&
+                (header.numLevels > 0u) && (header.numLevels <= CUBEMAP_ASSET_MAX_LEVELS) &&
+                (header.resolution > 0u) && (header.bytesPerPixel > 0u);
+
+  for (int l=0; bValid && (l<int(header.numLevels)); ++l) {
+    for (int face=0; face<6; ++face) {
+      bValid = bValid && (header.offsets[l][face] <= m_size) &&
+                         (getFaceSize( l ) <= m_size - header.offsets[l][face]);
+    }
+  }
+
+  if (!bValid)
+  {
+    fprintf( stderr, "IrradianceEnvMap : %s is not a valid cubemap asset.\n", filename);
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void CubemapAsset::close()
+{
+  if (0 == m_data) {
+    return;
+  }
+
+  #ifndef _WIN32
+  if (m_bMapped) {
+    munmap( const_cast<unsigned char*>(m_data), m_size);
+  }
+  #else
+  delete [] m_data;
+  #endif
+
+  m_data = 0;
+  m_size = 0u;
+  m_bMapped = false;
+}
+
+
+} //namespace IrradianceEnvMap
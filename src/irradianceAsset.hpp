@@ -0,0 +1,141 @@
+/**
+ *
+ *      \file irradianceAsset.hpp
+ *
+ *      Baked cubemap asset : the faces of every mip level, stored in their
+ *      GL upload format, and the irradiance precomputed from them, so that
+ *      a cubemap is loaded without decoding its images nor prefiltering it.
+ *
+ *      The file is mapped in memory and the levels uploaded straight from
+ *      the mapping. Its layout is a CubemapAssetHeader_t followed by the
+ *      faces, each one at a CUBEMAP_ASSET_ALIGNMENT bytes boundary :
+ *
+ *        header | level 0 : +X -X +Y -Y +Z -Z | level 1 : ... | ...
+ *
+ *      The values are stored in the byte order of the machine which baked
+ *      the asset (checked by the magic number).
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEASSET_HPP
+#define IRRADIANCEASSET_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include <tools/ImageLoader.hpp>
+#include "irradianceSH.hpp"
+
+class ThreadPool;
+
+
+namespace IrradianceEnvMap
+{
+
+  const uint32_t CUBEMAP_ASSET_MAGIC = 0x434d4549;    // "IEMC"
+  const uint32_t CUBEMAP_ASSET_VERSION = 1u;
+  const int CUBEMAP_ASSET_MAX_LEVELS = 16;
+  const size_t CUBEMAP_ASSET_ALIGNMENT = 64u;
+
+  /** Flags of a baked asset */
+  enum CubemapAssetFlag
+  {
+    ASSET_SPECULAR_MIPMAP = 1u << 0     // levels prefiltered by prefilterSpecular
+  };
+
+  /** Header of a baked asset */
+  struct CubemapAssetHeader_t
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t numLevels;
+    uint32_t resolution;                // of the level 0
+
+    /// GL upload format of the faces
+    uint32_t bytesPerPixel;
+    uint32_t internalFormat;
+    uint32_t format;
+    uint32_t type;
+    uint32_t reserved;
+
+    /// Irradiance matrices, as prefilter, and the radiance coefficients of
+    /// order SH_MAX_ORDER, as prefilter<SH_MAX_ORDER> (the ones of a lower
+    /// order being their first bands)
+    float M[3][16];
+    float shCoeffs[3][(SH_MAX_ORDER+1) * (SH_MAX_ORDER+1)];
+
+    /// Offsets of the faces from the start of the file
+    uint64_t offsets[CUBEMAP_ASSET_MAX_LEVELS][6];
+  };
+
+
+  /** Bake a cubemap to an asset file. Its levels are prefiltered by
+   *  prefilterSpecular when bSpecular is set, box filtered otherwise (as
+   *  glGenerateMipmap) in the format of the faces. Return false on failure. */
+  bool bakeCubemapAsset( const Image_t envmap[6], const char *filename, const bool bSpecular,
+                         ThreadPool &pool);
+
+
+  /** Read only mapping of a baked asset */
+  class CubemapAsset
+  {
+    protected:
+      const unsigned char *m_data;
+      size_t m_size;
+      bool m_bMapped;         // false when read in memory (no mmap on the system)
+
+    public:
+      CubemapAsset() : m_data(0), m_size(0u), m_bMapped(false) {}
+      ~CubemapAsset() { close(); }
+
+      /** Map an asset and check its header. Return false (the asset being
+       *  closed) when it can not be read or is not valid. */
+      bool open( const char *filename );
+
+      /** Unmap the asset */
+      void close();
+
+      bool isOpen() const { return 0 != m_data; }
+
+      const CubemapAssetHeader_t& getHeader() const
+      {
+        return *reinterpret_cast<const CubemapAssetHeader_t*>(m_data);
+      }
+
+      /** Pixels of a face of a level, in the upload format of the header */
+      const void* getFace( const int level, const int face ) const
+      {
+        return m_data + getHeader().offsets[level][face];
+      }
+
+      /** Width (and height) of a level */
+      int getLevelSize( const int level ) const
+      {
+        const int size = int(getHeader().resolution) >> level;
+        return (size > 0) ? size : 1;
+      }
+
+      /** Size in bytes of a face of a level */
+      size_t getFaceSize( const int level ) const
+      {
+        const size_t size = getLevelSize( level );
+        return size * size * getHeader().bytesPerPixel;
+      }
+
+      /** Size of the file */
+      size_t getSize() const { return m_size; }
+
+
+    private:
+      CubemapAsset(const CubemapAsset&);
+      CubemapAsset& operator =(const CubemapAsset&) const;
+  };
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEASSET_HPP
@@ -0,0 +1,256 @@
+/**
+ *
+ *      \file irradianceBaker.cpp
+ *
+ */
+
+
+#include "irradianceBaker.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradianceKernels.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Texels evaluated at once before being packed to RGB9E5
+static const int BAKE_CHUNK_SIZE = 256;
+
+/// Largest value of RGB9E5, (2^9 - 1) / 2^9 * 2^(31 - 15)
+static const float RGB9E5_MAX_VALUE = 65408.0f;
+
+/// Texels packed together, on GCC vector types (lowered to the SSE / NEON
+/// registers available)
+static const int PACK_VEC_WIDTH = 4;
+typedef float PackVec_t __attribute__((vector_size(PACK_VEC_WIDTH * sizeof(float))));
+typedef int32_t PackVecInt_t __attribute__((vector_size(PACK_VEC_WIDTH * sizeof(int32_t))));
+
+
+/// 2^e as a float, for e in [-126, 127]
+static inline
+float getPowerOfTwo( const int e )
+{
+  const uint32_t bits = uint32_t(127 + e) << 23;
+  float f;
+  memcpy( &f, &bits, sizeof(f));
+  return f;
+}
+
+/// Clamp a channel to the RGB9E5 range (NaN giving 0)
+static inline
+float clampRGB9E5( const float c )
+{
+  return (c > 0.0f) ? std::min( c, RGB9E5_MAX_VALUE ) : 0.0f;
+}
+
+
+size_t getBakedTexelSize( const BakeFormat format )
+{
+  return (BAKE_RGB9E5 == format) ? sizeof(uint32_t) : 3u * sizeof(float);
+}
+
+uint32_t packRGB9E5( const float r, const float g, const float b)
+{
+  const float rc = clampRGB9E5( r );
+  const float gc = clampRGB9E5( g );
+  const float bc = clampRGB9E5( b );
+  const float maxc = std::max( rc, std::max( gc, bc));
+
+  // Shared exponent max(-16, floor(log2(maxc))) + 16, from the float bits
+  uint32_t bits;
+  memcpy( &bits, &maxc, sizeof(bits));
+  int e = std::max( -16, int((bits >> 23) & 0xff) - 127 ) + 16;
+
+  // The largest channel may round up to 2^9
+  float scale = getPowerOfTwo( 24 - e );
+  if (uint32_t(maxc * scale + 0.5f) >= 512u)
+  {
+    ++e;
+    scale *= 0.5f;
+  }
+
+  const uint32_t rs = uint32_t(rc * scale + 0.5f);
+  const uint32_t gs = uint32_t(gc * scale + 0.5f);
+  const uint32_t bs = uint32_t(bc * scale + 0.5f);
+
+  return rs | (gs << 9) | (bs << 18) | (uint32_t(e) << 27);
+}
+
+glm::vec3 unpackRGB9E5( const uint32_t rgb9e5 )
+{
+  const float scale = getPowerOfTwo( int(rgb9e5 >> 27) - 24 );
+
+  return scale * glm::vec3( float(rgb9e5 & 511u),
+                            float((rgb9e5 >> 9) & 511u),
+                            float((rgb9e5 >> 18) & 511u));
+}
+
+
+/// Pack 'count' interleaved RGB colors to RGB9E5, as packRGB9E5
+static
+void packRowRGB9E5( const float *rgb, const int count, uint32_t *texels)
+{
+  const PackVec_t zero = PackVec_t{};
+  const PackVec_t maxValue = zero + RGB9E5_MAX_VALUE;
+  const PackVec_t half = zero + 0.5f;
+
+  int j = 0;
+  for (; j+PACK_VEC_WIDTH <= count; j+=PACK_VEC_WIDTH)
+  {
+    PackVec_t c[3];
+    for (int k=0; k<3; ++k) {
+      for (int i=0; i<PACK_VEC_WIDTH; ++i) {
+        c[k][i] = rgb[3*(j + i) + k];
+      }
+      c[k] = (c[k] > zero) ? ((c[k] < maxValue) ? c[k] : maxValue) : zero;
+    }
+
+    const PackVec_t maxc = (c[0] > c[1]) ? ((c[0] > c[2]) ? c[0] : c[2]) 
+                                         : ((c[1] > c[2]) ? c[1] : c[2]);
+
+    PackVecInt_t e = (((PackVecInt_t)maxc >> 23) & 0xff) - 127;
+    e = ((e > -16) ? e : -16) + 16;
+
+    PackVecInt_t scaleBits = (127 + 24 - e) << 23;
+    PackVec_t scale = (PackVec_t)scaleBits;
+
+    // The largest channel may round up to 2^9
+    const PackVecInt_t bRoundUp = (__builtin_convertvector( maxc * scale + half, PackVecInt_t ) >= 512);
+    e -= bRoundUp;
+    scale = bRoundUp ? scale * 0.5f : scale;
+
+    const PackVecInt_t rs = __builtin_convertvector( c[0] * scale + half, PackVecInt_t );
+    const PackVecInt_t gs = __builtin_convertvector( c[1] * scale + half, PackVecInt_t );
+    const PackVecInt_t bs = __builtin_convertvector( c[2] * scale + half, PackVecInt_t );
+    const PackVecInt_t packed = rs | (gs << 9) | (bs << 18) | (e << 27);
+
+    memcpy( texels + j, &packed, sizeof(packed));
+  }
+
+  for (; j<count; ++j) {
+    texels[j] = packRGB9E5( rgb[3*j + 0], rgb[3*j + 1], rgb[3*j + 2]);
+  }
+}
+
+/// Bake the faces of 'count' probes, the face f of the probe i being
+/// stored at faceData[6 * i + f]
+static
+void bakeFaces( const glm::mat4 (*M)[3], const size_t count, const int size,
+                const BakeFormat format, unsigned char *const faceData[], ThreadPool &pool)
+{
+  assert( size > 0 );
+
+  const size_t faceTexels = size_t(size) * size;
+
+  /// Normalized texel directions of the 6 faces, as prefilter
+  std::vector<float> nx( 6u * faceTexels ), ny( 6u * faceTexels ), nz( 6u * faceTexels );
+
+  for (int face=0; face<6; ++face)
+  {
+    const float (&frame)[3][3] = FACE_FRAMES[face];
+
+    for (int i=0; i<size; ++i)
+    {
+      const float v = 2.0f * (i + 0.5f) / size - 1.0f;
+
+      for (int j=0; j<size; ++j)
+      {
+        const float u = 2.0f * (j + 0.5f) / size - 1.0f;
+        const size_t index = face * faceTexels + size_t(i) * size + j;
+
+        const float x = frame[0][0] + u * frame[1][0] + v * frame[2][0];
+        const float y = frame[0][1] + u * frame[1][1] + v * frame[2][1];
+        const float z = frame[0][2] + u * frame[1][2] + v * frame[2][2];
+        const float rs = 1.0f / sqrtf( x*x + y*y + z*z );
+
+        nx[index] = x * rs;
+        ny[index] = y * rs;
+        nz[index] = z * rs;
+      }
+    }
+  }
+
+  const EvaluateIrradianceFn evaluate = getEvaluateIrradiance( getKernel() );
+
+  pool.parallelFor( 6u * count, [&](size_t taskId)
+  {
+    const size_t probe = taskId / 6u;
+    const size_t first = (taskId % 6u) * faceTexels;
+
+    float poly[3][9];
+    getIrradiancePolynomial( M[probe], poly);
+
+    if (BAKE_RGB32F == format)
+    {
+      evaluate( poly, &nx[first], &ny[first], &nz[first], int(faceTexels),
+                reinterpret_cast<float*>(faceData[taskId]));
+      return;
+    }
+
+    uint32_t *texels = reinterpret_cast<uint32_t*>(faceData[taskId]);
+    float rgb[3 * BAKE_CHUNK_SIZE];
+
+    for (size_t k=0u; k<faceTexels; k+=BAKE_CHUNK_SIZE)
+    {
+      const int n = int(std::min( size_t(BAKE_CHUNK_SIZE), faceTexels - k));
+      evaluate( poly, &nx[first + k], &ny[first + k], &nz[first + k], n, rgb);
+      packRowRGB9E5( rgb, n, texels + k);
+    }
+  });
+}
+
+void bakeIrradiance( const glm::mat4 (*M)[3], const size_t count, const int size,
+                     const BakeFormat format, void *pixels, ThreadPool &pool)
+{
+  const size_t faceBytes = size_t(size) * size * getBakedTexelSize( format );
+
+  std::vector<unsigned char*> faceData( 6u * count );
+  for (size_t i=0u; i<faceData.size(); ++i) {
+    faceData[i] = static_cast<unsigned char*>(pixels) + i * faceBytes;
+  }
+
+  bakeFaces( M, count, size, format, &faceData[0], pool);
+}
+
+void bakeIrradiance( const glm::mat4 M[3], const int size, const BakeFormat format,
+                     Image_t faces[6], ThreadPool &pool)
+{
+  const size_t faceBytes = size_t(size) * size * getBakedTexelSize( format );
+  unsigned char *faceData[6];
+
+  for (int face=0; face<6; ++face)
+  {
+    faces[face].clean();
+    faces[face].target = GL_TEXTURE_2D;
+    faces[face].width = faces[face].height = size;
+    faces[face].format = GL_RGB;
+
+    if (BAKE_RGB9E5 == format)
+    {
+      faces[face].internalFormat = GL_RGB9_E5;
+      faces[face].type = GL_UNSIGNED_INT_5_9_9_9_REV;
+    }
+    else
+    {
+      faces[face].internalFormat = GL_RGB32F;
+      faces[face].type = GL_FLOAT;
+    }
+
+    faces[face].bytesPerPixel = unsigned(getBakedTexelSize( format ));
+    faces[face].data = new GLubyte[faceBytes];
+    faceData[face] = faces[face].data;
+  }
+
+  bakeFaces( reinterpret_cast<const glm::mat4 (*)[3]>(M), 1u, size, format, faceData, pool);
+}
+
+
+} //namespace IrradianceEnvMap
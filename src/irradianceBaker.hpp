@@ -0,0 +1,69 @@
+/**
+ *
+ *      \file irradianceBaker.hpp
+ *
+ *      Rasterization of irradiance matrices into small cubemaps, for the
+ *      renderers sampling a prebaked irradiance cubemap instead of
+ *      evaluating the matrices per vertex.
+ *
+ *      The texel directions are the ones of prefilter (cf. FACE_FRAMES),
+ *      they are normalized once per call and shared by all the probes, each
+ *      face being evaluated by the EvaluateIrradianceFn kernel of setKernel.
+ *
+ *      RGB9E5 texels are packed as GL_UNSIGNED_INT_5_9_9_9_REV (shared
+ *      exponent, cf. EXT_texture_shared_exponent) : the relative error of
+ *      the largest channel is below 2^-9, negative values are clamped to 0.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEBAKER_HPP
+#define IRRADIANCEBAKER_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include <tools/ImageLoader.hpp>
+
+class ThreadPool;
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Texel formats of the baked cubemaps */
+  enum BakeFormat
+  {
+    BAKE_RGB32F,        // GL_RGB32F, 3 floats
+    BAKE_RGB9E5,        // GL_RGB9_E5, a packed 32-bit word
+
+    NUM_BAKE_FORMAT
+  };
+
+  /** Size in bytes of a baked texel */
+  size_t getBakedTexelSize( const BakeFormat format );
+
+  /** Pack a color to RGB9E5 */
+  uint32_t packRGB9E5( const float r, const float g, const float b);
+
+  /** Unpack a RGB9E5 color */
+  glm::vec3 unpackRGB9E5( const uint32_t rgb9e5 );
+
+  /** Rasterize the irradiance of 'count' sets of matrices into size x size
+   *  cubemaps, stored in pixels face after face (+X, -X, +Y, -Y, +Z, -Z),
+   *  and probe after probe. The faces of all the probes are tasks of a
+   *  single pass on the pool. */
+  void bakeIrradiance( const glm::mat4 (*M)[3], const size_t count, const int size,
+                       const BakeFormat format, void *pixels, ThreadPool &pool);
+
+  /** Rasterize the irradiance of M into the faces of a size x size cubemap,
+   *  set as 2D images ready for TextureCubemap::upload */
+  void bakeIrradiance( const glm::mat4 M[3], const int size, const BakeFormat format,
+                       Image_t faces[6], ThreadPool &pool);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEBAKER_HPP
@@ -0,0 +1,423 @@
+/**
+ *
+ *      \file irradianceCache.cpp
+ *
+ */
+
+
+#include "irradianceCache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include <tools/Timer.hpp>
+#include "irradianceFaceSums.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+namespace
+{
+  const uint32_t CACHE_ENTRY_MAGIC = 0x534d4549;    // "IEMS"
+  const uint32_t CACHE_REF_MAGIC = 0x524d4549;      // "IEMR"
+  const uint32_t CACHE_VERSION = 1u;
+
+  /// Files left by an interrupted write, removed after this delay (seconds)
+  const int CACHE_TMP_LIFETIME = 60;
+
+  /// Size of the blocks of a face hashed at once
+  const size_t CACHE_READ_SIZE = 1u << 20;
+
+  /// Key of a set of faces from their stats (file *.ref)
+  struct CacheRef_t
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t statKey;
+    uint64_t key;
+  };
+
+  /// Header of an entry (file *.sh), followed by the matrices & coefficients
+  struct CacheEntry_t
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numCoeffs;       // per channel
+    uint32_t reserved;
+    uint64_t key;
+    uint64_t checksum;        // of the values
+  };
+
+  /// File of the cache, for the eviction
+  struct CacheFile_t
+  {
+    std::string path;
+    size_t size;
+    double lastUse;           // modification time, in seconds
+  };
+
+  bool operator <( const CacheFile_t &a, const CacheFile_t &b )
+  {
+    return a.lastUse < b.lastUse;
+  }
+}
+
+
+/// Combine a value into a running hash
+static inline void hashCombine( uint64_t &h, const uint64_t v )
+{
+  const uint64_t data[2] = { h, v };
+  h = hashBytes( reinterpret_cast<const unsigned char*>(data), sizeof(data));
+}
+
+/// Hash of the content of a file, block by block. Return false when it can't
+/// be read.
+static
+bool hashFile( const std::string &filename, std::vector<unsigned char> &buffer, uint64_t &h)
+{
+  FILE *fd = fopen( filename.c_str(), "rb");
+  if (0 == fd) {
+    return false;
+  }
+
+  buffer.resize( CACHE_READ_SIZE );
+  size_t size;
+  while ((size = fread( &buffer[0], 1u, buffer.size(), fd)) > 0u) {
+    hashCombine( h, hashBytes( &buffer[0], size));
+  }
+
+  const bool bRead = (0 == ferror( fd ));
+  fclose( fd );
+
+  return bRead;
+}
+
+/// Mark a file as just used
+static inline void touchFile( const std::string &path )
+{
+  #ifndef _WIN32
+  utime( path.c_str(), 0);
+  #endif
+}
+
+
+IrradianceCache::IrradianceCache( const std::string &directory, const size_t maxSize )
+  : m_directory(directory),
+    m_maxSize(maxSize),
+    m_bEnabled(false),
+    m_statKey(0u)
+{
+  memset( &m_stats, 0, sizeof(m_stats));
+
+  #ifndef _WIN32
+  struct stat st;
+  m_bEnabled = ((0 == mkdir( directory.c_str(), 0755)) || (EEXIST == errno)) &&
+               (0 == stat( directory.c_str(), &st)) && S_ISDIR( st.st_mode );
+  #endif
+
+  if (!m_bEnabled) {
+    fprintf( stderr, "IrradianceEnvMap : no irradiance cache in %s.\n", directory.c_str());
+  }
+}
+
+uint64_t IrradianceCache::getKey( const std::string filenames[], const size_t count, 
+                                  const uint32_t settings )
+{
+  if (!m_bEnabled) {
+    return 0u;
+  }
+
+  Timer &timer = Timer::getInstance();
+  const double tStart = timer.getAbsoluteTime();
+
+  uint64_t key = 0u;
+
+  #ifndef _WIN32
+  /// Key of the stats of the faces, for the files left unchanged
+  uint64_t statKey = CACHE_VERSION;
+  hashCombine( statKey, settings);
+
+  for (size_t i=0u; i<count; ++i)
+  {
+    struct stat st;
+    if (0 != stat( filenames[i].c_str(), &st))
+    {
+      m_stats.lookupTime += timer.getAbsoluteTime() - tStart;
+      return 0u;
+    }
+
+    hashCombine( statKey, hashBytes( reinterpret_cast<const unsigned char*>(filenames[i].c_str()),
+                                     filenames[i].size()));
+    hashCombine( statKey, uint64_t(st.st_size));
+    hashCombine( statKey, uint64_t(st.st_mtim.tv_sec));
+    hashCombine( statKey, uint64_t(st.st_mtim.tv_nsec));
+  }
+
+  const std::string refPath = _getPath( statKey, ".ref");
+  CacheRef_t ref;
+  FILE *fd = fopen( refPath.c_str(), "rb");
+
+  if (0 != fd)
+  {
+    if ((1u == fread( &ref, sizeof(ref), 1u, fd)) &&
+        (CACHE_REF_MAGIC == ref.magic) && (CACHE_VERSION == ref.version) &&
+        (statKey == ref.statKey))
+    {
+      key = ref.key;
+      touchFile( refPath );
+    }
+    fclose( fd );
+  }
+
+  /// Otherwise, key of their content
+  if (0u == key)
+  {
+    std::vector<unsigned char> buffer;
+    key = CACHE_VERSION;
+    hashCombine( key, settings);
+
+    for (size_t i=0u; i<count; ++i)
+    {
+      uint64_t h = 0u;
+      if (!hashFile( filenames[i], buffer, h))
+      {
+        m_stats.lookupTime += timer.getAbsoluteTime() - tStart;
+        return 0u;
+      }
+      hashCombine( key, h);
+    }
+    key = std::max( key, uint64_t(1u));
+
+    ref.magic = CACHE_REF_MAGIC;
+    ref.version = CACHE_VERSION;
+    ref.statKey = statKey;
+    ref.key = key;
+    _writeFile( refPath, &ref, sizeof(ref));
+  }
+  else
+  {
+    m_statKey = key;
+  }
+  #endif
+
+  m_stats.lookupTime += timer.getAbsoluteTime() - tStart;
+
+  return key;
+}
+
+bool IrradianceCache::lookup( const uint64_t key, glm::mat4 M[3], float *shCoeffs,
+                              const size_t numCoeffs )
+{
+  if (!m_bEnabled || (0u == key)) {
+    return false;
+  }
+
+  Timer &timer = Timer::getInstance();
+  const double tStart = timer.getAbsoluteTime();
+
+  const std::string path = _getPath( key, ".sh");
+  const size_t numValues = 3u * 16u + 3u * numCoeffs;
+
+  CacheEntry_t entry;
+  std::vector<float> values( numValues );
+  bool bRead = false;
+  bool bValid = false;
+
+  FILE *fd = fopen( path.c_str(), "rb");
+  if (0 != fd)
+  {
+    bRead = true;
+    bValid = (1u == fread( &entry, sizeof(entry), 1u, fd)) &&
+             (CACHE_ENTRY_MAGIC == entry.magic) && (CACHE_VERSION == entry.version) &&
+             (numCoeffs == entry.numCoeffs) && (key == entry.key) &&
+             (numValues == fread( &values[0], sizeof(float), numValues, fd)) &&
+             (EOF == fgetc( fd )) &&
+             (entry.checksum == hashBytes( reinterpret_cast<const unsigned char*>(&values[0]),
+                                           numValues * sizeof(float)));
+    fclose( fd );
+  }
+
+  if (bValid)
+  {
+    for (int c=0; c<3; ++c) {
+      memcpy( &M[c][0][0], &values[16*c], 16u * sizeof(float));
+    }
+    if (numCoeffs > 0u) {
+      memcpy( shCoeffs, &values[48], 3u * numCoeffs * sizeof(float));
+    }
+    touchFile( path );
+
+    ++m_stats.numHits;
+    m_stats.numStatHits += (key == m_statKey) ? 1u : 0u;
+  }
+  else
+  {
+    if (bRead)
+    {
+      // Truncated or from another version
+      remove( path.c_str() );
+      ++m_stats.numCorrupted;
+    }
+    ++m_stats.numMisses;
+  }
+  m_statKey = 0u;
+
+  m_stats.lookupTime += timer.getAbsoluteTime() - tStart;
+
+  return bValid;
+}
+
+bool IrradianceCache::store( const uint64_t key, const glm::mat4 M[3], const float *shCoeffs,
+                             const size_t numCoeffs )
+{
+  if (!m_bEnabled || (0u == key)) {
+    return false;
+  }
+
+  const size_t numValues = 3u * 16u + 3u * numCoeffs;
+  std::vector<unsigned char> data( sizeof(CacheEntry_t) + numValues * sizeof(float) );
+  float *values = reinterpret_cast<float*>(&data[sizeof(CacheEntry_t)]);
+
+  for (int c=0; c<3; ++c) {
+    memcpy( &values[16*c], &M[c][0][0], 16u * sizeof(float));
+  }
+  if (numCoeffs > 0u) {
+    memcpy( &values[48], shCoeffs, 3u * numCoeffs * sizeof(float));
+  }
+
+  CacheEntry_t entry;
+  entry.magic = CACHE_ENTRY_MAGIC;
+  entry.version = CACHE_VERSION;
+  entry.numCoeffs = uint32_t(numCoeffs);
+  entry.reserved = 0u;
+  entry.key = key;
+  entry.checksum = hashBytes( reinterpret_cast<const unsigned char*>(values),
+                              numValues * sizeof(float));
+  memcpy( &data[0], &entry, sizeof(entry));
+
+  if (!_writeFile( _getPath( key, ".sh"), &data[0], data.size())) {
+    return false;
+  }
+  ++m_stats.numStores;
+
+  evict();
+
+  return true;
+}
+
+void IrradianceCache::evict()
+{
+  #ifndef _WIN32
+  DIR *dir = opendir( m_directory.c_str() );
+  if (0 == dir) {
+    return;
+  }
+
+  std::vector<CacheFile_t> files;
+  size_t totalSize = 0u;
+  const time_t now = time( 0 );
+
+  struct dirent *dirEntry;
+  while (0 != (dirEntry = readdir( dir )))
+  {
+    const std::string path = m_directory + "/" + dirEntry->d_name;
+
+    struct stat st;
+    if ((0 != stat( path.c_str(), &st)) || !S_ISREG( st.st_mode )) {
+      continue;
+    }
+
+    // Left by an interrupted write
+    if (0 != strstr( dirEntry->d_name, ".tmp"))
+    {
+      if (now - st.st_mtime > CACHE_TMP_LIFETIME) {
+        remove( path.c_str() );
+      }
+      continue;
+    }
+
+    CacheFile_t file;
+    file.path = path;
+    file.size = st.st_size;
+    file.lastUse = st.st_mtim.tv_sec + 1.0e-9 * st.st_mtim.tv_nsec;
+    files.push_back( file );
+    totalSize += file.size;
+  }
+  closedir( dir );
+
+  if (totalSize <= m_maxSize) {
+    return;
+  }
+
+  std::sort( files.begin(), files.end());
+  for (size_t i=0u; (i<files.size()) && (totalSize > m_maxSize); ++i)
+  {
+    if (0 == remove( files[i].path.c_str() ))
+    {
+      totalSize -= files[i].size;
+      ++m_stats.numEvictions;
+    }
+  }
+  #endif
+}
+
+std::string IrradianceCache::_getPath( const uint64_t key, const char *extension ) const
+{
+  char name[32];
+  sprintf( name, "/%016llx", (unsigned long long)key);
+  return m_directory + name + extension;
+}
+
+bool IrradianceCache::_writeFile( const std::string &path, const void *data, const size_t size )
+{
+  #ifndef _WIN32
+  /// Written aside, flushed to the disk then renamed, so that the file is
+  /// either complete or absent after a crash
+  char suffix[32];
+  sprintf( suffix, ".tmp%d", int(getpid()));
+  const std::string tmpPath = path + suffix;
+
+  FILE *fd = fopen( tmpPath.c_str(), "wb");
+  if (0 == fd) {
+    return false;
+  }
+
+  bool bWritten = (1u == fwrite( data, size, 1u, fd)) &&
+                  (0 == fflush( fd )) &&
+                  (0 == fsync( fileno( fd )));
+  bWritten = (0 == fclose( fd )) && bWritten;
+
+  if (!bWritten || (0 != rename( tmpPath.c_str(), path.c_str() )))
+  {
+    remove( tmpPath.c_str() );
+    return false;
+  }
+
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+
+IrradianceCache& getIrradianceCache()
+{
+  static IrradianceCache sCache( IEM_CACHE_DIRECTORY, IEM_CACHE_MAX_SIZE);
+  return sCache;
+}
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,108 @@
+/**
+ *
+ *      \file irradianceCache.hpp
+ *
+ *      On-disk cache of the irradiance of the cubemaps, so that the faces
+ *      which were already prefiltered on a previous launch are not.
+ *
+ *      An entry holds the irradiance matrices and the SH coefficients of a
+ *      cubemap, in a file named by the hash of the content of its faces
+ *      (and of the settings of the projection). Hashing the faces reading
+ *      them, the key of a set of files is also kept by their paths, sizes
+ *      and modification times : unchanged files are looked up from a stat
+ *      only, touched but identical ones still hit by their content.
+ *
+ *      The files are written aside then renamed, and checked when read, so
+ *      that an interrupted write is never taken for an entry. The least
+ *      recently used files are removed when the cache exceeds its size.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCECACHE_HPP
+#define IRRADIANCECACHE_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <glm/glm.hpp>
+
+/// Irradiance of the cubemaps loaded by the textures looked up in the cache
+#ifndef ENABLE_IEM_SH_CACHE
+#define ENABLE_IEM_SH_CACHE   1
+#endif
+
+/// Directory & size in bytes of the cache of getIrradianceCache
+#ifndef IEM_CACHE_DIRECTORY
+#define IEM_CACHE_DIRECTORY   ".iem_cache"
+#endif
+
+#ifndef IEM_CACHE_MAX_SIZE
+#define IEM_CACHE_MAX_SIZE    (1u << 20)
+#endif
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Counters of an IrradianceCache */
+  struct IrradianceCacheStats_t
+  {
+    unsigned int numHits;
+    unsigned int numStatHits;       // hits whose faces were not read
+    unsigned int numMisses;
+    unsigned int numCorrupted;      // entries removed when read
+    unsigned int numStores;
+    unsigned int numEvictions;
+    double lookupTime;              // in milliseconds, keys included
+  };
+
+  /** Cache of the irradiance of the cubemaps in a directory */
+  class IrradianceCache
+  {
+    protected:
+      std::string m_directory;
+      size_t m_maxSize;
+      bool m_bEnabled;              // false when the directory can't be created
+      uint64_t m_statKey;           // last key read from the stats of the faces
+      IrradianceCacheStats_t m_stats;
+
+    public:
+      IrradianceCache( const std::string &directory, const size_t maxSize );
+
+      /** Key of the cubemap of the given files (its 6 faces, or a single
+       *  cross), prefiltered with 'settings' (any value telling apart the 
+       *  projections of the same faces). Return 0 when a file can't be read. */
+      uint64_t getKey( const std::string filenames[], const size_t count, 
+                       const uint32_t settings );
+
+      /** Read the entry of key to M & numCoeffs coefficients per channel.
+       *  Return false on a miss. */
+      bool lookup( const uint64_t key, glm::mat4 M[3], float *shCoeffs, const size_t numCoeffs );
+
+      /** Write the entry of key, then evict the least recently used ones */
+      bool store( const uint64_t key, const glm::mat4 M[3], const float *shCoeffs,
+                  const size_t numCoeffs );
+
+      /** Remove the least recently used files until the cache fits in maxSize */
+      void evict();
+
+      bool isEnabled() const { return m_bEnabled; }
+      const std::string& getDirectory() const { return m_directory; }
+      const IrradianceCacheStats_t& getStats() const { return m_stats; }
+
+
+    protected:
+      std::string _getPath( const uint64_t key, const char *extension ) const;
+      bool _writeFile( const std::string &path, const void *data, const size_t size );
+  };
+
+  /** Return the cache of IEM_CACHE_DIRECTORY used by the textures */
+  IrradianceCache& getIrradianceCache();
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCECACHE_HPP
@@ -7,9 +7,19 @@
 
 #include "irradianceEnvMap.hpp"
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <cmath>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <tools/ThreadPool.hpp>
+#include <tools/Timer.hpp>
+#include "irradiancePixelFormat.hpp"
+#include "irradianceWeightTable.hpp"
 
 
 namespace IrradianceEnvMap {
@@ -44,17 +54,185 @@ float test_coeffs[3][9] =
 #endif
 
 
-static
-void setIrradianceMatrices( const float shCoeff[3][9], glm::mat4 M[3]);
+/// Constants of the irradiance matrices (cf. equation 12 from the paper)
+static const float IRRADIANCE_C1 = 0.429043f;
+static const float IRRADIANCE_C2 = 0.511664f;
+static const float IRRADIANCE_C3 = 0.743125f;
+static const float IRRADIANCE_C4 = 0.886227f;
+static const float IRRADIANCE_C5 = 0.247708f;
+
+/// Number of texel rows processed by a single prefiltering task.
+/// It is independent of the number of threads so that the reduction order,
+/// hence the result, stays the same whatever the pool size.
+static const int PREFILTER_BAND_ROWS = 16;
+
+namespace {
+
+/// Partial sums of a task, padded to avoid false sharing between workers
+struct alignas(64) SHPartial_t
+{
+  float shCoeff[3][9];
+  float sumWeight;
+};
+
+/// Exact partial moments of a fixed point task
+struct alignas(64) FixedPartial_t
+{
+  int64_t moments[3][9];
+};
+
+} //namespace
+
+
 
 static
 void getTexelAttrib( const int texId, const float u, const float v, const float texelSize,
                      glm::vec3 *direction, float *solidAngle);
+
+template<PixelFormat Format>
+static
+void projectBand( const ImageView_t &face, const int texId, const int firstRow, const int lastRow,
+                  SHPartial_t *partial);
+
+template<PixelFormat Format>
+static
+void projectBandSoA( const ImageView_t &face, const int texId, const int firstRow, const int lastRow,
+                     ProjectRowFn projectRow, SHPartial_t *partial);
+
+static
+bool usesWeightTable( const ImageView_t envmap[6] );
+
+
+namespace {
+
+/// Projection of cubemaps split in independent tasks, whose partial sums
+/// are merged in a fixed order once they are all done
+class PrefilterJob
+{
+  public:
+    virtual ~PrefilterJob() {}
+
+    virtual size_t getNumTasks() const = 0;
+
+    /// Number of texels read by a task, an estimate of its cost
+    virtual double getTaskCost(const size_t taskId) const = 0;
+
+    virtual void runTask(const size_t taskId) = 0;
+
+    /// Merge the partials to the normalized SH coefficients of the results
+    virtual void finish() = 0;
+};
+
+/// Direct projection of a cubemap, by bands of PREFILTER_BAND_ROWS rows
+class DirectJob : public PrefilterJob
+{
+  protected:
+    const ImageView_t *m_envmap;
+    SHPartial_t *m_result;
+    PixelFormat m_format;
+    ProjectRowFn m_projectRow;
+    int m_bandsPerFace;
+    std::vector<SHPartial_t> m_partials;
+
+  public:
+    DirectJob(const ImageView_t envmap[6], SHPartial_t *result);
+
+    size_t getNumTasks() const { return m_partials.size(); }
+    double getTaskCost(const size_t taskId) const;
+    void runTask(const size_t taskId);
+    void finish();
+};
+
+/// Weight table projection of cubemaps of the same resolution & format
+class TableJob : public PrefilterJob
+{
+  protected:
+    const ImageView_t *const *m_envmaps;
+    size_t m_count;
+    SHPartial_t *m_results;
+    std::shared_ptr<const WeightTable> m_table;
+    SIMDKernel m_kernel;
+    bool m_bFixed;
+    int m_bandsPerFace;
+    size_t m_numGroups;
+
+    // Partials of the task t for the cubemap i of its group at [t * groupSize + i]
+    std::vector<SHPartial_t> m_partials;
+    std::vector<FixedPartial_t> m_fixedPartials;
+
+  public:
+    TableJob(const ImageView_t *const envmaps[], const size_t count, SHPartial_t results[]);
+
+    size_t getNumTasks() const { return m_numGroups * 6u * m_bandsPerFace; }
+    double getTaskCost(const size_t taskId) const;
+    void runTask(const size_t taskId);
+    void finish();
+};
+
+} //namespace
+
+static
+void runJobs( PrefilterJob *const jobs[], const size_t numJobs, ThreadPool &pool);
+
+
+/// Kernel used by prefilter, NUM_SIMD_KERNEL until set or first used
+static SIMDKernel sKernel = NUM_SIMD_KERNEL;
+
+/// Projection method used by prefilter
+static PrefilterMethod sMethod = PREFILTER_WEIGHT_TABLE;
                        
                        
 
+ThreadPool& getThreadPool()
+{
+  static ThreadPool sPool;
+  return sPool;
+}
+
+void setKernel( SIMDKernel kernel )
+{
+  if (!isKernelSupported( kernel ))
+  {
+    fprintf( stderr, "IrradianceEnvMap : %s kernel not supported by the CPU.\n", 
+             getKernelName( kernel ));
+    kernel = getBestKernel();
+  }
+  sKernel = kernel;
+}
+
+SIMDKernel getKernel()
+{
+  if (NUM_SIMD_KERNEL == sKernel) {
+    sKernel = getBestKernel();
+  }
+  return sKernel;
+}
+
+void setPrefilterMethod( PrefilterMethod method )
+{
+  sMethod = method;
+}
+
+PrefilterMethod getPrefilterMethod()
+{
+  return sMethod;
+}
 
 void prefilter( const Image_t envmap[6], glm::mat4 M[3])
+{
+  prefilter( envmap, M, getThreadPool());
+}
+
+void prefilter( const Image_t envmap[6], glm::mat4 M[3], ThreadPool &pool)
+{
+  const ImageView_t views[6] = 
+  {
+    envmap[0], envmap[1], envmap[2], envmap[3], envmap[4], envmap[5]
+  };
+  prefilter( views, M, pool);
+}
+
+void prefilter( const ImageView_t envmap[6], glm::mat4 M[3], ThreadPool &pool)
 {
 /**
  * Computes Spherical Harmonics coefficients for standard unsigned byte 
@@ -64,79 +242,279 @@ void prefilter( const Image_t envmap[6], glm::mat4 M[3])
  *        (cf. equation 13).
  */
 
-  float shCoeff[3][9];  
-  memset( shCoeff[RED],   0, 9u*sizeof(float));
-  memset( shCoeff[GREEN], 0, 9u*sizeof(float));
-  memset( shCoeff[BLUE],  0, 9u*sizeof(float));
-
-  /// Precompute generals attribs needed inside the loop
-  const int texRes = envmap[0].width;
-  const float texelSize = 1.0f / float(texRes);
-  const float dColor = 1.0f / float( (sizeof(unsigned char) << 8) - 1 ); //    
+  SHPartial_t result;
   
-  // Take care of the internal format (ugly!)
-  const int nc = (envmap[0].internalFormat==GL_RGBA)?4:3; //
-
+  if (NUM_PIXEL_FORMAT == getPixelFormat( envmap[0] ))
+  {
+    fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+    memset( &result, 0, sizeof(result));
+  }
+  else if (usesWeightTable( envmap ))
+  {
+    const ImageView_t *envmaps[1] = { envmap };
+    TableJob job( envmaps, 1u, &result);
+    PrefilterJob *jobs[1] = { &job };
+    runJobs( jobs, 1u, pool);
+  }
+  else
+  {
+    DirectJob job( envmap, &result);
+    PrefilterJob *jobs[1] = { &job };
+    runJobs( jobs, 1u, pool);
+  }
+  
+  #if IEM_TEST
+  setIrradianceMatrices( test_coeffs, M);
+  #else
+  setIrradianceMatrices( result.shCoeff, M); 
+  #endif
+}
 
-  float sumWeight = 0.0f;  
-  for (int texId=0; texId<6; ++texId)
+void projectFaceRows( const ImageView_t &face, const int faceId, const int firstRow, 
+                      const int lastRow, float shCoeff[3][9], float *sumWeight)
+{
+  SHPartial_t partial;
+  memset( &partial, 0, sizeof(partial));
+  
+  const PixelFormat format = getPixelFormat( face );
+  
+  if (NUM_PIXEL_FORMAT == format) {
+    fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+  }
+  else
   {
-    float u, v;
-    unsigned char *pixels = envmap[texId].data;    
+    const ProjectRowFn projectRow = (KERNEL_SCALAR == getKernel()) ? 0 : getProjectRow( getKernel() );
     
-    for (int i=0; i<texRes; ++i)
+    dispatchPixelFormat( format, [&](auto F)
     {
-      // map value to [-1, 1]
-      v = 2.0f * ((i+0.5f) * texelSize) - 1.0f;
+      constexpr PixelFormat Format = decltype(F)::value;
       
-      for (int j=0; j<texRes; ++j)
-      {
-        u = 2.0f * ((j+0.5f) * texelSize) - 1.0f;        
-        
-        glm::vec3 dir; float solidAngle;
-        getTexelAttrib( texId, u, v, texelSize, &dir, &solidAngle);
-        sumWeight += solidAngle;
-        
-        float lambda;
-        
-        lambda = (pixels[RED] * dColor) * solidAngle;  
-        shCoeff[RED][0] += lambda * Y0( dir );
-        shCoeff[RED][1] += lambda * Y1( dir );
-        shCoeff[RED][2] += lambda * Y2( dir );
-        shCoeff[RED][3] += lambda * Y3( dir );
-        shCoeff[RED][4] += lambda * Y4( dir );
-        shCoeff[RED][5] += lambda * Y5( dir );
-        shCoeff[RED][6] += lambda * Y6( dir );
-        shCoeff[RED][7] += lambda * Y7( dir );
-        shCoeff[RED][8] += lambda * Y8( dir );
-        
-        lambda = (pixels[GREEN] * dColor) * solidAngle;
-        shCoeff[GREEN][0] += lambda * Y0( dir );
-        shCoeff[GREEN][1] += lambda * Y1( dir );
-        shCoeff[GREEN][2] += lambda * Y2( dir );
-        shCoeff[GREEN][3] += lambda * Y3( dir );
-        shCoeff[GREEN][4] += lambda * Y4( dir );
-        shCoeff[GREEN][5] += lambda * Y5( dir );
-        shCoeff[GREEN][6] += lambda * Y6( dir );
-        shCoeff[GREEN][7] += lambda * Y7( dir );
-        shCoeff[GREEN][8] += lambda * Y8( dir );        
-        
-        lambda = (pixels[BLUE] * dColor) * solidAngle;
-        shCoeff[BLUE][0] += lambda * Y0( dir );
-        shCoeff[BLUE][1] += lambda * Y1( dir );
-        shCoeff[BLUE][2] += lambda * Y2( dir );
-        shCoeff[BLUE][3] += lambda * Y3( dir );
-        shCoeff[BLUE][4] += lambda * Y4( dir );
-        shCoeff[BLUE][5] += lambda * Y5( dir );
-        shCoeff[BLUE][6] += lambda * Y6( dir );
-        shCoeff[BLUE][7] += lambda * Y7( dir );
-        shCoeff[BLUE][8] += lambda * Y8( dir );
-        
-        pixels += nc;
+      if (0 != projectRow) {
+        projectBandSoA<Format>( face, faceId, firstRow, lastRow, projectRow, &partial);
+      } else {
+        projectBand<Format>( face, faceId, firstRow, lastRow, &partial);
       }
-    }
+    });
   }
   
+  memcpy( shCoeff, partial.shCoeff, sizeof(partial.shCoeff));
+  *sumWeight = partial.sumWeight;
+}
+
+void prefilter( const Image_t *const envmaps[], const size_t count, glm::mat4 (*M)[3],
+                ThreadPool &pool)
+{
+  prefilterBatch( envmaps, count, M, pool, 0);
+}
+
+void prefilterBatch( const Image_t *const envmaps[], const size_t count, glm::mat4 (*M)[3],
+                     ThreadPool &pool, BatchStats_t *stats)
+{
+/**
+ * Cubemaps sharing a weight table (same resolution & pixel format) make a
+ * single TableJob, the others a DirectJob each, and the tasks of all the
+ * jobs are scheduled together by runJobs.
+ */
+
+  Timer &timer = Timer::getInstance();
+  const double tStart = timer.getAbsoluteTime();
+
+  struct TableGroup_t
+  {
+    std::vector<size_t> indices;
+    std::vector<const ImageView_t*> envmaps;
+    std::vector<SHPartial_t> results;
+  };
+
+  std::vector<SHPartial_t> results( count );
+  std::vector<ImageView_t> views( 6u * count );
+  std::map< std::pair<int, int>, TableGroup_t > groups;
+  std::vector< std::unique_ptr<PrefilterJob> > jobs;
+  double numTexels = 0.0;
+
+  for (size_t i=0u; i<count; ++i)
+  {
+    const ImageView_t *envmap = &views[6u * i];
+    std::copy( envmaps[i], envmaps[i] + 6, views.begin() + 6u * i);
+    
+    const PixelFormat format = getPixelFormat( envmap[0] );
+    numTexels += 6.0 * envmaps[i][0].width * envmaps[i][0].height;
+
+    if (NUM_PIXEL_FORMAT == format)
+    {
+      fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+      memset( &results[i], 0, sizeof(results[i]));
+    }
+    else if (usesWeightTable( envmap ))
+    {
+      TableGroup_t &group = groups[ std::make_pair( envmap[0].width, int(format)) ];
+      group.indices.push_back( i );
+      group.envmaps.push_back( envmap );
+    }
+    else
+    {
+      jobs.emplace_back( new DirectJob( envmap, &results[i]) );
+    }
+  }
+
+  for (auto &it : groups)
+  {
+    TableGroup_t &group = it.second;
+    group.results.resize( group.indices.size() );
+    jobs.emplace_back( new TableJob( &group.envmaps[0], group.indices.size(), &group.results[0]) );
+  }
+
+  std::vector<PrefilterJob*> pJobs( jobs.size() );
+  for (size_t j=0u; j<jobs.size(); ++j) {
+    pJobs[j] = jobs[j].get();
+  }
+
+  if (!pJobs.empty()) {
+    runJobs( &pJobs[0], pJobs.size(), pool);
+  }
+
+  for (auto &it : groups) {
+    for (size_t k=0u; k<it.second.indices.size(); ++k) {
+      results[ it.second.indices[k] ] = it.second.results[k];
+    }
+  }
+
+  for (size_t i=0u; i<count; ++i)
+  {
+    #if IEM_TEST
+    setIrradianceMatrices( test_coeffs, M[i]);
+    #else
+    setIrradianceMatrices( results[i].shCoeff, M[i]);
+    #endif
+  }
+
+  if (stats)
+  {
+    const double time = timer.getAbsoluteTime() - tStart;
+
+    stats->numCubemaps = count;
+    stats->numTexels = numTexels;
+    stats->time = time;
+    stats->texelsPerSecond = (time > 0.0) ? 1.0e3 * numTexels / time : 0.0;
+    stats->cubemapsPerSecond = (time > 0.0) ? 1.0e3 * count / time : 0.0;
+  }
+}
+
+static
+bool usesWeightTable( const ImageView_t envmap[6] )
+{
+  return ((PREFILTER_WEIGHT_TABLE == sMethod) || (PREFILTER_FIXED_POINT == sMethod)) &&
+         (0 == (envmap[0].width & 1));
+}
+
+static
+void runJobs( PrefilterJob *const jobs[], const size_t numJobs, ThreadPool &pool)
+{
+/**
+ * The tasks of all the jobs are run by a single parallelFor, the costliest
+ * first. As each thread picks the next task as soon as it is done, the
+ * smallest ones fill the end of the run, whatever the mix of resolutions.
+ * Each job merges its own partials in a fixed order, so the results do not
+ * depend on the schedule.
+ */
+
+  struct JobTask_t
+  {
+    PrefilterJob *job;
+    size_t taskId;
+    double cost;
+  };
+
+  std::vector<JobTask_t> tasks;
+  for (size_t j=0u; j<numJobs; ++j) {
+    for (size_t t=0u; t<jobs[j]->getNumTasks(); ++t)
+    {
+      const JobTask_t task = { jobs[j], t, jobs[j]->getTaskCost(t) };
+      tasks.push_back( task );
+    }
+  }
+
+  std::stable_sort( tasks.begin(), tasks.end(), [](const JobTask_t &a, const JobTask_t &b) {
+    return a.cost > b.cost;
+  });
+
+  pool.parallelFor( tasks.size(), [&](size_t i)
+  {
+    tasks[i].job->runTask( tasks[i].taskId );
+  });
+
+  for (size_t j=0u; j<numJobs; ++j) {
+    jobs[j]->finish();
+  }
+}
+
+
+DirectJob::DirectJob(const ImageView_t envmap[6], SHPartial_t *result)
+  : m_envmap(envmap),
+    m_result(result),
+    m_format(getPixelFormat( envmap[0] )),
+    m_projectRow((KERNEL_SCALAR == getKernel()) ? 0 : getProjectRow( getKernel() )),
+    m_bandsPerFace((envmap[0].width + PREFILTER_BAND_ROWS - 1) / PREFILTER_BAND_ROWS)
+{
+/**
+ * Each face is split in bands of PREFILTER_BAND_ROWS rows, each band being a
+ * task with its own partial sums. The partials are then merged in band order.
+ *
+ * Bands are projected by the vectorized kernel selected with setKernel, or
+ * texel by texel by the reference path for KERNEL_SCALAR, both specialized
+ * for the pixel format of the cubemap.
+ */
+
+  m_partials.resize( 6u * m_bandsPerFace );
+}
+
+double DirectJob::getTaskCost(const size_t taskId) const
+{
+  const int texRes = m_envmap[0].width;
+  const int firstRow = (taskId % m_bandsPerFace) * PREFILTER_BAND_ROWS;
+  return double(std::min( PREFILTER_BAND_ROWS, texRes - firstRow)) * texRes;
+}
+
+void DirectJob::runTask(const size_t taskId)
+{
+  const int texRes = m_envmap[0].width;
+  const int texId = taskId / m_bandsPerFace;
+  const int firstRow = (taskId % m_bandsPerFace) * PREFILTER_BAND_ROWS;
+  const int lastRow = std::min( firstRow + PREFILTER_BAND_ROWS, texRes);
+
+  dispatchPixelFormat( m_format, [&](auto format)
+  {
+    constexpr PixelFormat Format = decltype(format)::value;
+
+    if (0 != m_projectRow) {
+      projectBandSoA<Format>( m_envmap[texId], texId, firstRow, lastRow, m_projectRow,
+                              &m_partials[taskId]);
+    } else {
+      projectBand<Format>( m_envmap[texId], texId, firstRow, lastRow, &m_partials[taskId]);
+    }
+  });
+}
+
+void DirectJob::finish()
+{
+  /// Fixed order reduction
+  float (*shCoeff)[9] = m_result->shCoeff;
+  memset( shCoeff[RED],   0, 9u*sizeof(float));
+  memset( shCoeff[GREEN], 0, 9u*sizeof(float));
+  memset( shCoeff[BLUE],  0, 9u*sizeof(float));
+
+  float sumWeight = 0.0f;
+  for (size_t t=0u; t<m_partials.size(); ++t)
+  {
+    for (int i=0; i<9; ++i)
+    {
+      shCoeff[RED][i]   += m_partials[t].shCoeff[RED][i];
+      shCoeff[GREEN][i] += m_partials[t].shCoeff[GREEN][i];
+      shCoeff[BLUE][i]  += m_partials[t].shCoeff[BLUE][i];
+    }
+    sumWeight += m_partials[t].sumWeight;
+  }
+
   /**/
   const float dnorm = 2.0f * M_PI / sumWeight;
   for (int i=0; i<9; ++i)
@@ -146,12 +524,283 @@ void prefilter( const Image_t envmap[6], glm::mat4 M[3])
     shCoeff[BLUE][i]  *= dnorm;
   }
   /**/
+
+  m_result->sumWeight = sumWeight;
+}
+
+
+TableJob::TableJob(const ImageView_t *const envmaps[], const size_t count, SHPartial_t results[])
+  : m_envmaps(envmaps),
+    m_count(count),
+    m_results(results),
+    m_table(WeightTable::get( envmaps[0][0].width )),
+    m_kernel(getKernel()),
+    m_bFixed(false),
+    m_bandsPerFace(m_table->getNumTileRows()),
+    m_numGroups((count + WeightTable::MAX_BATCH_SIZE - 1u) / WeightTable::MAX_BATCH_SIZE)
+{
+/**
+ * The cubemaps are processed by groups of WeightTable::MAX_BATCH_SIZE, each
+ * task projecting a row of octant tiles of the same face of a whole group.
+ * The bands partial moments are merged in band order for each face, then
+ * turned to SH coefficients.
+ *
+ * With PREFILTER_FIXED_POINT, 8-bit cubemaps are projected by the integer
+ * weights, whose partial moments are summed exactly before being scaled.
+ */
+
+  const PixelFormat format = getPixelFormat( envmaps[0][0] );
+  m_bFixed = (PREFILTER_FIXED_POINT == sMethod) &&
+             ((PIXEL_RGB8 == format) || (PIXEL_RGBA8 == format));
+
+  const size_t numPartials = getNumTasks() * WeightTable::MAX_BATCH_SIZE;
+  if (m_bFixed) {
+    m_fixedPartials.resize( numPartials );
+  } else {
+    m_partials.resize( numPartials );
+  }
+}
+
+double TableJob::getTaskCost(const size_t taskId) const
+{
+  // A row of octant tiles folds 8 texels per entry
+  const size_t tasksPerGroup = 6u * m_bandsPerFace;
+  const size_t first = (taskId / tasksPerGroup) * WeightTable::MAX_BATCH_SIZE;
+  const size_t numFaces = std::min( size_t(WeightTable::MAX_BATCH_SIZE), m_count - first);
+  const int tileRow = taskId % m_bandsPerFace;
+
+  const double tileTexels = 8.0 * WeightTable::TILE_SIZE * WeightTable::TILE_SIZE;
+  return double(numFaces) * (tileRow + 1) * tileTexels;
+}
+
+void TableJob::runTask(const size_t taskId)
+{
+  const size_t groupSize = WeightTable::MAX_BATCH_SIZE;
+  const size_t tasksPerGroup = 6u * m_bandsPerFace;
+
+  const size_t group = taskId / tasksPerGroup;
+  const int texId = (taskId % tasksPerGroup) / m_bandsPerFace;
+  const int tileRow = taskId % m_bandsPerFace;
+
+  const size_t first = group * groupSize;
+  const size_t numFaces = std::min( groupSize, m_count - first);
+
+  const ImageView_t *faces[WeightTable::MAX_BATCH_SIZE] = {};
+  for (size_t i=0u; i<numFaces; ++i) {
+    faces[i] = &m_envmaps[first + i][texId];
+  }
+
+  if (m_bFixed)
+  {
+    int64_t moments[WeightTable::MAX_BATCH_SIZE][3][WeightTable::NUM_WEIGHTS];
+    memset( moments, 0, sizeof(moments));
+
+    m_table->projectTileRowsFixed( faces, numFaces, tileRow, tileRow + 1, m_kernel, moments);
+
+    for (size_t i=0u; i<numFaces; ++i) {
+      memcpy( m_fixedPartials[taskId * groupSize + i].moments, moments[i], sizeof(moments[i]));
+    }
+    return;
+  }
+
+  float moments[WeightTable::MAX_BATCH_SIZE][3][WeightTable::NUM_WEIGHTS];
+  memset( moments, 0, sizeof(moments));
+
+  m_table->projectTileRows( faces, numFaces, tileRow, tileRow + 1, m_kernel, moments);
+
+  for (size_t i=0u; i<numFaces; ++i) {
+    memcpy( m_partials[taskId * groupSize + i].shCoeff, moments[i], sizeof(moments[i]));
+  }
+}
+
+void TableJob::finish()
+{
+  /// Fixed order reduction
+  const size_t groupSize = WeightTable::MAX_BATCH_SIZE;
+  const size_t tasksPerGroup = 6u * m_bandsPerFace;
+
+  const double dColor = getColorScale( getPixelFormat( m_envmaps[0][0] ));
+  const double dnorm = dColor * 2.0 * M_PI / m_table->getSumWeight();
+
+  for (size_t i=0u; i<m_count; ++i)
+  {
+    const size_t group = i / groupSize;
+    double shCoeff[3][9] = {};
+
+    for (int texId=0; texId<6; ++texId)
+    {
+      double moments[3][WeightTable::NUM_WEIGHTS] = {};
+      int64_t fixedMoments[3][WeightTable::NUM_WEIGHTS] = {};
+
+      for (int band=0; band<m_bandsPerFace; ++band)
+      {
+        const size_t taskId = group * tasksPerGroup + texId * m_bandsPerFace + band;
+        const size_t index = taskId * groupSize + (i % groupSize);
+
+        for (int c=0; c<3; ++c) {
+          for (int k=0; k<WeightTable::NUM_WEIGHTS; ++k)
+          {
+            if (m_bFixed) {
+              fixedMoments[c][k] += m_fixedPartials[index].moments[c][k];
+            } else {
+              moments[c][k] += m_partials[index].shCoeff[c][k];
+            }
+          }
+        }
+      }
+
+      if (m_bFixed)
+      {
+        for (int c=0; c<3; ++c) {
+          for (int k=0; k<WeightTable::NUM_WEIGHTS; ++k) {
+            moments[c][k] = double(fixedMoments[c][k]) * m_table->getFixedScale(k);
+          }
+        }
+      }
+
+      WeightTable::addFaceMoments( texId, moments, shCoeff);
+    }
+
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<9; ++k) {
+        m_results[i].shCoeff[c][k] = float(dnorm * shCoeff[c][k]);
+      }
+    }
+    m_results[i].sumWeight = float(m_table->getSumWeight());
+  }
+}
+
+template<PixelFormat Format>
+static
+void projectBand( const ImageView_t &face, const int texId, const int firstRow, const int lastRow,
+                  SHPartial_t *partial)
+{
+  typedef PixelTraits<Format> Traits;
   
-  #if IEM_TEST
-  setIrradianceMatrices( test_coeffs, M);
-  #else
-  setIrradianceMatrices( shCoeff, M); 
-  #endif
+  float (*shCoeff)[9] = partial->shCoeff;
+  memset( shCoeff, 0, sizeof(partial->shCoeff));
+
+  /// Precompute generals attribs needed inside the loop
+  const int texRes = face.width;
+  const float texelSize = 1.0f / float(texRes);
+  const int nc = Traits::NUM_CHANNELS;
+
+
+  float sumWeight = 0.0f;  
+  float u, v;
+  
+  for (int i=firstRow; i<lastRow; ++i)
+  {
+    const typename Traits::Channel_t *pixels = 
+      reinterpret_cast<const typename Traits::Channel_t*>(face.getRow( i ));
+    
+    // map value to [-1, 1]
+    v = 2.0f * ((i+0.5f) * texelSize) - 1.0f;
+    
+    for (int j=0; j<texRes; ++j)
+    {
+      u = 2.0f * ((j+0.5f) * texelSize) - 1.0f;        
+      
+      glm::vec3 dir; float solidAngle;
+      getTexelAttrib( texId, u, v, texelSize, &dir, &solidAngle);
+      sumWeight += solidAngle;
+      
+      float lambda;
+      
+      lambda = toFloat( pixels[RED] ) * solidAngle;  
+      shCoeff[RED][0] += lambda * Y0( dir );
+      shCoeff[RED][1] += lambda * Y1( dir );
+      shCoeff[RED][2] += lambda * Y2( dir );
+      shCoeff[RED][3] += lambda * Y3( dir );
+      shCoeff[RED][4] += lambda * Y4( dir );
+      shCoeff[RED][5] += lambda * Y5( dir );
+      shCoeff[RED][6] += lambda * Y6( dir );
+      shCoeff[RED][7] += lambda * Y7( dir );
+      shCoeff[RED][8] += lambda * Y8( dir );
+      
+      lambda = toFloat( pixels[GREEN] ) * solidAngle;
+      shCoeff[GREEN][0] += lambda * Y0( dir );
+      shCoeff[GREEN][1] += lambda * Y1( dir );
+      shCoeff[GREEN][2] += lambda * Y2( dir );
+      shCoeff[GREEN][3] += lambda * Y3( dir );
+      shCoeff[GREEN][4] += lambda * Y4( dir );
+      shCoeff[GREEN][5] += lambda * Y5( dir );
+      shCoeff[GREEN][6] += lambda * Y6( dir );
+      shCoeff[GREEN][7] += lambda * Y7( dir );
+      shCoeff[GREEN][8] += lambda * Y8( dir );        
+      
+      lambda = toFloat( pixels[BLUE] ) * solidAngle;
+      shCoeff[BLUE][0] += lambda * Y0( dir );
+      shCoeff[BLUE][1] += lambda * Y1( dir );
+      shCoeff[BLUE][2] += lambda * Y2( dir );
+      shCoeff[BLUE][3] += lambda * Y3( dir );
+      shCoeff[BLUE][4] += lambda * Y4( dir );
+      shCoeff[BLUE][5] += lambda * Y5( dir );
+      shCoeff[BLUE][6] += lambda * Y6( dir );
+      shCoeff[BLUE][7] += lambda * Y7( dir );
+      shCoeff[BLUE][8] += lambda * Y8( dir );
+      
+      pixels += nc;
+    }
+  }
+  
+  // 8-bit colors are kept in [0, 255] inside the loop
+  const float dColor = Traits::COLOR_SCALE;
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<9; ++k) {
+      shCoeff[c][k] *= dColor;
+    }
+  }
+  
+  partial->sumWeight = sumWeight;
+}
+
+template<PixelFormat Format>
+static
+void projectBandSoA( const ImageView_t &face, const int texId, const int firstRow, const int lastRow,
+                     ProjectRowFn projectRow, SHPartial_t *partial)
+{
+  typedef PixelTraits<Format> Traits;
+  
+  const float (*axes)[3] = FACE_FRAMES[texId];
+  
+  memset( partial->shCoeff, 0, sizeof(partial->shCoeff));
+  partial->sumWeight = 0.0f;
+  
+  const int texRes = face.width;
+  const float texelSize = 1.0f / float(texRes);
+  const float texelArea = 4.0f * texelSize * texelSize;
+  
+  /// Structure-of-arrays row
+  std::vector<float> soa( 3 * texRes );
+  float *red   = &soa[0];
+  float *green = red + texRes;
+  float *blue  = green + texRes;
+  
+  for (int i=firstRow; i<lastRow; ++i)
+  {
+    convertRow<Format>( face.getRow( i ), texRes, red, green, blue);
+    
+    const float v = 2.0f * ((i+0.5f) * texelSize) - 1.0f;
+    const float base[3] = 
+    { 
+      axes[0][0] + v * axes[2][0], 
+      axes[0][1] + v * axes[2][1], 
+      axes[0][2] + v * axes[2][2]
+    };
+    
+    projectRow( red, green, blue, texRes, base, axes[1], 
+                texelSize - 1.0f, 2.0f * texelSize, texelArea, 
+                partial->shCoeff, &partial->sumWeight);
+  }
+  
+  // 8-bit colors are kept in [0, 255] inside the loop
+  const float dColor = Traits::COLOR_SCALE;
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<9; ++k) {
+      partial->shCoeff[c][k] *= dColor;
+    }
+  }
 }
 
 static
@@ -220,7 +869,6 @@ void getTexelAttrib( const int texId, const float u, const float v, const float
 }
 
 
-static
 void setIrradianceMatrices( const float shCoeff[3][9], glm::mat4 M[3] )
 {
 /**
@@ -231,11 +879,11 @@ void setIrradianceMatrices( const float shCoeff[3][9], glm::mat4 M[3] )
  *  of memory / computation. 
  */
  
-  const float c1 = 0.429043f;
-  const float c2 = 0.511664f;
-  const float c3 = 0.743125f;
-  const float c4 = 0.886227f;
-  const float c5 = 0.247708f;
+  const float c1 = IRRADIANCE_C1;
+  const float c2 = IRRADIANCE_C2;
+  const float c3 = IRRADIANCE_C3;
+  const float c4 = IRRADIANCE_C4;
+  const float c5 = IRRADIANCE_C5;
   
   
   for (int c=0; c<3; ++c)
@@ -262,6 +910,84 @@ void setIrradianceMatrices( const float shCoeff[3][9], glm::mat4 M[3] )
   }
 }
 
+void getSHCoefficients( const glm::mat4 M[3], float shCoeff[3][9] )
+{
+  for (int c=0; c<3; ++c)
+  {
+    shCoeff[c][8] = M[c][0][0] / IRRADIANCE_C1;
+    shCoeff[c][4] = M[c][0][1] / IRRADIANCE_C1;
+    shCoeff[c][7] = M[c][0][2] / IRRADIANCE_C1;
+    shCoeff[c][5] = M[c][1][2] / IRRADIANCE_C1;
+    shCoeff[c][3] = M[c][0][3] / IRRADIANCE_C2;
+    shCoeff[c][1] = M[c][1][3] / IRRADIANCE_C2;
+    shCoeff[c][2] = M[c][2][3] / IRRADIANCE_C2;
+    shCoeff[c][6] = M[c][2][2] / IRRADIANCE_C3;
+    shCoeff[c][0] = (M[c][3][3] + IRRADIANCE_C5 * shCoeff[c][6]) / IRRADIANCE_C4;
+  }
+}
+
+
+/// Normals evaluated by a single task
+static const size_t EVALUATION_CHUNK_SIZE = 16384u;
+
+void getIrradiancePolynomial( const glm::mat4 M[3], float poly[3][9] )
+{
+/**
+ *  n^T M n with n = (x, y, z, 1), the squares being rewritten with 
+ *  x^2 + y^2 + z^2 = 1 to the terms of EvaluateIrradianceFn : 
+ *  
+ *    x^2 = (1 - z^2 + (x^2 - y^2)) / 2
+ *    y^2 = (1 - z^2 - (x^2 - y^2)) / 2
+ */
+  for (int c=0; c<3; ++c)
+  {
+    const glm::mat4 &m = M[c];
+    poly[c][0] = m[3][3] + 0.5f * (m[0][0] + m[1][1]);
+    poly[c][1] = 2.0f * m[1][3];
+    poly[c][2] = 2.0f * m[2][3];
+    poly[c][3] = 2.0f * m[0][3];
+    poly[c][4] = 2.0f * m[0][1];
+    poly[c][5] = 2.0f * m[1][2];
+    poly[c][6] = m[2][2] - 0.5f * (m[0][0] + m[1][1]);
+    poly[c][7] = 2.0f * m[0][2];
+    poly[c][8] = 0.5f * (m[0][0] - m[1][1]);
+  }
+}
+
+void evaluateIrradiance( const glm::mat4 M[3], const float *nx, const float *ny, 
+                         const float *nz, const size_t count, float *rgb, 
+                         ThreadPool &pool)
+{
+  float poly[3][9];
+  getIrradiancePolynomial( M, poly);
+  
+  const EvaluateIrradianceFn evaluate = getEvaluateIrradiance( getKernel() );
+  
+  if (count <= EVALUATION_CHUNK_SIZE) 
+  {
+    evaluate( poly, nx, ny, nz, int(count), rgb);
+    return;
+  }
+  
+  const size_t numTasks = (count + EVALUATION_CHUNK_SIZE - 1u) / EVALUATION_CHUNK_SIZE;
+  
+  pool.parallelFor( numTasks, [&](size_t taskId)
+  {
+    const size_t first = taskId * EVALUATION_CHUNK_SIZE;
+    const size_t n = std::min( EVALUATION_CHUNK_SIZE, count - first);
+    
+    evaluate( poly, nx + first, ny + first, nz + first, int(n), rgb + 3u * first);
+  });
+}
+
+void evaluateIrradiance( const float shCoeff[3][9], const float *nx, const float *ny, 
+                         const float *nz, const size_t count, float *rgb)
+{
+  glm::mat4 M[3];
+  setIrradianceMatrices( shCoeff, M);
+  evaluateIrradiance( M, nx, ny, nz, count, rgb, getThreadPool());
+}
+
 #undef IEM_TEST
 
 #undef Y0
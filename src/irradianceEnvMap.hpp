@@ -18,13 +18,110 @@
 #define IRRADIANCEENVMAP_HPP
 
 #include <glm/glm.hpp>
-#include <tools/ImageLoader.hpp>
+#include <tools/ImageView.hpp>
+#include "irradianceKernels.hpp"
+
+class ThreadPool;
 
 namespace IrradianceEnvMap
 {
   
+  /** Projection methods of prefilter */
+  enum PrefilterMethod
+  {
+    PREFILTER_DIRECT,         // texel by texel, with the kernel of setKernel
+    PREFILTER_WEIGHT_TABLE,   // product by the cached weights of the resolution
+    PREFILTER_FIXED_POINT     // as PREFILTER_WEIGHT_TABLE, with the exact integer
+                              // weights of WeightTable for 8-bit cubemaps
+  };
+  
+  /** Compute the irradiance matrices of a cubemap using the shared thread pool */
   void prefilter( const Image_t envmap[6], glm::mat4 M[3]);
   
+  /** Compute the irradiance matrices of a cubemap using a specific thread pool.
+   *  The result does not depend on the number of threads used. */
+  void prefilter( const Image_t envmap[6], glm::mat4 M[3], ThreadPool &pool);
+  
+  /** Compute the irradiance matrices of a cubemap whose faces are views, 
+   *  eg. of a cross (cf. getCubemapFaces), without copying them */
+  void prefilter( const ImageView_t envmap[6], glm::mat4 M[3], ThreadPool &pool);
+  
+  /** Throughput of a prefilterBatch call */
+  struct BatchStats_t
+  {
+    size_t numCubemaps;
+    double numTexels;           // texels of all the faces
+    double time;                // in milliseconds
+    double texelsPerSecond;
+    double cubemapsPerSecond;
+  };
+  
+  /** Compute the irradiance matrices of 'count' cubemaps, as prefilterBatch */
+  void prefilter( const Image_t *const envmaps[], const size_t count, glm::mat4 (*M)[3],
+                  ThreadPool &pool);
+  
+  /** Compute the irradiance matrices of 'count' cubemaps of any resolutions
+   *  and formats. The tasks of all the cubemaps are run by a single pass on
+   *  the pool, the costliest first, so that the threads stay busy until its 
+   *  end. Cubemaps of the same resolution and format are projected together
+   *  by the weight table. The results are the ones of prefilter, and the 
+   *  throughput is returned in stats (if not null). */
+  void prefilterBatch( const Image_t *const envmaps[], const size_t count, glm::mat4 (*M)[3],
+                       ThreadPool &pool, BatchStats_t *stats=0);
+  
+  /** Project the rows [firstRow, lastRow) of the face faceId of a cubemap
+   *  as the direct path of prefilter, with the kernel of setKernel. The 
+   *  unnormalized SH sums (8-bit colors mapped to [0, 1]) are set in shCoeff
+   *  and the solid angles in sumWeight : the coefficients of a cubemap are 
+   *  the sums of all its rows times 2pi / sumWeight. */
+  void projectFaceRows( const ImageView_t &face, const int faceId, const int firstRow, 
+                        const int lastRow, float shCoeff[3][9], float *sumWeight);
+  
+  /** Set the irradiance matrices from the 2nd order SH coefficients of a 
+   *  cubemap, normalized as by prefilter */
+  void setIrradianceMatrices( const float shCoeff[3][9], glm::mat4 M[3]);
+  
+  /** Get back the SH coefficients of irradiance matrices (inverse of
+   *  setIrradianceMatrices) */
+  void getSHCoefficients( const glm::mat4 M[3], float shCoeff[3][9]);
+  
+  /** Get the polynomial form of irradiance matrices on normalized normals, 
+   *  as used by EvaluateIrradianceFn */
+  void getIrradiancePolynomial( const glm::mat4 M[3], float poly[3][9]);
+  
+  /** Evaluate the irradiance of M on 'count' normalized normals given as 
+   *  arrays of coordinates, as computeIrradiance of EnvMapping.glsl, with 
+   *  the kernel of setKernel. The RGB results are interleaved in 
+   *  rgb[3 * count]. Large counts are split in tasks on the pool. */
+  void evaluateIrradiance( const glm::mat4 M[3], const float *nx, const float *ny, 
+                           const float *nz, const size_t count, float *rgb, 
+                           ThreadPool &pool);
+  
+  /** Same, from the 2nd order SH coefficients of a cubemap (as normalized 
+   *  by prefilter), using the shared thread pool */
+  void evaluateIrradiance( const float shCoeff[3][9], const float *nx, const float *ny, 
+                           const float *nz, const size_t count, float *rgb);
+  
+  /** Select the projection method of prefilter (PREFILTER_WEIGHT_TABLE by
+   *  default, odd resolutions always use PREFILTER_DIRECT). 
+   *  PREFILTER_FIXED_POINT gives results identical whatever the kernel, the
+   *  batch or the threads, within WeightTable::getFixedErrorBound of the 
+   *  weight table ones. Other pixel formats use PREFILTER_WEIGHT_TABLE. */
+  void setPrefilterMethod( PrefilterMethod method );
+  
+  /** Return the projection method of prefilter */
+  PrefilterMethod getPrefilterMethod();
+  
+  /** Return the thread pool shared by the prefiltering functions */
+  ThreadPool& getThreadPool();
+  
+  /** Select the projection kernel used by prefilter (the best one supported 
+   *  by default). KERNEL_SCALAR is the per-texel reference path. */
+  void setKernel( SIMDKernel kernel );
+  
+  /** Return the projection kernel used by prefilter */
+  SIMDKernel getKernel();
+  
 } //namespace IrradianceEnvMap
 
 
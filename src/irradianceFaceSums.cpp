@@ -0,0 +1,199 @@
+/**
+ *
+ *      \file irradianceFaceSums.cpp
+ *
+ */
+
+
+#include "irradianceFaceSums.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <tools/ThreadPool.hpp>
+#include <tools/Timer.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradiancePixelFormat.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Word by word : it only has to tell an edited tile from the previous one,
+/// at a fraction of the cost of its projection
+uint64_t hashBytes( const unsigned char *bytes, const size_t size)
+{
+  const uint64_t kMul = 0x9e3779b97f4a7c15ull;
+  uint64_t h = size * kMul;
+
+  size_t i = 0u;
+  for (; i+8u <= size; i+=8u)
+  {
+    uint64_t w;
+    memcpy( &w, bytes + i, 8u);
+    h = (h ^ w) * kMul;
+    h ^= h >> 32;
+  }
+
+  for (; i<size; ++i) {
+    h = (h ^ bytes[i]) * kMul;
+  }
+
+  return h ^ (h >> 29);
+}
+
+
+CubemapSums::CubemapSums()
+  : m_resolution(0),
+    m_format(NUM_PIXEL_FORMAT),
+    m_tilesPerFace(0),
+    m_sumWeight(0.0)
+{
+  memset( m_shCoeff, 0, sizeof(m_shCoeff));
+}
+
+bool CubemapSums::init( const Image_t envmap[6], ThreadPool &pool)
+{
+  m_tiles.clear();
+  memset( m_shCoeff, 0, sizeof(m_shCoeff));
+  m_sumWeight = 0.0;
+
+  const PixelFormat format = getPixelFormat( envmap[0] );
+  if (NUM_PIXEL_FORMAT == format)
+  {
+    fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+    return false;
+  }
+
+  m_resolution = envmap[0].width;
+  m_format = format;
+  m_tilesPerFace = (m_resolution + TILE_ROWS - 1) / TILE_ROWS;
+
+  std::vector<Tile_t> tiles( 6u * m_tilesPerFace );
+  std::vector<char> changed;
+
+  for (int i=0; i<6; ++i) {
+    _projectFace( i, envmap[i], 0, &tiles[i * m_tilesPerFace], changed, pool);
+  }
+
+  /// Fixed order reduction
+  for (const Tile_t &tile : tiles)
+  {
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<9; ++k) {
+        m_shCoeff[c][k] += tile.shCoeff[c][k];
+      }
+    }
+    m_sumWeight += tile.sumWeight;
+  }
+
+  m_tiles.swap( tiles );
+  return true;
+}
+
+bool CubemapSums::updateFace( const int faceId, const Image_t &face, ThreadPool &pool,
+                              FaceUpdateStats_t *stats)
+{
+  assert( (faceId >= 0) && (faceId < 6) );
+
+  Timer &timer = Timer::getInstance();
+  const double tStart = timer.getAbsoluteTime();
+
+  if (!isValid() || (face.width != m_resolution) || (face.height != m_resolution) ||
+      (getPixelFormat( face ) != m_format))
+  {
+    fprintf( stderr, "IrradianceEnvMap : face %d does not match its cubemap.\n", faceId);
+    return false;
+  }
+
+  Tile_t *oldTiles = &m_tiles[faceId * m_tilesPerFace];
+  std::vector<Tile_t> tiles( m_tilesPerFace );
+  std::vector<char> changed;
+
+  _projectFace( faceId, face, oldTiles, &tiles[0], changed, pool);
+
+  /// Swap the contribution of the changed tiles, in tile order
+  int numChangedTiles = 0;
+  for (int t=0; t<m_tilesPerFace; ++t)
+  {
+    if (!changed[t]) {
+      continue;
+    }
+
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<9; ++k) {
+        m_shCoeff[c][k] += tiles[t].shCoeff[c][k] - oldTiles[t].shCoeff[c][k];
+      }
+    }
+    m_sumWeight += tiles[t].sumWeight - oldTiles[t].sumWeight;
+
+    oldTiles[t] = tiles[t];
+    ++numChangedTiles;
+  }
+
+  if (stats)
+  {
+    stats->numTiles = m_tilesPerFace;
+    stats->numChangedTiles = numChangedTiles;
+    stats->time = timer.getAbsoluteTime() - tStart;
+  }
+
+  return true;
+}
+
+void CubemapSums::getIrradianceMatrices( glm::mat4 M[3] ) const
+{
+  float shCoeff[3][9] = {};
+
+  if (m_sumWeight > 0.0)
+  {
+    const double dnorm = 2.0 * M_PI / m_sumWeight;
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<9; ++k) {
+        shCoeff[c][k] = float(dnorm * m_shCoeff[c][k]);
+      }
+    }
+  }
+
+  setIrradianceMatrices( shCoeff, M);
+}
+
+void CubemapSums::_projectFace( const int faceId, const Image_t &face, const Tile_t *oldTiles,
+                                Tile_t tiles[], std::vector<char> &changed,
+                                ThreadPool &pool) const
+{
+  const size_t rowSize = size_t(face.bytesPerPixel) * face.width;
+
+  changed.assign( m_tilesPerFace, 1 );
+
+  pool.parallelFor( m_tilesPerFace, [&](size_t t)
+  {
+    const int firstRow = int(t) * TILE_ROWS;
+    const int lastRow = std::min( firstRow + TILE_ROWS, m_resolution);
+
+    Tile_t &tile = tiles[t];
+    tile.hash = hashBytes( face.data + firstRow * rowSize, (lastRow - firstRow) * rowSize);
+
+    if (oldTiles && (oldTiles[t].hash == tile.hash))
+    {
+      changed[t] = 0;
+      return;
+    }
+
+    float shCoeff[3][9], sumWeight;
+    projectFaceRows( face, faceId, firstRow, lastRow, shCoeff, &sumWeight);
+
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<9; ++k) {
+        tile.shCoeff[c][k] = shCoeff[c][k];
+      }
+    }
+    tile.sumWeight = sumWeight;
+  });
+}
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,98 @@
+/**
+ *
+ *      \file irradianceFaceSums.hpp
+ *
+ *      Partial SH sums of a cubemap kept per face and per tile (bands of
+ *      rows), so that the irradiance of a cubemap whose faces are edited
+ *      is updated without projecting the unchanged texels again.
+ *
+ *      A new face is hashed tile by tile, and only the tiles whose texels
+ *      changed are projected : their old sums are subtracted from the
+ *      running total and the new ones added. The total is kept in double,
+ *      so that successive updates do not drift from a full projection.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEFACESUMS_HPP
+#define IRRADIANCEFACESUMS_HPP
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <tools/ImageLoader.hpp>
+
+class ThreadPool;
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Result of CubemapSums::updateFace */
+  struct FaceUpdateStats_t
+  {
+    int numTiles;               // tiles of the face
+    int numChangedTiles;        // tiles projected again
+    double time;                // in milliseconds
+  };
+
+  /** 64-bit hash of 'size' bytes (not a cryptographic one) */
+  uint64_t hashBytes( const unsigned char *bytes, const size_t size);
+
+  /** Per face & per tile SH sums of a cubemap */
+  class CubemapSums
+  {
+    public:
+      /** Rows of a tile, as the bands of prefilter */
+      static const int TILE_ROWS = 16;
+
+    protected:
+      struct Tile_t
+      {
+        double shCoeff[3][9];
+        double sumWeight;
+        uint64_t hash;          // of the tile texels
+      };
+
+      int m_resolution;
+      int m_format;
+      int m_tilesPerFace;
+      std::vector<Tile_t> m_tiles;    // tiles of the face i at [i * m_tilesPerFace]
+
+      double m_shCoeff[3][9];
+      double m_sumWeight;
+
+
+    public:
+      CubemapSums();
+
+      /** Project all the tiles of a cubemap. Return false (and stay empty)
+       *  when its pixel format is not supported. */
+      bool init( const Image_t envmap[6], ThreadPool &pool);
+
+      /** Replace the face faceId, projecting only its changed tiles. Return
+       *  false when the face does not match the resolution & pixel format of
+       *  the cubemap, the sums being left unchanged. */
+      bool updateFace( const int faceId, const Image_t &face, ThreadPool &pool,
+                       FaceUpdateStats_t *stats=0);
+
+      /** Return true once initialized */
+      bool isValid() const { return !m_tiles.empty(); }
+
+      /** Irradiance matrices of the current faces, as prefilter */
+      void getIrradianceMatrices( glm::mat4 M[3] ) const;
+
+
+    protected:
+      /** Hash the tiles of a face to tiles, projecting the ones whose hash
+       *  differs from oldTiles (all of them when it is null) */
+      void _projectFace( const int faceId, const Image_t &face, const Tile_t *oldTiles,
+                         Tile_t tiles[], std::vector<char> &changed, ThreadPool &pool) const;
+  };
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEFACESUMS_HPP
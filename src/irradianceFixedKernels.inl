@@ -0,0 +1,92 @@
+/**
+ *
+ *      \file irradianceFixedKernels.inl
+ *
+ *      Body of the fixed point folding kernel, included once per instruction
+ *      set by irradianceKernels.cpp. The including namespace must define :
+ *
+ *        vint, SIMD_WIDTH16 (number of 16-bit lanes), vzeroi, vloadu8i
+ *        (unsigned bytes to 16-bit lanes), vloadw (16-bit weights, the lanes
+ *        past FOLD_TILE_SIZE being read from the next row), vadd16, vsub16,
+ *        vmadd16 (products of 16-bit lanes summed by pairs to 32-bit lanes),
+ *        vadd32 and vhsum32 (horizontal sum of 32-bit lanes to 64 bits).
+ *
+ *      The 8 texels of an entry fold to sums of magnitude up to 8 * 255 = 2040
+ *      (1020 for the sums of 4 of them) and the weights are below 2^15, so a
+ *      vector adds less than 2 * 2040 * 2^15 < 2^27 to a 32-bit lane, which 
+ *      can take 16 of them before being added to the 64-bit moments.
+ *
+ */
+
+
+static
+void foldTileFixed( const unsigned char *unswapped, const unsigned char *swapped,
+                    const int16_t *weights, int64_t moments[9])
+{
+  const int quadrantSize = FOLD_TILE_SIZE * FOLD_TILE_SIZE;
+  const int rowStride = 9 * FOLD_TILE_SIZE;
+
+  // Rows accumulated on 32 bits, 16 vectors per lane at most
+  const int rowsPerFlush = (SIMD_WIDTH16 < FOLD_TILE_SIZE) ? SIMD_WIDTH16 : FOLD_TILE_SIZE;
+
+  for (int firstRow=0; firstRow<FOLD_TILE_SIZE; firstRow+=rowsPerFlush)
+  {
+    vint acc[9];
+    for (int k=0; k<9; ++k) {
+      acc[k] = vzeroi();
+    }
+
+    const int begin = firstRow * FOLD_TILE_SIZE;
+    const int end = begin + rowsPerFlush * FOLD_TILE_SIZE;
+
+    for (int p=begin; p<end; p+=SIMD_WIDTH16)
+    {
+      const unsigned char *u = unswapped + p;
+      const unsigned char *s = swapped + p;
+      const int16_t *w = weights + (p / FOLD_TILE_SIZE) * rowStride + (p % FOLD_TILE_SIZE);
+
+      const vint u0 = vloadu8i( u ), u1 = vloadu8i( u + quadrantSize );
+      const vint u2 = vloadu8i( u + 2*quadrantSize ), u3 = vloadu8i( u + 3*quadrantSize );
+      const vint s0 = vloadu8i( s ), s1 = vloadu8i( s + quadrantSize );
+      const vint s2 = vloadu8i( s + 2*quadrantSize ), s3 = vloadu8i( s + 3*quadrantSize );
+
+      const vint up = vadd16( u0, u1), um = vsub16( u0, u1);
+      const vint dp = vadd16( u2, u3), dm = vsub16( u2, u3);
+      const vint Su  = vadd16( up, dp);
+      const vint Xu  = vadd16( um, dm);
+      const vint Yu  = vsub16( up, dp);
+      const vint XYu = vsub16( um, dm);
+
+      const vint sup = vadd16( s0, s1), sum = vsub16( s0, s1);
+      const vint sdp = vadd16( s2, s3), sdm = vsub16( s2, s3);
+      const vint Ss  = vadd16( sup, sdp);
+      const vint Xs  = vadd16( sum, sdm);
+      const vint Ys  = vsub16( sup, sdp);
+      const vint XYs = vsub16( sum, sdm);
+
+      const vint S = vadd16( Su, Ss);
+
+      const vint w1 = vloadw( w + 1*FOLD_TILE_SIZE, rowStride );
+      const vint w2 = vloadw( w + 2*FOLD_TILE_SIZE, rowStride );
+      const vint w5 = vloadw( w + 5*FOLD_TILE_SIZE, rowStride );
+      const vint w6 = vloadw( w + 6*FOLD_TILE_SIZE, rowStride );
+      const vint w7 = vloadw( w + 7*FOLD_TILE_SIZE, rowStride );
+      const vint w8 = vloadw( w + 8*FOLD_TILE_SIZE, rowStride );
+
+      acc[0] = vadd32( acc[0], vmadd16( vloadw( w + 0*FOLD_TILE_SIZE, rowStride ), S));
+      acc[1] = vadd32( acc[1], vadd32( vmadd16( w1, Xu), vmadd16( w2, Xs)));
+      acc[2] = vadd32( acc[2], vadd32( vmadd16( w2, Yu), vmadd16( w1, Ys)));
+      acc[3] = vadd32( acc[3], vmadd16( vloadw( w + 3*FOLD_TILE_SIZE, rowStride ), S));
+      acc[4] = vadd32( acc[4], vmadd16( vloadw( w + 4*FOLD_TILE_SIZE, rowStride ),
+                                        vadd16( XYu, XYs)));
+      acc[5] = vadd32( acc[5], vadd32( vmadd16( w5, Yu), vmadd16( w6, Ys)));
+      acc[6] = vadd32( acc[6], vadd32( vmadd16( w6, Xu), vmadd16( w5, Xs)));
+      acc[7] = vadd32( acc[7], vadd32( vmadd16( w7, Su), vmadd16( w8, Ss)));
+      acc[8] = vadd32( acc[8], vadd32( vmadd16( w8, Su), vmadd16( w7, Ss)));
+    }
+
+    for (int k=0; k<9; ++k) {
+      moments[k] += vhsum32( acc[k] );
+    }
+  }
+}
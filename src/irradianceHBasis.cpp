@@ -0,0 +1,243 @@
+/**
+ *
+ *      \file irradianceHBasis.cpp
+ *
+ */
+
+
+#include "irradianceHBasis.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "irradianceEnvMap.hpp"
+#include "irradianceSH.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Largest H-basis supported
+static const int HBASIS_MAX_COEFFS = 6;
+
+
+namespace {
+
+/// Term w x^a y^b z^c of a polynomial
+struct Monomial_t
+{
+  double w;
+  int a, b, c;
+};
+
+/// Projections of the terms of getIrradiancePolynomial on the normalized
+/// H-basis functions, for each hemisphere
+struct HBasisTable_t
+{
+  double T[2][HBASIS_MAX_COEFFS][9];
+};
+
+} //namespace
+
+
+/// Normalization of the H-basis functions
+static const double HBASIS_NORM[HBASIS_MAX_COEFFS] =
+{
+  1.0 / sqrt( 2.0 * M_PI ),
+  sqrt( 3.0 / (2.0 * M_PI) ),
+  sqrt( 3.0 / (2.0 * M_PI) ),
+  sqrt( 3.0 / (2.0 * M_PI) ),
+  sqrt( 15.0 / (2.0 * M_PI) ),
+  sqrt( 15.0 / (8.0 * M_PI) )
+};
+
+/// Integral of x^a y^b z^c over the hemisphere y >= 0
+static
+double getHemisphereMoment( const int a, const int b, const int c)
+{
+  if ((a & 1) || (c & 1)) {
+    return 0.0;
+  }
+
+  // x = s cos(phi), z = s sin(phi), y = t with s = sqrt(1 - t^2)
+  const double phi = 2.0 * M_PI * SHConstants::doubleFactorial( a - 1 )
+                                * SHConstants::doubleFactorial( c - 1 )
+                                / SHConstants::doubleFactorial( a + c );
+
+  // Integral of t^b (1 - t^2)^m on [0, 1]
+  const int m = (a + c) / 2;
+  double binomial = 1.0;
+  double sum = 0.0;
+
+  for (int i=0; i<=m; ++i)
+  {
+    sum += ((i & 1) ? -binomial : binomial) / (b + 2*i + 1);
+    binomial = binomial * (m - i) / (i + 1);
+  }
+
+  return phi * sum;
+}
+
+/// Terms of the H-basis functions (without normalization), t being y
+static
+void getHBasisTerms( const int k, std::vector<Monomial_t> &terms)
+{
+  switch (k)
+  {
+    case 0: terms = { {1.0, 0, 0, 0} };                   break;
+    case 1: terms = { {1.0, 0, 0, 1} };                   break;
+    case 2: terms = { {2.0, 0, 1, 0}, {-1.0, 0, 0, 0} };  break;
+    case 3: terms = { {1.0, 1, 0, 0} };                   break;
+    case 4: terms = { {1.0, 1, 0, 1} };                   break;
+    case 5: terms = { {1.0, 2, 0, 0}, {-1.0, 0, 0, 2} };  break;
+    default: terms.clear();
+  }
+}
+
+/// Terms 1, y, z, x, xy, yz, z^2, xz, x^2 - y^2 of getIrradiancePolynomial
+static
+void getPolynomialTerms( const int i, std::vector<Monomial_t> &terms)
+{
+  switch (i)
+  {
+    case 0: terms = { {1.0, 0, 0, 0} };                   break;
+    case 1: terms = { {1.0, 0, 1, 0} };                   break;
+    case 2: terms = { {1.0, 0, 0, 1} };                   break;
+    case 3: terms = { {1.0, 1, 0, 0} };                   break;
+    case 4: terms = { {1.0, 1, 1, 0} };                   break;
+    case 5: terms = { {1.0, 0, 1, 1} };                   break;
+    case 6: terms = { {1.0, 0, 0, 2} };                   break;
+    case 7: terms = { {1.0, 1, 0, 1} };                   break;
+    case 8: terms = { {1.0, 2, 0, 0}, {-1.0, 0, 2, 0} };  break;
+    default: terms.clear();
+  }
+}
+
+/// Table of the projections, built on first use. The lower hemisphere is
+/// integrated as the upper one, the polynomial being mirrored in y.
+static
+const HBasisTable_t& getHBasisTable()
+{
+  static const HBasisTable_t sTable = []()
+  {
+    HBasisTable_t table;
+    std::vector<Monomial_t> hTerms, pTerms;
+
+    for (int k=0; k<HBASIS_MAX_COEFFS; ++k)
+    {
+      getHBasisTerms( k, hTerms);
+
+      for (int i=0; i<9; ++i)
+      {
+        getPolynomialTerms( i, pTerms);
+
+        double upper = 0.0, lower = 0.0;
+        for (const Monomial_t &h : hTerms) {
+          for (const Monomial_t &p : pTerms)
+          {
+            const double m = h.w * p.w * getHemisphereMoment( h.a + p.a, h.b + p.b, h.c + p.c);
+            upper += m;
+            lower += (p.b & 1) ? -m : m;
+          }
+        }
+
+        table.T[0][k][i] = HBASIS_NORM[k] * upper;
+        table.T[1][k][i] = HBASIS_NORM[k] * lower;
+      }
+    }
+
+    return table;
+  }();
+
+  return sTable;
+}
+
+/// Unnormalized H-basis functions at n
+template<int NumCoeffs>
+static inline
+void evaluateHBasisTerms( const glm::vec3 &n, float H[NumCoeffs])
+{
+  const float t = fabsf( n.y );
+
+  H[0] = 1.0f;
+  H[1] = n.z;
+  H[2] = 2.0f * t - 1.0f;
+  H[3] = n.x;
+
+  if (NumCoeffs > 4)
+  {
+    H[4] = n.x * n.z;
+    H[5] = n.x * n.x - n.z * n.z;
+  }
+}
+
+
+template<int NumCoeffs>
+void getHBasisIrradiance( const glm::mat4 M[3], HBasis_t<NumCoeffs> &h)
+{
+  static_assert( (4 == NumCoeffs) || (6 == NumCoeffs), "H4 or H6 basis only" );
+
+  const HBasisTable_t &table = getHBasisTable();
+
+  float poly[3][9];
+  getIrradiancePolynomial( M, poly);
+
+  for (int hemi=0; hemi<2; ++hemi) {
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<NumCoeffs; ++k)
+      {
+        double sum = 0.0;
+        for (int i=0; i<9; ++i) {
+          sum += table.T[hemi][k][i] * poly[c][i];
+        }
+        h.coeffs[hemi][c][k] = float(sum);
+      }
+    }
+  }
+}
+
+template<int NumCoeffs>
+glm::vec3 evaluate( const HBasis_t<NumCoeffs> &h, const glm::vec3 &n)
+{
+  const int hemi = (n.y >= 0.0f) ? 0 : 1;
+
+  float H[NumCoeffs];
+  evaluateHBasisTerms<NumCoeffs>( n, H);
+
+  glm::vec3 color( 0.0f );
+  for (int k=0; k<NumCoeffs; ++k)
+  {
+    const float w = float(HBASIS_NORM[k]) * H[k];
+    color.r += h.coeffs[hemi][0][k] * w;
+    color.g += h.coeffs[hemi][1][k] * w;
+    color.b += h.coeffs[hemi][2][k] * w;
+  }
+
+  return color;
+}
+
+template<int NumCoeffs>
+void getShaderCoefficients( const HBasis_t<NumCoeffs> &h, glm::vec3 out[2 * NumCoeffs])
+{
+  for (int hemi=0; hemi<2; ++hemi) {
+    for (int k=0; k<NumCoeffs; ++k)
+    {
+      const float K = float(HBASIS_NORM[k]);
+      out[hemi * NumCoeffs + k] = K * glm::vec3( h.coeffs[hemi][0][k],
+                                                 h.coeffs[hemi][1][k],
+                                                 h.coeffs[hemi][2][k]);
+    }
+  }
+}
+
+
+#define IEM_INSTANTIATE_HBASIS(NumCoeffs)                                                   \
+  template void getHBasisIrradiance<NumCoeffs>( const glm::mat4[3], HBasis_t<NumCoeffs>& ); \
+  template glm::vec3 evaluate<NumCoeffs>( const HBasis_t<NumCoeffs>&, const glm::vec3&);    \
+  template void getShaderCoefficients<NumCoeffs>( const HBasis_t<NumCoeffs>&, glm::vec3[]);
+
+IEM_INSTANTIATE_HBASIS(4)
+IEM_INSTANTIATE_HBASIS(6)
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,72 @@
+/**
+ *
+ *      \file irradianceHBasis.hpp
+ *
+ *      Irradiance in the H-basis, orthonormal on the hemisphere (P. Habel &
+ *      M. Wimmer, "Efficient Irradiance Normal Mapping", I3D 2010).
+ *
+ *      The irradiance of each hemisphere around the Y axis (up in the
+ *      cubemaps) is projected on its own basis, so that a normal needs the
+ *      4 (H4) or 6 (H6) coefficients of its hemisphere only, instead of the
+ *      9 of the matrices. With t = |n.y| :
+ *
+ *        H1 = 1 / sqrt(2pi)
+ *        H2 = sqrt(3 / 2pi) z
+ *        H3 = sqrt(3 / 2pi) (2t - 1)
+ *        H4 = sqrt(3 / 2pi) x
+ *        H5 = sqrt(15 / 2pi) xz
+ *        H6 = sqrt(15 / 8pi) (x^2 - z^2)
+ *
+ *      The coefficients are the exact projections of the polynomial of the
+ *      irradiance matrices (cf. getIrradiancePolynomial), by a table built
+ *      from the moments of the hemisphere. They are thus as cheap to get as
+ *      the rotated matrices, and the two hemispheres meet with a seam of
+ *      the order of the approximation error.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEHBASIS_HPP
+#define IRRADIANCEHBASIS_HPP
+
+#include <glm/glm.hpp>
+
+/// Size of the H-basis used by the renderer, 4 or 6
+/// (when compiled with -DENABLE_IEM_HBASIS=1)
+#ifndef IEM_HBASIS_SIZE
+#define IEM_HBASIS_SIZE  4
+#endif
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Irradiance coefficients in the H-basis of NumCoeffs functions (4 or 6),
+   *  of the hemisphere y >= 0 (0) and of the hemisphere y < 0 (1) */
+  template<int NumCoeffs>
+  struct HBasis_t
+  {
+    enum { NUM_COEFFS = NumCoeffs };
+    float coeffs[2][3][NumCoeffs];
+  };
+
+  /** Project irradiance matrices on the H-basis of each hemisphere */
+  template<int NumCoeffs>
+  void getHBasisIrradiance( const glm::mat4 M[3], HBasis_t<NumCoeffs> &h);
+
+  /** Evaluate H-basis coefficients on the normalized direction n */
+  template<int NumCoeffs>
+  glm::vec3 evaluate( const HBasis_t<NumCoeffs> &h, const glm::vec3 &n);
+
+  /** Fold the basis normalization in H-basis coefficients, for the
+   *  uHBasisIrradiance uniform of EnvMapping.Vertex.HBasis (the upper
+   *  hemisphere first) */
+  template<int NumCoeffs>
+  void getShaderCoefficients( const HBasis_t<NumCoeffs> &h, glm::vec3 out[2 * NumCoeffs]);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEHBASIS_HPP
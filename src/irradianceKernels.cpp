@@ -0,0 +1,564 @@
+/**
+ * 
+ *      \file irradianceKernels.cpp
+ * 
+ *      Error bounds of the vectorized kernels, relative to the scalar 
+ *      reference path of prefilter :
+ *      
+ *       # The reciprocal square root comes from rsqrtps (|rel. error| < 1.5*2^-12)
+ *         or vrsqrt14ps (< 2^-14) refined by one Newton-Raphson step, giving
+ *         a relative error below 2^-21 on the directions and below 3*2^-21 
+ *         on the solid angles.
+ *      
+ *       # The solid angle uses the differential form texelArea / |d|^3 instead
+ *         of the difference of four atan2 terms. The later subtracts values
+ *         of order 1 to get a result of order 1/texRes^2 and loses most of
+ *         its float precision on large faces. The differential form differs 
+ *         from the exact texel solid angle by less than 1.5/texRes^2 
+ *         (relative), and the error is mostly absorbed by the normalization 
+ *         by the total weight.
+ *      
+ *      In practice the irradiance matrices match the reference within 1e-4 of
+ *      their largest coefficient from 64^2 faces (2e-5 on 2048^2 faces, the
+ *      difference coming mostly from the float summation order), and within
+ *      0.1/texRes^2 below.
+ * 
+ */
+ 
+
+#include "irradianceKernels.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define IEM_X86_SIMD  1
+  #include <immintrin.h>
+#else
+  #define IEM_X86_SIMD  0
+#endif
+
+
+namespace IrradianceEnvMap {
+
+
+const float FACE_FRAMES[6][3][3] =
+{
+  { { +1.0f,  0.0f,  0.0f }, {  0.0f,  0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f } },
+  { { -1.0f,  0.0f,  0.0f }, {  0.0f,  0.0f, +1.0f }, { 0.0f, -1.0f,  0.0f } },
+  { {  0.0f, +1.0f,  0.0f }, { +1.0f,  0.0f,  0.0f }, { 0.0f,  0.0f, +1.0f } },
+  { {  0.0f, -1.0f,  0.0f }, { +1.0f,  0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f } },
+  { {  0.0f,  0.0f, +1.0f }, { +1.0f,  0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } },
+  { {  0.0f,  0.0f, -1.0f }, { -1.0f,  0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } }
+};
+
+
+/** Scalar ------------------------------------------------------------------ */
+
+namespace scalar {
+
+typedef float vfloat;
+enum { SIMD_WIDTH = 1 };
+
+static inline vfloat vset1(float a)                     { return a; }
+static inline vfloat vload(const float *p)              { return *p; }
+static inline void   vstore(float *p, vfloat a)         { *p = a; }
+static inline vfloat vloadu8(const unsigned char *p)    { return float(*p); }
+static inline vfloat vadd(vfloat a, vfloat b)           { return a + b; }
+static inline vfloat vsub(vfloat a, vfloat b)           { return a - b; }
+static inline vfloat vmul(vfloat a, vfloat b)           { return a * b; }
+static inline vfloat vmax(vfloat a, vfloat b)           { return (a > b) ? a : b; }
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return a * b + c; }
+static inline vfloat vrsqrt(vfloat a)                   { return 1.0f / sqrtf(a); }
+static inline vfloat vramp()                            { return 0.0f; }
+static inline float  vhsum(vfloat a)                    { return a; }
+
+typedef int64_t vint;
+enum { SIMD_WIDTH16 = 1 };
+
+static inline vint    vzeroi()                                { return 0; }
+static inline vint    vloadu8i(const unsigned char *p)        { return *p; }
+static inline vint    vloadw(const int16_t *p, int)           { return *p; }
+static inline vint    vadd16(vint a, vint b)                  { return a + b; }
+static inline vint    vsub16(vint a, vint b)                  { return a - b; }
+static inline vint    vmadd16(vint a, vint b)                 { return a * b; }
+static inline vint    vadd32(vint a, vint b)                  { return a + b; }
+static inline int64_t vhsum32(vint a)                         { return a; }
+
+#include "irradianceKernels.inl"
+#include "irradianceFixedKernels.inl"
+
+} //namespace scalar
+
+
+#if IEM_X86_SIMD
+
+
+/** SSE4.1 ------------------------------------------------------------------ */
+
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+namespace sse41 {
+
+typedef __m128 vfloat;
+enum { SIMD_WIDTH = 4 };
+
+static inline vfloat vset1(float a)                     { return _mm_set1_ps(a); }
+static inline vfloat vload(const float *p)              { return _mm_loadu_ps(p); }
+static inline void   vstore(float *p, vfloat a)         { _mm_storeu_ps(p, a); }
+
+static inline vfloat vloadu8(const unsigned char *p)
+{
+  int bytes;
+  memcpy( &bytes, p, sizeof(bytes));
+  return _mm_cvtepi32_ps( _mm_cvtepu8_epi32( _mm_cvtsi32_si128(bytes) ));
+}
+
+static inline vfloat vadd(vfloat a, vfloat b)           { return _mm_add_ps(a, b); }
+static inline vfloat vsub(vfloat a, vfloat b)           { return _mm_sub_ps(a, b); }
+static inline vfloat vmul(vfloat a, vfloat b)           { return _mm_mul_ps(a, b); }
+static inline vfloat vmax(vfloat a, vfloat b)           { return _mm_max_ps(a, b); }
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+static inline vfloat vramp()                            { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+
+static inline vfloat vrsqrt(vfloat a)
+{
+  // One Newton-Raphson step : r' = 0.5 * r * (3 - a * r * r)
+  const vfloat r = _mm_rsqrt_ps(a);
+  const vfloat arr = _mm_mul_ps( _mm_mul_ps(a, r), r);
+  return _mm_mul_ps( _mm_mul_ps( _mm_set1_ps(0.5f), r), _mm_sub_ps( _mm_set1_ps(3.0f), arr));
+}
+
+static inline float vhsum(vfloat a)
+{
+  a = _mm_hadd_ps(a, a);
+  a = _mm_hadd_ps(a, a);
+  return _mm_cvtss_f32(a);
+}
+
+typedef __m128i vint;
+enum { SIMD_WIDTH16 = 8 };
+
+static inline vint vzeroi()                             { return _mm_setzero_si128(); }
+static inline vint vloadw(const int16_t *p, int)        { return _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) ); }
+static inline vint vadd16(vint a, vint b)               { return _mm_add_epi16(a, b); }
+static inline vint vsub16(vint a, vint b)               { return _mm_sub_epi16(a, b); }
+static inline vint vmadd16(vint a, vint b)              { return _mm_madd_epi16(a, b); }
+static inline vint vadd32(vint a, vint b)               { return _mm_add_epi32(a, b); }
+
+static inline vint vloadu8i(const unsigned char *p)
+{
+  return _mm_cvtepu8_epi16( _mm_loadl_epi64( reinterpret_cast<const __m128i*>(p) ));
+}
+
+static inline int64_t vhsum32(vint a)
+{
+  const __m128i s = _mm_add_epi64( _mm_cvtepi32_epi64(a), _mm_cvtepi32_epi64( _mm_srli_si128(a, 8) ));
+  int64_t lanes[2];
+  _mm_storeu_si128( reinterpret_cast<__m128i*>(lanes), s);
+  return lanes[0] + lanes[1];
+}
+
+#include "irradianceKernels.inl"
+#include "irradianceFixedKernels.inl"
+
+} //namespace sse41
+
+#pragma GCC pop_options
+
+
+/** AVX2 -------------------------------------------------------------------- */
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+
+namespace avx2 {
+
+typedef __m256 vfloat;
+enum { SIMD_WIDTH = 8 };
+
+static inline vfloat vset1(float a)                     { return _mm256_set1_ps(a); }
+static inline vfloat vload(const float *p)              { return _mm256_loadu_ps(p); }
+static inline void   vstore(float *p, vfloat a)         { _mm256_storeu_ps(p, a); }
+
+static inline vfloat vloadu8(const unsigned char *p)
+{
+  const __m128i bytes = _mm_loadl_epi64( reinterpret_cast<const __m128i*>(p) );
+  return _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32(bytes) );
+}
+
+static inline vfloat vadd(vfloat a, vfloat b)           { return _mm256_add_ps(a, b); }
+static inline vfloat vsub(vfloat a, vfloat b)           { return _mm256_sub_ps(a, b); }
+static inline vfloat vmul(vfloat a, vfloat b)           { return _mm256_mul_ps(a, b); }
+static inline vfloat vmax(vfloat a, vfloat b)           { return _mm256_max_ps(a, b); }
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a, b, c); }
+static inline vfloat vramp()  { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+
+static inline vfloat vrsqrt(vfloat a)
+{
+  const vfloat r = _mm256_rsqrt_ps(a);
+  const vfloat arr = _mm256_mul_ps( _mm256_mul_ps(a, r), r);
+  return _mm256_mul_ps( _mm256_mul_ps( _mm256_set1_ps(0.5f), r), 
+                        _mm256_sub_ps( _mm256_set1_ps(3.0f), arr));
+}
+
+static inline float vhsum(vfloat a)
+{
+  __m128 s = _mm_add_ps( _mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+  s = _mm_hadd_ps(s, s);
+  s = _mm_hadd_ps(s, s);
+  return _mm_cvtss_f32(s);
+}
+
+typedef __m256i vint;
+enum { SIMD_WIDTH16 = 16 };
+
+static inline vint vzeroi()                             { return _mm256_setzero_si256(); }
+static inline vint vloadw(const int16_t *p, int)        { return _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) ); }
+static inline vint vadd16(vint a, vint b)               { return _mm256_add_epi16(a, b); }
+static inline vint vsub16(vint a, vint b)               { return _mm256_sub_epi16(a, b); }
+static inline vint vmadd16(vint a, vint b)              { return _mm256_madd_epi16(a, b); }
+static inline vint vadd32(vint a, vint b)               { return _mm256_add_epi32(a, b); }
+
+static inline vint vloadu8i(const unsigned char *p)
+{
+  return _mm256_cvtepu8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) ));
+}
+
+static inline int64_t vhsum32(vint a)
+{
+  const __m256i s64 = _mm256_add_epi64( _mm256_cvtepi32_epi64( _mm256_castsi256_si128(a) ),
+                                        _mm256_cvtepi32_epi64( _mm256_extracti128_si256(a, 1) ));
+  const __m128i s = _mm_add_epi64( _mm256_castsi256_si128(s64), _mm256_extracti128_si256(s64, 1));
+  int64_t lanes[2];
+  _mm_storeu_si128( reinterpret_cast<__m128i*>(lanes), s);
+  return lanes[0] + lanes[1];
+}
+
+#include "irradianceKernels.inl"
+#include "irradianceFixedKernels.inl"
+
+} //namespace avx2
+
+#pragma GCC pop_options
+
+
+/** AVX-512 ----------------------------------------------------------------- */
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+namespace avx512 {
+
+typedef __m512 vfloat;
+enum { SIMD_WIDTH = 16 };
+
+static inline vfloat vset1(float a)                     { return _mm512_set1_ps(a); }
+static inline vfloat vload(const float *p)              { return _mm512_loadu_ps(p); }
+static inline void   vstore(float *p, vfloat a)         { _mm512_storeu_ps(p, a); }
+
+static inline vfloat vloadu8(const unsigned char *p)
+{
+  const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+  return _mm512_cvtepi32_ps( _mm512_cvtepu8_epi32(bytes) );
+}
+
+static inline vfloat vadd(vfloat a, vfloat b)           { return _mm512_add_ps(a, b); }
+static inline vfloat vsub(vfloat a, vfloat b)           { return _mm512_sub_ps(a, b); }
+static inline vfloat vmul(vfloat a, vfloat b)           { return _mm512_mul_ps(a, b); }
+static inline vfloat vmax(vfloat a, vfloat b)           { return _mm512_max_ps(a, b); }
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return _mm512_fmadd_ps(a, b, c); }
+static inline float  vhsum(vfloat a)                    { return _mm512_reduce_add_ps(a); }
+
+static inline vfloat vramp()
+{ 
+  return _mm512_setr_ps( 0.0f, 1.0f,  2.0f,  3.0f,  4.0f,  5.0f,  6.0f,  7.0f, 
+                         8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f); 
+}
+
+static inline vfloat vrsqrt(vfloat a)
+{
+  const vfloat r = _mm512_rsqrt14_ps(a);
+  const vfloat arr = _mm512_mul_ps( _mm512_mul_ps(a, r), r);
+  return _mm512_mul_ps( _mm512_mul_ps( _mm512_set1_ps(0.5f), r), 
+                        _mm512_sub_ps( _mm512_set1_ps(3.0f), arr));
+}
+
+#include "irradianceKernels.inl"
+
+} //namespace avx512
+
+#pragma GCC pop_options
+
+
+/** AVX-512 BW (fixed point kernel) ----------------------------------------- */
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+
+namespace avx512bw {
+
+typedef __m512i vint;
+enum { SIMD_WIDTH16 = 32 };
+
+static inline vint vzeroi()                             { return _mm512_setzero_si512(); }
+static inline vint vadd16(vint a, vint b)               { return _mm512_add_epi16(a, b); }
+static inline vint vsub16(vint a, vint b)               { return _mm512_sub_epi16(a, b); }
+static inline vint vmadd16(vint a, vint b)              { return _mm512_madd_epi16(a, b); }
+static inline vint vadd32(vint a, vint b)               { return _mm512_add_epi32(a, b); }
+
+static inline vint vloadu8i(const unsigned char *p)
+{
+  return _mm512_cvtepu8_epi16( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) ));
+}
+
+static inline vint vloadw(const int16_t *p, int rowStride)
+{
+  const __m256i lo = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) );
+  const __m256i hi = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p + rowStride) );
+  return _mm512_inserti64x4( _mm512_castsi256_si512(lo), hi, 1);
+}
+
+static inline int64_t vhsum32(vint a)
+{
+  return _mm512_reduce_add_epi64( _mm512_cvtepi32_epi64( _mm512_castsi512_si256(a) )) +
+         _mm512_reduce_add_epi64( _mm512_cvtepi32_epi64( _mm512_extracti64x4_epi64(a, 1) ));
+}
+
+#include "irradianceFixedKernels.inl"
+
+} //namespace avx512bw
+
+#pragma GCC pop_options
+
+
+#endif //IEM_X86_SIMD
+
+
+
+SIMDKernel getBestKernel()
+{
+  static const SIMDKernel sBest = []
+  {
+    for (int k=NUM_SIMD_KERNEL-1; k>KERNEL_SCALAR; --k) {
+      if (isKernelSupported( SIMDKernel(k) )) {
+        return SIMDKernel(k);
+      }
+    }
+    return KERNEL_SCALAR;
+  }();
+  
+  return sBest;
+}
+
+bool isKernelSupported( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  __builtin_cpu_init();
+  
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return __builtin_cpu_supports("sse4.1");
+    
+    case KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    
+    case KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512f");
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return KERNEL_SCALAR == kernel;
+}
+
+ProjectRowFn getProjectRow( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::projectRow;
+    
+    case KERNEL_AVX2:
+    return avx2::projectRow;
+    
+    case KERNEL_AVX512:
+    return avx512::projectRow;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::projectRow;
+}
+
+FoldTileFn getFoldTile( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::foldTile<unsigned char>;
+    
+    case KERNEL_AVX2:
+    return avx2::foldTile<unsigned char>;
+    
+    case KERNEL_AVX512:
+    return avx512::foldTile<unsigned char>;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::foldTile<unsigned char>;
+}
+
+FoldTileFloatFn getFoldTileFloat( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::foldTile<float>;
+    
+    case KERNEL_AVX2:
+    return avx2::foldTile<float>;
+    
+    case KERNEL_AVX512:
+    return avx512::foldTile<float>;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::foldTile<float>;
+}
+
+
+FoldTileFixedFn getFoldTileFixed( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::foldTileFixed;
+    
+    case KERNEL_AVX2:
+    return avx2::foldTileFixed;
+    
+    case KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512bw") ? avx512bw::foldTileFixed : 
+                                                avx2::foldTileFixed;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::foldTileFixed;
+}
+
+AccumulateRowFn getAccumulateRow( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::accumulateRow<unsigned char>;
+    
+    case KERNEL_AVX2:
+    return avx2::accumulateRow<unsigned char>;
+    
+    case KERNEL_AVX512:
+    return avx512::accumulateRow<unsigned char>;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::accumulateRow<unsigned char>;
+}
+
+AccumulateRowFloatFn getAccumulateRowFloat( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::accumulateRow<float>;
+    
+    case KERNEL_AVX2:
+    return avx2::accumulateRow<float>;
+    
+    case KERNEL_AVX512:
+    return avx512::accumulateRow<float>;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::accumulateRow<float>;
+}
+
+EvaluateIrradianceFn getEvaluateIrradiance( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::evaluateIrradiance;
+    
+    case KERNEL_AVX2:
+    return avx2::evaluateIrradiance;
+    
+    case KERNEL_AVX512:
+    return avx512::evaluateIrradiance;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::evaluateIrradiance;
+}
+
+ConvolveTileFn getConvolveTile( SIMDKernel kernel )
+{
+  #if IEM_X86_SIMD
+  switch (kernel)
+  {
+    case KERNEL_SSE41:
+    return sse41::convolveTile;
+    
+    case KERNEL_AVX2:
+    return avx2::convolveTile;
+    
+    case KERNEL_AVX512:
+    return avx512::convolveTile;
+    
+    default:
+    break;
+  }
+  #endif
+  
+  return scalar::convolveTile;
+}
+
+const char* getKernelName( SIMDKernel kernel )
+{
+  static const char* sNames[NUM_SIMD_KERNEL] = { "scalar", "SSE4.1", "AVX2", "AVX-512" };
+  return (kernel < NUM_SIMD_KERNEL) ? sNames[kernel] : "unknown";
+}
+
+
+} //namespace IrradianceEnvMap
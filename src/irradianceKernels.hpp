@@ -0,0 +1,143 @@
+/**
+ * 
+ *      \file irradianceKernels.hpp
+ * 
+ *      Vectorized kernels projecting rows of texels onto the 9 first
+ *      Spherical Harmonics basis functions, selected at runtime depending
+ *      on the CPU capabilities.
+ * 
+ *      The kernels work on a structure-of-arrays row (one array per color 
+ *      channel) and compute the texel directions & solid angles on the fly :
+ *      
+ *          d  = base + u * axisU
+ *          dw = texelArea / |d|^3
+ *      
+ *      which only needs one reciprocal square root per texel (see 
+ *      irradianceKernels.cpp for the error bounds).
+ *      
+ *      The folding kernels apply the precomputed weights of a WeightTable.
+ * 
+ */
+ 
+
+#pragma once
+
+#ifndef IRRADIANCEKERNELS_HPP
+#define IRRADIANCEKERNELS_HPP
+
+#include <stdint.h>
+
+
+namespace IrradianceEnvMap
+{
+  
+  /** Instruction sets of the projection kernels */
+  enum SIMDKernel
+  {
+    KERNEL_SCALAR,
+    KERNEL_SSE41,
+    KERNEL_AVX2,
+    KERNEL_AVX512,
+    
+    NUM_SIMD_KERNEL
+  };
+  
+  /** Spherical Harmonics constants (cf. the Y0..Y8 macros of irradianceEnvMap.cpp) */
+  const float SH_C0 = 0.282095f;
+  const float SH_C1 = 0.488603f;
+  const float SH_C2 = 1.092548f;
+  const float SH_C3 = 0.315392f;
+  const float SH_C4 = 0.546274f;
+  
+  /** Frame of each cubemap face {N, U, V}, such as the direction of the 
+   *  texel (u, v) in [-1, 1]^2 is N + u * U + v * V */
+  extern const float FACE_FRAMES[6][3][3];
+  
+  /** Add the projection of 'count' texels to shCoeff & sumWeight.
+   *  The texel j has the direction base + (u0 + j*du) * axisU. */
+  typedef void (*ProjectRowFn)( const float *red, const float *green, const float *blue, 
+                                const int count,
+                                const float base[3], const float axisU[3], 
+                                const float u0, const float du, const float texelArea,
+                                float shCoeff[3][9], float *sumWeight);
+  
+  /** Size of the octant tiles of the weight tables */
+  const int FOLD_TILE_SIZE = 16;
+  
+  /** Add to moments[0..8] the weighted sums of a tile of octant entries of
+   *  a color channel (cf. WeightTable).
+   *  The texels of the entry (i, j) are at [(k * FOLD_TILE_SIZE + i) * 
+   *  FOLD_TILE_SIZE + j] of the unswapped & swapped buffers, k being the 
+   *  quadrant {(+a,+b), (-a,+b), (+a,-b), (-a,-b)}, and its weight n is at
+   *  weights[(i * 9 + n) * FOLD_TILE_SIZE + j]. 
+   *  8-bit texels are folded in [0, 255]. */
+  typedef void (*FoldTileFn)( const unsigned char *unswapped, const unsigned char *swapped, 
+                              const float *weights, float moments[9]);
+  
+  typedef void (*FoldTileFloatFn)( const float *unswapped, const float *swapped, 
+                                   const float *weights, float moments[9]);
+  
+  /** Add to moments[0..8] the weighted sums of a tile of 8-bit texels with
+   *  the 16-bit fixed point weights of a WeightTable, as FoldTileFn. The 
+   *  integer sums are exact, so they do not depend on their order. */
+  typedef void (*FoldTileFixedFn)( const unsigned char *unswapped, const unsigned char *swapped,
+                                   const int16_t *weights, int64_t moments[9]);
+  
+  /** Add 'count' 8-bit or float values to acc (box reduction of the 
+   *  cubemaps, cf. irradianceMipmap.hpp) */
+  typedef void (*AccumulateRowFn)( const unsigned char *src, const int count, float *acc);
+  
+  typedef void (*AccumulateRowFloatFn)( const float *src, const int count, float *acc);
+  
+  /** Evaluate the irradiance polynomial of each channel on 'count' normals
+   *  given by their coordinates, the RGB results being interleaved in rgb.
+   *  The terms of poly[c] are (1, y, z, x, xy, yz, z^2, xz, x^2 - y^2), the 
+   *  polynomial form of the 9 first basis functions. */
+  typedef void (*EvaluateIrradianceFn)( const float poly[3][9], const float *nx, 
+                                        const float *ny, const float *nz, 
+                                        const int count, float *rgb);
+  
+  /** Set rgb to the cosine weighted sums max(n.d, 0) * L of a tile of 
+   *  'count' source texels, stored as count x, y, z normalized directions 
+   *  then count red, green, blue radiances (cf. irradianceReference.hpp) */
+  typedef void (*ConvolveTileFn)( const float *tile, const int count, const float n[3], 
+                                  float rgb[3]);
+  
+  /** Return the most efficient kernel supported by the CPU */
+  SIMDKernel getBestKernel();
+  
+  /** Return true if the kernel can run on this CPU */
+  bool isKernelSupported( SIMDKernel kernel );
+  
+  /** Return the row projection function of a supported kernel */
+  ProjectRowFn getProjectRow( SIMDKernel kernel );
+  
+  /** Return the octant folding function of a supported kernel */
+  FoldTileFn getFoldTile( SIMDKernel kernel );
+  
+  /** Return the octant folding function of float texels of a supported kernel */
+  FoldTileFloatFn getFoldTileFloat( SIMDKernel kernel );
+  
+  /** Return the fixed point folding function of a supported kernel (the 
+   *  AVX-512 one also needs AVX-512 BW, AVX2 being used otherwise) */
+  FoldTileFixedFn getFoldTileFixed( SIMDKernel kernel );
+  
+  /** Return the row accumulation function of a supported kernel */
+  AccumulateRowFn getAccumulateRow( SIMDKernel kernel );
+  
+  /** Return the row accumulation function of float values of a supported kernel */
+  AccumulateRowFloatFn getAccumulateRowFloat( SIMDKernel kernel );
+  
+  /** Return the irradiance evaluation function of a supported kernel */
+  EvaluateIrradianceFn getEvaluateIrradiance( SIMDKernel kernel );
+  
+  /** Return the cosine convolution function of a supported kernel */
+  ConvolveTileFn getConvolveTile( SIMDKernel kernel );
+  
+  /** Return a printable name for the kernel */
+  const char* getKernelName( SIMDKernel kernel );
+  
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEKERNELS_HPP
@@ -0,0 +1,333 @@
+/**
+ * 
+ *      \file irradianceKernels.inl
+ * 
+ *      Body of the row projection, folding and evaluation kernels, included 
+ *      once per instruction set by irradianceKernels.cpp. The including namespace must define :
+ *        
+ *        vfloat, SIMD_WIDTH, vset1, vload, vstore, vloadu8 (from unsigned 
+ *        bytes), vadd, vsub, vmul, vmax, vfmadd, vrsqrt, vramp (0, 1, 2, ..) 
+ *        and vhsum (horizontal sum).
+ * 
+ */
+
+
+static
+void projectTexel( const float red, const float green, const float blue,
+                   const float base[3], const float axisU[3], const float u, 
+                   const float texelArea, float shCoeff[3][9], float *sumWeight)
+{
+  const float x0 = base[0] + u * axisU[0];
+  const float y0 = base[1] + u * axisU[1];
+  const float z0 = base[2] + u * axisU[2];
+  
+  const float rs = 1.0f / sqrtf( x0*x0 + y0*y0 + z0*z0 );
+  const float x = x0 * rs;
+  const float y = y0 * rs;
+  const float z = z0 * rs;
+  const float dw = texelArea * rs * rs * rs;
+  
+  const float Y[9] = 
+  {
+    SH_C0,
+    SH_C1 * y,
+    SH_C1 * z,
+    SH_C1 * x,
+    SH_C2 * x * y,
+    SH_C2 * y * z,
+    SH_C3 * (3.0f * z * z - 1.0f),
+    SH_C2 * x * z,
+    SH_C4 * (x * x - y * y)
+  };
+  
+  const float lambda[3] = { red * dw, green * dw, blue * dw };
+  
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<9; ++k) {
+      shCoeff[c][k] += lambda[c] * Y[k];
+    }
+  }
+  *sumWeight += dw;
+}
+
+
+static
+void projectRow( const float *red, const float *green, const float *blue, 
+                 const int count,
+                 const float base[3], const float axisU[3], 
+                 const float u0, const float du, const float texelArea,
+                 float shCoeff[3][9], float *sumWeight)
+{
+  const vfloat bx = vset1( base[0] );
+  const vfloat by = vset1( base[1] );
+  const vfloat bz = vset1( base[2] );
+  const vfloat ax = vset1( axisU[0] );
+  const vfloat ay = vset1( axisU[1] );
+  const vfloat az = vset1( axisU[2] );
+  const vfloat vu0 = vset1( u0 );
+  const vfloat vdu = vset1( du );
+  const vfloat vArea = vset1( texelArea );
+  
+  const vfloat c0 = vset1( SH_C0 );
+  const vfloat c1 = vset1( SH_C1 );
+  const vfloat c2 = vset1( SH_C2 );
+  const vfloat c3 = vset1( SH_C3 );
+  const vfloat c4 = vset1( SH_C4 );
+  const vfloat three = vset1( 3.0f );
+  const vfloat minusOne = vset1( -1.0f );
+  
+  vfloat acc[3][9];
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<9; ++k) {
+      acc[c][k] = vset1( 0.0f );
+    }
+  }
+  vfloat accWeight = vset1( 0.0f );
+  
+  const float *channels[3] = { red, green, blue };
+  const vfloat ramp = vramp();
+  
+  int j = 0;
+  for (; j + SIMD_WIDTH <= count; j += SIMD_WIDTH)
+  {
+    const vfloat u = vfmadd( vadd( vset1( float(j) ), ramp), vdu, vu0);
+    
+    vfloat x = vfmadd( u, ax, bx);
+    vfloat y = vfmadd( u, ay, by);
+    vfloat z = vfmadd( u, az, bz);
+    
+    const vfloat rs = vrsqrt( vfmadd( x, x, vfmadd( y, y, vmul( z, z))) );
+    x = vmul( x, rs);
+    y = vmul( y, rs);
+    z = vmul( z, rs);
+    const vfloat dw = vmul( vArea, vmul( rs, vmul( rs, rs)));
+    accWeight = vadd( accWeight, dw);
+    
+    const vfloat Y[9] = 
+    {
+      c0,
+      vmul( c1, y),
+      vmul( c1, z),
+      vmul( c1, x),
+      vmul( c2, vmul( x, y)),
+      vmul( c2, vmul( y, z)),
+      vmul( c3, vfmadd( three, vmul( z, z), minusOne)),
+      vmul( c2, vmul( x, z)),
+      vmul( c4, vfmadd( x, x, vmul( minusOne, vmul( y, y))))
+    };
+    
+    for (int c=0; c<3; ++c)
+    {
+      const vfloat lambda = vmul( vload( channels[c] + j ), dw);
+      
+      for (int k=0; k<9; ++k) {
+        acc[c][k] = vfmadd( lambda, Y[k], acc[c][k]);
+      }
+    }
+  }
+  
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<9; ++k) {
+      shCoeff[c][k] += vhsum( acc[c][k] );
+    }
+  }
+  *sumWeight += vhsum( accWeight );
+  
+  // Remaining texels
+  for (; j<count; ++j) 
+  {
+    projectTexel( red[j], green[j], blue[j], base, axisU, u0 + j * du, 
+                  texelArea, shCoeff, sumWeight);
+  }
+}
+
+
+static inline vfloat vloadTexel(const unsigned char *p) { return vloadu8(p); }
+static inline vfloat vloadTexel(const float *p)         { return vload(p); }
+
+template<typename Texel>
+static
+void foldTile( const Texel *unswapped, const Texel *swapped, 
+               const float *weights, float moments[9])
+{
+  vfloat acc[9];
+  for (int k=0; k<9; ++k) {
+    acc[k] = vset1( 0.0f );
+  }
+  
+  const int quadrantSize = FOLD_TILE_SIZE * FOLD_TILE_SIZE;
+  
+  for (int i=0; i<FOLD_TILE_SIZE; ++i)
+  {
+    const Texel *u = unswapped + i * FOLD_TILE_SIZE;
+    const Texel *s = swapped + i * FOLD_TILE_SIZE;
+    const float *w = weights + i * 9 * FOLD_TILE_SIZE;
+    
+    for (int j=0; j<FOLD_TILE_SIZE; j+=SIMD_WIDTH)
+    {
+      const vfloat u0 = vloadTexel( u + j ), u1 = vloadTexel( u + quadrantSize + j );
+      const vfloat u2 = vloadTexel( u + 2*quadrantSize + j ), u3 = vloadTexel( u + 3*quadrantSize + j );
+      const vfloat s0 = vloadTexel( s + j ), s1 = vloadTexel( s + quadrantSize + j );
+      const vfloat s2 = vloadTexel( s + 2*quadrantSize + j ), s3 = vloadTexel( s + 3*quadrantSize + j );
+      
+      const vfloat up = vadd( u0, u1), um = vsub( u0, u1);
+      const vfloat dp = vadd( u2, u3), dm = vsub( u2, u3);
+      const vfloat Su  = vadd( up, dp);
+      const vfloat Xu  = vadd( um, dm);
+      const vfloat Yu  = vsub( up, dp);
+      const vfloat XYu = vsub( um, dm);
+      
+      const vfloat sup = vadd( s0, s1), sum = vsub( s0, s1);
+      const vfloat sdp = vadd( s2, s3), sdm = vsub( s2, s3);
+      const vfloat Ss  = vadd( sup, sdp);
+      const vfloat Xs  = vadd( sum, sdm);
+      const vfloat Ys  = vsub( sup, sdp);
+      const vfloat XYs = vsub( sum, sdm);
+      
+      const vfloat S = vadd( Su, Ss);
+      
+      const vfloat w1 = vload( w + 1*FOLD_TILE_SIZE + j );
+      const vfloat w2 = vload( w + 2*FOLD_TILE_SIZE + j );
+      const vfloat w5 = vload( w + 5*FOLD_TILE_SIZE + j );
+      const vfloat w6 = vload( w + 6*FOLD_TILE_SIZE + j );
+      const vfloat w7 = vload( w + 7*FOLD_TILE_SIZE + j );
+      const vfloat w8 = vload( w + 8*FOLD_TILE_SIZE + j );
+      
+      acc[0] = vfmadd( vload( w + 0*FOLD_TILE_SIZE + j ), S, acc[0]);
+      acc[1] = vfmadd( w1, Xu, vfmadd( w2, Xs, acc[1]));
+      acc[2] = vfmadd( w2, Yu, vfmadd( w1, Ys, acc[2]));
+      acc[3] = vfmadd( vload( w + 3*FOLD_TILE_SIZE + j ), S, acc[3]);
+      acc[4] = vfmadd( vload( w + 4*FOLD_TILE_SIZE + j ), vadd( XYu, XYs), acc[4]);
+      acc[5] = vfmadd( w5, Yu, vfmadd( w6, Ys, acc[5]));
+      acc[6] = vfmadd( w6, Xu, vfmadd( w5, Xs, acc[6]));
+      acc[7] = vfmadd( w7, Su, vfmadd( w8, Ss, acc[7]));
+      acc[8] = vfmadd( w8, Su, vfmadd( w7, Ss, acc[8]));
+    }
+  }
+  
+  for (int k=0; k<9; ++k) {
+    moments[k] += vhsum( acc[k] );
+  }
+}
+
+template<typename Texel>
+static
+void accumulateRow( const Texel *src, const int count, float *acc)
+{
+  int j = 0;
+  for (; j+SIMD_WIDTH <= count; j+=SIMD_WIDTH) {
+    vstore( acc + j, vadd( vload( acc + j ), vloadTexel( src + j )));
+  }
+  
+  for (; j<count; ++j) {
+    acc[j] += float( src[j] );
+  }
+}
+
+
+static
+void evaluateIrradiance( const float poly[3][9], const float *nx, const float *ny, 
+                         const float *nz, const int count, float *rgb)
+{
+  vfloat p[3][9];
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<9; ++k) {
+      p[c][k] = vset1( poly[c][k] );
+    }
+  }
+  
+  float result[3][SIMD_WIDTH];
+  
+  int j = 0;
+  for (; j+SIMD_WIDTH <= count; j+=SIMD_WIDTH)
+  {
+    const vfloat x = vload( nx + j );
+    const vfloat y = vload( ny + j );
+    const vfloat z = vload( nz + j );
+    
+    const vfloat B[8] = 
+    {
+      y, z, x,
+      vmul( x, y),
+      vmul( y, z),
+      vmul( z, z),
+      vmul( x, z),
+      vsub( vmul( x, x), vmul( y, y))
+    };
+    
+    for (int c=0; c<3; ++c)
+    {
+      vfloat e = p[c][0];
+      for (int k=1; k<9; ++k) {
+        e = vfmadd( p[c][k], B[k-1], e);
+      }
+      vstore( result[c], e);
+    }
+    
+    for (int i=0; i<SIMD_WIDTH; ++i) {
+      for (int c=0; c<3; ++c) {
+        rgb[3*(j + i) + c] = result[c][i];
+      }
+    }
+  }
+  
+  // Remaining normals
+  for (; j<count; ++j)
+  {
+    const float x = nx[j], y = ny[j], z = nz[j];
+    const float B[8] = { y, z, x, x*y, y*z, z*z, x*z, x*x - y*y };
+    
+    for (int c=0; c<3; ++c)
+    {
+      float e = poly[c][0];
+      for (int k=1; k<9; ++k) {
+        e += poly[c][k] * B[k-1];
+      }
+      rgb[3*j + c] = e;
+    }
+  }
+}
+
+
+static
+void convolveTile( const float *tile, const int count, const float n[3], float rgb[3])
+{
+  const float *dx = tile;
+  const float *dy = dx + count;
+  const float *dz = dy + count;
+  const float *red = dz + count;
+  const float *green = red + count;
+  const float *blue = green + count;
+  
+  const vfloat nx = vset1( n[0] );
+  const vfloat ny = vset1( n[1] );
+  const vfloat nz = vset1( n[2] );
+  const vfloat zero = vset1( 0.0f );
+  
+  vfloat accR = zero, accG = zero, accB = zero;
+  
+  int j = 0;
+  for (; j+SIMD_WIDTH <= count; j+=SIMD_WIDTH)
+  {
+    const vfloat cosTheta = vfmadd( nx, vload( dx + j ), 
+                            vfmadd( ny, vload( dy + j ), vmul( nz, vload( dz + j ))));
+    const vfloat w = vmax( cosTheta, zero);
+    
+    accR = vfmadd( w, vload( red + j ), accR);
+    accG = vfmadd( w, vload( green + j ), accG);
+    accB = vfmadd( w, vload( blue + j ), accB);
+  }
+  
+  rgb[0] = vhsum( accR );
+  rgb[1] = vhsum( accG );
+  rgb[2] = vhsum( accB );
+  
+  // Remaining texels
+  for (; j<count; ++j)
+  {
+    const float w = fmaxf( n[0] * dx[j] + n[1] * dy[j] + n[2] * dz[j], 0.0f);
+    rgb[0] += w * red[j];
+    rgb[1] += w * green[j];
+    rgb[2] += w * blue[j];
+  }
+}
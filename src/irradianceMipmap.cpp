@@ -0,0 +1,273 @@
+/**
+ *
+ *      \file irradianceMipmap.cpp
+ *
+ */
+
+
+#include "irradianceMipmap.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradiancePixelFormat.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Number of reduced rows produced by a single task
+static const int REDUCE_BAND_ROWS = 4;
+
+
+/// Accumulate a row of 'count' channels to acc
+static inline
+void accumulateChannels( const unsigned char *src, const int count, float *acc, 
+                         float *, const SIMDKernel kernel)
+{
+  getAccumulateRow( kernel )( src, count, acc);
+}
+
+static inline
+void accumulateChannels( const uint16_t *src, const int count, float *acc, 
+                         float *buffer, const SIMDKernel kernel)
+{
+  convertHalfToFloat( src, count, buffer);
+  getAccumulateRowFloat( kernel )( buffer, count, acc);
+}
+
+static inline
+void accumulateChannels( const float *src, const int count, float *acc, 
+                         float *, const SIMDKernel kernel)
+{
+  getAccumulateRowFloat( kernel )( src, count, acc);
+}
+
+/// Reduce the rows [firstRow, lastRow) of a face : the factor source rows 
+/// of a reduced row are summed channel-wise by the SIMD kernel, then the
+/// columns by blocks of factor texels
+template<PixelFormat Format>
+static
+void reduceBand( const Image_t &src, const int factor, const int firstRow, const int lastRow,
+                 const SIMDKernel kernel, Image_t &dst)
+{
+  typedef PixelTraits<Format> Traits;
+  const int NC = Traits::NUM_CHANNELS;
+
+  const int srcRes = src.width;
+  const int dstRes = srcRes / factor;
+  const int rowSize = srcRes * NC;
+  const typename Traits::Channel_t *pixels =
+    reinterpret_cast<const typename Traits::Channel_t*>(src.data);
+  const float scale = float(Traits::COLOR_SCALE / (factor * factor));
+
+  std::vector<float> acc( rowSize );
+  std::vector<float> buffer( rowSize );
+
+  float *out = reinterpret_cast<float*>(dst.data);
+
+  for (int i=firstRow; i<lastRow; ++i)
+  {
+    std::fill( acc.begin(), acc.end(), 0.0f);
+
+    for (int k=0; k<factor; ++k) {
+      accumulateChannels( pixels + size_t(i * factor + k) * rowSize, rowSize, 
+                          &acc[0], &buffer[0], kernel);
+    }
+
+    float *dstRow = out + size_t(i) * dstRes * 3;
+    const float *block = &acc[0];
+
+    for (int j=0; j<dstRes; ++j, block += factor * NC)
+    {
+      float r = 0.0f, g = 0.0f, b = 0.0f;
+      for (int k=0; k<factor; ++k)
+      {
+        r += block[k * NC + 0];
+        g += block[k * NC + 1];
+        b += block[k * NC + 2];
+      }
+      dstRow[3*j + 0] = scale * r;
+      dstRow[3*j + 1] = scale * g;
+      dstRow[3*j + 2] = scale * b;
+    }
+  }
+}
+
+void reduceCubemap( const Image_t src[6], const int factor, Image_t dst[6], ThreadPool &pool)
+{
+  const int dstRes = src[0].width / factor;
+  const int bandsPerFace = (dstRes + REDUCE_BAND_ROWS - 1) / REDUCE_BAND_ROWS;
+
+  assert( (factor > 0) && (0 == (factor & (factor - 1))) );
+  assert( 0 == (src[0].width % factor) );
+
+  for (int face=0; face<6; ++face)
+  {
+    dst[face].clean();
+    dst[face].target = GL_TEXTURE_2D;
+    dst[face].width = dst[face].height = dstRes;
+    dst[face].format = GL_RGB;
+    dst[face].internalFormat = GL_RGB32F;
+    dst[face].type = GL_FLOAT;
+    dst[face].bytesPerPixel = 3u * sizeof(float);
+    dst[face].data = new GLubyte[dst[face].getMemorySize()];
+  }
+
+  const SIMDKernel kernel = getKernel();
+
+  dispatchPixelFormat( getPixelFormat( src[0] ), [&](auto F)
+  {
+    pool.parallelFor( 6u * bandsPerFace, [&](size_t taskId)
+    {
+      const int face = taskId / bandsPerFace;
+      const int firstRow = (taskId % bandsPerFace) * REDUCE_BAND_ROWS;
+      const int lastRow = std::min( firstRow + REDUCE_BAND_ROWS, dstRes);
+
+      reduceBand<decltype(F)::value>( src[face], factor, firstRow, lastRow, kernel, dst[face]);
+    });
+  });
+}
+
+float getRelativeDifference( const glm::mat4 M[3], const glm::mat4 reference[3])
+{
+  float diff = 0.0f;
+  float scale = 0.0f;
+
+  for (int c=0; c<3; ++c) {
+    for (int i=0; i<4; ++i) {
+      for (int j=0; j<4; ++j)
+      {
+        diff = fmaxf( diff, fabsf( M[c][i][j] - reference[c][i][j] ));
+        scale = fmaxf( scale, fabsf( reference[c][i][j] ));
+      }
+    }
+  }
+
+  return (scale > 0.0f) ? diff / scale : diff;
+}
+
+
+/// Largest power of 2 dividing texRes such that texRes / factor >= resolution
+static
+int getReductionFactor( const int texRes, const int resolution )
+{
+  int factor = 1;
+  while ((0 == (texRes % (2*factor))) && (texRes / (2*factor) >= resolution)) {
+    factor *= 2;
+  }
+  return factor;
+}
+
+float prefilterReduced( const Image_t envmap[6], const int resolution, glm::mat4 M[3],
+                        ThreadPool &pool)
+{
+  if (NUM_PIXEL_FORMAT == getPixelFormat( envmap[0] ))
+  {
+    prefilter( envmap, M, pool);
+    return -1.0f;
+  }
+
+  const int factor = getReductionFactor( envmap[0].width, resolution);
+
+  Image_t level[6];
+  const Image_t *finer = envmap;
+
+  if (factor > 1)
+  {
+    reduceCubemap( envmap, factor, level, pool);
+    finer = level;
+  }
+  prefilter( finer, M, pool);
+
+  if (finer[0].width & 1) {
+    return -1.0f;
+  }
+
+  Image_t coarser[6];
+  glm::mat4 coarserM[3];
+  reduceCubemap( finer, 2, coarser, pool);
+  prefilter( coarser, coarserM, pool);
+
+  return getRelativeDifference( coarserM, M);
+}
+
+int prefilterWithinBudget( const Image_t envmap[6], const float errorBudget, glm::mat4 M[3],
+                           float *estimatedError, ThreadPool &pool, const int maxResolution)
+{
+  const int texRes = envmap[0].width;
+  float error = -1.0f;
+
+  if (NUM_PIXEL_FORMAT == getPixelFormat( envmap[0] ))
+  {
+    prefilter( envmap, M, pool);
+    if (estimatedError) {
+      *estimatedError = error;
+    }
+    return texRes;
+  }
+
+  /// Levels from maxResolution (at most half the cubemap's) down to 
+  /// MIPMAP_MIN_RESOLUTION, the finest one being reduced from the cubemap 
+  /// and the others from their parent
+  const int topFactor = getReductionFactor( texRes, std::min( texRes/2, maxResolution));
+
+  std::vector< std::unique_ptr<Image_t[]> > levels;
+
+  if (topFactor > 1)
+  {
+    levels.emplace_back( new Image_t[6] );
+    reduceCubemap( envmap, topFactor, levels.back().get(), pool);
+
+    while ((0 == (levels.back()[0].width & 1)) &&
+           (levels.back()[0].width / 2 >= MIPMAP_MIN_RESOLUTION))
+    {
+      const Image_t *parent = levels.back().get();
+      levels.emplace_back( new Image_t[6] );
+      reduceCubemap( parent, 2, levels.back().get(), pool);
+    }
+  }
+
+  /// Project from the coarsest level up to the first one within budget
+  glm::mat4 coarserM[3];
+
+  for (int l=int(levels.size())-1; l>=0; --l)
+  {
+    prefilter( levels[l].get(), M, pool);
+
+    if (l < int(levels.size())-1)
+    {
+      error = getRelativeDifference( coarserM, M);
+      if (error <= errorBudget)
+      {
+        if (estimatedError) {
+          *estimatedError = error;
+        }
+        return levels[l][0].width;
+      }
+    }
+    for (int c=0; c<3; ++c) {
+      coarserM[c] = M[c];
+    }
+  }
+
+  /// No level is accurate enough, use the whole cubemap
+  prefilter( envmap, M, pool);
+  if (!levels.empty()) {
+    error = getRelativeDifference( coarserM, M);
+  }
+
+  if (estimatedError) {
+    *estimatedError = error;
+  }
+  return texRes;
+}
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,69 @@
+/**
+ *
+ *      \file irradianceMipmap.hpp
+ *
+ *      Approximate prefiltering from box-reduced cubemaps.
+ *
+ *      The irradiance only keeps the 2nd order SH bands of the environment,
+ *      so a cubemap averaged on 2^n x 2^n blocks of texels gives almost the
+ *      same matrices for a fraction of the projection cost.
+ *
+ *      The error of a level is estimated by the difference between its
+ *      matrices and the ones of the next lower level (half resolution). As
+ *      the error decreases with the resolution, this overestimates the error
+ *      of the level.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEMIPMAP_HPP
+#define IRRADIANCEMIPMAP_HPP
+
+#include <glm/glm.hpp>
+#include <tools/ImageLoader.hpp>
+
+class ThreadPool;
+
+/// Relative error accepted by the approximate prefiltering of the textures
+/// (when compiled with -DENABLE_IEM_APPROX_PREFILTER=1)
+#ifndef IEM_APPROX_ERROR_BUDGET
+#define IEM_APPROX_ERROR_BUDGET   1.0e-3f
+#endif
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Lowest resolution considered by prefilterWithinBudget */
+  const int MIPMAP_MIN_RESOLUTION = 8;
+
+  /** Average the texels of a cubemap by blocks of factor x factor, factor
+   *  being a power of 2 dividing its resolution. The result is stored as
+   *  RGB32F, 8-bit colors being mapped to [0, 1]. */
+  void reduceCubemap( const Image_t src[6], const int factor, Image_t dst[6],
+                      ThreadPool &pool);
+
+  /** Largest difference between the coefficients of two sets of irradiance
+   *  matrices, relative to the largest coefficient of the reference */
+  float getRelativeDifference( const glm::mat4 M[3], const glm::mat4 reference[3]);
+
+  /** Compute the irradiance matrices of a cubemap reduced to 'resolution'
+   *  (rounded up to the closest reachable level). Return the estimated
+   *  relative error, or a negative value when the level can not be halved. */
+  float prefilterReduced( const Image_t envmap[6], const int resolution, glm::mat4 M[3],
+                          ThreadPool &pool);
+
+  /** Compute the irradiance matrices of a cubemap on its smallest level up
+   *  to maxResolution whose estimated relative error is below errorBudget,
+   *  or on the cubemap itself when none is. Return the resolution used and
+   *  its estimated error in estimatedError (if not null). */
+  int prefilterWithinBudget( const Image_t envmap[6], const float errorBudget, glm::mat4 M[3],
+                             float *estimatedError, ThreadPool &pool,
+                             const int maxResolution=256);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEMIPMAP_HPP
@@ -0,0 +1,196 @@
+/**
+ *
+ *      \file irradiancePixelFormat.hpp
+ *
+ *      Source pixel formats of the prefiltering, resolved once per cubemap
+ *      so that each format gets its own specialized loops.
+ *
+ *      8-bit channels are projected in [0, 255] and rescaled once on the
+ *      final sums (cf. PixelTraits::COLOR_SCALE), half and float channels
+ *      are projected as is.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEPIXELFORMAT_HPP
+#define IRRADIANCEPIXELFORMAT_HPP
+
+#include <stdint.h>
+#include <type_traits>
+#include <tools/Half.hpp>
+#include <tools/ImageView.hpp>
+
+
+namespace IrradianceEnvMap
+{
+
+  enum PixelFormat
+  {
+    PIXEL_RGB8,
+    PIXEL_RGBA8,
+    PIXEL_RGB16F,
+    PIXEL_RGBA16F,
+    PIXEL_RGB32F,
+    PIXEL_RGBA32F,
+
+    NUM_PIXEL_FORMAT
+  };
+
+
+  /** Channel type, count & scale of each format */
+  template<PixelFormat Format>
+  struct PixelTraits;
+
+  template<typename Channel, int NumChannels, bool bNormalized>
+  struct PixelTraitsBase
+  {
+    typedef Channel Channel_t;
+
+    enum { NUM_CHANNELS = NumChannels };
+
+    /** 8-bit formats are projected in [0, 255] */
+    static constexpr double COLOR_SCALE = bNormalized ? 1.0 / 255.0 : 1.0;
+
+    /** Type of the texels buffered by the weight table */
+    typedef typename std::conditional<bNormalized, unsigned char, float>::type Texel_t;
+  };
+
+  template<> struct PixelTraits<PIXEL_RGB8>    : PixelTraitsBase<unsigned char, 3, true>  {};
+  template<> struct PixelTraits<PIXEL_RGBA8>   : PixelTraitsBase<unsigned char, 4, true>  {};
+  template<> struct PixelTraits<PIXEL_RGB16F>  : PixelTraitsBase<uint16_t, 3, false>      {};
+  template<> struct PixelTraits<PIXEL_RGBA16F> : PixelTraitsBase<uint16_t, 4, false>      {};
+  template<> struct PixelTraits<PIXEL_RGB32F>  : PixelTraitsBase<float, 3, false>         {};
+  template<> struct PixelTraits<PIXEL_RGBA32F> : PixelTraitsBase<float, 4, false>         {};
+
+
+  /** Return a channel as projected (8-bit values are kept in [0, 255]) */
+  inline float toFloat( const unsigned char c ) { return c; }
+  inline float toFloat( const uint16_t c )      { return halfToFloat(c); }
+  inline float toFloat( const float c )         { return c; }
+
+  /** Copy the RGB channels of 'count' pixels to float arrays */
+  template<PixelFormat Format>
+  inline void convertRow( const void *pixels, const int count,
+                          float *red, float *green, float *blue)
+  {
+    typedef PixelTraits<Format> Traits;
+    const typename Traits::Channel_t *src =
+      static_cast<const typename Traits::Channel_t*>(pixels);
+
+    for (int j=0; j<count; ++j, src += Traits::NUM_CHANNELS)
+    {
+      red[j]   = toFloat( src[0] );
+      green[j] = toFloat( src[1] );
+      blue[j]  = toFloat( src[2] );
+    }
+  }
+
+  /** Half rows are widened by blocks before being split */
+  template<int NumChannels>
+  inline void convertHalfRow( const void *pixels, const int count,
+                              float *red, float *green, float *blue)
+  {
+    enum { BLOCK_SIZE = 64 };
+    float block[BLOCK_SIZE * NumChannels];
+
+    const uint16_t *src = static_cast<const uint16_t*>(pixels);
+
+    for (int first=0; first<count; first+=BLOCK_SIZE)
+    {
+      const int n = (count - first < BLOCK_SIZE) ? count - first : BLOCK_SIZE;
+      convertHalfToFloat( src + first * NumChannels, n * NumChannels, block);
+
+      for (int j=0; j<n; ++j)
+      {
+        red[first + j]   = block[j * NumChannels + 0];
+        green[first + j] = block[j * NumChannels + 1];
+        blue[first + j]  = block[j * NumChannels + 2];
+      }
+    }
+  }
+
+  template<>
+  inline void convertRow<PIXEL_RGB16F>( const void *pixels, const int count,
+                                        float *red, float *green, float *blue)
+  {
+    convertHalfRow<3>( pixels, count, red, green, blue);
+  }
+
+  template<>
+  inline void convertRow<PIXEL_RGBA16F>( const void *pixels, const int count,
+                                         float *red, float *green, float *blue)
+  {
+    convertHalfRow<4>( pixels, count, red, green, blue);
+  }
+
+
+  /** Return the format of an image, NUM_PIXEL_FORMAT if not supported */
+  inline PixelFormat getPixelFormat( const ImageView_t &image )
+  {
+    const bool bRGBA = (GL_RGBA == image.format);
+
+    if (!bRGBA && (GL_RGB != image.format)) {
+      return NUM_PIXEL_FORMAT;
+    }
+
+    switch (image.type)
+    {
+      case GL_UNSIGNED_BYTE:
+        return bRGBA ? PIXEL_RGBA8 : PIXEL_RGB8;
+
+      case GL_HALF_FLOAT:
+        return bRGBA ? PIXEL_RGBA16F : PIXEL_RGB16F;
+
+      case GL_FLOAT:
+        return bRGBA ? PIXEL_RGBA32F : PIXEL_RGB32F;
+
+      default:
+        return NUM_PIXEL_FORMAT;
+    }
+  }
+
+  /** Return the size in bytes of a pixel */
+  inline size_t getPixelSize( const PixelFormat format )
+  {
+    static const size_t sizes[NUM_PIXEL_FORMAT] = { 3u, 4u, 6u, 8u, 12u, 16u };
+    return sizes[format];
+  }
+
+  /** Return the scale of the projected colors of a format */
+  inline double getColorScale( const PixelFormat format )
+  {
+    return ((PIXEL_RGB8 == format) || (PIXEL_RGBA8 == format)) ? 1.0 / 255.0 : 1.0;
+  }
+
+  inline const char* getPixelFormatName( const PixelFormat format )
+  {
+    static const char* names[NUM_PIXEL_FORMAT+1] =
+    {
+      "RGB8", "RGBA8", "RGB16F", "RGBA16F", "RGB32F", "RGBA32F", "unsupported"
+    };
+    return names[format];
+  }
+
+  /** Call f(std::integral_constant<PixelFormat, format>), so that the code
+   *  specialized for the format is selected once */
+  template<typename F>
+  inline void dispatchPixelFormat( const PixelFormat format, F &&f)
+  {
+    switch (format)
+    {
+      case PIXEL_RGB8:    f( std::integral_constant<PixelFormat, PIXEL_RGB8>() );    break;
+      case PIXEL_RGBA8:   f( std::integral_constant<PixelFormat, PIXEL_RGBA8>() );   break;
+      case PIXEL_RGB16F:  f( std::integral_constant<PixelFormat, PIXEL_RGB16F>() );  break;
+      case PIXEL_RGBA16F: f( std::integral_constant<PixelFormat, PIXEL_RGBA16F>() ); break;
+      case PIXEL_RGB32F:  f( std::integral_constant<PixelFormat, PIXEL_RGB32F>() );  break;
+      case PIXEL_RGBA32F: f( std::integral_constant<PixelFormat, PIXEL_RGBA32F>() ); break;
+      default: break;
+    }
+  }
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEPIXELFORMAT_HPP
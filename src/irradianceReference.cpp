@@ -0,0 +1,264 @@
+/**
+ *
+ *      \file irradianceReference.cpp
+ *
+ */
+
+
+#include "irradianceReference.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceBaker.hpp"
+#include "irradianceEnvMap.hpp"
+#include "irradianceKernels.hpp"
+#include "irradianceMipmap.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+namespace {
+
+/// Source texels of a tile, at [offset, offset + 6 * count) of the tiles
+/// buffer (cf. ConvolveTileFn), with the bounding cone of their directions
+struct Tile_t
+{
+  size_t offset;
+  int count;
+  glm::vec3 axis;
+  float cullThreshold;    // the tile is below the horizon of n when n.axis <= cullThreshold
+};
+
+} //namespace
+
+
+/// Direction of the texel (u, v) in [-1, 1]^2 of a face
+static inline
+glm::vec3 getTexelDirection( const int face, const float u, const float v)
+{
+  const float (&frame)[3][3] = FACE_FRAMES[face];
+
+  return glm::vec3( frame[0][0] + u * frame[1][0] + v * frame[2][0],
+                    frame[0][1] + u * frame[1][1] + v * frame[2][1],
+                    frame[0][2] + u * frame[1][2] + v * frame[2][2]);
+}
+
+/// Split a RGB32F cubemap in tiles, return the sum of the texel solid angles
+static
+double buildTiles( const Image_t src[6], std::vector<Tile_t> &tiles, std::vector<float> &data)
+{
+  const int res = src[0].width;
+  const int tileSize = std::min( REFERENCE_TILE_SIZE, res);
+  const int tilesPerSide = (res + tileSize - 1) / tileSize;
+  const float texelArea = 4.0f / (float(res) * res);
+
+  tiles.clear();
+  data.resize( 6u * 6u * res * res );
+
+  double sumWeight = 0.0;
+  size_t offset = 0u;
+
+  for (int face=0; face<6; ++face)
+  {
+    const float *pixels = reinterpret_cast<const float*>(src[face].data);
+
+    for (int ty=0; ty<tilesPerSide; ++ty) {
+      for (int tx=0; tx<tilesPerSide; ++tx)
+      {
+        const int i0 = ty * tileSize, i1 = std::min( i0 + tileSize, res);
+        const int j0 = tx * tileSize, j1 = std::min( j0 + tileSize, res);
+
+        Tile_t tile;
+        tile.offset = offset;
+        tile.count = (i1 - i0) * (j1 - j0);
+
+        float *dx = &data[offset];
+        float *dy = dx + tile.count;
+        float *dz = dy + tile.count;
+        float *red = dz + tile.count;
+        float *green = red + tile.count;
+        float *blue = green + tile.count;
+
+        glm::vec3 sumDir( 0.0f );
+        int k = 0;
+
+        for (int i=i0; i<i1; ++i) {
+          for (int j=j0; j<j1; ++j, ++k)
+          {
+            const float u = 2.0f * (j + 0.5f) / res - 1.0f;
+            const float v = 2.0f * (i + 0.5f) / res - 1.0f;
+            const glm::vec3 d = getTexelDirection( face, u, v);
+
+            const float rs = 1.0f / sqrtf( glm::dot( d, d) );
+            const float dw = texelArea * rs * rs * rs;
+            const float *texel = pixels + 3u * (size_t(i) * res + j);
+
+            dx[k] = d.x * rs;
+            dy[k] = d.y * rs;
+            dz[k] = d.z * rs;
+            red[k] = dw * texel[0];
+            green[k] = dw * texel[1];
+            blue[k] = dw * texel[2];
+
+            sumDir += d * rs;
+            sumWeight += dw;
+          }
+        }
+
+        // The farthest direction from the axis is a corner of the tile
+        tile.axis = glm::normalize( sumDir );
+        float cosHalfAngle = 1.0f;
+
+        for (int c=0; c<4; ++c)
+        {
+          const float u = 2.0f * ((c & 1) ? j1 : j0) / res - 1.0f;
+          const float v = 2.0f * ((c & 2) ? i1 : i0) / res - 1.0f;
+          const glm::vec3 corner = glm::normalize( getTexelDirection( face, u, v) );
+          cosHalfAngle = std::min( cosHalfAngle, glm::dot( corner, tile.axis));
+        }
+
+        tile.cullThreshold = (cosHalfAngle > 0.0f) ? -sqrtf( 1.0f - cosHalfAngle * cosHalfAngle )
+                                                   : -2.0f;
+
+        tiles.push_back( tile );
+        offset += 6u * tile.count;
+      }
+    }
+  }
+
+  return sumWeight;
+}
+
+/// Set a face as a 2D float image
+static
+void allocateFace( const int size, const bool bSingleChannel, Image_t &face)
+{
+  face.clean();
+  face.target = GL_TEXTURE_2D;
+  face.width = face.height = size;
+  face.format = bSingleChannel ? GL_RED : GL_RGB;
+  face.internalFormat = bSingleChannel ? GL_R32F : GL_RGB32F;
+  face.type = GL_FLOAT;
+  face.bytesPerPixel = (bSingleChannel ? 1u : 3u) * sizeof(float);
+  face.data = new GLubyte[face.getMemorySize()];
+}
+
+
+void bakeReferenceIrradiance( const Image_t envmap[6], const int size,
+                              const int sourceResolution, Image_t faces[6],
+                              ThreadPool &pool)
+{
+  assert( size > 0 );
+
+  /// Source reduced to RGB32F
+  const int res = envmap[0].width;
+  int factor = 1;
+  while ((0 == res % (2*factor)) && (res / (2*factor) >= sourceResolution)) {
+    factor *= 2;
+  }
+
+  Image_t reduced[6];
+  reduceCubemap( envmap, factor, reduced, pool);
+
+  std::vector<Tile_t> tiles;
+  std::vector<float> data;
+  const double sumWeight = buildTiles( reduced, tiles, data);
+  const double normalization = 2.0 * M_PI / sumWeight;
+
+  for (int face=0; face<6; ++face) {
+    allocateFace( size, false, faces[face]);
+  }
+
+  const ConvolveTileFn convolveTile = getConvolveTile( getKernel() );
+
+  pool.parallelFor( 6u * size, [&](size_t taskId)
+  {
+    const int face = int(taskId / size);
+    const int i = int(taskId % size);
+    const float v = 2.0f * (i + 0.5f) / size - 1.0f;
+
+    std::vector<glm::vec3> normals( size );
+    std::vector<double> acc( 3u * size, 0.0 );
+
+    for (int j=0; j<size; ++j)
+    {
+      const float u = 2.0f * (j + 0.5f) / size - 1.0f;
+      normals[j] = glm::normalize( getTexelDirection( face, u, v) );
+    }
+
+    for (const Tile_t &tile : tiles) {
+      for (int j=0; j<size; ++j)
+      {
+        if (glm::dot( normals[j], tile.axis) <= tile.cullThreshold) {
+          continue;
+        }
+
+        float rgb[3];
+        convolveTile( &data[tile.offset], tile.count, &normals[j][0], rgb);
+
+        for (int c=0; c<3; ++c) {
+          acc[3*j + c] += rgb[c];
+        }
+      }
+    }
+
+    float *row = reinterpret_cast<float*>(faces[face].data) + 3u * size_t(i) * size;
+    for (int k=0; k<3*size; ++k) {
+      row[k] = float(normalization * acc[k]);
+    }
+  });
+}
+
+ReferenceError_t getErrorMaps( const glm::mat4 M[3], const Image_t reference[6],
+                               Image_t errorMaps[6], ThreadPool &pool)
+{
+  const int size = reference[0].width;
+  const size_t faceTexels = size_t(size) * size;
+
+  Image_t approx[6];
+  bakeIrradiance( M, size, BAKE_RGB32F, approx, pool);
+
+  float maxReference = 0.0f;
+  for (int face=0; face<6; ++face)
+  {
+    const float *ref = reinterpret_cast<const float*>(reference[face].data);
+    maxReference = std::max( maxReference, *std::max_element( ref, ref + 3u * faceTexels));
+  }
+
+  ReferenceError_t error = { 0.0f, 0.0f };
+  double sumSquares = 0.0;
+
+  for (int face=0; face<6; ++face)
+  {
+    allocateFace( size, true, errorMaps[face]);
+
+    const float *ref = reinterpret_cast<const float*>(reference[face].data);
+    const float *sh = reinterpret_cast<const float*>(approx[face].data);
+    float *map = reinterpret_cast<float*>(errorMaps[face].data);
+
+    for (size_t k=0u; k<faceTexels; ++k)
+    {
+      float e = 0.0f;
+      for (int c=0; c<3; ++c) {
+        e = std::max( e, fabsf( sh[3u*k + c] - ref[3u*k + c] ));
+      }
+      e = (maxReference > 0.0f) ? e / maxReference : e;
+
+      map[k] = e;
+      error.maxError = std::max( error.maxError, e);
+      sumSquares += double(e) * e;
+    }
+  }
+  error.rmsError = float(sqrt( sumSquares / (6.0 * faceTexels) ));
+
+  return error;
+}
+
+
+} //namespace IrradianceEnvMap
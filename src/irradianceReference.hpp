@@ -0,0 +1,65 @@
+/**
+ *
+ *      \file irradianceReference.hpp
+ *
+ *      Ground truth irradiance cubemaps, to validate the SH approximation.
+ *
+ *      The irradiance of each output texel is the brute force cosine
+ *      weighted integral of the source texels :
+ *
+ *        E(n) = 2pi / sum dw  *  sum max(n.d, 0) L(d) dw
+ *
+ *      with the normalization of prefilter (2pi / sum dw, cf.
+ *      irradianceEnvMap.cpp). The source is first box-reduced (cf.
+ *      reduceCubemap) and split in tiles of REFERENCE_TILE_SIZE^2 texels of
+ *      a face, stored as structure-of-arrays. Each task bakes a row of
+ *      output texels tile after tile, so that a tile stays in cache while
+ *      it is used by the whole row, and skips the tiles entirely below the
+ *      horizon of an output texel (from their bounding cones).
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEREFERENCE_HPP
+#define IRRADIANCEREFERENCE_HPP
+
+#include <glm/glm.hpp>
+#include <tools/ImageLoader.hpp>
+
+class ThreadPool;
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Side of the source tiles, in texels */
+  const int REFERENCE_TILE_SIZE = 16;
+
+  /** Difference between the irradiance of some matrices and a reference */
+  struct ReferenceError_t
+  {
+    float maxError;         // largest texel error
+    float rmsError;         // root mean square of the texel errors
+  };
+
+  /** Bake the exact irradiance cubemap of size x size of an environment,
+   *  from its box-reduction to sourceResolution (rounded up to the closest
+   *  reachable level). The faces are set as RGB32F 2D images, with the
+   *  texel directions of bakeIrradiance. */
+  void bakeReferenceIrradiance( const Image_t envmap[6], const int size,
+                                const int sourceResolution, Image_t faces[6],
+                                ThreadPool &pool);
+
+  /** Set the error maps of the irradiance of M against a reference cubemap
+   *  (as baked by bakeReferenceIrradiance) : the largest channel difference
+   *  of each texel, relative to the largest value of the reference. The
+   *  maps are single channel R32F 2D images. */
+  ReferenceError_t getErrorMaps( const glm::mat4 M[3], const Image_t reference[6],
+                                 Image_t errorMaps[6], ThreadPool &pool);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEREFERENCE_HPP
@@ -0,0 +1,215 @@
+/**
+ *
+ *      \file irradianceRotation.cpp
+ *
+ */
+
+
+#include "irradianceRotation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceEnvMap.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Number of coefficient sets rotated by a single task
+static const size_t ROTATION_CHUNK_SIZE = 256u;
+
+
+/// Offset of the band l matrix
+static inline
+int getBandOffset( const int l )
+{
+  return (l * (4*l*l - 1)) / 3;
+}
+
+/// Entry (m, n) of the band l matrix
+static inline
+double& getBandEntry( double *bands, const int l, const int m, const int n)
+{
+  return bands[ getBandOffset( l ) + (m + l) * (2*l + 1) + (n + l) ];
+}
+
+/// Function P of Ivanic & Ruedenberg, from the bands 1 and l-1
+static inline
+double P( double *bands, const int i, const int l, const int a, const int b)
+{
+  const double ri1 = getBandEntry( bands, 1, i, 1);
+  const double rim1 = getBandEntry( bands, 1, i, -1);
+  const double ri0 = getBandEntry( bands, 1, i, 0);
+
+  if (b == l) {
+    return ri1 * getBandEntry( bands, l-1, a, l-1) - rim1 * getBandEntry( bands, l-1, a, -l+1);
+  }
+  if (b == -l) {
+    return ri1 * getBandEntry( bands, l-1, a, -l+1) + rim1 * getBandEntry( bands, l-1, a, l-1);
+  }
+  return ri0 * getBandEntry( bands, l-1, a, b);
+}
+
+/// Build the band matrices of R up to 'order'
+static
+void buildBands( const glm::mat3 &R, const int order, double *bands)
+{
+  getBandEntry( bands, 0, 0, 0) = 1.0;
+
+  if (order < 1) {
+    return;
+  }
+
+  // R in the (y, z, x) order of the band 1 (glm matrices are column major)
+  const int axis[3] = { 1, 2, 0 };
+  for (int m=-1; m<=1; ++m) {
+    for (int n=-1; n<=1; ++n) {
+      getBandEntry( bands, 1, m, n) = R[ axis[n+1] ][ axis[m+1] ];
+    }
+  }
+
+  for (int l=2; l<=order; ++l) {
+    for (int m=-l; m<=l; ++m) {
+      for (int n=-l; n<=l; ++n)
+      {
+        const int d = (0 == m);
+        const int am = abs(m);
+        const double denom = (abs(n) < l) ? double((l + n) * (l - n)) : double(2*l * (2*l - 1));
+
+        const double u = sqrt( (l + m) * (l - m) / denom );
+        const double v = 0.5 * sqrt( (1 + d) * (l + am - 1) * (l + am) / denom ) * (1 - 2*d);
+        const double w = -0.5 * sqrt( (l - am - 1) * (l - am) / denom ) * (1 - d);
+
+        double value = 0.0;
+
+        if (0.0 != u) {
+          value += u * P( bands, 0, l, m, n);
+        }
+
+        if (0.0 != v)
+        {
+          if (0 == m) {
+            value += v * (P( bands, 1, l, 1, n) + P( bands, -1, l, -1, n));
+          } else if (m > 0) {
+            const int d1 = (1 == m);
+            value += v * (P( bands, 1, l, m-1, n) * sqrt( 1.0 + d1 ) - P( bands, -1, l, -m+1, n) * (1 - d1));
+          } else {
+            const int d1 = (-1 == m);
+            value += v * (P( bands, 1, l, m+1, n) * (1 - d1) + P( bands, -1, l, -m-1, n) * sqrt( 1.0 + d1 ));
+          }
+        }
+
+        if (0.0 != w)
+        {
+          if (m > 0) {
+            value += w * (P( bands, 1, l, m+1, n) + P( bands, -1, l, -m-1, n));
+          } else {
+            value += w * (P( bands, 1, l, m-1, n) - P( bands, -1, l, -m+1, n));
+          }
+        }
+
+        getBandEntry( bands, l, m, n) = value;
+      }
+    }
+  }
+}
+
+
+template<int Order>
+SHRotation<Order>::SHRotation(const glm::mat3 &R)
+{
+  double bands[NUM_ENTRIES];
+  buildBands( R, Order, bands);
+
+  for (int i=0; i<NUM_ENTRIES; ++i) {
+    m_bands[i] = float(bands[i]);
+  }
+}
+
+template<int Order>
+void SHRotation<Order>::apply(const float in[NUM_COEFFS], float out[NUM_COEFFS]) const
+{
+  float rotated[NUM_COEFFS];
+  const float *band = m_bands;
+
+  for (int l=0; l<=Order; ++l)
+  {
+    const int size = 2*l + 1;
+    const float *x = in + l*l;
+
+    for (int m=0; m<size; ++m)
+    {
+      float sum = 0.0f;
+      for (int n=0; n<size; ++n) {
+        sum += band[m * size + n] * x[n];
+      }
+      rotated[l*l + m] = sum;
+    }
+    band += size * size;
+  }
+
+  memcpy( out, rotated, sizeof(rotated));
+}
+
+template<int Order>
+void SHRotation<Order>::apply(const SH_t<Order> &in, SH_t<Order> &out) const
+{
+  for (int c=0; c<3; ++c) {
+    apply( in.coeffs[c], out.coeffs[c]);
+  }
+}
+
+
+template<int Order>
+void rotate( const SH_t<Order> in[], SH_t<Order> out[], const size_t count,
+             const glm::mat3 &R, ThreadPool &pool)
+{
+  const SHRotation<Order> rotation( R );
+  const size_t numTasks = (count + ROTATION_CHUNK_SIZE - 1u) / ROTATION_CHUNK_SIZE;
+
+  pool.parallelFor( numTasks, [&](size_t taskId)
+  {
+    const size_t first = taskId * ROTATION_CHUNK_SIZE;
+    const size_t last = std::min( first + ROTATION_CHUNK_SIZE, count);
+
+    for (size_t i=first; i<last; ++i) {
+      rotation.apply( in[i], out[i]);
+    }
+  });
+}
+
+void rotateIrradianceMatrices( const glm::mat4 M[3], const glm::mat3 &R, glm::mat4 out[3])
+{
+  float shCoeff[3][9];
+  getSHCoefficients( M, shCoeff);
+
+  const SHRotation<2> rotation( R );
+  for (int c=0; c<3; ++c) {
+    rotation.apply( shCoeff[c], shCoeff[c]);
+  }
+
+  setIrradianceMatrices( shCoeff, out);
+}
+
+
+#define IEM_INSTANTIATE_ROTATION(Order)                                               \
+  template class SHRotation<Order>;                                                   \
+  template void rotate<Order>( const SH_t<Order>[], SH_t<Order>[], const size_t,      \
+                               const glm::mat3&, ThreadPool&);
+
+IEM_INSTANTIATE_ROTATION(1)
+IEM_INSTANTIATE_ROTATION(2)
+IEM_INSTANTIATE_ROTATION(3)
+IEM_INSTANTIATE_ROTATION(4)
+IEM_INSTANTIATE_ROTATION(5)
+IEM_INSTANTIATE_ROTATION(6)
+IEM_INSTANTIATE_ROTATION(7)
+IEM_INSTANTIATE_ROTATION(8)
+
+#undef IEM_INSTANTIATE_ROTATION
+
+
+} //namespace IrradianceEnvMap
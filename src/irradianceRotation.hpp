@@ -0,0 +1,85 @@
+/**
+ *
+ *      \file irradianceRotation.hpp
+ *
+ *      Rotation of SH coefficients, so that a rotated environment does not
+ *      need its normals to be rotated back at each vertex.
+ *
+ *      A rotation R maps each band l of the basis to itself, by a
+ *      (2l+1) x (2l+1) matrix. The band 1 matrix is R itself, expressed in
+ *      the (y, z, x) order of the basis, and the band l one is built from
+ *      the bands 1 and l-1 by the recurrences of J. Ivanic & K. Ruedenberg,
+ *      "Rotation Matrices for Real Spherical Harmonics. Direct Determination
+ *      by Recursion" (J. Phys. Chem. 1996, with the 1998 errata).
+ *
+ *      The matrices being built once per rotation, the cost of applying it
+ *      is sum (2l+1)^2 multiply-adds per channel : 34 at order 2, 969 at
+ *      order 8.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCEROTATION_HPP
+#define IRRADIANCEROTATION_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "irradianceSH.hpp"
+
+class ThreadPool;
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Band matrices of a rotation, up to the order Order */
+  template<int Order>
+  class SHRotation
+  {
+    public:
+      enum
+      {
+        ORDER = Order,
+        NUM_COEFFS = SHBasis<Order>::NUM_COEFFS,
+        NUM_ENTRIES = ((Order+1) * (4*(Order+1)*(Order+1) - 1)) / 3
+      };
+
+    protected:
+      /** Band l matrix at [l * (4l^2 - 1) / 3], row m & column n at
+       *  [(m + l) * (2l + 1) + (n + l)] */
+      float m_bands[NUM_ENTRIES];
+
+    public:
+      /** Build the matrices of the coefficients of f(R^-1 d) from the ones of
+       *  f(d), R being a rotation (eg. the model matrix of the skybox) */
+      explicit SHRotation(const glm::mat3 &R);
+
+      /** Return the entry (m, n) of the band l matrix */
+      float getEntry(const int l, const int m, const int n) const
+      {
+        return m_bands[ (l * (4*l*l - 1)) / 3 + (m + l) * (2*l + 1) + (n + l) ];
+      }
+
+      /** Rotate the coefficients of a channel, in may be out */
+      void apply(const float in[NUM_COEFFS], float out[NUM_COEFFS]) const;
+
+      /** Rotate RGB coefficients, in may be out */
+      void apply(const SH_t<Order> &in, SH_t<Order> &out) const;
+  };
+
+  /** Rotate 'count' sets of coefficients (in may be out) by the same
+   *  rotation, split in tasks on the pool */
+  template<int Order>
+  void rotate( const SH_t<Order> in[], SH_t<Order> out[], const size_t count,
+               const glm::mat3 &R, ThreadPool &pool);
+
+  /** Rotate irradiance matrices, as set by setIrradianceMatrices. The result
+   *  gives at n the irradiance of the source at R^-1 n. */
+  void rotateIrradianceMatrices( const glm::mat4 M[3], const glm::mat3 &R, glm::mat4 out[3]);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEROTATION_HPP
@@ -0,0 +1,283 @@
+/**
+ *
+ *      \file irradianceSH.cpp
+ *
+ */
+
+
+#include "irradianceSH.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradianceKernels.hpp"
+#include "irradiancePixelFormat.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Number of texel rows processed by a single prefiltering task
+static const int SH_BAND_ROWS = 16;
+
+/// Texels projected together, the basis being evaluated on a GCC vector type
+/// (lowered to the SSE / NEON registers available)
+static const int SH_VEC_WIDTH = 4;
+typedef float SHVec_t __attribute__((vector_size(SH_VEC_WIDTH * sizeof(float))));
+
+
+namespace {
+
+/// Partial sums of a task
+template<int Order>
+struct SHPartial_t
+{
+  double coeffs[3][SH_t<Order>::NUM_COEFFS];
+  double sumWeight;
+};
+
+} //namespace
+
+
+static inline
+double hsum( const SHVec_t v )
+{
+  double sum = 0.0;
+  for (int i=0; i<SH_VEC_WIDTH; ++i) {
+    sum += v[i];
+  }
+  return sum;
+}
+
+template<int Order, PixelFormat Format>
+static
+void projectBand( const ImageView_t &face, const int texId, const int firstRow, const int lastRow,
+                  SHPartial_t<Order> *partial)
+{
+  enum { NUM_COEFFS = SH_t<Order>::NUM_COEFFS };
+  typedef PixelTraits<Format> Traits;
+
+  const float (*axes)[3] = FACE_FRAMES[texId];
+
+  const int texRes = face.width;
+  const float texelSize = 1.0f / float(texRes);
+  const float texelArea = 4.0f * texelSize * texelSize;
+
+  /// Structure-of-arrays row, padded with null texels
+  const int paddedRes = (texRes + SH_VEC_WIDTH - 1) & ~(SH_VEC_WIDTH - 1);
+  std::vector<float> soa( 4 * paddedRes, 0.0f );
+  float *red   = &soa[0];
+  float *green = red + paddedRes;
+  float *blue  = green + paddedRes;
+  float *mask  = blue + paddedRes;
+  std::fill( mask, mask + texRes, 1.0f);
+
+  SHVec_t acc[3][NUM_COEFFS] = {};
+  SHVec_t accWeight = {};
+
+  SHVec_t ramp;
+  for (int i=0; i<SH_VEC_WIDTH; ++i) {
+    ramp[i] = float(i);
+  }
+
+  for (int i=firstRow; i<lastRow; ++i)
+  {
+    convertRow<Format>( face.getRow( i ), texRes, red, green, blue);
+
+    const float v = 2.0f * ((i+0.5f) * texelSize) - 1.0f;
+
+    for (int j=0; j<texRes; j+=SH_VEC_WIDTH)
+    {
+      const SHVec_t u = (2.0f * texelSize) * (ramp + float(j)) + (texelSize - 1.0f);
+
+      // Unnormalized direction, |d|^2 = 1 + u^2 + v^2
+      const SHVec_t dx = axes[0][0] + u * axes[1][0] + v * axes[2][0];
+      const SHVec_t dy = axes[0][1] + u * axes[1][1] + v * axes[2][1];
+      const SHVec_t dz = axes[0][2] + u * axes[1][2] + v * axes[2][2];
+      const SHVec_t r2 = 1.0f + u * u + v * v;
+
+      SHVec_t invLength;
+      for (int k=0; k<SH_VEC_WIDTH; ++k) {
+        invLength[k] = 1.0f / sqrtf( r2[k] );
+      }
+
+      // Differential solid angle, as the projection kernels
+      SHVec_t solidAngle;
+      memcpy( &solidAngle, mask + j, sizeof(solidAngle));
+      solidAngle *= texelArea * invLength * invLength * invLength;
+      accWeight += solidAngle;
+
+      SHVec_t Y[NUM_COEFFS];
+      SHBasis<Order>::evaluate( dx * invLength, dy * invLength, dz * invLength, Y);
+
+      SHVec_t r, g, b;
+      memcpy( &r, red + j,   sizeof(r));
+      memcpy( &g, green + j, sizeof(g));
+      memcpy( &b, blue + j,  sizeof(b));
+      r *= solidAngle;
+      g *= solidAngle;
+      b *= solidAngle;
+
+      Unroll<NUM_COEFFS>::run( [&](auto K)
+      {
+        constexpr int k = decltype(K)::value;
+        acc[0][k] += r * Y[k];
+        acc[1][k] += g * Y[k];
+        acc[2][k] += b * Y[k];
+      });
+    }
+  }
+
+  // 8-bit colors are kept in [0, 255] inside the loop
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<NUM_COEFFS; ++k) {
+      partial->coeffs[c][k] = Traits::COLOR_SCALE * hsum( acc[c][k] );
+    }
+  }
+  partial->sumWeight = hsum( accWeight );
+}
+
+
+template<int Order>
+void prefilter( const Image_t envmap[6], SH_t<Order> &sh, ThreadPool &pool)
+{
+  const ImageView_t views[6] = 
+  {
+    envmap[0], envmap[1], envmap[2], envmap[3], envmap[4], envmap[5]
+  };
+  prefilter( views, sh, pool);
+}
+
+template<int Order>
+void prefilter( const ImageView_t envmap[6], SH_t<Order> &sh, ThreadPool &pool)
+{
+  enum { NUM_COEFFS = SH_t<Order>::NUM_COEFFS };
+
+  const int texRes = envmap[0].width;
+  const int bandsPerFace = (texRes + SH_BAND_ROWS - 1) / SH_BAND_ROWS;
+
+  std::vector<SHPartial_t<Order> > partials( 6u * bandsPerFace );
+
+  const PixelFormat format = getPixelFormat( envmap[0] );
+  if (NUM_PIXEL_FORMAT == format)
+  {
+    fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+    memset( &sh, 0, sizeof(sh));
+    return;
+  }
+
+  dispatchPixelFormat( format, [&](auto F)
+  {
+    pool.parallelFor( partials.size(), [&](size_t taskId)
+    {
+      const int texId = taskId / bandsPerFace;
+      const int firstRow = (taskId % bandsPerFace) * SH_BAND_ROWS;
+      const int lastRow = std::min( firstRow + SH_BAND_ROWS, texRes);
+
+      projectBand<Order, decltype(F)::value>( envmap[texId], texId, firstRow, lastRow, 
+                                              &partials[taskId]);
+    });
+  });
+
+  /// Fixed order reduction
+  double coeffs[3][NUM_COEFFS] = {};
+  double sumWeight = 0.0;
+
+  for (size_t t=0u; t<partials.size(); ++t)
+  {
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<NUM_COEFFS; ++k) {
+        coeffs[c][k] += partials[t].coeffs[c][k];
+      }
+    }
+    sumWeight += partials[t].sumWeight;
+  }
+
+  const double dnorm = 2.0 * M_PI / sumWeight;
+
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<NUM_COEFFS; ++k) {
+      sh.coeffs[c][k] = float(dnorm * coeffs[c][k]);
+    }
+  }
+}
+
+template<int Order>
+void convolveIrradiance( SH_t<Order> &sh )
+{
+  for (int k=0; k<SH_t<Order>::NUM_COEFFS; ++k)
+  {
+    const float A = float(SHConstants::A( SHConstants::band(k) ));
+    sh.coeffs[0][k] *= A;
+    sh.coeffs[1][k] *= A;
+    sh.coeffs[2][k] *= A;
+  }
+}
+
+template<int Order>
+glm::vec3 evaluate( const SH_t<Order> &sh, const glm::vec3 &n)
+{
+  float Y[SH_t<Order>::NUM_COEFFS];
+  SHBasis<Order>::evaluate( n.x, n.y, n.z, Y);
+
+  glm::vec3 color( 0.0f );
+  for (int k=0; k<SH_t<Order>::NUM_COEFFS; ++k)
+  {
+    color.r += sh.coeffs[0][k] * Y[k];
+    color.g += sh.coeffs[1][k] * Y[k];
+    color.b += sh.coeffs[2][k] * Y[k];
+  }
+
+  return color;
+}
+
+template<int Order>
+void getShaderCoefficients( const SH_t<Order> &sh, glm::vec3 out[SH_t<Order>::NUM_COEFFS])
+{
+  for (int k=0; k<SH_t<Order>::NUM_COEFFS; ++k)
+  {
+    const int l = SHConstants::band(k);
+    const float K = float(SHConstants::K( l, abs(k - l*(l+1)) ));
+    out[k] = K * glm::vec3( sh.coeffs[0][k], sh.coeffs[1][k], sh.coeffs[2][k]);
+  }
+}
+
+void getL1Irradiance( const glm::mat4 M[3], SH_t<1> &sh)
+{
+  float shCoeff[3][9];
+  getSHCoefficients( M, shCoeff);
+
+  for (int c=0; c<3; ++c) {
+    for (int k=0; k<SH_t<1>::NUM_COEFFS; ++k) {
+      sh.coeffs[c][k] = shCoeff[c][k];
+    }
+  }
+  convolveIrradiance( sh );
+}
+
+
+#define IEM_INSTANTIATE_SH(Order)                                                     \
+  template void prefilter<Order>( const Image_t[6], SH_t<Order>&, ThreadPool&);      \
+  template void prefilter<Order>( const ImageView_t[6], SH_t<Order>&, ThreadPool&);  \
+  template void convolveIrradiance<Order>( SH_t<Order>& );                            \
+  template glm::vec3 evaluate<Order>( const SH_t<Order>&, const glm::vec3&);          \
+  template void getShaderCoefficients<Order>( const SH_t<Order>&, glm::vec3[]);
+
+IEM_INSTANTIATE_SH(1)
+IEM_INSTANTIATE_SH(2)
+IEM_INSTANTIATE_SH(3)
+IEM_INSTANTIATE_SH(4)
+IEM_INSTANTIATE_SH(5)
+IEM_INSTANTIATE_SH(6)
+IEM_INSTANTIATE_SH(7)
+IEM_INSTANTIATE_SH(8)
+
+#undef IEM_INSTANTIATE_SH
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,222 @@
+/**
+ *
+ *      \file irradianceSH.hpp
+ *
+ *      Real spherical harmonics of any order from 1 to 8, their constants
+ *      being generated at compile time.
+ *
+ *      The basis follows the convention of the Y0..Y8 macros (no Condon-
+ *      Shortley phase, coefficient l * (l+1) + m), and is evaluated with the
+ *      recurrences of P. P. Sloan's "Efficient Spherical Harmonic Evaluation" :
+ *
+ *        C_m = x C_m-1 - y S_m-1,        S_m = x S_m-1 + y C_m-1
+ *        P_m,m   = (2m - 1)!!
+ *        P_l,m   = ((2l - 1) z P_l-1,m - (l + m - 1) P_l-2,m) / (l - m)
+ *
+ *        Y_l,0  = K_l,0 P_l,0
+ *        Y_l,+m = sqrt(2) K_l,m P_l,m C_m
+ *        Y_l,-m = sqrt(2) K_l,m P_l,m S_m
+ *
+ *      The EnvMapping.Vertex.SH shader uses the same recurrences, the K_l,m
+ *      factors being folded in its coefficients (cf. getShaderCoefficients).
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCESH_HPP
+#define IRRADIANCESH_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include <tools/ImageView.hpp>
+
+class ThreadPool;
+
+/// SH order used by the renderer, 2 uses the irradiance matrices
+#ifndef IEM_SH_ORDER
+#define IEM_SH_ORDER  2
+#endif
+
+
+namespace IrradianceEnvMap
+{
+
+  const int SH_MAX_ORDER = 8;
+
+  /** Compile time constants of the basis */
+  namespace SHConstants
+  {
+    constexpr double PI = 3.14159265358979323846;
+
+    constexpr double factorial(const int n)
+    {
+      return (n <= 1) ? 1.0 : n * factorial(n - 1);
+    }
+
+    constexpr double doubleFactorial(const int n)
+    {
+      return (n <= 1) ? 1.0 : n * doubleFactorial(n - 2);
+    }
+
+    constexpr double sqrt(const double x, const double r=1.0, const int it=0)
+    {
+      return (it == 32) ? r : sqrt( x, 0.5 * (r + x / r), it + 1);
+    }
+
+    /** Normalization of Y_l,+-m, sqrt(2) included for m > 0 */
+    constexpr double K(const int l, const int m)
+    {
+      return ((m > 0) ? sqrt(2.0) : 1.0) *
+             sqrt( (2*l + 1) / (4.0 * PI) * factorial(l - m) / factorial(l + m));
+    }
+
+    /** Cosine lobe convolution of the band l (A_l of the paper) */
+    constexpr double A(const int l)
+    {
+      return (0 == l) ? PI :
+             (1 == l) ? 2.0 * PI / 3.0 :
+             (l & 1)  ? 0.0 :
+             2.0 * PI * (((l/2) & 1) ? 1.0 : -1.0) / ((l + 2) * (l - 1)) *
+             factorial(l) / (factorial(l/2) * factorial(l/2) * double(1 << l));
+    }
+
+    /** Band of the coefficient i */
+    constexpr int band(const int i, const int l=0)
+    {
+      return ((l+1) * (l+1) > i) ? l : band( i, l+1);
+    }
+  } //namespace SHConstants
+
+
+  /** Calls f(std::integral_constant<int, i>) for i in [0, N) */
+  template<int N>
+  struct Unroll
+  {
+    template<typename F>
+    static inline void run(F &&f)
+    {
+      Unroll<N-1>::run(f);
+      f( std::integral_constant<int, N-1>() );
+    }
+  };
+
+  template<>
+  struct Unroll<0>
+  {
+    template<typename F>
+    static inline void run(F &&) {}
+  };
+
+
+  /** Real SH basis of order Order, evaluated on any arithmetic type T
+   *  (float or a vector extension type) */
+  template<int Order>
+  struct SHBasis
+  {
+    static_assert( (Order >= 1) && (Order <= SH_MAX_ORDER), "unsupported SH order");
+
+    enum { ORDER = Order, NUM_COEFFS = (Order + 1) * (Order + 1) };
+
+    /** Evaluate Y[0..NUM_COEFFS-1] on the normalized direction (x, y, z) */
+    template<typename T>
+    static inline void evaluate(const T x, const T y, const T z, T Y[NUM_COEFFS])
+    {
+      T cm = T{} + 1.0f;
+      T sm = T{};
+
+      Unroll<Order+1>::run( [&](auto M)
+      {
+        constexpr int m = decltype(M)::value;
+
+        if constexpr (m > 0)
+        {
+          const T c = x * cm - y * sm;
+          sm = x * sm + y * cm;
+          cm = c;
+        }
+
+        T p2 = T{};
+        T p1 = T{} + float(SHConstants::doubleFactorial( 2*m - 1 ));
+
+        Unroll<Order-m+1>::run( [&](auto L)
+        {
+          constexpr int l = m + decltype(L)::value;
+
+          if constexpr (l > m)
+          {
+            constexpr float a = float(2*l - 1) / float(l - m);
+            constexpr float b = float(l + m - 1) / float(l - m);
+            const T p = a * z * p1 - b * p2;
+            p2 = p1;
+            p1 = p;
+          }
+
+          constexpr float k = float(SHConstants::K( l, m));
+          if constexpr (0 == m) {
+            Y[l*(l+1)] = k * p1;
+          } else {
+            Y[l*(l+1) + m] = (k * p1) * cm;
+            Y[l*(l+1) - m] = (k * p1) * sm;
+          }
+        });
+      });
+    }
+  };
+
+
+  /** Coefficients of an order in the basis of SHBasis<Order>, stored by 
+   *  channel (cf. irradianceSHAlgebra.hpp for their operations) */
+  template<int Order, int Channels=3>
+  struct SHCoeffs
+  {
+    enum 
+    { 
+      ORDER = Order, 
+      CHANNELS = Channels,
+      NUM_COEFFS = SHBasis<Order>::NUM_COEFFS,
+      SIZE = Channels * NUM_COEFFS
+    };
+    float coeffs[Channels][NUM_COEFFS];
+  };
+
+  /** RGB coefficients of an order */
+  template<int Order>
+  using SH_t = SHCoeffs<Order, 3>;
+
+
+  /** Project a cubemap on the SH basis of order Order, with the same
+   *  normalization as prefilter. The result does not depend on the number
+   *  of threads used. */
+  template<int Order>
+  void prefilter( const Image_t envmap[6], SH_t<Order> &sh, ThreadPool &pool);
+
+  /** Same as above for faces viewed in place (cf. getCubemapFaces) */
+  template<int Order>
+  void prefilter( const ImageView_t envmap[6], SH_t<Order> &sh, ThreadPool &pool);
+
+  /** Convolve radiance coefficients by the cosine lobe, giving irradiance
+   *  coefficients (cf. equation 7 from the paper) */
+  template<int Order>
+  void convolveIrradiance( SH_t<Order> &sh );
+
+  /** Evaluate coefficients on the normalized direction n */
+  template<int Order>
+  glm::vec3 evaluate( const SH_t<Order> &sh, const glm::vec3 &n);
+
+  /** Fold the basis normalization in irradiance coefficients, for the
+   *  uSHIrradiance uniform of EnvMapping.Vertex.SH */
+  template<int Order>
+  void getShaderCoefficients( const SH_t<Order> &sh, glm::vec3 out[SH_t<Order>::NUM_COEFFS]);
+
+  /** Irradiance coefficients of order 1 (L1) of irradiance matrices : the
+   *  bands 0 and 1 of the matrices, which need no projection of their own
+   *  (for EnvMapping.Vertex.L1) */
+  void getL1Irradiance( const glm::mat4 M[3], SH_t<1> &sh);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCESH_HPP
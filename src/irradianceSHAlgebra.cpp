@@ -0,0 +1,376 @@
+/**
+ *
+ *      \file irradianceSHAlgebra.cpp
+ *
+ */
+
+
+#include "irradianceSHAlgebra.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#include "irradianceEnvMap.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// GCC vector of a block of probes (lowered to the SSE / NEON registers available)
+typedef float SHAVec_t __attribute__((vector_size(SH_ALGEBRA_BLOCK_SIZE * sizeof(float))));
+
+/// Gaunt coefficients smaller than this are considered null
+static const double GAUNT_EPSILON = 1.0e-6;
+
+
+namespace {
+
+/// Non zero Gaunt coefficient g = int Y_i Y_j Y_k, with i <= j
+struct GauntEntry_t
+{
+  uint16_t i, j, k;
+  float g;
+};
+
+/// Gaunt coefficients of an order, i == j and i < j apart
+struct GauntTable_t
+{
+  std::vector<GauntEntry_t> diagonal;
+  std::vector<GauntEntry_t> offDiagonal;
+};
+
+} //namespace
+
+
+static inline
+SHAVec_t vload( const float *p )
+{
+  SHAVec_t v;
+  memcpy( &v, p, sizeof(v));
+  return v;
+}
+
+static inline
+void vstore( float *p, const SHAVec_t v)
+{
+  memcpy( p, &v, sizeof(v));
+}
+
+/// First float of an array of coefficients
+template<int Order, int Channels>
+static inline
+const float* getData( const SHCoeffs<Order, Channels> a[] )
+{
+  return reinterpret_cast<const float*>(a);
+}
+
+template<int Order, int Channels>
+static inline
+float* getData( SHCoeffs<Order, Channels> a[] )
+{
+  return reinterpret_cast<float*>(a);
+}
+
+
+/// Nodes & weights of the n points Gauss-Legendre quadrature on [-1, 1]
+static
+void getGaussLegendre( const int n, std::vector<double> &nodes, std::vector<double> &weights)
+{
+  nodes.resize( n );
+  weights.resize( n );
+
+  for (int i=0; i<n; ++i)
+  {
+    // Newton iterations on P_n from the Chebyshev approximation of the root
+    double x = cos( M_PI * (i + 0.75) / (n + 0.5) );
+    double dp = 1.0;
+
+    for (int it=0; it<100; ++it)
+    {
+      double p0 = 1.0, p1 = x;
+      for (int l=2; l<=n; ++l)
+      {
+        const double p = ((2*l - 1) * x * p1 - (l - 1) * p0) / l;
+        p0 = p1;
+        p1 = p;
+      }
+      dp = n * (x * p1 - p0) / (x * x - 1.0);
+
+      const double dx = p1 / dp;
+      x -= dx;
+      if (fabs(dx) < 1.0e-15) {
+        break;
+      }
+    }
+
+    nodes[i] = x;
+    weights[i] = 2.0 / ((1.0 - x * x) * dp * dp);
+  }
+}
+
+/// Gaunt coefficients of an order, computed on first use. The integrand is
+/// a polynomial of degree at most 3 * Order, integrated exactly by a
+/// Gauss-Legendre quadrature in z and a uniform one in phi.
+template<int Order>
+static
+const GauntTable_t& getGauntTable()
+{
+  static const GauntTable_t sTable = []()
+  {
+    const int N = SHBasis<Order>::NUM_COEFFS;
+    const int numZ = 2 * Order + 2;
+    const int numPhi = 4 * Order + 2;
+
+    std::vector<double> nodes, weights;
+    getGaussLegendre( numZ, nodes, weights);
+
+    // Symmetric tensor, for i <= j <= k only
+    std::vector<double> T( N * N * N, 0.0 );
+
+    for (int iz=0; iz<numZ; ++iz) {
+      for (int ip=0; ip<numPhi; ++ip)
+      {
+        const double z = nodes[iz];
+        const double r = sqrt( 1.0 - z * z );
+        const double phi = 2.0 * M_PI * ip / numPhi;
+        const double w = weights[iz] * 2.0 * M_PI / numPhi;
+
+        double Y[N];
+        SHBasis<Order>::evaluate( r * cos(phi), r * sin(phi), z, Y);
+
+        for (int i=0; i<N; ++i) {
+          for (int j=i; j<N; ++j)
+          {
+            const double yij = w * Y[i] * Y[j];
+            for (int k=j; k<N; ++k) {
+              T[(i * N + j) * N + k] += yij * Y[k];
+            }
+          }
+        }
+      }
+    }
+
+    GauntTable_t table;
+    for (int k=0; k<N; ++k) {
+      for (int i=0; i<N; ++i) {
+        for (int j=i; j<N; ++j)
+        {
+          int s[3] = { i, j, k };
+          std::sort( s, s + 3);
+          const double g = T[(s[0] * N + s[1]) * N + s[2]];
+
+          if (fabs(g) > GAUNT_EPSILON)
+          {
+            const GauntEntry_t entry = { uint16_t(i), uint16_t(j), uint16_t(k), float(g) };
+            (i == j) ? table.diagonal.push_back( entry ) : table.offDiagonal.push_back( entry );
+          }
+        }
+      }
+    }
+
+    return table;
+  }();
+
+  return sTable;
+}
+
+
+template<int Order, int Channels>
+void add( const SHCoeffs<Order, Channels> a[], const SHCoeffs<Order, Channels> b[],
+          SHCoeffs<Order, Channels> out[], const size_t count)
+{
+  const float *pa = getData( a );
+  const float *pb = getData( b );
+  float *pout = getData( out );
+
+  const size_t n = count * SHCoeffs<Order, Channels>::SIZE;
+  size_t i = 0u;
+
+  for (; i+SH_ALGEBRA_BLOCK_SIZE<=n; i+=SH_ALGEBRA_BLOCK_SIZE) {
+    vstore( pout + i, vload( pa + i ) + vload( pb + i ));
+  }
+  for (; i<n; ++i) {
+    pout[i] = pa[i] + pb[i];
+  }
+}
+
+template<int Order, int Channels>
+void scale( const SHCoeffs<Order, Channels> a[], const float s,
+            SHCoeffs<Order, Channels> out[], const size_t count)
+{
+  const float *pa = getData( a );
+  float *pout = getData( out );
+
+  const size_t n = count * SHCoeffs<Order, Channels>::SIZE;
+  size_t i = 0u;
+
+  for (; i+SH_ALGEBRA_BLOCK_SIZE<=n; i+=SH_ALGEBRA_BLOCK_SIZE) {
+    vstore( pout + i, s * vload( pa + i ));
+  }
+  for (; i<n; ++i) {
+    pout[i] = s * pa[i];
+  }
+}
+
+template<int Order, int Channels>
+void lerp( const SHCoeffs<Order, Channels> a[], const SHCoeffs<Order, Channels> b[],
+           const float t, SHCoeffs<Order, Channels> out[], const size_t count)
+{
+  const float *pa = getData( a );
+  const float *pb = getData( b );
+  float *pout = getData( out );
+
+  const size_t n = count * SHCoeffs<Order, Channels>::SIZE;
+  size_t i = 0u;
+
+  for (; i+SH_ALGEBRA_BLOCK_SIZE<=n; i+=SH_ALGEBRA_BLOCK_SIZE)
+  {
+    const SHAVec_t va = vload( pa + i );
+    vstore( pout + i, va + t * (vload( pb + i ) - va));
+  }
+  for (; i<n; ++i) {
+    pout[i] = pa[i] + t * (pb[i] - pa[i]);
+  }
+}
+
+template<int Order, int Channels>
+void convolve( const SHCoeffs<Order, Channels> a[], const float zonal[Order+1],
+               SHCoeffs<Order, Channels> out[], const size_t count)
+{
+  typedef SHCoeffs<Order, Channels> SH;
+
+  /// Factors of the coefficients of a block of probes, so that a block is
+  /// multiplied by SH::SIZE vectors
+  float factors[SH_ALGEBRA_BLOCK_SIZE * SH::SIZE];
+  for (int k=0; k<SH::NUM_COEFFS; ++k)
+  {
+    const int l = SHConstants::band( k );
+    const float f = float(sqrt( 4.0 * M_PI / (2*l + 1) )) * zonal[l];
+
+    for (int i=0; i<SH_ALGEBRA_BLOCK_SIZE * Channels; ++i) {
+      factors[i * SH::NUM_COEFFS + k] = f;
+    }
+  }
+
+  const float *pa = getData( a );
+  float *pout = getData( out );
+  const size_t blockSize = SH_ALGEBRA_BLOCK_SIZE * SH::SIZE;
+  const size_t n = count * SH::SIZE;
+  size_t i = 0u;
+
+  for (; i+blockSize<=n; i+=blockSize) {
+    for (size_t v=0u; v<blockSize; v+=SH_ALGEBRA_BLOCK_SIZE) {
+      vstore( pout + i + v, vload( pa + i + v ) * vload( factors + v ));
+    }
+  }
+  for (; i<n; ++i) {
+    pout[i] = pa[i] * factors[i % blockSize];
+  }
+}
+
+template<int Order, int Channels>
+void multiply( const SHCoeffs<Order, Channels> a[], const SHCoeffs<Order, Channels> b[],
+               SHCoeffs<Order, Channels> out[], const size_t count)
+{
+  const int N = SHCoeffs<Order, Channels>::NUM_COEFFS;
+  const GauntTable_t &table = getGauntTable<Order>();
+
+  for (size_t first=0u; first<count; first+=SH_ALGEBRA_BLOCK_SIZE)
+  {
+    const int numProbes = int(std::min( size_t(SH_ALGEBRA_BLOCK_SIZE), count - first));
+
+    for (int c=0; c<Channels; ++c)
+    {
+      /// Coefficients of the block, lane p being the probe first + p
+      SHAVec_t va[N], vb[N], vout[N];
+      for (int k=0; k<N; ++k)
+      {
+        va[k] = vb[k] = vout[k] = SHAVec_t{};
+        for (int p=0; p<numProbes; ++p)
+        {
+          va[k][p] = a[first + p].coeffs[c][k];
+          vb[k][p] = b[first + p].coeffs[c][k];
+        }
+      }
+
+      for (const GauntEntry_t &e : table.diagonal) {
+        vout[e.k] += e.g * (va[e.i] * vb[e.i]);
+      }
+      for (const GauntEntry_t &e : table.offDiagonal) {
+        vout[e.k] += e.g * (va[e.i] * vb[e.j] + va[e.j] * vb[e.i]);
+      }
+
+      for (int k=0; k<N; ++k) {
+        for (int p=0; p<numProbes; ++p) {
+          out[first + p].coeffs[c][k] = vout[k][p];
+        }
+      }
+    }
+  }
+}
+
+template<int Order>
+void getCosineLobe( float zonal[Order+1] )
+{
+  for (int l=0; l<=Order; ++l) {
+    zonal[l] = float(SHConstants::A( l ) / sqrt( 4.0 * M_PI / (2*l + 1) ));
+  }
+}
+
+template<int Order>
+size_t getNumGauntCoefficients()
+{
+  const GauntTable_t &table = getGauntTable<Order>();
+  return table.diagonal.size() + table.offDiagonal.size();
+}
+
+void getIrradianceMatrices( const SHCoeffs<2, 3> sh[], glm::mat4 (*M)[3], const size_t count)
+{
+  for (size_t i=0u; i<count; ++i) {
+    setIrradianceMatrices( sh[i].coeffs, M[i]);
+  }
+}
+
+void getRadianceCoefficients( const glm::mat4 (*M)[3], SHCoeffs<2, 3> sh[], const size_t count)
+{
+  for (size_t i=0u; i<count; ++i) {
+    getSHCoefficients( M[i], sh[i].coeffs);
+  }
+}
+
+
+#define IEM_INSTANTIATE_SH_ALGEBRA(Order, Channels)                                           \
+  template void add<Order, Channels>( const SHCoeffs<Order, Channels>[],                      \
+    const SHCoeffs<Order, Channels>[], SHCoeffs<Order, Channels>[], const size_t);            \
+  template void scale<Order, Channels>( const SHCoeffs<Order, Channels>[], const float,       \
+    SHCoeffs<Order, Channels>[], const size_t);                                               \
+  template void lerp<Order, Channels>( const SHCoeffs<Order, Channels>[],                     \
+    const SHCoeffs<Order, Channels>[], const float, SHCoeffs<Order, Channels>[], const size_t); \
+  template void convolve<Order, Channels>( const SHCoeffs<Order, Channels>[], const float[],  \
+    SHCoeffs<Order, Channels>[], const size_t);                                               \
+  template void multiply<Order, Channels>( const SHCoeffs<Order, Channels>[],                 \
+    const SHCoeffs<Order, Channels>[], SHCoeffs<Order, Channels>[], const size_t);
+
+#define IEM_INSTANTIATE_SH_ORDER(Order)                                                       \
+  IEM_INSTANTIATE_SH_ALGEBRA(Order, 1)                                                        \
+  IEM_INSTANTIATE_SH_ALGEBRA(Order, 3)                                                        \
+  template void getCosineLobe<Order>( float[] );                                              \
+  template size_t getNumGauntCoefficients<Order>();
+
+IEM_INSTANTIATE_SH_ORDER(1)
+IEM_INSTANTIATE_SH_ORDER(2)
+IEM_INSTANTIATE_SH_ORDER(3)
+IEM_INSTANTIATE_SH_ORDER(4)
+IEM_INSTANTIATE_SH_ORDER(5)
+IEM_INSTANTIATE_SH_ORDER(6)
+IEM_INSTANTIATE_SH_ORDER(7)
+IEM_INSTANTIATE_SH_ORDER(8)
+
+#undef IEM_INSTANTIATE_SH_ORDER
+#undef IEM_INSTANTIATE_SH_ALGEBRA
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,126 @@
+/**
+ *
+ *      \file irradianceSHAlgebra.hpp
+ *
+ *      Operations on arrays of SHCoeffs, to blend, filter and combine many
+ *      probes without going through the irradiance matrices.
+ *
+ *      The coefficients of an array are contiguous floats, so the linear
+ *      operations run on the whole array by SIMD vectors, as the convolution
+ *      whose factors are repeated along blocks of SH_ALGEBRA_BLOCK_SIZE
+ *      probes. The product transposes such blocks, each vector lane holding
+ *      the same coefficient of a different probe.
+ *
+ *      A zonal kernel h (symmetric around +z) is given by its coefficients
+ *      h_l = h_l,0, the convolution of f by h being (Funk-Hecke) :
+ *
+ *        (f * h)_l,m = sqrt(4pi / (2l + 1)) h_l f_l,m
+ *
+ *      The product of two functions is projected back to the order of its
+ *      factors by the Gaunt coefficients of the basis (integrals of triple
+ *      products), computed once per order by an exact quadrature :
+ *
+ *        (f g)_k = sum_ij  f_i g_j  int Y_i Y_j Y_k
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCESHALGEBRA_HPP
+#define IRRADIANCESHALGEBRA_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "irradianceSH.hpp"
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Probes processed together by convolve & multiply */
+  const int SH_ALGEBRA_BLOCK_SIZE = 4;
+
+  /** out[i] = a[i] + b[i] */
+  template<int Order, int Channels>
+  void add( const SHCoeffs<Order, Channels> a[], const SHCoeffs<Order, Channels> b[],
+            SHCoeffs<Order, Channels> out[], const size_t count);
+
+  /** out[i] = s * a[i] */
+  template<int Order, int Channels>
+  void scale( const SHCoeffs<Order, Channels> a[], const float s,
+              SHCoeffs<Order, Channels> out[], const size_t count);
+
+  /** out[i] = a[i] + t * (b[i] - a[i]) */
+  template<int Order, int Channels>
+  void lerp( const SHCoeffs<Order, Channels> a[], const SHCoeffs<Order, Channels> b[],
+             const float t, SHCoeffs<Order, Channels> out[], const size_t count);
+
+  /** out[i] = a[i] * h, h being the zonal kernel of coefficients zonal[l] */
+  template<int Order, int Channels>
+  void convolve( const SHCoeffs<Order, Channels> a[], const float zonal[Order+1],
+                 SHCoeffs<Order, Channels> out[], const size_t count);
+
+  /** out[i] = a[i] b[i], projected on the order Order. out may not be a or b. */
+  template<int Order, int Channels>
+  void multiply( const SHCoeffs<Order, Channels> a[], const SHCoeffs<Order, Channels> b[],
+                 SHCoeffs<Order, Channels> out[], const size_t count);
+
+  /** Zonal coefficients of the clamped cosine lobe max(z, 0), whose
+   *  convolution is convolveIrradiance */
+  template<int Order>
+  void getCosineLobe( float zonal[Order+1] );
+
+  /** Number of non zero Gaunt coefficients of an order, up to the symmetry
+   *  of the product */
+  template<int Order>
+  size_t getNumGauntCoefficients();
+
+  /** Set the irradiance matrices of 'count' radiance coefficients of order 2,
+   *  normalized as by prefilter (cf. setIrradianceMatrices) */
+  void getIrradianceMatrices( const SHCoeffs<2, 3> sh[], glm::mat4 (*M)[3], const size_t count);
+
+  /** Get back the radiance coefficients of 'count' irradiance matrices */
+  void getRadianceCoefficients( const glm::mat4 (*M)[3], SHCoeffs<2, 3> sh[], const size_t count);
+
+
+  /** Single set versions */
+  template<int Order, int Channels>
+  inline void add( const SHCoeffs<Order, Channels> &a, const SHCoeffs<Order, Channels> &b,
+                   SHCoeffs<Order, Channels> &out)
+  {
+    add( &a, &b, &out, 1u);
+  }
+
+  template<int Order, int Channels>
+  inline void scale( const SHCoeffs<Order, Channels> &a, const float s,
+                     SHCoeffs<Order, Channels> &out)
+  {
+    scale( &a, s, &out, 1u);
+  }
+
+  template<int Order, int Channels>
+  inline void lerp( const SHCoeffs<Order, Channels> &a, const SHCoeffs<Order, Channels> &b,
+                    const float t, SHCoeffs<Order, Channels> &out)
+  {
+    lerp( &a, &b, t, &out, 1u);
+  }
+
+  template<int Order, int Channels>
+  inline void convolve( const SHCoeffs<Order, Channels> &a, const float zonal[Order+1],
+                        SHCoeffs<Order, Channels> &out)
+  {
+    convolve( &a, zonal, &out, 1u);
+  }
+
+  template<int Order, int Channels>
+  inline void multiply( const SHCoeffs<Order, Channels> &a, const SHCoeffs<Order, Channels> &b,
+                        SHCoeffs<Order, Channels> &out)
+  {
+    multiply( &a, &b, &out, 1u);
+  }
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCESHALGEBRA_HPP
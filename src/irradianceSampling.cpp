@@ -0,0 +1,283 @@
+/**
+ *
+ *      \file irradianceSampling.cpp
+ *
+ */
+
+
+#include "irradianceSampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#include <tools/ThreadPool.hpp>
+#include "irradianceEnvMap.hpp"
+#include "irradiancePixelFormat.hpp"
+#include "irradianceSH.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Number of samples projected by a single task
+static const int SAMPLING_CHUNK_SIZE = 1024;
+
+/// Seed of the rotations of the sample sets
+static const uint64_t SAMPLING_SEED = 0x2545f4914f6cdd1dull;
+
+
+namespace {
+
+/// Partial sums of a task
+struct SamplePartial_t
+{
+  double shCoeff[3][9];
+};
+
+} //namespace
+
+
+/// Uniform value in [0, 1) from a 64-bit state (splitmix64)
+static
+double nextUniform( uint64_t &state )
+{
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/// Uniformly distributed rotation of the sample set 'replica'
+/// (from the random unit quaternion of K. Shoemake's "Uniform random
+/// rotations", Graphics Gems III)
+static
+void getReplicaRotation( const int replica, float R[3][3] )
+{
+  uint64_t state = SAMPLING_SEED + uint64_t(replica);
+
+  const double u1 = nextUniform( state );
+  const double u2 = 2.0 * M_PI * nextUniform( state );
+  const double u3 = 2.0 * M_PI * nextUniform( state );
+
+  const double a = sqrt( 1.0 - u1 );
+  const double b = sqrt( u1 );
+  const double x = a * sin(u2), y = a * cos(u2);
+  const double z = b * sin(u3), w = b * cos(u3);
+
+  R[0][0] = float(1.0 - 2.0*(y*y + z*z));
+  R[0][1] = float(2.0*(x*y - z*w));
+  R[0][2] = float(2.0*(x*z + y*w));
+  R[1][0] = float(2.0*(x*y + z*w));
+  R[1][1] = float(1.0 - 2.0*(x*x + z*z));
+  R[1][2] = float(2.0*(y*z - x*w));
+  R[2][0] = float(2.0*(x*z - y*w));
+  R[2][1] = float(2.0*(y*z + x*w));
+  R[2][2] = float(1.0 - 2.0*(x*x + y*y));
+}
+
+/// Bilinear lookup, colors not scaled (cf. PixelTraits::COLOR_SCALE)
+template<PixelFormat Format>
+static inline
+glm::vec3 lookup( const Image_t envmap[6], const float dx, const float dy, const float dz)
+{
+  typedef PixelTraits<Format> Traits;
+  const int NC = Traits::NUM_CHANNELS;
+
+  /// Face of the major axis, ordered as FACE_FRAMES
+  const float d[3] = { dx, dy, dz };
+  const float ax = fabsf(dx), ay = fabsf(dy), az = fabsf(dz);
+  const int axis = ((ax >= ay) & (ax >= az)) ? 0 : (ay >= az) ? 1 : 2;
+  const int texId = 2 * axis + (d[axis] < 0.0f);
+
+  const float (*axes)[3] = FACE_FRAMES[texId];
+  const float invMajor = 1.0f / (axes[0][0] * dx + axes[0][1] * dy + axes[0][2] * dz);
+  const float u = (axes[1][0] * dx + axes[1][1] * dy + axes[1][2] * dz) * invMajor;
+  const float v = (axes[2][0] * dx + axes[2][1] * dy + axes[2][2] * dz) * invMajor;
+
+  /// Texel coordinates, texel centers being at integer positions
+  const Image_t &face = envmap[texId];
+  const int texRes = face.width;
+  const float maxCoord = float(texRes - 1);
+  const float x = std::min( std::max( 0.5f * (u + 1.0f) * texRes - 0.5f, 0.0f), maxCoord);
+  const float y = std::min( std::max( 0.5f * (v + 1.0f) * texRes - 0.5f, 0.0f), maxCoord);
+
+  const int x0 = int(x), y0 = int(y);
+  const int x1 = std::min( x0 + 1, texRes - 1);
+  const int y1 = std::min( y0 + 1, texRes - 1);
+  const float fx = x - x0, fy = y - y0;
+
+  const typename Traits::Channel_t *pixels =
+    reinterpret_cast<const typename Traits::Channel_t*>(face.data);
+  const typename Traits::Channel_t *p00 = pixels + (size_t(y0) * texRes + x0) * NC;
+  const typename Traits::Channel_t *p01 = pixels + (size_t(y0) * texRes + x1) * NC;
+  const typename Traits::Channel_t *p10 = pixels + (size_t(y1) * texRes + x0) * NC;
+  const typename Traits::Channel_t *p11 = pixels + (size_t(y1) * texRes + x1) * NC;
+
+  glm::vec3 color;
+  for (int c=0; c<3; ++c)
+  {
+    const float top    = toFloat( p00[c] ) + fx * (toFloat( p01[c] ) - toFloat( p00[c] ));
+    const float bottom = toFloat( p10[c] ) + fx * (toFloat( p11[c] ) - toFloat( p10[c] ));
+    color[c] = top + fy * (bottom - top);
+  }
+
+  return color;
+}
+
+/// Project the samples [first, last) of a rotated set of n samples
+template<PixelFormat Format>
+static
+void projectSamples( const Image_t envmap[6], const float R[3][3], const int n,
+                     const int first, const int last, SamplePartial_t *partial)
+{
+  const double goldenAngle = M_PI * (3.0 - sqrt(5.0));
+  const double cosStep = cos(goldenAngle), sinStep = sin(goldenAngle);
+
+  double acc[3][9] = {};
+
+  /// phi_i is incremented by rotating (cos phi, sin phi) from the chunk start
+  const double phi0 = fmod( first * goldenAngle, 2.0 * M_PI );
+  double cosPhi = cos(phi0), sinPhi = sin(phi0);
+
+  for (int i=first; i<last; ++i)
+  {
+    const float z = 1.0f - (2.0f * i + 1.0f) / float(n);
+    const float r = sqrtf( std::max( 0.0f, 1.0f - z * z));
+    const float x = r * float(cosPhi);
+    const float y = r * float(sinPhi);
+
+    const double c = cosPhi * cosStep - sinPhi * sinStep;
+    sinPhi = sinPhi * cosStep + cosPhi * sinStep;
+    cosPhi = c;
+
+    const float dx = R[0][0] * x + R[0][1] * y + R[0][2] * z;
+    const float dy = R[1][0] * x + R[1][1] * y + R[1][2] * z;
+    const float dz = R[2][0] * x + R[2][1] * y + R[2][2] * z;
+
+    const glm::vec3 color = lookup<Format>( envmap, dx, dy, dz);
+
+    float Y[9];
+    SHBasis<2>::evaluate( dx, dy, dz, Y);
+
+    for (int k=0; k<9; ++k)
+    {
+      acc[0][k] += color.r * Y[k];
+      acc[1][k] += color.g * Y[k];
+      acc[2][k] += color.b * Y[k];
+    }
+  }
+
+  memcpy( partial->shCoeff, acc, sizeof(acc));
+}
+
+float prefilterSampled( const Image_t envmap[6], const int numSamples, glm::mat4 M[3],
+                        ThreadPool &pool)
+{
+  const PixelFormat format = getPixelFormat( envmap[0] );
+  if (NUM_PIXEL_FORMAT == format)
+  {
+    fprintf( stderr, "IrradianceEnvMap : unsupported pixel format.\n");
+    for (int c=0; c<3; ++c) {
+      M[c] = glm::mat4(0.0f);
+    }
+    return 0.0f;
+  }
+
+  const int R = SAMPLING_NUM_REPLICAS;
+  const int n = std::max( 1, (numSamples + R - 1) / R );
+  const int chunksPerSet = (n + SAMPLING_CHUNK_SIZE - 1) / SAMPLING_CHUNK_SIZE;
+
+  float rotations[SAMPLING_NUM_REPLICAS][3][3];
+  for (int r=0; r<R; ++r) {
+    getReplicaRotation( r, rotations[r]);
+  }
+
+  std::vector<SamplePartial_t> partials( size_t(R) * chunksPerSet );
+
+  dispatchPixelFormat( format, [&](auto F)
+  {
+    pool.parallelFor( partials.size(), [&](size_t taskId)
+    {
+      const int replica = taskId / chunksPerSet;
+      const int first = (taskId % chunksPerSet) * SAMPLING_CHUNK_SIZE;
+      const int last = std::min( first + SAMPLING_CHUNK_SIZE, n);
+
+      projectSamples<decltype(F)::value>( envmap, rotations[replica], n, first, last,
+                                          &partials[taskId]);
+    });
+  });
+
+  /// Matrices of each set, samples weighting 4pi/n and normalized as prefilter
+  const double dnorm = getColorScale( format ) * 2.0 * M_PI / n;
+  glm::mat4 replicaM[SAMPLING_NUM_REPLICAS][3];
+
+  for (int r=0; r<R; ++r)
+  {
+    double sums[3][9] = {};
+    for (int t=0; t<chunksPerSet; ++t) {
+      for (int c=0; c<3; ++c) {
+        for (int k=0; k<9; ++k) {
+          sums[c][k] += partials[r * chunksPerSet + t].shCoeff[c][k];
+        }
+      }
+    }
+
+    float shCoeff[3][9];
+    for (int c=0; c<3; ++c) {
+      for (int k=0; k<9; ++k) {
+        shCoeff[c][k] = float(dnorm * sums[c][k]);
+      }
+    }
+    setIrradianceMatrices( shCoeff, replicaM[r]);
+  }
+
+  /// Mean & standard error of the sets
+  float maxError = 0.0f;
+  float maxCoeff = 0.0f;
+
+  for (int c=0; c<3; ++c) {
+    for (int i=0; i<4; ++i) {
+      for (int j=0; j<4; ++j)
+      {
+        double mean = 0.0;
+        for (int r=0; r<R; ++r) {
+          mean += replicaM[r][c][i][j];
+        }
+        mean /= R;
+
+        double variance = 0.0;
+        for (int r=0; r<R; ++r) {
+          variance += (replicaM[r][c][i][j] - mean) * (replicaM[r][c][i][j] - mean);
+        }
+        variance /= (R - 1) * R;
+
+        M[c][i][j] = float(mean);
+        maxError = std::max( maxError, float(sqrt(variance)));
+        maxCoeff = std::max( maxCoeff, float(fabs(mean)));
+      }
+    }
+  }
+
+  return (maxCoeff > 0.0f) ? maxError / maxCoeff : maxError;
+}
+
+glm::vec3 sampleCubemap( const Image_t envmap[6], const glm::vec3 &d)
+{
+  glm::vec3 color( 0.0f );
+  const PixelFormat format = getPixelFormat( envmap[0] );
+
+  dispatchPixelFormat( format, [&](auto F)
+  {
+    color = float(getColorScale( format )) * lookup<decltype(F)::value>( envmap, d.x, d.y, d.z);
+  });
+
+  return color;
+}
+
+
+} //namespace IrradianceEnvMap
@@ -0,0 +1,55 @@
+/**
+ *
+ *      \file irradianceSampling.hpp
+ *
+ *      Projection of a cubemap from a fixed number of sample directions,
+ *      whose cost does not depend on its resolution.
+ *
+ *      The samples are spherical Fibonacci points, an almost uniform set of
+ *      equal area cells :
+ *
+ *        z_i = 1 - (2i + 1) / n,     phi_i = i * pi * (3 - sqrt(5))
+ *
+ *      each one reading the radiance with a bilinear lookup in its face, so
+ *      that every sample has the weight 4pi / n.
+ *
+ *      The samples are split in SAMPLING_NUM_REPLICAS sets, each one being
+ *      randomly rotated. The sets give independent estimates of the
+ *      coefficients, whose mean is the result and whose variance gives its
+ *      standard error.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCESAMPLING_HPP
+#define IRRADIANCESAMPLING_HPP
+
+#include <glm/glm.hpp>
+#include <tools/ImageLoader.hpp>
+
+class ThreadPool;
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Number of randomly rotated sample sets */
+  const int SAMPLING_NUM_REPLICAS = 8;
+
+  /** Compute the irradiance matrices of a cubemap from numSamples sample
+   *  directions (rounded up to a multiple of SAMPLING_NUM_REPLICAS). Return
+   *  the estimated standard error of the matrices coefficients, relative to
+   *  the largest one. The result does not depend on the number of threads. */
+  float prefilterSampled( const Image_t envmap[6], const int numSamples, glm::mat4 M[3],
+                          ThreadPool &pool);
+
+  /** Return the bilinearly interpolated color of the cubemap in the
+   *  direction d (not necessarily normalized), 8-bit colors being in [0, 1] */
+  glm::vec3 sampleCubemap( const Image_t envmap[6], const glm::vec3 &d);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCESAMPLING_HPP
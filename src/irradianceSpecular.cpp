@@ -0,0 +1,405 @@
+/**
+ *
+ *      \file irradianceSpecular.cpp
+ *
+ */
+
+
+#include "irradianceSpecular.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include <tools/ThreadPool.hpp>
+#include <tools/Timer.hpp>
+#include "irradianceKernels.hpp"
+#include "irradianceMipmap.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Samples processed together, on GCC vector types (lowered to the SSE /
+/// NEON registers available)
+static const int SPEC_VEC_WIDTH = 4;
+typedef float SpecVec_t __attribute__((vector_size(SPEC_VEC_WIDTH * sizeof(float))));
+
+
+namespace {
+
+/// GGX samples of a roughness in the tangent frame of N = V, as arrays
+/// padded to a multiple of SPEC_VEC_WIDTH
+struct SpecularSamples_t
+{
+  std::vector<float> x, y, z;       // directions L
+  std::vector<float> weight;        // N.L
+  std::vector<float> lod;           // source level read
+  int count;
+  float sumWeight;
+};
+
+} //namespace
+
+
+static inline
+SpecVec_t vload( const float *p )
+{
+  SpecVec_t v;
+  memcpy( &v, p, sizeof(v));
+  return v;
+}
+
+static inline
+void vstore( float *p, const SpecVec_t v)
+{
+  memcpy( p, &v, sizeof(v));
+}
+
+/// Van der Corput radical inverse in base 2
+static inline
+float getRadicalInverse( uint32_t bits )
+{
+  bits = (bits << 16u) | (bits >> 16u);
+  bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+  bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+  bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+  bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+  return float(bits) * 2.3283064365386963e-10f;
+}
+
+/// GGX half vector of the Hammersley point i of n, in the tangent frame
+static inline
+glm::vec3 sampleGGX( const int i, const int n, const float alpha)
+{
+  const float phi = 2.0f * M_PI * float(i) / float(n);
+  const float xi = getRadicalInverse( i );
+  const float a2 = alpha * alpha;
+
+  const float cosTheta = sqrtf( (1.0f - xi) / (1.0f + (a2 - 1.0f) * xi) );
+  const float sinTheta = sqrtf( 1.0f - cosTheta * cosTheta );
+
+  return glm::vec3( sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+}
+
+/// Samples of a roughness, the lookups of a source of resolution res and
+/// numSourceLevels levels
+static
+void getSpecularSamples( const float roughness, const int numSamples, const int res,
+                         const int numSourceLevels, SpecularSamples_t &samples)
+{
+  const float alpha = roughness * roughness;
+  const float a2 = alpha * alpha;
+  const float texelSolidAngle = 4.0f * M_PI / (6.0f * res * res);
+
+  samples.x.clear();
+  samples.y.clear();
+  samples.z.clear();
+  samples.weight.clear();
+  samples.lod.clear();
+  samples.sumWeight = 0.0f;
+
+  for (int i=0; i<numSamples; ++i)
+  {
+    const glm::vec3 H = sampleGGX( i, numSamples, alpha);
+    const float NdotH = H.z;
+    const glm::vec3 L = 2.0f * NdotH * H - glm::vec3( 0.0f, 0.0f, 1.0f);
+
+    if (L.z <= 0.0f) {
+      continue;
+    }
+
+    // pdf of L, D * N.H / (4 V.H) with N = V
+    const float d = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+    const float pdf = a2 / (4.0f * M_PI * d * d);
+    const float sampleSolidAngle = 1.0f / (numSamples * pdf);
+    const float lod = 0.5f * log2f( sampleSolidAngle / texelSolidAngle ) + 1.0f;
+
+    samples.x.push_back( L.x );
+    samples.y.push_back( L.y );
+    samples.z.push_back( L.z );
+    samples.weight.push_back( L.z );
+    samples.lod.push_back( std::min( std::max( lod, 0.0f), float(numSourceLevels - 1)) );
+    samples.sumWeight += L.z;
+  }
+
+  samples.count = int(samples.x.size());
+
+  const size_t padded = ((samples.count + SPEC_VEC_WIDTH - 1) / SPEC_VEC_WIDTH) * SPEC_VEC_WIDTH;
+  samples.x.resize( padded, 0.0f );
+  samples.y.resize( padded, 0.0f );
+  samples.z.resize( padded, 0.0f );
+  samples.weight.resize( padded, 0.0f );
+  samples.lod.resize( padded, 0.0f );
+}
+
+/// Bilinear fetch of a RGB32F face at (u, v) in [-1, 1]^2
+static inline
+glm::vec3 fetchBilinear( const Image_t &face, const float u, const float v)
+{
+  const int res = face.width;
+  const float x = std::min( std::max( 0.5f * (u + 1.0f) * res - 0.5f, 0.0f), float(res - 1));
+  const float y = std::min( std::max( 0.5f * (v + 1.0f) * res - 0.5f, 0.0f), float(res - 1));
+
+  const int x0 = int(x), y0 = int(y);
+  const int x1 = std::min( x0 + 1, res - 1), y1 = std::min( y0 + 1, res - 1);
+  const float fx = x - x0, fy = y - y0;
+
+  const float *pixels = reinterpret_cast<const float*>(face.data);
+  const float *p00 = pixels + 3u * (size_t(y0) * res + x0);
+  const float *p01 = pixels + 3u * (size_t(y0) * res + x1);
+  const float *p10 = pixels + 3u * (size_t(y1) * res + x0);
+  const float *p11 = pixels + 3u * (size_t(y1) * res + x1);
+
+  const glm::vec3 c00( p00[0], p00[1], p00[2] );
+  const glm::vec3 c01( p01[0], p01[1], p01[2] );
+  const glm::vec3 c10( p10[0], p10[1], p10[2] );
+  const glm::vec3 c11( p11[0], p11[1], p11[2] );
+
+  return glm::mix( glm::mix( c00, c01, fx), glm::mix( c10, c11, fx), fy);
+}
+
+/// Trilinear lookup of the source levels in the direction d
+static
+glm::vec3 sampleSource( const std::vector<const Image_t*> &source, const glm::vec3 &d,
+                        const float lod)
+{
+  const glm::vec3 a = glm::abs( d );
+  const int face = ((a.x >= a.y) && (a.x >= a.z)) ? ((d.x > 0.0f) ? 0 : 1) :
+                   (a.y >= a.z)                   ? ((d.y > 0.0f) ? 2 : 3) :
+                                                    ((d.z > 0.0f) ? 4 : 5);
+
+  // Inverse of d = N + u * U + v * V
+  const float (&frame)[3][3] = FACE_FRAMES[face];
+  const float ma = d.x * frame[0][0] + d.y * frame[0][1] + d.z * frame[0][2];
+  const float u = (d.x * frame[1][0] + d.y * frame[1][1] + d.z * frame[1][2]) / ma;
+  const float v = (d.x * frame[2][0] + d.y * frame[2][1] + d.z * frame[2][2]) / ma;
+
+  const int l0 = int(lod);
+  const int l1 = std::min( l0 + 1, int(source.size()) - 1);
+  const float t = lod - l0;
+
+  const glm::vec3 c0 = fetchBilinear( source[l0][face], u, v);
+  return (t > 0.0f) ? glm::mix( c0, fetchBilinear( source[l1][face], u, v), t) : c0;
+}
+
+/// Prefiltered color in the direction N, wx, wy & wz being buffers of the
+/// padded sample count
+static
+glm::vec3 prefilterTexel( const std::vector<const Image_t*> &source, const SpecularSamples_t &samples,
+                          const glm::vec3 &N, float *wx, float *wy, float *wz)
+{
+  const glm::vec3 up = (fabsf(N.z) < 0.999f) ? glm::vec3( 0.0f, 0.0f, 1.0f) : glm::vec3( 1.0f, 0.0f, 0.0f);
+  const glm::vec3 T = glm::normalize( glm::cross( up, N) );
+  const glm::vec3 B = glm::cross( N, T);
+
+  /// Samples to world space
+  for (int i=0; i<samples.count; i+=SPEC_VEC_WIDTH)
+  {
+    const SpecVec_t x = vload( &samples.x[i] );
+    const SpecVec_t y = vload( &samples.y[i] );
+    const SpecVec_t z = vload( &samples.z[i] );
+
+    vstore( wx + i, x * T.x + y * B.x + z * N.x);
+    vstore( wy + i, x * T.y + y * B.y + z * N.y);
+    vstore( wz + i, x * T.z + y * B.z + z * N.z);
+  }
+
+  glm::vec3 color( 0.0f );
+  for (int i=0; i<samples.count; ++i)
+  {
+    const glm::vec3 L( wx[i], wy[i], wz[i]);
+    color += samples.weight[i] * sampleSource( source, L, samples.lod[i]);
+  }
+
+  return color / samples.sumWeight;
+}
+
+
+void prefilterSpecular( const Image_t envmap[6], const int size, const int numSamples,
+                        std::vector< std::unique_ptr<Image_t[]> > &levels, ThreadPool &pool,
+                        std::vector<SpecularLevelStats_t> *stats)
+{
+  assert( (size > 0) && (numSamples > 0) );
+
+  Timer &timer = Timer::getInstance();
+
+  /// Source converted to RGB32F and its box-reduced levels
+  std::vector< std::unique_ptr<Image_t[]> > sourceLevels;
+  sourceLevels.emplace_back( new Image_t[6] );
+  reduceCubemap( envmap, 1, sourceLevels.back().get(), pool);
+
+  while ((0 == (sourceLevels.back()[0].width & 1)) && (sourceLevels.back()[0].width > 1))
+  {
+    const Image_t *parent = sourceLevels.back().get();
+    sourceLevels.emplace_back( new Image_t[6] );
+    reduceCubemap( parent, 2, sourceLevels.back().get(), pool);
+  }
+
+  std::vector<const Image_t*> source;
+  for (const std::unique_ptr<Image_t[]> &level : sourceLevels) {
+    source.push_back( level.get() );
+  }
+  const int sourceRes = envmap[0].width;
+
+  int numLevels = 1;
+  while ((size >> numLevels) > 0) {
+    ++numLevels;
+  }
+
+  levels.clear();
+
+  for (int l=0; l<numLevels; ++l)
+  {
+    const double tStart = timer.getAbsoluteTime();
+    const int levelSize = size >> l;
+    const float roughness = getSpecularRoughness( l, numLevels );
+
+    levels.emplace_back( new Image_t[6] );
+    Image_t *faces = levels.back().get();
+
+    for (int face=0; face<6; ++face)
+    {
+      faces[face].clean();
+      faces[face].target = GL_TEXTURE_2D;
+      faces[face].width = faces[face].height = levelSize;
+      faces[face].format = GL_RGB;
+      faces[face].internalFormat = GL_RGB32F;
+      faces[face].type = GL_FLOAT;
+      faces[face].bytesPerPixel = 3u * sizeof(float);
+      faces[face].data = new GLubyte[faces[face].getMemorySize()];
+    }
+
+    /// The level 0 is a single lookup, at the source level of its texels
+    SpecularSamples_t samples;
+    if (l > 0) {
+      getSpecularSamples( roughness, numSamples, sourceRes, int(source.size()), samples);
+    }
+    const float mirrorLod = std::min( std::max( log2f( float(sourceRes) / levelSize ), 0.0f),
+                                      float(source.size() - 1));
+
+    pool.parallelFor( 6u * levelSize, [&](size_t taskId)
+    {
+      const int face = int(taskId / levelSize);
+      const int i = int(taskId % levelSize);
+      const float v = 2.0f * (i + 0.5f) / levelSize - 1.0f;
+      const float (&frame)[3][3] = FACE_FRAMES[face];
+
+      std::vector<float> buffer( 3u * samples.x.size() );
+      float *row = reinterpret_cast<float*>(faces[face].data) + 3u * size_t(i) * levelSize;
+
+      for (int j=0; j<levelSize; ++j)
+      {
+        const float u = 2.0f * (j + 0.5f) / levelSize - 1.0f;
+        const glm::vec3 N = glm::normalize( glm::vec3( frame[0][0] + u * frame[1][0] + v * frame[2][0],
+                                                       frame[0][1] + u * frame[1][1] + v * frame[2][1],
+                                                       frame[0][2] + u * frame[1][2] + v * frame[2][2]) );
+
+        const glm::vec3 color = (0 == l) ? sampleSource( source, N, mirrorLod) :
+                                prefilterTexel( source, samples, N, &buffer[0],
+                                                &buffer[samples.x.size()],
+                                                &buffer[2u * samples.x.size()]);
+        row[3*j + 0] = color.r;
+        row[3*j + 1] = color.g;
+        row[3*j + 2] = color.b;
+      }
+    });
+
+    if (stats)
+    {
+      const SpecularLevelStats_t levelStats =
+      {
+        levelSize, roughness, (0 == l) ? 1 : numSamples, timer.getAbsoluteTime() - tStart
+      };
+      stats->push_back( levelStats );
+    }
+  }
+}
+
+
+void bakeBRDFTable( const int size, const int numSamples, Image_t &table, ThreadPool &pool)
+{
+  assert( (size > 0) && (numSamples > 0) );
+
+  table.clean();
+  table.target = GL_TEXTURE_2D;
+  table.width = table.height = size;
+  table.format = GL_RG;
+  table.internalFormat = GL_RG32F;
+  table.type = GL_FLOAT;
+  table.bytesPerPixel = 2u * sizeof(float);
+  table.data = new GLubyte[table.getMemorySize()];
+
+  const int padded = ((numSamples + SPEC_VEC_WIDTH - 1) / SPEC_VEC_WIDTH) * SPEC_VEC_WIDTH;
+
+  pool.parallelFor( size, [&](size_t taskId)
+  {
+    const int i = int(taskId);
+    const float roughness = (i + 0.5f) / size;
+    const float alpha = roughness * roughness;
+
+    // Smith-GGX geometry term with k = alpha / 2 (cf. the paper)
+    const float k = 0.5f * alpha;
+
+    /// Half vectors of the row, padded by null ones
+    std::vector<float> hx( padded, 0.0f ), hy( padded, 0.0f ), hz( padded, 0.0f );
+    for (int s=0; s<numSamples; ++s)
+    {
+      const glm::vec3 H = sampleGGX( s, numSamples, alpha);
+      hx[s] = H.x;
+      hy[s] = H.y;
+      hz[s] = H.z;
+    }
+
+    float *row = reinterpret_cast<float*>(table.data) + 2u * size_t(i) * size;
+    const SpecVec_t zero = SpecVec_t{};
+
+    for (int j=0; j<size; ++j)
+    {
+      const float NdotV = (j + 0.5f) / size;
+      const float vx = sqrtf( 1.0f - NdotV * NdotV );
+      const float vz = NdotV;
+      const float gv = NdotV / (NdotV * (1.0f - k) + k);
+
+      SpecVec_t accA = zero, accB = zero;
+
+      for (int s=0; s<padded; s+=SPEC_VEC_WIDTH)
+      {
+        const SpecVec_t x = vload( &hx[s] );
+        const SpecVec_t z = vload( &hz[s] );
+
+        // L = 2 (V.H) H - V
+        const SpecVec_t VdotH = vx * x + vz * z;
+        const SpecVec_t NdotL = 2.0f * VdotH * z - vz;
+        const SpecVec_t NdotH = z;
+
+        const SpecVec_t gl = NdotL / (NdotL * (1.0f - k) + k);
+        const SpecVec_t visibility = gv * gl * VdotH / (NdotH * NdotV);
+
+        const SpecVec_t f = 1.0f - VdotH;
+        const SpecVec_t f2 = f * f;
+        const SpecVec_t fresnel = f2 * f2 * f;
+
+        // Padding & samples below the horizon do not count
+        const SpecVec_t g = ((NdotL > zero) && (NdotH > zero)) ? visibility : zero;
+        accA += (1.0f - fresnel) * g;
+        accB += fresnel * g;
+      }
+
+      float a = 0.0f, b = 0.0f;
+      for (int lane=0; lane<SPEC_VEC_WIDTH; ++lane)
+      {
+        a += accA[lane];
+        b += accB[lane];
+      }
+      row[2*j + 0] = a / numSamples;
+      row[2*j + 1] = b / numSamples;
+    }
+  });
+}
+
+
+} //namespace IrradianceEnvMap
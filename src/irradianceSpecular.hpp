@@ -0,0 +1,78 @@
+/**
+ *
+ *      \file irradianceSpecular.hpp
+ *
+ *      GGX prefiltered mipmaps of a cubemap and the BRDF integration table
+ *      of the split-sum approximation (B. Karis, "Real Shading in Unreal
+ *      Engine 4", SIGGRAPH 2013), for glossy reflections :
+ *
+ *        specular = prefiltered(R, roughness) * (F0 * lut.x + lut.y)
+ *
+ *      The level l of a chain of n levels is prefiltered for the roughness
+ *      l / (n - 1), so that it is sampled with textureLod(envmap, R,
+ *      roughness * (n - 1)). The level 0 is the mirror reflection.
+ *
+ *      Each texel takes numSamples GGX importance samples (N = V = R, as in
+ *      the paper) with mip-filtered lookups (J. Krivanek & M. Colbert,
+ *      "Real-time Shading with Filtered Importance Sampling", EGSR 2008) :
+ *      a sample of density pdf reads the box-reduced source level whose
+ *      texels cover its solid angle 1 / (numSamples * pdf), which removes
+ *      most of the noise of low sample counts.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IRRADIANCESPECULAR_HPP
+#define IRRADIANCESPECULAR_HPP
+
+#include <memory>
+#include <vector>
+#include <tools/ImageLoader.hpp>
+
+class ThreadPool;
+
+/// GGX samples per texel of the specular mipmaps of the textures
+/// (when compiled with -DENABLE_IEM_SPECULAR_MIPMAP=1)
+#ifndef IEM_SPECULAR_SAMPLES
+#define IEM_SPECULAR_SAMPLES   64
+#endif
+
+
+namespace IrradianceEnvMap
+{
+
+  /** Timing of a prefiltered level */
+  struct SpecularLevelStats_t
+  {
+    int size;
+    float roughness;
+    int numSamples;           // per texel
+    double time;              // in milliseconds
+  };
+
+  /** Roughness of the level l of a chain of numLevels levels */
+  inline float getSpecularRoughness( const int level, const int numLevels )
+  {
+    return (numLevels > 1) ? float(level) / float(numLevels - 1) : 0.0f;
+  }
+
+  /** Prefilter the mipmaps of a cubemap, from size x size down to 1 x 1,
+   *  with numSamples GGX samples per texel. The faces of each level are
+   *  RGB32F 2D images (8-bit colors being mapped to [0, 1]), ready for
+   *  TextureCubemap::upload. The timing of each level is added to stats
+   *  (if not null). */
+  void prefilterSpecular( const Image_t envmap[6], const int size, const int numSamples,
+                          std::vector< std::unique_ptr<Image_t[]> > &levels, ThreadPool &pool,
+                          std::vector<SpecularLevelStats_t> *stats=0);
+
+  /** Bake the size x size BRDF integration table, cos(theta_v) along x and
+   *  the roughness along y, with numSamples GGX samples per texel. The
+   *  scale & bias of F0 are stored as a RG32F 2D image. */
+  void bakeBRDFTable( const int size, const int numSamples, Image_t &table, ThreadPool &pool);
+
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCESPECULAR_HPP
@@ -0,0 +1,456 @@
+/**
+ * 
+ *      \file irradianceWeightTable.cpp
+ * 
+ */
+ 
+
+#include "irradianceWeightTable.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include "irradianceKernels.hpp"
+
+
+namespace IrradianceEnvMap {
+
+
+/// Solid angle of the texel centered on (u, v), of half size 'h'
+static
+double getTexelSolidAngle( const double u, const double v, const double h)
+{
+  #define AREA(x, y)  atan2(x * y, sqrt(x * x + y * y + 1.0))
+  
+  const double x0 = u - h;
+  const double y0 = v - h;
+  const double x1 = u + h;
+  const double y1 = v + h;
+  
+  return (AREA(x0,y0) + AREA(x1,y1)) - (AREA(x0,y1) + AREA(x1,y0));
+  
+  #undef AREA
+}
+
+
+/// Number of tiles whose weights are shared by a batch (9 KB per tile)
+static const int TILE_BLOCK_SIZE = 8;
+
+/// Texels of an octant tile, by [channel][quadrant][row][column], quadrants 
+/// being (+a,+b), (-a,+b), (+a,-b), (-a,-b)
+template<typename Texel>
+struct TileBuffer_t
+{
+  typedef Texel Texels_t[3][4][WeightTable::TILE_SIZE][WeightTable::TILE_SIZE];
+};
+
+
+/// Copy the channels of the octant entries [iBegin, iEnd) x [jBegin, jEnd)
+template<PixelFormat Format>
+static
+void gatherTile( const ImageView_t &face, const int half, 
+                 const int iBegin, const int iEnd, const int jBegin, const int jEnd,
+                 typename TileBuffer_t<typename PixelTraits<Format>::Channel_t>::Texels_t &unswapped, 
+                 typename TileBuffer_t<typename PixelTraits<Format>::Channel_t>::Texels_t &swapped)
+{
+  typedef PixelTraits<Format> Traits;
+  typedef typename Traits::Channel_t Channel_t;
+  
+  const int NC = Traits::NUM_CHANNELS;
+  const size_t pitch = face.rowStride / sizeof(Channel_t);
+  const Channel_t *data = reinterpret_cast<const Channel_t*>(face.data);
+  
+  // Unswapped : rows v = +-q, columns u = +-p
+  for (int ii=iBegin; ii<iEnd; ++ii)
+  {
+    const int i = ii - iBegin;
+    const Channel_t *rowP = data + (half + ii) * pitch + (half + jBegin) * NC;
+    const Channel_t *rowN = data + (half - 1 - ii) * pitch + (half + jBegin) * NC;
+    
+    for (int j=0; j<jEnd-jBegin; ++j)
+    {
+      const int mirror = -(2*(jBegin + j) + 1) * NC;
+      const Channel_t *pP = rowP + j * NC;
+      const Channel_t *pN = rowN + j * NC;
+      
+      for (int c=0; c<3; ++c)
+      {
+        unswapped[c][0][i][j] = pP[c];
+        unswapped[c][1][i][j] = pP[mirror + c];
+        unswapped[c][2][i][j] = pN[c];
+        unswapped[c][3][i][j] = pN[mirror + c];
+      }
+    }
+  }
+  
+  // Swapped : rows v = +-p, columns u = +-q, read row by row
+  for (int jj=jBegin; jj<jEnd; ++jj)
+  {
+    const int j = jj - jBegin;
+    const Channel_t *rowP = data + (half + jj) * pitch + (half + iBegin) * NC;
+    const Channel_t *rowN = data + (half - 1 - jj) * pitch + (half + iBegin) * NC;
+    
+    for (int i=0; i<iEnd-iBegin; ++i)
+    {
+      const int mirror = -(2*(iBegin + i) + 1) * NC;
+      const Channel_t *pP = rowP + i * NC;
+      const Channel_t *pN = rowN + i * NC;
+      
+      for (int c=0; c<3; ++c)
+      {
+        swapped[c][0][i][j] = pP[c];
+        swapped[c][1][i][j] = pP[mirror + c];
+        swapped[c][2][i][j] = pN[c];
+        swapped[c][3][i][j] = pN[mirror + c];
+      }
+    }
+  }
+}
+
+static inline FoldTileFn getFoldTileFn( SIMDKernel kernel, unsigned char* )  { return getFoldTile( kernel ); }
+static inline FoldTileFloatFn getFoldTileFn( SIMDKernel kernel, float* )     { return getFoldTileFloat( kernel ); }
+
+
+WeightTable::WeightTable(const int texRes)
+  : m_texRes(texRes),
+    m_halfRes(texRes / 2),
+    m_numTileRows((texRes / 2 + TILE_SIZE - 1) / TILE_SIZE),
+    m_sumWeight(0.0)
+{
+  assert( 0 == (texRes & 1) );
+  
+  // Entries out of the octant keep a null weight
+  const size_t numTiles = (m_numTileRows * (m_numTileRows + 1)) / 2;
+  m_weights.resize( numTiles * TILE_WEIGHTS, 0.0f);
+  
+  const double h = 1.0 / texRes;
+  double sumWeight = 0.0;
+  
+  for (int ii=0; ii<m_halfRes; ++ii)
+  {
+    const int i = ii % TILE_SIZE;
+    const double q = (2*ii + 1) * h;
+    
+    for (int jj=0; jj<=ii; ++jj)
+    {
+      const int j = jj % TILE_SIZE;
+      const double p = (2*jj + 1) * h;
+      
+      // Diagonal entries are their own mirror along u=v
+      const double multiplicity = (jj == ii) ? 0.5 : 1.0;
+      const double dw = multiplicity * getTexelSolidAngle( p, q, h);
+      sumWeight += 8.0 * dw;
+      
+      const double invLength = 1.0 / sqrt( p*p + q*q + 1.0 );
+      const double a = p * invLength;
+      const double b = q * invLength;
+      const double c = invLength;
+      
+      float *w = const_cast<float*>(getTile( ii / TILE_SIZE, jj / TILE_SIZE));
+      w += i * NUM_WEIGHTS * TILE_SIZE + j;
+      
+      w[0*TILE_SIZE] = dw;
+      w[1*TILE_SIZE] = dw * a;
+      w[2*TILE_SIZE] = dw * b;
+      w[3*TILE_SIZE] = dw * c;
+      w[4*TILE_SIZE] = dw * a * b;
+      w[5*TILE_SIZE] = dw * b * c;
+      w[6*TILE_SIZE] = dw * a * c;
+      w[7*TILE_SIZE] = dw * a * a;
+      w[8*TILE_SIZE] = dw * b * b;
+    }
+  }
+  
+  m_sumWeight = 6.0 * sumWeight;
+  
+  // Fixed point weights, the largest of each monomial using 15 bits. The
+  // folding adds the products of the weights 1 & 2, 5 & 6 and 7 & 8 to the 
+  // same moments, so they share their scale.
+  m_fixedWeights.resize( m_weights.size() );
+  
+  const int scaleGroup[NUM_WEIGHTS] = { 0, 1, 1, 3, 4, 5, 5, 7, 7 };
+  float maxWeight[NUM_WEIGHTS] = {};
+  
+  for (size_t t=0u; t<m_weights.size(); t+=TILE_WEIGHTS) {
+    for (int e=0; e<TILE_SIZE*TILE_SIZE; ++e) {
+      for (int k=0; k<NUM_WEIGHTS; ++k) 
+      {
+        const float w = m_weights[t + ((e / TILE_SIZE)*NUM_WEIGHTS + k)*TILE_SIZE + (e % TILE_SIZE)];
+        float &groupMax = maxWeight[ scaleGroup[k] ];
+        groupMax = std::max( groupMax, fabsf( w ));
+      }
+    }
+  }
+  
+  for (int k=0; k<NUM_WEIGHTS; ++k)
+  {
+    const float groupMax = maxWeight[ scaleGroup[k] ];
+    const int shift = (groupMax > 0.0f) ? 14 - ilogb( groupMax ) : 0;
+    const double scale = ldexp( 1.0, shift);
+    
+    m_fixedScale[k] = 1.0 / scale;
+    m_fixedError[k] = 0.0;
+    
+    for (size_t t=0u; t<m_weights.size(); t+=TILE_WEIGHTS) {
+      for (int e=0; e<TILE_SIZE*TILE_SIZE; ++e) 
+      {
+        const size_t index = t + ((e / TILE_SIZE)*NUM_WEIGHTS + k)*TILE_SIZE + (e % TILE_SIZE);
+        const double w = m_weights[index] * scale;
+        const double fixed = std::min( std::max( round(w), -32767.0), 32767.0);
+        
+        m_fixedWeights[index] = int16_t(fixed);
+        m_fixedError[k] += fabs( fixed - w ) * m_fixedScale[k];
+      }
+    }
+  }
+}
+
+double WeightTable::getFixedErrorBound() const
+{
+  // Each entry folds 8 texels, of the same color in the worst case
+  double maxError = 0.0;
+  for (int k=0; k<NUM_WEIGHTS; ++k) {
+    maxError = std::max( maxError, 8.0 * m_fixedError[k]);
+  }
+  return maxError / (m_sumWeight / 6.0);
+}
+
+
+void WeightTable::projectTileRows( const ImageView_t *const faces[], const size_t count, 
+                                   const int firstTileRow, const int lastTileRow, 
+                                   const SIMDKernel kernel,
+                                   float (*moments)[3][NUM_WEIGHTS]) const
+{
+  dispatchPixelFormat( getPixelFormat( *faces[0] ), [&](auto format)
+  {
+    _projectTileRows<decltype(format)::value>( faces, count, firstTileRow, lastTileRow, 
+                                               kernel, moments);
+  });
+}
+
+template<PixelFormat Format>
+void WeightTable::_projectTileRows( const ImageView_t *const faces[], const size_t count, 
+                                    const int firstTileRow, const int lastTileRow, 
+                                    const SIMDKernel kernel,
+                                    float (*moments)[3][NUM_WEIGHTS]) const
+{
+/**
+ * For an entry (p, q), the 8 texels are, in the face frame :
+ *    (+-p, +-q) : "unswapped" texels, read along the octant row,
+ *    (+-q, +-p) : "swapped" texels, read along a column.
+ * 
+ * The texels of a tile are first gathered by channel, the swapped ones 
+ * transposed, so that the folding kernel reads both contiguously. 
+ * Entries out of the octant are left as is, their weights being null.
+ */
+ 
+  typedef typename PixelTraits<Format>::Channel_t Channel_t;
+  typedef typename PixelTraits<Format>::Texel_t Texel_t;
+  
+  typedef typename TileBuffer_t<Texel_t>::Texels_t TexelBuffer_t;
+  
+  // Half channels are widened once gathered
+  constexpr bool bHalf = !std::is_same<Channel_t, Texel_t>::value;
+  
+  assert( count <= MAX_BATCH_SIZE );
+  
+  const int half = m_halfRes;
+  const auto foldTile = getFoldTileFn( kernel, (Texel_t*)0 );
+  
+  alignas(64) typename TileBuffer_t<Channel_t>::Texels_t unswapped;
+  alignas(64) typename TileBuffer_t<Channel_t>::Texels_t swapped;
+  memset( unswapped, 0, sizeof(unswapped));
+  memset( swapped, 0, sizeof(swapped));
+  
+  alignas(64) typename TileBuffer_t<Texel_t>::Texels_t unswappedWide;
+  alignas(64) typename TileBuffer_t<Texel_t>::Texels_t swappedWide;
+  
+  TexelBuffer_t *unswappedTexels = &unswappedWide;
+  TexelBuffer_t *swappedTexels = &swappedWide;
+  if constexpr (!bHalf)
+  {
+    unswappedTexels = &unswapped;
+    swappedTexels = &swapped;
+  }
+  
+  for (int ti=firstTileRow; ti<lastTileRow; ++ti)
+  {
+    const int iBegin = ti * TILE_SIZE;
+    const int iEnd = std::min( iBegin + TILE_SIZE, half);
+    
+    // The faces share the weights of a block of tiles, kept in cache
+    for (int tjBlock=0; tjBlock<=ti; tjBlock+=TILE_BLOCK_SIZE)
+    {
+      const int tjEnd = std::min( tjBlock + TILE_BLOCK_SIZE, ti + 1);
+      
+      for (size_t b=0u; b<count; ++b)
+      {
+        for (int tj=tjBlock; tj<tjEnd; ++tj)
+        {
+          const int jBegin = tj * TILE_SIZE;
+          const int jEnd = std::min( jBegin + TILE_SIZE, iEnd);
+          
+          /// Gather the tile texels
+          gatherTile<Format>( *faces[b], half, iBegin, iEnd, jBegin, jEnd, unswapped, swapped);
+          
+          if constexpr (bHalf)
+          {
+            const size_t numTexels = sizeof(unswapped) / sizeof(Channel_t);
+            convertHalfToFloat( unswapped[0][0][0], numTexels, (*unswappedTexels)[0][0][0]);
+            convertHalfToFloat( swapped[0][0][0], numTexels, (*swappedTexels)[0][0][0]);
+          }
+          
+          /// Fold & weight them
+          const float *weights = getTile( ti, tj);
+          for (int c=0; c<3; ++c) {
+            foldTile( (*unswappedTexels)[c][0][0], (*swappedTexels)[c][0][0], weights, moments[b][c]);
+          }
+        }
+      }
+    }
+  }
+}
+
+
+void WeightTable::projectTileRowsFixed( const ImageView_t *const faces[], const size_t count, 
+                                        const int firstTileRow, const int lastTileRow, 
+                                        const SIMDKernel kernel,
+                                        int64_t (*moments)[3][NUM_WEIGHTS]) const
+{
+  switch (getPixelFormat( *faces[0] ))
+  {
+    case PIXEL_RGB8:
+      _projectTileRowsFixed<PIXEL_RGB8>( faces, count, firstTileRow, lastTileRow, kernel, moments);
+    break;
+    
+    case PIXEL_RGBA8:
+      _projectTileRowsFixed<PIXEL_RGBA8>( faces, count, firstTileRow, lastTileRow, kernel, moments);
+    break;
+    
+    default:
+      assert( !"fixed point projection of a non 8-bit cubemap" );
+    break;
+  }
+}
+
+template<PixelFormat Format>
+void WeightTable::_projectTileRowsFixed( const ImageView_t *const faces[], const size_t count, 
+                                         const int firstTileRow, const int lastTileRow, 
+                                         const SIMDKernel kernel,
+                                         int64_t (*moments)[3][NUM_WEIGHTS]) const
+{
+  /// Same traversal as _projectTileRows
+  assert( count <= MAX_BATCH_SIZE );
+  
+  const int half = m_halfRes;
+  const FoldTileFixedFn foldTile = getFoldTileFixed( kernel );
+  
+  alignas(64) TileBuffer_t<unsigned char>::Texels_t unswapped;
+  alignas(64) TileBuffer_t<unsigned char>::Texels_t swapped;
+  memset( unswapped, 0, sizeof(unswapped));
+  memset( swapped, 0, sizeof(swapped));
+  
+  for (int ti=firstTileRow; ti<lastTileRow; ++ti)
+  {
+    const int iBegin = ti * TILE_SIZE;
+    const int iEnd = std::min( iBegin + TILE_SIZE, half);
+    
+    for (int tjBlock=0; tjBlock<=ti; tjBlock+=TILE_BLOCK_SIZE)
+    {
+      const int tjEnd = std::min( tjBlock + TILE_BLOCK_SIZE, ti + 1);
+      
+      for (size_t b=0u; b<count; ++b)
+      {
+        for (int tj=tjBlock; tj<tjEnd; ++tj)
+        {
+          const int jBegin = tj * TILE_SIZE;
+          const int jEnd = std::min( jBegin + TILE_SIZE, iEnd);
+          
+          gatherTile<Format>( *faces[b], half, iBegin, iEnd, jBegin, jEnd, unswapped, swapped);
+          
+          const int16_t *weights = getFixedTile( ti, tj);
+          for (int c=0; c<3; ++c) {
+            foldTile( unswapped[c][0][0], swapped[c][0][0], weights, moments[b][c]);
+          }
+        }
+      }
+    }
+  }
+}
+
+
+void WeightTable::addFaceMoments( const int texId, const double moments[3][NUM_WEIGHTS], 
+                                  double shCoeff[3][9])
+{
+  // Face axes, in the order of the local coordinates (a, b, c)
+  const float (*frame)[3] = FACE_FRAMES[texId];
+  const float *axes[3] = { frame[1], frame[2], frame[0] };
+  
+  for (int ch=0; ch<3; ++ch)
+  {
+    const double *m = moments[ch];
+    
+    const double m0 = m[0];
+    const double local1[3] = { m[1], m[2], m[3] };
+    const double local2[3][3] = 
+    {
+      { m[7], m[4], m[6] },
+      { m[4], m[8], m[5] },
+      { m[6], m[5], m0 - m[7] - m[8] }
+    };
+    
+    // First & second order moments in the cubemap frame
+    double g1[3] = { 0.0, 0.0, 0.0 };
+    double g2[3][3] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+    
+    for (int i=0; i<3; ++i) 
+    {
+      for (int x=0; x<3; ++x) {
+        g1[x] += local1[i] * axes[i][x];
+      }
+      
+      for (int j=0; j<3; ++j) {
+        for (int x=0; x<3; ++x) {
+          for (int y=0; y<3; ++y) {
+            g2[x][y] += local2[i][j] * axes[i][x] * axes[j][y];
+          }
+        }
+      }
+    }
+    
+    // Cf. the Y0..Y8 basis
+    double *sh = shCoeff[ch];
+    sh[0] += SH_C0 * m0;
+    sh[1] += SH_C1 * g1[1];
+    sh[2] += SH_C1 * g1[2];
+    sh[3] += SH_C1 * g1[0];
+    sh[4] += SH_C2 * g2[0][1];
+    sh[5] += SH_C2 * g2[1][2];
+    sh[6] += SH_C3 * (3.0 * g2[2][2] - m0);
+    sh[7] += SH_C2 * g2[0][2];
+    sh[8] += SH_C4 * (g2[0][0] - g2[1][1]);
+  }
+}
+
+
+std::shared_ptr<const WeightTable> WeightTable::get(const int texRes)
+{
+  static std::mutex sMutex;
+  static std::map<int, std::shared_ptr<const WeightTable> > sCache;
+  
+  std::lock_guard<std::mutex> lock( sMutex );
+  
+  std::shared_ptr<const WeightTable> &table = sCache[texRes];
+  if (!table) {
+    table = std::make_shared<const WeightTable>( texRes );
+  }
+  
+  return table;
+}
+
+
+} //namespace IrradianceEnvMap
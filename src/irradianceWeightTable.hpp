@@ -0,0 +1,167 @@
+/**
+ * 
+ *      \file irradianceWeightTable.hpp
+ * 
+ *      Precomputed projection weights of a cubemap resolution.
+ * 
+ *      For a given resolution, the direction and solid angle of each texel 
+ *      are fixed, so the projection of a cubemap is a product of its [3 x N]
+ *      color plane by a [N x 9] weight matrix. 
+ * 
+ *      The matrix is stored in the frame of a face, (a, b, c) being the 
+ *      direction coordinates along its {U, V, N} axes (cf. FACE_FRAMES), 
+ *      using the monomials basis of the 2nd order SH space :
+ *      
+ *        dw * {1, a, b, c, ab, bc, ac, a^2, b^2}
+ *      
+ *      A face is symmetric with respect to the lines u=0, v=0 and u=v, so only
+ *      the octant 0 <= u <= v is kept : the 8 texels sharing an entry are 
+ *      first folded together then multiplied by its weights. The monomials 
+ *      moments of the faces are finally turned to SH coefficients in the 
+ *      cubemap frame.
+ *      
+ *      The octant is stored by packed square tiles (the lower triangle of
+ *      the diagonal ones padded with zero weights), in the order they are 
+ *      processed, like the panels of a blocked matrix product.
+ * 
+ *      The weights are also kept as 16-bit fixed point numbers, with a power
+ *      of 2 scale per monomial, for the exact integer projection of 8-bit 
+ *      cubemaps (cf. projectTileRowsFixed).
+ * 
+ *      Only even resolutions are supported.
+ * 
+ */
+ 
+
+#pragma once
+
+#ifndef IRRADIANCEWEIGHTTABLE_HPP
+#define IRRADIANCEWEIGHTTABLE_HPP
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+#include <tools/ImageView.hpp>
+#include "irradianceKernels.hpp"
+#include "irradiancePixelFormat.hpp"
+
+
+namespace IrradianceEnvMap
+{
+  
+  class WeightTable
+  {
+    public:
+      enum 
+      { 
+        NUM_WEIGHTS = 9,
+        TILE_SIZE = FOLD_TILE_SIZE,
+        TILE_WEIGHTS = TILE_SIZE * NUM_WEIGHTS * TILE_SIZE,
+        MAX_BATCH_SIZE = 16
+      };
+      
+    protected:
+      int m_texRes;
+      int m_halfRes;
+      int m_numTileRows;
+      
+      /** Weights of the octant, tile by tile */
+      std::vector<float> m_weights;
+      
+      /** Weights of the octant as m_weights, in fixed point */
+      std::vector<int16_t> m_fixedWeights;
+      
+      /** Value of the unit of the fixed point weights k */
+      double m_fixedScale[NUM_WEIGHTS];
+      
+      /** Sum of the fixed point rounding errors of the weights k */
+      double m_fixedError[NUM_WEIGHTS];
+      
+      /** Solid angle of the whole sphere, as summed on the texels */
+      double m_sumWeight;
+      
+    
+    public:
+      explicit WeightTable(const int texRes);
+      
+      int getResolution() const { return m_texRes; }
+      int getHalfResolution() const { return m_halfRes; }
+      int getNumTileRows() const { return m_numTileRows; }
+      double getSumWeight() const { return m_sumWeight; }
+      size_t getMemorySize() const 
+      { 
+        return m_weights.size() * sizeof(float) + m_fixedWeights.size() * sizeof(int16_t); 
+      }
+      
+      /** Value of the unit of the fixed point weights k */
+      double getFixedScale(const int k) const { return m_fixedScale[k]; }
+      
+      /** Upper bound of the error of the fixed point moments of a face, 
+       *  relative to the moment 0 of a face of constant maximal color. 
+       *  Each weight being rounded to half a unit, it is at most of the order 
+       *  of 2^-15 for a weight as large as the mean one. */
+      double getFixedErrorBound() const;
+      
+      /** Return the weights of the tile (ti, tj), tj <= ti. The octant entry 
+       *  (ii, jj) = (ti, tj) * TILE_SIZE + (i, j) is the texel of coordinates
+       *  (u, v) = (2 * (jj, ii) + 1) / texRes and its weight k is at 
+       *  [(i * NUM_WEIGHTS + k) * TILE_SIZE + j]. */
+      const float* getTile(const int ti, const int tj) const
+      { 
+        return &m_weights[ ((ti * (ti+1)) / 2 + tj) * TILE_WEIGHTS ]; 
+      }
+      
+      /** Return the fixed point weights of the tile (ti, tj), as getTile */
+      const int16_t* getFixedTile(const int ti, const int tj) const
+      { 
+        return &m_fixedWeights[ ((ti * (ti+1)) / 2 + tj) * TILE_WEIGHTS ]; 
+      }
+      
+      /** Add the monomials moments of the octant tile rows [firstTileRow, 
+       *  lastTileRow) of 'count' (<= MAX_BATCH_SIZE) faces of the same format
+       *  to moments[0..count-1], using the folding functions of kernel. 
+       *  Colors are not scaled (cf. PixelTraits::COLOR_SCALE). */
+      void projectTileRows( const ImageView_t *const faces[], const size_t count, 
+                            const int firstTileRow, const int lastTileRow, 
+                            const SIMDKernel kernel, 
+                            float (*moments)[3][NUM_WEIGHTS]) const;
+      
+      /** As projectTileRows for 8-bit faces (PIXEL_RGB8 or PIXEL_RGBA8), with 
+       *  the fixed point weights : the moments are exact integers, to be 
+       *  multiplied by getFixedScale(k), so their sum does not depend on its 
+       *  order, nor on the kernel. */
+      void projectTileRowsFixed( const ImageView_t *const faces[], const size_t count, 
+                                 const int firstTileRow, const int lastTileRow, 
+                                 const SIMDKernel kernel, 
+                                 int64_t (*moments)[3][NUM_WEIGHTS]) const;
+      
+      /** Add the SH coefficients of the face texId given its moments */
+      static 
+      void addFaceMoments( const int texId, const double moments[3][NUM_WEIGHTS], 
+                           double shCoeff[3][9]);
+      
+      /** Return the table of a resolution, built on first request */
+      static 
+      std::shared_ptr<const WeightTable> get(const int texRes);
+      
+    private:
+      template<PixelFormat Format>
+      void _projectTileRows( const ImageView_t *const faces[], const size_t count, 
+                             const int firstTileRow, const int lastTileRow, 
+                             const SIMDKernel kernel, 
+                             float (*moments)[3][NUM_WEIGHTS]) const;
+      
+      template<PixelFormat Format>
+      void _projectTileRowsFixed( const ImageView_t *const faces[], const size_t count, 
+                                  const int firstTileRow, const int lastTileRow, 
+                                  const SIMDKernel kernel, 
+                                  int64_t (*moments)[3][NUM_WEIGHTS]) const;
+      
+      WeightTable(const WeightTable&);
+      WeightTable& operator =(const WeightTable&) const;
+  };
+  
+} //namespace IrradianceEnvMap
+
+
+#endif //IRRADIANCEWEIGHTTABLE_HPP
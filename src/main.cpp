@@ -37,9 +37,12 @@
 #include <sys/types.h> 
 #include <unistd.h>
 
+#include <GLType/Texture.hpp>
 #include <tools/TCamera.hpp>
 #include <tools/Timer.hpp>
 #include <tools/Logger.hpp>
+#include "irradianceHBasis.hpp"
+#include "irradianceSH.hpp"
 #include "App.hpp"
 
 
@@ -87,6 +90,16 @@ namespace
 
 int main(int argc, char *argv[])
 {  
+  // Offline bake of cubemap assets : "--bake path/*.jpg ..."
+  if ((argc > 1) && (0 == strcmp( argv[1], "--bake")))
+  {
+    bool bBaked = true;
+    for (int i=2; i<argc; ++i) {
+      bBaked = TextureCubemap::bakeAsset( argv[i] ) && bBaked;
+    }
+    return bBaked ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  
   initApp( argc, argv);  
   
   glutMainLoop();
@@ -195,6 +208,14 @@ namespace
     glswInit();
     glswSetPath("./shaders/", ".glsl");
     glswAddDirectiveToken("*", "#version 330 core");
+    
+    char shOrderDirective[32];
+    sprintf( shOrderDirective, "#define SH_ORDER %d", IEM_SH_ORDER);
+    glswAddDirectiveToken("SH", shOrderDirective);
+    
+    char hbasisDirective[32];
+    sprintf( hbasisDirective, "#define HBASIS_SIZE %d", IEM_HBASIS_SIZE);
+    glswAddDirectiveToken("HBasis", hbasisDirective);
   
   
     // App Objects
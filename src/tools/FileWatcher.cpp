@@ -0,0 +1,115 @@
+/**
+ *
+ *      \file FileWatcher.cpp
+ *
+ */
+
+
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+
+FileWatcher::FileWatcher()
+  : m_fd(-1)
+{
+  #ifdef __linux__
+  m_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+  if (m_fd < 0) {
+    fprintf( stderr, "FileWatcher : inotify unavailable (%s).\n", strerror(errno));
+  }
+  #endif
+}
+
+FileWatcher::~FileWatcher()
+{
+  #ifdef __linux__
+  if (m_fd >= 0) {
+    close( m_fd );
+  }
+  #endif
+}
+
+int FileWatcher::addFile(const std::string &path)
+{
+  if (m_fd < 0) {
+    return -1;
+  }
+
+  #ifdef __linux__
+  const size_t slash = path.find_last_of( '/' );
+  const std::string dirname = (slash == path.npos) ? "." : path.substr( 0, slash + 1);
+  const std::string filename = (slash == path.npos) ? path : path.substr( slash + 1 );
+
+  // The same watch is returned for every file of a directory
+  const int wd = inotify_add_watch( m_fd, dirname.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (wd < 0)
+  {
+    fprintf( stderr, "FileWatcher : can't watch %s (%s).\n", dirname.c_str(), strerror(errno));
+    return -1;
+  }
+
+  Watch_t watch = { wd, filename };
+  m_files.push_back( watch );
+  return int(m_files.size()) - 1;
+  #else
+  return -1;
+  #endif
+}
+
+size_t FileWatcher::poll(std::vector<int> &changed)
+{
+  const size_t first = changed.size();
+
+  #ifdef __linux__
+  if (m_fd < 0) {
+    return 0u;
+  }
+
+  alignas(struct inotify_event) char buffer[4096];
+  ssize_t length;
+
+  while ((length = read( m_fd, buffer, sizeof(buffer))) > 0)
+  {
+    for (ssize_t offset = 0; offset < length; )
+    {
+      const struct inotify_event *event =
+        reinterpret_cast<const struct inotify_event*>(buffer + offset);
+      offset += sizeof(struct inotify_event) + event->len;
+
+      if (0u == event->len) {
+        continue;
+      }
+
+      for (size_t i=0u; i<m_files.size(); ++i)
+      {
+        const int id = int(i);
+        if ((m_files[i].wd == event->wd) && (m_files[i].filename == event->name) &&
+            (std::find( changed.begin() + first, changed.end(), id) == changed.end()))
+        {
+          changed.push_back( id );
+        }
+      }
+    }
+  }
+  #endif
+
+  return changed.size() - first;
+}
+
+bool FileWatcher::isSupported()
+{
+  #ifdef __linux__
+  return true;
+  #else
+  return false;
+  #endif
+}
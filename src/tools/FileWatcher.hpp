@@ -0,0 +1,58 @@
+/**
+ *
+ *      \file FileWatcher.hpp
+ *
+ *      Notify the files written since the last poll, without blocking (eg.
+ *      the faces of a cubemap being edited).
+ *
+ *      Uses inotify on Linux, on the directories of the files so that the
+ *      files replaced by a rename (as saved by most editors) are seen too.
+ *      Other systems never report any change.
+ *
+ */
+
+
+#pragma once
+
+#ifndef FILEWATCHER_HPP
+#define FILEWATCHER_HPP
+
+#include <string>
+#include <vector>
+
+
+class FileWatcher
+{
+  protected:
+    struct Watch_t
+    {
+      int wd;                   // inotify watch of the directory
+      std::string filename;     // in the directory
+    };
+
+    int m_fd;
+    std::vector<Watch_t> m_files;   // file i at m_files[i]
+
+
+  public:
+    FileWatcher();
+    ~FileWatcher();
+
+    /** Watch a file, return its id (-1 on failure) */
+    int addFile(const std::string &path);
+
+    /** Append to changed the ids of the files written since the last poll,
+     *  once each, and return their number */
+    size_t poll(std::vector<int> &changed);
+
+    /** Return true if changes can be notified on this system */
+    static bool isSupported();
+
+
+  private:
+    FileWatcher(const FileWatcher&);
+    FileWatcher& operator =(const FileWatcher&) const;
+};
+
+
+#endif //FILEWATCHER_HPP
@@ -0,0 +1,99 @@
+/**
+ *
+ *        \file Half.cpp
+ *
+ */
+
+
+#include "Half.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define HALF_F16C  1
+  #include <immintrin.h>
+#else
+  #define HALF_F16C  0
+#endif
+
+
+static
+void convertHalfToFloatScalar( const uint16_t *src, const size_t count, float *dst)
+{
+  for (size_t i=0u; i<count; ++i) {
+    dst[i] = halfToFloat( src[i] );
+  }
+}
+
+static
+void convertFloatToHalfScalar( const float *src, const size_t count, uint16_t *dst)
+{
+  for (size_t i=0u; i<count; ++i) {
+    dst[i] = floatToHalf( src[i] );
+  }
+}
+
+
+#if HALF_F16C
+
+#pragma GCC push_options
+#pragma GCC target("avx,f16c")
+
+static
+void convertHalfToFloatF16C( const uint16_t *src, const size_t count, float *dst)
+{
+  size_t i = 0u;
+  for (; i+8u <= count; i+=8u)
+  {
+    const __m128i h = _mm_loadu_si128( reinterpret_cast<const __m128i*>(src + i) );
+    _mm256_storeu_ps( dst + i, _mm256_cvtph_ps(h) );
+  }
+  convertHalfToFloatScalar( src + i, count - i, dst + i);
+}
+
+static
+void convertFloatToHalfF16C( const float *src, const size_t count, uint16_t *dst)
+{
+  size_t i = 0u;
+  for (; i+8u <= count; i+=8u)
+  {
+    const __m128i h = _mm256_cvtps_ph( _mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i), h);
+  }
+  convertFloatToHalfScalar( src + i, count - i, dst + i);
+}
+
+#pragma GCC pop_options
+
+static
+bool hasF16C()
+{
+  return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+}
+
+#endif
+
+
+void convertHalfToFloat( const uint16_t *src, const size_t count, float *dst)
+{
+  typedef void (*ConvertFn)( const uint16_t*, const size_t, float*);
+
+  #if HALF_F16C
+  static const ConvertFn convert = hasF16C() ? convertHalfToFloatF16C : convertHalfToFloatScalar;
+  #else
+  static const ConvertFn convert = convertHalfToFloatScalar;
+  #endif
+
+  convert( src, count, dst);
+}
+
+void convertFloatToHalf( const float *src, const size_t count, uint16_t *dst)
+{
+  typedef void (*ConvertFn)( const float*, const size_t, uint16_t*);
+
+  #if HALF_F16C
+  static const ConvertFn convert = hasF16C() ? convertFloatToHalfF16C : convertFloatToHalfScalar;
+  #else
+  static const ConvertFn convert = convertFloatToHalfScalar;
+  #endif
+
+  convert( src, count, dst);
+}
@@ -0,0 +1,78 @@
+/**
+ *
+ *        \file Half.hpp
+ *
+ *      IEEE half precision floats, stored as uint16_t.
+ *      The row conversions use F16C when the CPU supports it.
+ *
+ */
+
+
+#pragma once
+
+#ifndef HALF_HPP
+#define HALF_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+
+/** Convert an IEEE half to a float (denormals, infinities & NaN included) */
+inline float halfToFloat( const uint16_t h )
+{
+  const float magic = 5.192296858534828e+33f;   // 2^112, rebias the exponent
+  const float infnan = 65536.0f;                // smallest rebiased inf / NaN
+
+  uint32_t bits = uint32_t(h & 0x7fff) << 13;
+  float f;
+  memcpy( &f, &bits, sizeof(f));
+
+  f *= magic;
+  memcpy( &bits, &f, sizeof(f));
+  bits |= (f >= infnan) ? (255u << 23) : 0u;
+  bits |= uint32_t(h & 0x8000) << 16;
+
+  memcpy( &f, &bits, sizeof(f));
+  return f;
+}
+
+/** Convert a float to an IEEE half, rounding to nearest even */
+inline uint16_t floatToHalf( const float value )
+{
+  uint32_t bits;
+  memcpy( &bits, &value, sizeof(bits));
+
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  bits &= 0x7fffffff;
+
+  // Overflow, infinity or NaN
+  if (bits >= (143u << 23)) {
+    return sign | ((bits > (255u << 23)) ? 0x7e00 : 0x7c00);
+  }
+
+  // Denormal or zero, rounded by the float addition
+  if (bits < (113u << 23))
+  {
+    float f;
+    memcpy( &f, &bits, sizeof(f));
+    f += 0.5f;
+    memcpy( &bits, &f, sizeof(f));
+    return sign | uint16_t(bits - (126u << 23));
+  }
+
+  // Normal, rebias the exponent & round the mantissa
+  const uint32_t mantissaOdd = (bits >> 13) & 1u;
+  bits += 0xc8000fffu + mantissaOdd;
+  return sign | uint16_t(bits >> 13);
+}
+
+
+/** Convert 'count' halves to floats */
+void convertHalfToFloat( const uint16_t *src, const size_t count, float *dst);
+
+/** Convert 'count' floats to halves, rounding to nearest even */
+void convertFloatToHalf( const float *src, const size_t count, uint16_t *dst);
+
+
+#endif //HALF_HPP
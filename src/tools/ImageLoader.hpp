@@ -2,8 +2,12 @@
  * 
  *        ImageLoader.hpp
  * 
- *    Simple FreeImage wrapper to load 2D & Rectangle image for OpenGL
- *    (stored as unsigned char). 
+ *    Simple FreeImage wrapper to load 2D & Rectangle image for OpenGL.
+ *    
+ *    LDR images are stored as unsigned char. HDR images (FIT_RGBF, 
+ *    FIT_RGBAF, FIT_RGB16, FIT_RGBA16, ...) keep their range and are stored
+ *    as half or float RGB(A), for a GL_RGB16F / GL_RGBA16F internal format 
+ *    (16-bit integer channels being mapped to [0, 1]).
  *  
  *    TODO : rewrite it completely to handle multiples internal format
  */
@@ -16,7 +20,11 @@
 #include <FreeImage/FreeImage.h>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <vector>
+#include "Half.hpp"
+#include "PixelSwizzle.hpp"
 
 
 struct Image_t
@@ -31,6 +39,9 @@ struct Image_t
   GLenum type;
   GLubyte *data;  
   
+  /** FreeImage bitmap holding data, when it was converted in place */
+  FIBITMAP *bitmap;
+  
   
   Image_t()
     : target(GL_INVALID_ENUM),
@@ -39,7 +50,8 @@ struct Image_t
       height(0),
       format(GL_INVALID_ENUM),
       type(GL_INVALID_ENUM),
-      data(0)
+      data(0),
+      bitmap(0)
   {
    	// when using FreeImage as a static library
     #ifdef FREEIMAGE_LIB
@@ -59,12 +71,34 @@ struct Image_t
   
   void clean()
   {
-    if (data != 0) {
+    if (bitmap != 0) 
+    {
+      FreeImage_Unload(bitmap);
+      bitmap = 0;
+      data = 0;
+    }
+    else if (data != 0) 
+    {
       delete [] data;
+      data = 0;
     }
   }
   
-  bool load(const char *filename)
+  /** Size of the pixels in bytes */
+  size_t getMemorySize() const 
+  { 
+    return size_t(bytesPerPixel) * width * height; 
+  }
+  
+  /** Load an image, HDR ones being stored as halves when bHalfFloat is
+   *  set, as floats otherwise.
+   *  LDR images are converted in place in their FreeImage bitmap, without a
+   *  second copy of the pixels (unless its rows are padded). With bRawBGR,
+   *  their 24 / 32 bits rows are not even converted : they stay bottom-up
+   *  in GL_BGR / GL_BGRA order, ie. rotated by 180 degrees from the default
+   *  layout, for the textures sampled with flipped coordinates (those are
+   *  not supported by the irradiance functions). */
+  bool load(const char *filename, const bool bHalfFloat=true, const bool bRawBGR=false)
   {
     FREE_IMAGE_FORMAT format = FreeImage_GetFileType( filename,0);
     FIBITMAP* image = FreeImage_Load( format, filename);
@@ -75,6 +109,17 @@ struct Image_t
       return false;
     }
     
+    if (FIT_BITMAP != FreeImage_GetImageType(image))
+    {
+      const bool bLoaded = loadHDR( image, bHalfFloat);
+      FreeImage_Unload(image);
+      
+      if (!bLoaded) {
+        std::cerr << "ImageLoader : "<<filename << " can't be loaded."<<std::endl;
+      }
+      return bLoaded;
+    }
+    
     if (setDefaultAttributes(image) == false)
     {    
       // Convert to 32 bits
@@ -91,40 +136,49 @@ struct Image_t
    
     clean();
     
-    data = new GLubyte[bytesPerPixel*width*height];
     unsigned char* bits = (unsigned char*)FreeImage_GetBits(image);
-
-    const size_t numPixels = width*height;
+    const size_t rowSize = size_t(bytesPerPixel) * width;
+    const bool bPacked = (FreeImage_GetPitch(image) == rowSize);
     
-    // FreeImage loads in BGR format, so we need to swap the RED & BLUE bytes (or use GL_BGR).
-    // Furthermore, the pixel order is invert to match openGL implementation	
-    if (bytesPerPixel == 4)
+    // FreeImage loads bottom-up BGR rows : the pixel order is inverted and 
+    // the RED & BLUE bytes swapped (or kept for GL_BGR), row by row
+    if (bPacked && bRawBGR && (bytesPerPixel >= 3u))
     {
-      const size_t end = 4u*(numPixels-1u);
+      this->format = (4u == bytesPerPixel) ? GL_BGRA : GL_BGR;   // (not the file format)
+      bitmap = image;
+      data = bits;
+    }
+    else if (bPacked)
+    {
+      // In place, the bitmap keeping the pixels
+      std::vector<unsigned char> row( rowSize );
       
-      for (size_t j=0u; j<numPixels; ++j)
+      for (int y=0; y<(height+1)/2; ++y)
       {
-        size_t idx = 4u*j;
-        data[idx+0u] = bits[end-idx+2u];
-        data[idx+1u] = bits[end-idx+1u];
-        data[idx+2u] = bits[end-idx+0u];
-        data[idx+3u] = bits[end-idx+3u];
+        unsigned char *top = bits + y * rowSize;
+        unsigned char *bottom = bits + (height-1-y) * rowSize;
+        
+        swizzleRow( top, width, bytesPerPixel, &row[0]);
+        if (top != bottom) {
+          swizzleRow( bottom, width, bytesPerPixel, top);
+        }
+        memcpy( bottom, &row[0], rowSize);
       }
-    } 
-    else if (bytesPerPixel == 3)
+      
+      bitmap = image;
+      data = bits;
+    }
+    else
     {
-      const size_t end = 3u*(numPixels-1u);
+      data = new GLubyte[rowSize * height];
       
-      for (size_t j=0u; j<numPixels; ++j)
-      {
-        size_t idx = 3u*j;
-        data[idx+0u] = bits[end-idx+2u];
-        data[idx+1u] = bits[end-idx+1u];
-        data[idx+2u] = bits[end-idx+0u];
+      for (int y=0; y<height; ++y) {
+        swizzleRow( FreeImage_GetScanLine( image, height-1-y), width, bytesPerPixel, 
+                    data + y * rowSize);
       }
+      
+      FreeImage_Unload(image);
     }
-
-    FreeImage_Unload(image);
     
     return true;
   }
@@ -133,6 +187,81 @@ struct Image_t
     Image_t(const Image_t&);
     const Image_t& operator=(const Image_t&) const;
     
+    
+    bool loadHDR(FIBITMAP *dib, const bool bHalfFloat)
+    {
+      switch (FreeImage_GetImageType(dib))
+      {
+        case FIT_RGBF:
+          copyHDR<float>( dib, 3u, 1.0f, bHalfFloat);
+        return true;
+        
+        case FIT_RGBAF:
+          copyHDR<float>( dib, 4u, 1.0f, bHalfFloat);
+        return true;
+        
+        case FIT_RGB16:
+          copyHDR<unsigned short>( dib, 3u, 1.0f / 65535.0f, bHalfFloat);
+        return true;
+        
+        case FIT_RGBA16:
+          copyHDR<unsigned short>( dib, 4u, 1.0f / 65535.0f, bHalfFloat);
+        return true;
+        
+        default:
+        break;
+      }
+      
+      // Other types (greyscale, complex, ...) go through a float copy
+      FIBITMAP *rgbf = FreeImage_ConvertToRGBF(dib);
+      if (rgbf == 0) {
+        return false;
+      }
+      
+      copyHDR<float>( rgbf, 3u, 1.0f, bHalfFloat);
+      FreeImage_Unload(rgbf);
+      
+      return true;
+    }
+    
+    /** Copy the HDR pixels of dib, whose channels are already in RGB(A) 
+     *  order. As for LDR images, the pixel order is inverted. */
+    template<typename Channel_t>
+    void copyHDR(FIBITMAP *dib, const unsigned int nc, const float scale, 
+                 const bool bHalfFloat)
+    {
+      width = FreeImage_GetWidth(dib);
+      height = FreeImage_GetHeight(dib);
+      target = (width==height)? GL_TEXTURE_2D : GL_TEXTURE_RECTANGLE;
+      format = (4u == nc) ? GL_RGBA : GL_RGB;
+      internalFormat = (4u == nc) ? GL_RGBA16F : GL_RGB16F;
+      type = bHalfFloat ? GL_HALF_FLOAT : GL_FLOAT;
+      bytesPerPixel = nc * (bHalfFloat ? sizeof(uint16_t) : sizeof(float));
+      
+      clean();
+      data = new GLubyte[getMemorySize()];
+      
+      const size_t rowSize = size_t(width) * nc;
+      std::vector<float> row( rowSize );
+      
+      for (int y=0; y<height; ++y)
+      {
+        const Channel_t *bits = (const Channel_t*)FreeImage_GetScanLine( dib, height-1-y);
+        
+        for (int x=0; x<width; ++x) {
+          for (unsigned int c=0u; c<nc; ++c) {
+            row[x*nc + c] = scale * float(bits[(width-1-x)*nc + c]);
+          }
+        }
+        
+        if (bHalfFloat) {
+          convertFloatToHalf( &row[0], rowSize, reinterpret_cast<uint16_t*>(data) + y*rowSize);
+        } else {
+          memcpy( reinterpret_cast<float*>(data) + y*rowSize, &row[0], rowSize * sizeof(float));
+        }
+      }
+    }
+    
   
     bool setDefaultAttributes(FIBITMAP *dib)
     { 
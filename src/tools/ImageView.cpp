@@ -0,0 +1,113 @@
+/**
+ *
+ *        \file ImageView.cpp
+ *
+ */
+
+
+#include "ImageView.hpp"
+
+#include <cstring>
+
+
+CubemapLayout getCubemapLayout(const Image_t &image)
+{
+  const int w = image.width;
+  const int h = image.height;
+
+  if ((w <= 0) || (h <= 0)) {
+    return NUM_CUBEMAP_LAYOUT;
+  }
+
+  if ((3 * w == 4 * h) && (0 == w % 4)) return CUBEMAP_HORIZONTAL_CROSS;
+  if ((4 * w == 3 * h) && (0 == w % 3)) return CUBEMAP_VERTICAL_CROSS;
+  if ((w == 6 * h))                     return CUBEMAP_HORIZONTAL_STRIP;
+  if ((h == 6 * w))                     return CUBEMAP_VERTICAL_STRIP;
+
+  return NUM_CUBEMAP_LAYOUT;
+}
+
+CubemapLayout getCubemapFaces(const Image_t &image, ImageView_t faces[6], Image_t &rotated)
+{
+/**
+ * Image_t::load mirrors the rows of the file : the columns of the faces are
+ * reversed, as well as the order of the faces along a row. Hence, with +X,
+ * -X, +Y, -Y, +Z & -Z at (column, row) :
+ *
+ *    file horizontal cross : (2,1) (0,1) (1,0) (1,2) (1,1) (3,1)
+ *    loaded                : (1,1) (3,1) (2,0) (2,2) (2,1) (0,1)
+ *
+ * The -Z face of a vertical cross being upside down in the file, it is
+ * upside down in the loaded image too, and rotated back to a copy.
+ */
+
+  static const int kCells[NUM_CUBEMAP_LAYOUT][6][2] =
+  {
+    { {1,1}, {3,1}, {2,0}, {2,2}, {2,1}, {0,1} },    // horizontal cross
+    { {0,1}, {2,1}, {1,0}, {1,2}, {1,1}, {1,3} },    // vertical cross
+    { {5,0}, {4,0}, {3,0}, {2,0}, {1,0}, {0,0} },    // horizontal strip
+    { {0,0}, {0,1}, {0,2}, {0,3}, {0,4}, {0,5} }     // vertical strip
+  };
+
+  const CubemapLayout layout = getCubemapLayout( image );
+  if (NUM_CUBEMAP_LAYOUT == layout) {
+    return layout;
+  }
+
+  const int size = (CUBEMAP_HORIZONTAL_CROSS == layout) ? image.width / 4 :
+                   (CUBEMAP_VERTICAL_CROSS == layout)   ? image.width / 3 :
+                   (CUBEMAP_HORIZONTAL_STRIP == layout) ? image.height :
+                                                          image.width;
+
+  for (int i=0; i<6; ++i) {
+    faces[i] = ImageView_t( image, kCells[layout][i][0] * size, kCells[layout][i][1] * size,
+                            size, size);
+  }
+
+  if (CUBEMAP_VERTICAL_CROSS == layout)
+  {
+    const ImageView_t &src = faces[5];
+    const unsigned int bpp = src.bytesPerPixel;
+
+    rotated.clean();
+    rotated.bytesPerPixel = bpp;
+    rotated.target = GL_TEXTURE_2D;
+    rotated.internalFormat = src.internalFormat;
+    rotated.width = rotated.height = size;
+    rotated.format = src.format;
+    rotated.type = src.type;
+    rotated.data = new GLubyte[rotated.getMemorySize()];
+
+    for (int y=0; y<size; ++y)
+    {
+      const GLubyte *srcRow = src.getRow( size-1-y );
+      GLubyte *dstRow = rotated.data + size_t(y) * size * bpp;
+
+      for (int x=0; x<size; ++x) {
+        memcpy( dstRow + x * bpp, srcRow + (size-1-x) * bpp, bpp);
+      }
+    }
+
+    faces[5] = ImageView_t( rotated );
+  }
+
+  return layout;
+}
+
+void copyImageView(const ImageView_t &view, Image_t &image)
+{
+  image.clean();
+  image.bytesPerPixel = view.bytesPerPixel;
+  image.target = (view.width == view.height) ? GL_TEXTURE_2D : GL_TEXTURE_RECTANGLE;
+  image.internalFormat = view.internalFormat;
+  image.width = view.width;
+  image.height = view.height;
+  image.format = view.format;
+  image.type = view.type;
+  image.data = new GLubyte[image.getMemorySize()];
+
+  const size_t rowSize = size_t(view.bytesPerPixel) * view.width;
+  for (int y=0; y<view.height; ++y) {
+    memcpy( image.data + y * rowSize, view.getRow( y ), rowSize);
+  }
+}
@@ -0,0 +1,104 @@
+/**
+ *
+ *        \file ImageView.hpp
+ *
+ *      Non-owning view of the pixels of an image, whose rows may be apart
+ *      in memory : a region of a larger image, such as a face of a cubemap
+ *      stored as a cross or a strip, used in place without being copied.
+ *
+ */
+
+
+#pragma once
+
+#ifndef IMAGEVIEW_HPP
+#define IMAGEVIEW_HPP
+
+#include <cstddef>
+#include "ImageLoader.hpp"
+
+
+struct ImageView_t
+{
+  const GLubyte *data;          // first pixel of the first row
+  GLsizei width;
+  GLsizei height;
+  size_t rowStride;             // bytes from a row to the next one
+  unsigned int bytesPerPixel;   // bytes from a pixel to the next one
+
+  GLint internalFormat;
+  GLenum format;
+  GLenum type;
+
+
+  ImageView_t()
+    : data(0),
+      width(0),
+      height(0),
+      rowStride(0u),
+      bytesPerPixel(0u),
+      internalFormat(0),
+      format(GL_INVALID_ENUM),
+      type(GL_INVALID_ENUM)
+  {}
+
+  /** View of a whole image */
+  ImageView_t(const Image_t &image)
+    : data(image.data),
+      width(image.width),
+      height(image.height),
+      rowStride(size_t(image.bytesPerPixel) * image.width),
+      bytesPerPixel(image.bytesPerPixel),
+      internalFormat(image.internalFormat),
+      format(image.format),
+      type(image.type)
+  {}
+
+  /** View of the w x h pixels of an image from (x, y) */
+  ImageView_t(const Image_t &image, const int x, const int y, const int w, const int h)
+    : data(image.data + (size_t(y) * image.width + x) * image.bytesPerPixel),
+      width(w),
+      height(h),
+      rowStride(size_t(image.bytesPerPixel) * image.width),
+      bytesPerPixel(image.bytesPerPixel),
+      internalFormat(image.internalFormat),
+      format(image.format),
+      type(image.type)
+  {}
+
+  const GLubyte* getRow(const int y) const { return data + y * rowStride; }
+
+  /** Size of the pixels viewed in bytes, without the gaps between rows */
+  size_t getMemorySize() const { return size_t(bytesPerPixel) * width * height; }
+
+  /** Return true when the rows follow each other */
+  bool isPacked() const { return rowStride == size_t(bytesPerPixel) * width; }
+};
+
+
+/** Layouts of a cubemap stored in a single image */
+enum CubemapLayout
+{
+  CUBEMAP_HORIZONTAL_CROSS,     // 4 x 3 faces
+  CUBEMAP_VERTICAL_CROSS,       // 3 x 4 faces, -Z at the bottom, upside down
+  CUBEMAP_HORIZONTAL_STRIP,     // 6 x 1 faces, +X -X +Y -Y +Z -Z
+  CUBEMAP_VERTICAL_STRIP,       // 1 x 6 faces, +X -X +Y -Y +Z -Z
+
+  NUM_CUBEMAP_LAYOUT
+};
+
+/** Return the layout of a cubemap image from its size, NUM_CUBEMAP_LAYOUT
+ *  when it is not one */
+CubemapLayout getCubemapLayout(const Image_t &image);
+
+/** Set the views of the faces of a cubemap image, as loaded by Image_t::load
+ *  (mirrored from the file, as the faces loaded one by one). The faces are
+ *  viewed in place, but the -Z face of a vertical cross, rotated in the
+ *  file, which is copied to 'rotated'. Return the layout of the image. */
+CubemapLayout getCubemapFaces(const Image_t &image, ImageView_t faces[6], Image_t &rotated);
+
+/** Copy the pixels of a view to a packed image */
+void copyImageView(const ImageView_t &view, Image_t &image);
+
+
+#endif //IMAGEVIEW_HPP
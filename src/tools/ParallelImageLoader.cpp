@@ -0,0 +1,80 @@
+/**
+ *
+ *      \file ParallelImageLoader.cpp
+ *
+ */
+
+
+#include "ParallelImageLoader.hpp"
+
+#include <chrono>
+#include "ImageLoader.hpp"
+
+
+ParallelImageLoader::ParallelImageLoader(const std::string filenames[], Image_t images[],
+                                         const size_t count, unsigned int numThreads)
+  : m_filenames(filenames),
+    m_images(images),
+    m_count(count),
+    m_nextImage(0u),
+    m_loaded(count, 0),
+    m_decodeTimes(count, 0.0),
+    m_numReturned(0u)
+{
+  if ((0u == numThreads) || (numThreads > count)) {
+    numThreads = count;
+  }
+
+  m_ready.reserve( count );
+  m_threads.reserve( numThreads );
+
+  for (unsigned int i=0u; i<numThreads; ++i) {
+    m_threads.push_back( std::thread( &ParallelImageLoader::_decodeLoop, this) );
+  }
+}
+
+ParallelImageLoader::~ParallelImageLoader()
+{
+  for (size_t i=0u; i<m_threads.size(); ++i) {
+    m_threads[i].join();
+  }
+}
+
+int ParallelImageLoader::next(bool *bLoaded, double *decodeTime)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (m_numReturned == m_count) {
+    return -1;
+  }
+
+  m_readyCond.wait( lock, [this]() { return m_numReturned < m_ready.size(); });
+
+  const size_t i = m_ready[m_numReturned++];
+
+  if (bLoaded) *bLoaded = (0 != m_loaded[i]);
+  if (decodeTime) *decodeTime = m_decodeTimes[i];
+
+  return int(i);
+}
+
+void ParallelImageLoader::_decodeLoop()
+{
+  typedef std::chrono::steady_clock Clock_t;
+
+  size_t i;
+  while ((i = m_nextImage++) < m_count)
+  {
+    const Clock_t::time_point tStart = Clock_t::now();
+    const bool bLoaded = m_images[i].load( m_filenames[i].c_str() );
+    const std::chrono::duration<double, std::milli> tDecode = Clock_t::now() - tStart;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_loaded[i] = bLoaded;
+      m_decodeTimes[i] = tDecode.count();
+      m_ready.push_back( i );
+    }
+    m_readyCond.notify_one();
+  }
+}
@@ -0,0 +1,74 @@
+/**
+ *
+ *      \file ParallelImageLoader.hpp
+ *
+ *      Decode a set of images (eg. the faces of a cubemap) concurrently on
+ *      their own threads, handing each one to the caller as soon as it is
+ *      ready, so that the caller (the GL thread) uploads the first images
+ *      while the others are still decoding.
+ *
+ *      The images are decoded by Image_t::load, the BGR swap & flip included.
+ *
+ */
+
+
+#pragma once
+
+#ifndef PARALLELIMAGELOADER_HPP
+#define PARALLELIMAGELOADER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Image_t;
+
+
+class ParallelImageLoader
+{
+  protected:
+    const std::string *m_filenames;
+    Image_t *m_images;
+    size_t m_count;
+
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_nextImage;
+
+    /// Decoded images not yet returned by next, in completion order
+    std::mutex m_mutex;
+    std::condition_variable m_readyCond;
+    std::vector<size_t> m_ready;
+    std::vector<char> m_loaded;
+    std::vector<double> m_decodeTimes;
+    size_t m_numReturned;
+
+
+  public:
+    /** Start decoding filenames[i] to images[i] for i in [0, count), on
+     *  numThreads threads (count if 0). The images must stay alive until
+     *  the loader is destroyed. */
+    ParallelImageLoader(const std::string filenames[], Image_t images[], const size_t count,
+                        unsigned int numThreads=0u);
+
+    /** Wait for the images still decoding */
+    ~ParallelImageLoader();
+
+    /** Wait for the next decoded image and return its index, -1 once every
+     *  image was returned. bLoaded tells if it was loaded successfully, and
+     *  decodeTime is the time of its decoding, in milliseconds. */
+    int next(bool *bLoaded=0, double *decodeTime=0);
+
+
+  private:
+    ParallelImageLoader(const ParallelImageLoader&);
+    ParallelImageLoader& operator =(const ParallelImageLoader&) const;
+
+    void _decodeLoop();
+};
+
+
+#endif //PARALLELIMAGELOADER_HPP
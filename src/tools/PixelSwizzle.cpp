@@ -0,0 +1,161 @@
+/**
+ *
+ *        \file PixelSwizzle.cpp
+ *
+ */
+
+
+#include "PixelSwizzle.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define SWIZZLE_X86  1
+  #include <immintrin.h>
+#else
+  #define SWIZZLE_X86  0
+#endif
+
+
+static
+void swizzleRowScalar( const unsigned char *src, const size_t count, const unsigned int nc,
+                       unsigned char *dst)
+{
+  const unsigned char *p = src + (count - 1u) * nc;
+
+  if (nc >= 3u)
+  {
+    for (size_t x=0u; x<count; ++x, p-=nc, dst+=nc)
+    {
+      dst[0] = p[2];
+      dst[1] = p[1];
+      dst[2] = p[0];
+      if (4u == nc) {
+        dst[3] = p[3];
+      }
+    }
+  }
+  else
+  {
+    for (size_t x=0u; x<count; ++x, p-=nc, dst+=nc) {
+      for (unsigned int c=0u; c<nc; ++c) {
+        dst[c] = p[c];
+      }
+    }
+  }
+}
+
+
+#if SWIZZLE_X86
+
+/**
+ * With 3 bytes per pixel, reversing the pixels & swapping red and blue is
+ * the reversal of the row bytes. With 4, the pixels of a block are reversed
+ * with their first three bytes.
+ */
+
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+
+static
+void swizzleRowSSSE3( const unsigned char *src, const size_t count, const unsigned int nc,
+                      unsigned char *dst)
+{
+  const __m128i kReverse3 = _mm_setr_epi8( 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 );
+  const __m128i kReverse4 = _mm_setr_epi8( 14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3 );
+
+  if ((3u != nc) && (4u != nc))
+  {
+    swizzleRowScalar( src, count, nc, dst);
+    return;
+  }
+
+  const __m128i mask = (3u == nc) ? kReverse3 : kReverse4;
+  const size_t size = count * nc;
+
+  // Blocks of 16 bytes (whole pixels for 4 bytes), from the end of src
+  size_t i = 0u;
+  for (; i+16u <= size; i+=16u)
+  {
+    const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>(src + size - 16u - i) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8( v, mask));
+  }
+
+  const size_t done = i / nc;
+  swizzleRowScalar( src, count - done, nc, dst + done * nc);
+}
+
+#pragma GCC pop_options
+
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+static
+void swizzleRowAVX2( const unsigned char *src, const size_t count, const unsigned int nc,
+                     unsigned char *dst)
+{
+  const __m256i kReverse3 = _mm256_setr_epi8( 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                              15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 );
+  const __m256i kReverse4 = _mm256_setr_epi8( 14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                              14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3 );
+
+  if ((3u != nc) && (4u != nc))
+  {
+    swizzleRowScalar( src, count, nc, dst);
+    return;
+  }
+
+  const __m256i mask = (3u == nc) ? kReverse3 : kReverse4;
+  const size_t size = count * nc;
+
+  // Blocks of 32 bytes, reversed in each lane then the lanes swapped
+  size_t i = 0u;
+  for (; i+32u <= size; i+=32u)
+  {
+    const __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(src + size - 32u - i) );
+    const __m256i r = _mm256_permute4x64_epi64( _mm256_shuffle_epi8( v, mask), 0x4e);
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>(dst + i), r);
+  }
+
+  const size_t done = i / nc;
+  swizzleRowScalar( src, count - done, nc, dst + done * nc);
+}
+
+#pragma GCC pop_options
+
+#endif
+
+
+void swizzleRow( const unsigned char *src, const size_t count, const unsigned int nc,
+                 unsigned char *dst)
+{
+  static const SwizzleRowFn swizzle = getSwizzleRow( SWIZZLE_AVX2 ) ? getSwizzleRow( SWIZZLE_AVX2 ) :
+                                      getSwizzleRow( SWIZZLE_SSSE3 ) ? getSwizzleRow( SWIZZLE_SSSE3 ) :
+                                                                       swizzleRowScalar;
+  swizzle( src, count, nc, dst);
+}
+
+SwizzleRowFn getSwizzleRow( const SwizzleKernel kernel )
+{
+  switch (kernel)
+  {
+    case SWIZZLE_SCALAR:
+      return swizzleRowScalar;
+
+    #if SWIZZLE_X86
+    case SWIZZLE_SSSE3:
+      return __builtin_cpu_supports("ssse3") ? swizzleRowSSSE3 : 0;
+
+    case SWIZZLE_AVX2:
+      return __builtin_cpu_supports("avx2") ? swizzleRowAVX2 : 0;
+    #endif
+
+    default:
+      return 0;
+  }
+}
+
+const char* getSwizzleKernelName( const SwizzleKernel kernel )
+{
+  static const char* sNames[NUM_SWIZZLE_KERNEL] = { "scalar", "SSSE3", "AVX2" };
+  return (kernel < NUM_SWIZZLE_KERNEL) ? sNames[kernel] : "unknown";
+}
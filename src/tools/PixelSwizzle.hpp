@@ -0,0 +1,47 @@
+/**
+ *
+ *        \file PixelSwizzle.hpp
+ *
+ *      Row conversion of the FreeImage bitmaps (bottom-up BGR(A)) to the
+ *      pixel order of Image_t : each row is reversed and its red & blue
+ *      bytes swapped. The rows use SSSE3 or AVX2 when the CPU supports it.
+ *
+ */
+
+
+#pragma once
+
+#ifndef PIXELSWIZZLE_HPP
+#define PIXELSWIZZLE_HPP
+
+#include <cstddef>
+
+
+/** Implementations of swizzleRow */
+enum SwizzleKernel
+{
+  SWIZZLE_SCALAR,
+  SWIZZLE_SSSE3,
+  SWIZZLE_AVX2,
+
+  NUM_SWIZZLE_KERNEL
+};
+
+/** Copy 'count' pixels of nc bytes (1 to 4) from src to dst in reverse
+ *  order, swapping their first and third bytes when nc >= 3. The rows
+ *  must not overlap. */
+typedef void (*SwizzleRowFn)( const unsigned char *src, const size_t count,
+                              const unsigned int nc, unsigned char *dst);
+
+/** Swizzle a row with the best kernel supported */
+void swizzleRow( const unsigned char *src, const size_t count, const unsigned int nc,
+                 unsigned char *dst);
+
+/** Return the row function of a kernel, null when the CPU does not support it */
+SwizzleRowFn getSwizzleRow( const SwizzleKernel kernel );
+
+/** Return the name of a kernel */
+const char* getSwizzleKernelName( const SwizzleKernel kernel );
+
+
+#endif //PIXELSWIZZLE_HPP
@@ -0,0 +1,136 @@
+/**
+ *
+ *      \file ThreadPool.cpp
+ *
+ */
+
+
+#include "ThreadPool.hpp"
+
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+  : m_pTask(0),
+    m_numTasks(0u),
+    m_nextTask(0u),
+    m_generation(0u),
+    m_numBusyWorkers(0u),
+    m_bQuit(false)
+{
+  _start(numThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+  _stop();
+}
+
+void ThreadPool::resize(unsigned int numThreads)
+{
+  _stop();
+  _start(numThreads);
+}
+
+void ThreadPool::parallelFor(size_t numTasks, const Task_t &task)
+{
+  if (0u == numTasks) {
+    return;
+  }
+
+  // Nothing to share, avoid waking up the workers
+  if (m_workers.empty() || (1u == numTasks))
+  {
+    for (size_t i=0u; i<numTasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_pTask = &task;
+    m_numTasks = numTasks;
+    m_nextTask = 0u;
+    m_numBusyWorkers = m_workers.size();
+    ++m_generation;
+  }
+  m_wakeCond.notify_all();
+
+  // The caller works too
+  _runTasks();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_doneCond.wait( lock, [this]{ return 0u == m_numBusyWorkers; });
+  m_pTask = 0;
+}
+
+unsigned int ThreadPool::getHardwareConcurrency()
+{
+  unsigned int n = std::thread::hardware_concurrency();
+  return (n > 0u) ? n : 1u;
+}
+
+
+void ThreadPool::_start(unsigned int numThreads)
+{
+  if (0u == numThreads) {
+    numThreads = getHardwareConcurrency();
+  }
+
+  // The new workers wait for the generations following 0, whatever the
+  // previous ones ran
+  m_bQuit = false;
+  m_generation = 0u;
+  m_workers.reserve( numThreads-1u );
+
+  for (unsigned int i=1u; i<numThreads; ++i) {
+    m_workers.push_back( std::thread(&ThreadPool::_workerLoop, this) );
+  }
+}
+
+void ThreadPool::_stop()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bQuit = true;
+  }
+  m_wakeCond.notify_all();
+
+  for (size_t i=0u; i<m_workers.size(); ++i) {
+    m_workers[i].join();
+  }
+  m_workers.clear();
+}
+
+void ThreadPool::_workerLoop()
+{
+  unsigned int generation = 0u;
+
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeCond.wait( lock, [&]{ return m_bQuit || (generation != m_generation); });
+
+      if (m_bQuit) {
+        return;
+      }
+      generation = m_generation;
+    }
+
+    _runTasks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (0u == --m_numBusyWorkers) {
+      m_doneCond.notify_one();
+    }
+  }
+}
+
+void ThreadPool::_runTasks()
+{
+  const Task_t &task = *m_pTask;
+
+  for (size_t i = m_nextTask++; i < m_numTasks; i = m_nextTask++) {
+    task(i);
+  }
+}
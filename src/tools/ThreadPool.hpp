@@ -0,0 +1,81 @@
+/**
+ *
+ *      \file ThreadPool.hpp
+ *
+ *      Fixed-size pool of worker threads used to split CPU work (eg. the
+ *      irradiance prefiltering) into independent tasks.
+ *
+ *      The calling thread takes part in the work, so a pool of N threads
+ *      spawns N-1 workers.
+ *
+ */
+
+
+#pragma once
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+  public:
+    typedef std::function<void(size_t)> Task_t;
+
+  protected:
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCond;
+    std::condition_variable m_doneCond;
+
+    const Task_t *m_pTask;
+    size_t m_numTasks;
+    std::atomic<size_t> m_nextTask;
+
+    unsigned int m_generation;
+    unsigned int m_numBusyWorkers;
+    bool m_bQuit;
+
+
+  public:
+    /** Create a pool of 'numThreads' threads (hardware concurrency if 0) */
+    explicit ThreadPool(unsigned int numThreads=0u);
+
+    ~ThreadPool();
+
+    /** Recreate the workers to use 'numThreads' threads */
+    void resize(unsigned int numThreads);
+
+    /** Return the number of threads used, the caller included */
+    unsigned int getNumThreads() const { return m_workers.size() + 1u; }
+
+    /** Run task(i) for i in [0, numTasks) and wait for their completion.
+     *  Tasks are picked in increasing order but may end in any order. */
+    void parallelFor(size_t numTasks, const Task_t &task);
+
+
+    /** Return the number of threads available on the system */
+    static unsigned int getHardwareConcurrency();
+
+
+  private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator =(const ThreadPool&) const;
+
+    void _start(unsigned int numThreads);
+    void _stop();
+    void _workerLoop();
+    void _runTasks();
+};
+
+
+#endif //THREADPOOL_HPP
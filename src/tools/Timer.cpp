@@ -65,7 +65,7 @@ double Timer::getAbsoluteTime()
     
     static timeval t;
     gettimeofday( &t, NULL);
-    appTime = t.tv_sec * 1000.0f + t.tv_usec * 0.001f;
+    appTime = t.tv_sec * 1000.0 + t.tv_usec * 0.001;
     
   #endif
   